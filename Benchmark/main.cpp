@@ -0,0 +1,2746 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: main.cpp
+// Micro benchmarks for the engine's CPU code paths.  Run with no arguments to
+// run every benchmark, or name the benchmarks to run on the command line.
+////////////////////////////////////////////////////////////////////////////////
+
+/////////////
+// LINKING //
+/////////////
+#pragma comment(lib, "engine.lib")
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <windows.h>
+#include <iostream>
+#include <iomanip>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <string>
+#include <stdio.h>
+using namespace std;
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "softwareshaderclass.h"
+#include "softwaretextureclass.h"
+#include "commandlistclass.h"
+#include "threadpoolclass.h"
+#include "graphicsclass.h"
+#include "drawqueueclass.h"
+#include "cullingclass.h"
+#include "spatialtreeclass.h"
+#include "occlusionclass.h"
+#include "frameallocatorclass.h"
+#include "handletableclass.h"
+#include "textclass.h"
+#include "constantallocatorclass.h"
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int SHADING_SPAN_COUNT = 1024;
+const int SAMPLING_TEXTURE_SIZE = 1024;
+const int SAMPLING_SCREEN_SIZE = 512;
+const int SAMPLING_TILE_SIZE = 64;
+const int CACHE_LINE_SIZE = 64;
+const int CACHE_WAYS = 8;
+const int CACHE_SETS = 64;
+const int RECORD_OBJECT_COUNT = 65536;
+const int SCENE_MODEL_COUNT = 4;
+const int MAX_BENCHMARK_THREADS = 8;
+const int SORT_PACKET_COUNT = 100000;
+const int SORT_TEXTURE_COUNT = 256;
+const int SORT_BUFFER_COUNT = 64;
+const int ARRAY_MODEL_COUNT = 500;
+const int ARRAY_SIZE_GROUPS = 4;
+const int CULLING_OBJECT_COUNT = 1048576;
+const float CULLING_WORLD_SIZE = 1000.0f;
+const int TREE_MIN_OBJECTS = 10000;
+const int TREE_MAX_OBJECTS = 1000000;
+const int TREE_QUERY_COUNT = 100;
+const float TREE_REGION_SIZE = 20.0f;
+const int OCCLUSION_WALL_COUNT = 64;
+const int OCCLUSION_WALL_DIVISIONS = 8;
+const int OCCLUSION_BOX_COUNT = 100000;
+const int JOB_ITEM_COUNT = 1048576;
+const int JOB_GRAIN_SIZE = 1024;
+const int JOB_ITEM_WORK = 64;
+const int JOB_EMPTY_COUNT = 4096;
+const int JOB_STRESS_ROUNDS = 200;
+const int JOB_STRESS_PARENTS = 64;
+const int JOB_STRESS_CHILDREN = 64;
+const int JOB_STRESS_MAIN_INTERVAL = 16;
+const int TRANSIENT_ARRAY_COUNT = 16;
+const int TRANSIENT_ARRAY_SIZE = 6 * 64 * 20;
+const int TRANSIENT_FRAME_COUNT = 100000;
+const int HANDLE_RESOURCE_COUNT = 1024;
+const int HANDLE_LOOKUP_COUNT = 4000000;
+const int SPRITE_BITMAP_COUNT = 4;
+const int SPRITE_COUNT = 10000;
+const int SPRITE_SIZE = 8;
+const int SPRITE_LAYERS = 4;
+const int TEXT_OBJECT_COUNT = 32;
+const int TEXT_LINE_LENGTH = 64;
+const int CONSTANT_MIN_DRAWS = 1024;
+const int CONSTANT_MAX_DRAWS = 65536;
+const double BENCHMARK_SECONDS = 1.0;
+
+
+//////////////
+// TYPEDEFS //
+//////////////
+// A set associative cache with least recently used replacement, 32KB with the default sizes like a typical L1 data cache.
+struct CacheType
+{
+	unsigned int tags[CACHE_SETS][CACHE_WAYS];
+	unsigned int ages[CACHE_SETS][CACHE_WAYS];
+	unsigned int clock;
+	unsigned int accesses;
+	unsigned int misses;
+};
+
+// A loop of independent items for the job system to spread out.
+struct JobItemsType
+{
+	float* values;
+	int count;
+};
+
+// What the stress test's jobs counted, to check that every job ran once and main thread jobs ran on it.
+struct JobStressType
+{
+	ThreadPoolClass* threadPool;
+	ThreadPoolClass::CounterType children;
+	ThreadPoolClass::CounterType mainJobs;
+	ThreadPoolClass::CounterType wrongThread;
+};
+
+// The lists the recording threads fill, one per thread.
+struct RecordContextType
+{
+	CommandListClass* lists;
+	int listCount;
+};
+
+
+/////////////////////////
+// FUNCTION PROTOTYPES //
+/////////////////////////
+bool ShouldRun(int, char**, char*);
+double GetSeconds();
+float RandomFloat(float, float);
+bool BenchmarkShading();
+void ResetCache(CacheType*);
+void AccessCache(CacheType*, unsigned int);
+bool BenchmarkSampling();
+void RecordObjectsTask(void*, int);
+bool BenchmarkCommandLists();
+bool BenchmarkDrawSort();
+bool RecordModels(CommandListClass*, vector<int>&, vector<int>&, bool);
+int CountMergedDraws(DrawQueueClass*);
+bool BenchmarkTextureArrays();
+bool BenchmarkCulling();
+bool BoxOutside(float[CULLING_PLANE_COUNT][4], D3DXVECTOR3&, D3DXVECTOR3&);
+bool RayHitsBox(D3DXVECTOR3&, D3DXVECTOR3&, D3DXVECTOR3&, D3DXVECTOR3&, float, float&);
+bool BenchmarkSpatialTree();
+bool PointHidden(vector<D3DXVECTOR3>&, vector<D3DXVECTOR3>&, D3DXVECTOR3&, float);
+bool BenchmarkOcclusion();
+void JobItemsTask(void*, int, int);
+void EmptyTask(void*, int);
+bool BenchmarkJobs();
+void StressParentTask(void*, int);
+void StressChildTask(void*, int);
+void StressMainTask(void*, int);
+bool StressJobs();
+bool BenchmarkPipeline();
+bool BenchmarkFrameAllocator();
+bool BenchmarkHandles();
+bool BenchmarkSprites();
+bool BenchmarkText();
+bool BenchmarkConstants();
+bool BenchmarkHierarchicalZ();
+bool BenchmarkVertexCache();
+
+
+//////////////////
+// MAIN PROGRAM //
+//////////////////
+int main(int argc, char** argv)
+{
+	bool result;
+
+
+	if(ShouldRun(argc, argv, "shading"))
+	{
+		result = BenchmarkShading();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "sampling"))
+	{
+		result = BenchmarkSampling();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "commandlists"))
+	{
+		result = BenchmarkCommandLists();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "drawsort"))
+	{
+		result = BenchmarkDrawSort();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "texturearrays"))
+	{
+		result = BenchmarkTextureArrays();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "culling"))
+	{
+		result = BenchmarkCulling();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "spatialtree"))
+	{
+		result = BenchmarkSpatialTree();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "occlusion"))
+	{
+		result = BenchmarkOcclusion();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "jobs"))
+	{
+		result = BenchmarkJobs();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "jobstress"))
+	{
+		result = StressJobs();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "pipeline"))
+	{
+		result = BenchmarkPipeline();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "frameallocator"))
+	{
+		result = BenchmarkFrameAllocator();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "handles"))
+	{
+		result = BenchmarkHandles();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "sprites"))
+	{
+		result = BenchmarkSprites();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "text"))
+	{
+		result = BenchmarkText();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "constants"))
+	{
+		result = BenchmarkConstants();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "hierarchicalz"))
+	{
+		result = BenchmarkHierarchicalZ();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	if(ShouldRun(argc, argv, "vertexcache"))
+	{
+		result = BenchmarkVertexCache();
+		if(!result)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+bool ShouldRun(int argc, char** argv, char* name)
+{
+	int i;
+
+
+	// With no arguments every benchmark runs.
+	if(argc < 2)
+	{
+		return true;
+	}
+
+	for(i=1; i<argc; i++)
+	{
+		if(strcmp(argv[i], name) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+double GetSeconds()
+{
+	LARGE_INTEGER frequency, counter;
+
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+
+float RandomFloat(float minimum, float maximum)
+{
+	return minimum + (maximum - minimum) * ((float)rand() / (float)RAND_MAX);
+}
+
+
+bool BenchmarkShading()
+{
+	SoftwareShaderClass* shader;
+	SoftwareShaderClass::LightInputType* spans;
+	SoftwareShaderClass::LightConstantsType constants;
+	SoftwareShaderClass::InstructionSetType instructionSets[3];
+	unsigned int output[SOFTWARE_SIMD_WIDTH], checksum;
+	double start, elapsed, pixelsPerSecond;
+	float length, vector[3];
+	int i, j, k, set, passes;
+
+
+	cout << "Light pixel shading, one thread" << endl;
+
+	// Create the shading kernels.
+	shader = new SoftwareShaderClass;
+	if(!shader)
+	{
+		return false;
+	}
+
+	// Fill the spans with random unit normals and view directions and random texture colors.
+	spans = new SoftwareShaderClass::LightInputType[SHADING_SPAN_COUNT];
+	if(!spans)
+	{
+		return false;
+	}
+
+	srand(1);
+	for(i=0; i<SHADING_SPAN_COUNT; i++)
+	{
+		for(j=0; j<SOFTWARE_SIMD_WIDTH; j++)
+		{
+			for(k=0; k<3; k++)
+			{
+				vector[k] = RandomFloat(-1.0f, 1.0f);
+			}
+			length = sqrtf(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]) + 0.0001f;
+			for(k=0; k<3; k++)
+			{
+				spans[i].normal[k][j] = vector[k] / length;
+			}
+
+			for(k=0; k<3; k++)
+			{
+				vector[k] = RandomFloat(-1.0f, 1.0f);
+			}
+			length = sqrtf(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]) + 0.0001f;
+			for(k=0; k<3; k++)
+			{
+				spans[i].viewDirection[k][j] = vector[k] / length;
+			}
+
+			for(k=0; k<4; k++)
+			{
+				spans[i].texture[k][j] = RandomFloat(0.0f, 1.0f);
+			}
+		}
+	}
+
+	// Use the same light as the graphics class.
+	constants.ambientColor[0] = 0.2f;
+	constants.ambientColor[1] = 0.2f;
+	constants.ambientColor[2] = 0.2f;
+	constants.ambientColor[3] = 1.0f;
+	constants.diffuseColor[0] = 1.0f;
+	constants.diffuseColor[1] = 1.0f;
+	constants.diffuseColor[2] = 1.0f;
+	constants.diffuseColor[3] = 1.0f;
+	constants.lightDirection[0] = 0.8f;
+	constants.lightDirection[1] = -1.0f;
+	constants.lightDirection[2] = 0.1f;
+	constants.specularPower = 32.0f;
+	constants.specularColor[0] = 0.85f;
+	constants.specularColor[1] = 1.0f;
+	constants.specularColor[2] = 0.98f;
+	constants.specularColor[3] = 1.0f;
+
+	instructionSets[0] = SoftwareShaderClass::INSTRUCTIONS_SCALAR;
+	instructionSets[1] = SoftwareShaderClass::INSTRUCTIONS_SSE41;
+	instructionSets[2] = SoftwareShaderClass::INSTRUCTIONS_AVX2;
+
+	// Time each kernel this processor supports.
+	for(set=0; set<3; set++)
+	{
+		if(!shader->SetInstructionSet(instructionSets[set]))
+		{
+			continue;
+		}
+
+		// Checksum one pass over the spans to show the kernels agree.
+		checksum = 0;
+		for(i=0; i<SHADING_SPAN_COUNT; i++)
+		{
+			shader->ShadeLight(&spans[i], &constants, output);
+			for(j=0; j<SOFTWARE_SIMD_WIDTH; j++)
+			{
+				checksum = (checksum * 31) + output[j];
+			}
+		}
+
+		// Shade the spans over and over until enough time has passed for a stable measurement.
+		passes = 0;
+		start = GetSeconds();
+		do
+		{
+			for(i=0; i<SHADING_SPAN_COUNT; i++)
+			{
+				shader->ShadeLight(&spans[i], &constants, output);
+			}
+			passes++;
+			elapsed = GetSeconds() - start;
+		}
+		while(elapsed < BENCHMARK_SECONDS);
+
+		pixelsPerSecond = (double)passes * SHADING_SPAN_COUNT * SOFTWARE_SIMD_WIDTH / elapsed;
+
+		cout << "  " << setw(8) << left << shader->GetInstructionSetName() << right << setw(10) << fixed << setprecision(1)
+			<< pixelsPerSecond / 1000000.0 << " Mpixels/s per core  (checksum " << hex << checksum << dec << ")" << endl;
+	}
+
+	// Release the spans and the kernels.
+	delete [] spans;
+	spans = 0;
+
+	shader->Shutdown();
+	delete shader;
+	shader = 0;
+
+	return true;
+}
+
+
+void ResetCache(CacheType* cache)
+{
+	memset(cache, 0, sizeof(CacheType));
+
+	// Tag zero is a valid line, so mark the empty ways with a tag no address produces.
+	memset(cache->tags, 0xff, sizeof(cache->tags));
+
+	return;
+}
+
+
+void AccessCache(CacheType* cache, unsigned int address)
+{
+	unsigned int line, set, way, oldest;
+
+
+	line = address / CACHE_LINE_SIZE;
+	set = line % CACHE_SETS;
+
+	cache->clock++;
+	cache->accesses++;
+
+	// A hit refreshes the age of its way.
+	for(way=0; way<CACHE_WAYS; way++)
+	{
+		if(cache->tags[set][way] == line)
+		{
+			cache->ages[set][way] = cache->clock;
+			return;
+		}
+	}
+
+	// A miss replaces the least recently used way.
+	cache->misses++;
+
+	oldest = 0;
+	for(way=1; way<CACHE_WAYS; way++)
+	{
+		if(cache->ages[set][way] < cache->ages[set][oldest])
+		{
+			oldest = way;
+		}
+	}
+
+	cache->tags[set][oldest] = line;
+	cache->ages[set][oldest] = cache->clock;
+
+	return;
+}
+
+
+bool BenchmarkSampling()
+{
+	SoftwareTextureClass* texture;
+	SoftwareTextureClass::SampleInputType* spans;
+	SoftwareTextureClass::LayoutType layouts[2];
+	CacheType* cache;
+	unsigned int* pixels;
+	float output[4][SOFTWARE_SIMD_WIDTH], angles[4], angle, cosine, sine, x, y;
+	double start, elapsed, samplesPerSecond;
+	int i, j, layout, a, tileX, tileY, pixelX, pixelY, spanCount, span, lane, texelX, texelY, passes;
+	bool result;
+
+
+	cout << "Texture sampling, " << SAMPLING_TEXTURE_SIZE << "x" << SAMPLING_TEXTURE_SIZE << " texture drawn 1:1 to " <<
+		SAMPLING_SCREEN_SIZE << "x" << SAMPLING_SCREEN_SIZE << " pixels, one thread" << endl;
+
+	// Create a texture of random texels.
+	pixels = new unsigned int[SAMPLING_TEXTURE_SIZE * SAMPLING_TEXTURE_SIZE];
+	if(!pixels)
+	{
+		return false;
+	}
+
+	srand(1);
+	for(i=0; i<SAMPLING_TEXTURE_SIZE * SAMPLING_TEXTURE_SIZE; i++)
+	{
+		pixels[i] = ((unsigned int)rand() << 16) ^ (unsigned int)rand();
+	}
+
+	texture = new SoftwareTextureClass;
+	if(!texture)
+	{
+		return false;
+	}
+
+	result = texture->Initialize(SAMPLING_TEXTURE_SIZE, SAMPLING_TEXTURE_SIZE, pixels);
+	if(!result)
+	{
+		return false;
+	}
+
+	delete [] pixels;
+	pixels = 0;
+
+	spans = new SoftwareTextureClass::SampleInputType[(SAMPLING_SCREEN_SIZE * SAMPLING_SCREEN_SIZE) / SOFTWARE_SIMD_WIDTH];
+	if(!spans)
+	{
+		return false;
+	}
+
+	cache = new CacheType;
+	if(!cache)
+	{
+		return false;
+	}
+
+	layouts[0] = SoftwareTextureClass::LAYOUT_LINEAR;
+	layouts[1] = SoftwareTextureClass::LAYOUT_SWIZZLED;
+
+	angles[0] = 0.0f;
+	angles[1] = 30.0f;
+	angles[2] = 45.0f;
+	angles[3] = 90.0f;
+
+	for(a=0; a<4; a++)
+	{
+		angle = angles[a] * (float)D3DX_PI / 180.0f;
+		cosine = cosf(angle);
+		sine = sinf(angle);
+
+		// Build the spans in the order the rasterizer shades them: tile by tile, then row by row in spans of eight.
+		spanCount = 0;
+		for(tileY=0; tileY<SAMPLING_SCREEN_SIZE; tileY+=SAMPLING_TILE_SIZE)
+		{
+			for(tileX=0; tileX<SAMPLING_SCREEN_SIZE; tileX+=SAMPLING_TILE_SIZE)
+			{
+				for(pixelY=tileY; pixelY<tileY + SAMPLING_TILE_SIZE; pixelY++)
+				{
+					for(pixelX=tileX; pixelX<tileX + SAMPLING_TILE_SIZE; pixelX+=SOFTWARE_SIMD_WIDTH)
+					{
+						for(lane=0; lane<SOFTWARE_SIMD_WIDTH; lane++)
+						{
+							x = (float)(pixelX + lane) + 0.5f;
+							y = (float)pixelY + 0.5f;
+
+							// Rotate the texture on screen.  One pixel step moves one texel, so sampling stays on the top level.
+							spans[spanCount].u[lane] = (cosine * x - sine * y) / (float)SAMPLING_TEXTURE_SIZE;
+							spans[spanCount].v[lane] = (sine * x + cosine * y) / (float)SAMPLING_TEXTURE_SIZE;
+							spans[spanCount].dudx[lane] = cosine / (float)SAMPLING_TEXTURE_SIZE;
+							spans[spanCount].dvdx[lane] = sine / (float)SAMPLING_TEXTURE_SIZE;
+							spans[spanCount].dudy[lane] = -sine / (float)SAMPLING_TEXTURE_SIZE;
+							spans[spanCount].dvdy[lane] = cosine / (float)SAMPLING_TEXTURE_SIZE;
+						}
+						spanCount++;
+					}
+				}
+			}
+		}
+
+		cout << "  rotated " << setw(2) << (int)angles[a] << " degrees" << endl;
+
+		for(layout=0; layout<2; layout++)
+		{
+			result = texture->SetLayout(layouts[layout]);
+			if(!result)
+			{
+				return false;
+			}
+
+			// Replay the bilinear footprints through the cache model to count the lines each sample misses.
+			ResetCache(cache);
+			for(span=0; span<spanCount; span++)
+			{
+				for(lane=0; lane<SOFTWARE_SIMD_WIDTH; lane++)
+				{
+					texelX = (int)floorf(spans[span].u[lane] * (float)SAMPLING_TEXTURE_SIZE - 0.5f) & (SAMPLING_TEXTURE_SIZE - 1);
+					texelY = (int)floorf(spans[span].v[lane] * (float)SAMPLING_TEXTURE_SIZE - 0.5f) & (SAMPLING_TEXTURE_SIZE - 1);
+
+					for(i=0; i<2; i++)
+					{
+						for(j=0; j<2; j++)
+						{
+							AccessCache(cache, sizeof(unsigned int) * texture->GetTexelIndex(0, (texelX + j) & (SAMPLING_TEXTURE_SIZE - 1),
+								(texelY + i) & (SAMPLING_TEXTURE_SIZE - 1)));
+						}
+					}
+				}
+			}
+
+			// Sample the spans over and over until enough time has passed for a stable measurement.
+			passes = 0;
+			start = GetSeconds();
+			do
+			{
+				for(span=0; span<spanCount; span++)
+				{
+					texture->SampleSpan(&spans[span], output);
+				}
+				passes++;
+				elapsed = GetSeconds() - start;
+			}
+			while(elapsed < BENCHMARK_SECONDS);
+
+			samplesPerSecond = (double)passes * spanCount * SOFTWARE_SIMD_WIDTH / elapsed;
+
+			cout << "    " << setw(8) << left << ((layouts[layout] == SoftwareTextureClass::LAYOUT_LINEAR) ? "linear" : "swizzled") << right
+				<< setw(8) << fixed << setprecision(3) << (double)cache->misses / (double)(spanCount * SOFTWARE_SIMD_WIDTH)
+				<< " L1 misses per sample" << setw(10) << setprecision(1) << samplesPerSecond / 1000000.0 << " Msamples/s" << endl;
+		}
+	}
+
+	// Release the cache model, the spans and the texture.
+	delete cache;
+	cache = 0;
+
+	delete [] spans;
+	spans = 0;
+
+	texture->Shutdown();
+	delete texture;
+	texture = 0;
+
+	return true;
+}
+
+
+void RecordObjectsTask(void* context, int list)
+{
+	RecordContextType* record;
+	CommandListClass::LightCommandType* light;
+	D3DXMATRIX rotation, translation;
+	unsigned long long key;
+	int first, last, i;
+
+
+	record = (RecordContextType*)context;
+
+	record->lists[list].Reset();
+
+	// Each thread traverses an even share of the objects and packs a light draw for each one.
+	first = (list * RECORD_OBJECT_COUNT) / record->listCount;
+	last = ((list + 1) * RECORD_OBJECT_COUNT) / record->listCount;
+
+	for(i=first; i<last; i++)
+	{
+		key = DrawQueueClass::MakeKey(DrawQueueClass::PASS_SCENE, false, DrawQueueClass::SHADER_LIGHT, 0, 0, (float)(i / 256) / 256.0f);
+		light = record->lists[list].AddLight(key);
+		if(!light)
+		{
+			return;
+		}
+
+		// Place the objects on a grid with their own rotations.
+		D3DXMatrixRotationYawPitchRoll(&rotation, (float)i * 0.01f, (float)i * 0.02f, 0.0f);
+		D3DXMatrixTranslation(&translation, (float)(i % 256), 0.0f, (float)(i / 256));
+
+		light->model = 0;
+		light->indexCount = 3;
+		light->indexStart = 0;
+		light->worldMatrix = rotation * translation;
+		D3DXMatrixIdentity(&light->viewMatrix);
+		D3DXMatrixIdentity(&light->projectionMatrix);
+		light->ambientColor = D3DXVECTOR4(0.2f, 0.2f, 0.2f, 1.0f);
+		light->diffuseColor = D3DXVECTOR4(1.0f, 1.0f, 1.0f, 1.0f);
+		light->lightDirection = D3DXVECTOR3(0.8f, -1.0f, 0.1f);
+		light->specularPower = 32.0f;
+		light->specularColor = D3DXVECTOR4(0.85f, 1.0f, 0.98f, 1.0f);
+		light->cameraPosition = D3DXVECTOR3(0.0f, 0.0f, -10.0f);
+	}
+
+	return;
+}
+
+
+bool BenchmarkCommandLists()
+{
+	ThreadPoolClass* threadPool;
+	GraphicsClass* graphics;
+	RecordContextType record;
+	double start, elapsed, commandsPerSecond, baseline, frameTime;
+	GraphicsClass::ModelHandleType model;
+	int threads, i, frames, commands;
+	bool result;
+
+
+	cout << "Command list recording, " << RECORD_OBJECT_COUNT << " light draws per frame" << endl;
+
+	baseline = 0.0;
+	for(threads=1; threads<=MAX_BENCHMARK_THREADS; threads*=2)
+	{
+		// Create the workers, leaving one thread for the caller, and a list for each thread.
+		threadPool = new ThreadPoolClass;
+		if(!threadPool)
+		{
+			return false;
+		}
+
+		result = threadPool->Initialize(threads - 1);
+		if(!result)
+		{
+			return false;
+		}
+
+		record.listCount = threads;
+		record.lists = new CommandListClass[threads];
+		if(!record.lists)
+		{
+			return false;
+		}
+
+		for(i=0; i<threads; i++)
+		{
+			result = record.lists[i].Initialize(COMMAND_LIST_SIZE);
+			if(!result)
+			{
+				return false;
+			}
+		}
+
+		// Record frames until enough time has passed for a stable measurement.  The first frame grows the lists.
+		threadPool->Run(&RecordObjectsTask, &record, threads);
+
+		frames = 0;
+		start = GetSeconds();
+		do
+		{
+			threadPool->Run(&RecordObjectsTask, &record, threads);
+			frames++;
+			elapsed = GetSeconds() - start;
+		}
+		while(elapsed < BENCHMARK_SECONDS);
+
+		commands = 0;
+		for(i=0; i<threads; i++)
+		{
+			commands += record.lists[i].GetCommandCount();
+		}
+
+		commandsPerSecond = (double)frames * commands / elapsed;
+		if(threads == 1)
+		{
+			baseline = commandsPerSecond;
+		}
+
+		cout << "  " << setw(2) << threads << " threads" << setw(10) << fixed << setprecision(2) << commandsPerSecond / 1000000.0
+			<< " Mcommands/s" << setw(8) << setprecision(2) << commandsPerSecond / baseline << "x" << endl;
+
+		// Release the lists and the workers.
+		for(i=0; i<threads; i++)
+		{
+			record.lists[i].Shutdown();
+		}
+		delete [] record.lists;
+		record.lists = 0;
+
+		threadPool->Shutdown();
+		delete threadPool;
+		threadPool = 0;
+	}
+
+	cout << "Headless frames, " << SCENE_MODEL_COUNT << " models recorded in parallel and drawn by the software renderer" << endl;
+
+	baseline = 0.0;
+	for(threads=1; threads<=MAX_BENCHMARK_THREADS; threads*=2)
+	{
+		// Build the scene on a headless graphics object with this many threads.
+		graphics = new GraphicsClass;
+		if(!graphics)
+		{
+			return false;
+		}
+
+		result = graphics->InitializeHeadless(800, 600, threads - 1);
+		if(!result)
+		{
+			return false;
+		}
+
+		for(i=0; i<SCENE_MODEL_COUNT; i++)
+		{
+			model = graphics->LoadModelResource("../Engine/data/swordOpt.bin", L"../Engine/data/seafloor.dds");
+			if(model.value == HANDLE_INVALID)
+			{
+				return false;
+			}
+		}
+
+		// Draw frames until enough time has passed for a stable measurement.
+		frames = 0;
+		start = GetSeconds();
+		do
+		{
+			result = graphics->Frame(0.6f, 0.3f, 0.0f, -10.0f, 0.0f, 0.0f);
+			if(!result)
+			{
+				return false;
+			}
+			frames++;
+			elapsed = GetSeconds() - start;
+		}
+		while(elapsed < BENCHMARK_SECONDS);
+
+		frameTime = elapsed / (double)frames;
+		if(threads == 1)
+		{
+			baseline = frameTime;
+		}
+
+		cout << "  " << setw(2) << threads << " threads" << setw(10) << fixed << setprecision(2) << frameTime * 1000.0
+			<< " ms/frame" << setw(9) << setprecision(2) << baseline / frameTime << "x" << endl;
+
+		graphics->Shutdown();
+		delete graphics;
+		graphics = 0;
+	}
+
+	return true;
+}
+
+
+bool BenchmarkDrawSort()
+{
+	CommandListClass commands;
+	DrawQueueClass queue;
+	vector<unsigned long long> keys;
+	unsigned long long key;
+	double start, elapsed, radixTime, standardTime;
+	DrawQueueClass::PassType pass;
+	DrawQueueClass::ShaderType shader;
+	bool result, translucent;
+	int i, frames;
+
+
+	cout << "Draw sorting, " << SORT_PACKET_COUNT << " packets per frame" << endl;
+
+	result = commands.Initialize(COMMAND_LIST_SIZE);
+	if(!result)
+	{
+		return false;
+	}
+
+	result = queue.Initialize(SORT_PACKET_COUNT);
+	if(!result)
+	{
+		return false;
+	}
+
+	// Record packets with keys spread the way a scene would be: mostly opaque scene draws, some translucent ones and a few overlay
+	// draws, with random shaders, textures, buffers and depths.  The smallest packet is used since the sort only reads the keys.
+	srand(1);
+	for(i=0; i<SORT_PACKET_COUNT; i++)
+	{
+		pass = ((rand() % 16) == 0) ? DrawQueueClass::PASS_OVERLAY : DrawQueueClass::PASS_SCENE;
+		translucent = (pass == DrawQueueClass::PASS_SCENE) && ((rand() % 10) == 0);
+		shader = ((rand() % 2) == 0) ? DrawQueueClass::SHADER_LIGHT : DrawQueueClass::SHADER_TEXTURE;
+
+		key = DrawQueueClass::MakeKey(pass, translucent, shader, rand() % SORT_TEXTURE_COUNT, rand() % SORT_BUFFER_COUNT, RandomFloat(0.0f, 1.0f));
+		if(!commands.SetDepth(true, key))
+		{
+			return false;
+		}
+
+		keys.push_back(key);
+	}
+
+	// Merge and sort the queue until enough time has passed for a stable measurement.
+	frames = 0;
+	start = GetSeconds();
+	do
+	{
+		queue.Reset();
+		queue.Add(&commands);
+		queue.Sort();
+		frames++;
+		elapsed = GetSeconds() - start;
+	}
+	while(elapsed < BENCHMARK_SECONDS);
+
+	radixTime = elapsed / (double)frames;
+
+	// Check the packets come out in key order.
+	for(i=1; i<queue.GetCount(); i++)
+	{
+		if(queue.GetCommand(i - 1)->key > queue.GetCommand(i)->key)
+		{
+			cout << "  radix sort output is out of order" << endl;
+			return false;
+		}
+	}
+
+	// Sort the bare keys with the standard library for comparison.
+	frames = 0;
+	start = GetSeconds();
+	do
+	{
+		vector<unsigned long long> sorted(keys);
+		sort(sorted.begin(), sorted.end());
+		frames++;
+		elapsed = GetSeconds() - start;
+	}
+	while(elapsed < BENCHMARK_SECONDS);
+
+	standardTime = elapsed / (double)frames;
+
+	cout << "  merge and radix sort" << setw(10) << fixed << setprecision(3) << radixTime * 1000.0 << " ms/frame" << endl;
+	cout << "  std::sort of keys   " << setw(10) << fixed << setprecision(3) << standardTime * 1000.0 << " ms/frame" << endl;
+	cout << "  state changes " << queue.GetStateChanges(false) << " recorded, " << queue.GetStateChanges(true) << " sorted, "
+		<< queue.GetStateChanges(false) - queue.GetStateChanges(true) << " saved" << endl;
+
+	queue.Shutdown();
+	commands.Shutdown();
+
+	return true;
+}
+
+
+bool RecordModels(CommandListClass* commands, vector<int>& indexCounts, vector<int>& groups, bool arrays)
+{
+	CommandListClass::LightCommandType* light;
+	D3DXMATRIX identity;
+	vector<int> order;
+	unsigned long long key;
+	int indexStart, texture, i;
+
+
+	D3DXMatrixIdentity(&identity);
+
+	// Lay the models out in the index buffer in load order, or grouped by texture array the way BufferClass does it.
+	for(i=0; i<(int)indexCounts.size(); i++)
+	{
+		order.push_back(i);
+	}
+
+	if(arrays)
+	{
+		stable_sort(order.begin(), order.end(), [&groups](int a, int b) { return groups[a] < groups[b]; });
+	}
+
+	commands->Reset();
+	indexStart = 0;
+	for(i=0; i<(int)order.size(); i++)
+	{
+		// Key each model by its own texture, or by its array and then its place in the buffer like GraphicsClass.
+		texture = arrays ? groups[order[i]] : order[i];
+		key = DrawQueueClass::MakeKey(DrawQueueClass::PASS_SCENE, false, DrawQueueClass::SHADER_LIGHT, texture, arrays ? i : 0,
+			RandomFloat(0.0f, 1.0f));
+
+		light = commands->AddLight(key);
+		if(!light)
+		{
+			return false;
+		}
+
+		light->model = order[i];
+		light->texture = texture;
+		light->indexCount = indexCounts[order[i]];
+		light->indexStart = indexStart;
+		light->worldMatrix = identity;
+		light->viewMatrix = identity;
+		light->projectionMatrix = identity;
+		light->ambientColor = D3DXVECTOR4(0.15f, 0.15f, 0.15f, 1.0f);
+		light->diffuseColor = D3DXVECTOR4(1.0f, 1.0f, 1.0f, 1.0f);
+		light->lightDirection = D3DXVECTOR3(0.0f, 0.0f, 1.0f);
+		light->specularPower = 32.0f;
+		light->specularColor = D3DXVECTOR4(1.0f, 1.0f, 1.0f, 1.0f);
+		light->cameraPosition = D3DXVECTOR3(0.0f, 0.0f, -10.0f);
+
+		indexStart += indexCounts[order[i]];
+	}
+
+	return true;
+}
+
+
+int CountMergedDraws(DrawQueueClass* queue)
+{
+	CommandListClass::LightCommandType* previous;
+	CommandListClass::LightCommandType* light;
+	int draws, i;
+
+
+	// Count the draws left once neighbouring packets are merged like GraphicsClass::ExecuteCommands does.
+	draws = 0;
+	previous = 0;
+	for(i=0; i<queue->GetCount(); i++)
+	{
+		light = (CommandListClass::LightCommandType*)queue->GetCommand(i);
+		if(!previous || !CommandListClass::CanMerge(previous, light))
+		{
+			draws++;
+		}
+
+		previous = light;
+	}
+
+	return draws;
+}
+
+
+bool BenchmarkTextureArrays()
+{
+	CommandListClass commands;
+	DrawQueueClass queue;
+	vector<int> indexCounts, groups;
+	double start, elapsed, seconds[2];
+	bool result;
+	int draws[2], pass, i, frames;
+
+
+	cout << "Texture arrays, " << ARRAY_MODEL_COUNT << " models with textures of " << ARRAY_SIZE_GROUPS << " sizes" << endl;
+
+	result = commands.Initialize(COMMAND_LIST_SIZE);
+	if(!result)
+	{
+		return false;
+	}
+
+	result = queue.Initialize(ARRAY_MODEL_COUNT);
+	if(!result)
+	{
+		return false;
+	}
+
+	// Give every model a mesh of random size and a texture in one of a few sizes, each size making one array.
+	srand(1);
+	for(i=0; i<ARRAY_MODEL_COUNT; i++)
+	{
+		indexCounts.push_back(36 + (rand() % 3000) * 3);
+		groups.push_back(rand() % ARRAY_SIZE_GROUPS);
+	}
+
+	// Record, sort and merge a frame with a texture per model and then with the texture arrays.
+	for(pass=0; pass<2; pass++)
+	{
+		frames = 0;
+		start = GetSeconds();
+		do
+		{
+			result = RecordModels(&commands, indexCounts, groups, pass == 1);
+			if(!result)
+			{
+				return false;
+			}
+
+			queue.Reset();
+			queue.Add(&commands);
+			queue.Sort();
+			draws[pass] = CountMergedDraws(&queue);
+			frames++;
+			elapsed = GetSeconds() - start;
+		}
+		while(elapsed < BENCHMARK_SECONDS);
+
+		seconds[pass] = elapsed / (double)frames;
+	}
+
+	cout << "  texture per model " << setw(6) << draws[0] << " draws" << setw(10) << fixed << setprecision(3) << seconds[0] * 1000.0 << " ms/frame" << endl;
+	cout << "  texture arrays    " << setw(6) << draws[1] << " draws" << setw(10) << fixed << setprecision(3) << seconds[1] * 1000.0 << " ms/frame" << endl;
+	cout << "  " << draws[0] - draws[1] << " draws saved" << endl;
+
+	queue.Shutdown();
+	commands.Shutdown();
+
+	return true;
+}
+
+
+bool BenchmarkCulling()
+{
+	CullingClass* culling;
+	ThreadPoolClass* threadPool;
+	SoftwareShaderClass::InstructionSetType instructionSets[3];
+	const char* names[3];
+	D3DXMATRIX viewMatrix, projectionMatrix;
+	D3DXVECTOR3 eye, at, up, center, extents;
+	unsigned int checksum;
+	double start, elapsed, frameTime, baseline;
+	bool result;
+	int i, set, widest, threads, frames;
+
+
+	cout << "Frustum culling, " << CULLING_OBJECT_COUNT << " objects" << endl;
+
+	culling = new CullingClass;
+	if(!culling)
+	{
+		return false;
+	}
+
+	result = culling->Initialize(CULLING_OBJECT_COUNT);
+	if(!result)
+	{
+		return false;
+	}
+
+	result = culling->SetObjectCount(CULLING_OBJECT_COUNT);
+	if(!result)
+	{
+		return false;
+	}
+
+	// Scatter boxes of random sizes through the world, with spheres that are sometimes tighter than the boxes.
+	srand(1);
+	for(i=0; i<CULLING_OBJECT_COUNT; i++)
+	{
+		center = D3DXVECTOR3(RandomFloat(-0.5f, 0.5f), RandomFloat(-0.5f, 0.5f), RandomFloat(-0.5f, 0.5f)) * CULLING_WORLD_SIZE;
+		extents = D3DXVECTOR3(RandomFloat(0.5f, 5.0f), RandomFloat(0.5f, 5.0f), RandomFloat(0.5f, 5.0f));
+		culling->SetBounds(i, center, extents, D3DXVec3Length(&extents) * RandomFloat(0.6f, 1.0f));
+	}
+
+	// Put one object in front of the camera and one behind it to check the planes face the right way.
+	center = D3DXVECTOR3(0.0f, 0.0f, 10.0f);
+	culling->SetBounds(0, center, extents, 1.0f);
+	center = D3DXVECTOR3(0.0f, 0.0f, -10.0f);
+	culling->SetBounds(1, center, extents, 1.0f);
+
+	// Look down the Z axis from the middle of the world with the same projection as the graphics class.
+	eye = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+	at = D3DXVECTOR3(0.0f, 0.0f, 1.0f);
+	up = D3DXVECTOR3(0.0f, 1.0f, 0.0f);
+	D3DXMatrixLookAtLH(&viewMatrix, &eye, &at, &up);
+	D3DXMatrixPerspectiveFovLH(&projectionMatrix, (float)D3DX_PI / 4.0f, 1.0f, SCREEN_NEAR, SCREEN_DEPTH);
+	culling->SetFrustum(viewMatrix, projectionMatrix);
+
+	instructionSets[0] = SoftwareShaderClass::INSTRUCTIONS_SCALAR;
+	instructionSets[1] = SoftwareShaderClass::INSTRUCTIONS_SSE41;
+	instructionSets[2] = SoftwareShaderClass::INSTRUCTIONS_AVX2;
+	names[0] = "Scalar";
+	names[1] = "SSE4.1";
+	names[2] = "AVX2";
+
+	// Time each kernel this processor supports on one thread.
+	threadPool = new ThreadPoolClass;
+	if(!threadPool)
+	{
+		return false;
+	}
+
+	result = threadPool->Initialize(0);
+	if(!result)
+	{
+		return false;
+	}
+
+	widest = 0;
+	for(set=0; set<3; set++)
+	{
+		if(!culling->SetInstructionSet(instructionSets[set]))
+		{
+			continue;
+		}
+
+		widest = set;
+		frames = 0;
+		start = GetSeconds();
+		do
+		{
+			culling->Cull(threadPool);
+			frames++;
+			elapsed = GetSeconds() - start;
+		}
+		while(elapsed < BENCHMARK_SECONDS);
+
+		// Checksum the visible list to show the kernels agree.
+		checksum = 0;
+		for(i=0; i<culling->GetVisibleCount(); i++)
+		{
+			checksum = (checksum * 31) + culling->GetVisible()[i];
+		}
+
+		if((culling->GetVisibleCount() == 0) || (culling->GetVisible()[0] != 0) || ((culling->GetVisibleCount() > 1) && (culling->GetVisible()[1] == 1)))
+		{
+			cout << "  " << names[set] << " kernel culled the wrong side of the camera" << endl;
+			return false;
+		}
+
+		cout << "  " << setw(8) << left << names[set] << right << setw(10) << fixed << setprecision(3) << (elapsed / (double)frames) * 1000.0
+			<< " ms/frame  " << culling->GetVisibleCount() << " visible  (checksum " << hex << checksum << dec << ")" << endl;
+	}
+
+	threadPool->Shutdown();
+	delete threadPool;
+	threadPool = 0;
+
+	// Then scale the widest kernel across threads.
+	culling->SetInstructionSet(instructionSets[widest]);
+
+	baseline = 0.0;
+	for(threads=1; threads<=MAX_BENCHMARK_THREADS; threads*=2)
+	{
+		threadPool = new ThreadPoolClass;
+		if(!threadPool)
+		{
+			return false;
+		}
+
+		result = threadPool->Initialize(threads - 1);
+		if(!result)
+		{
+			return false;
+		}
+
+		frames = 0;
+		start = GetSeconds();
+		do
+		{
+			culling->Cull(threadPool);
+			frames++;
+			elapsed = GetSeconds() - start;
+		}
+		while(elapsed < BENCHMARK_SECONDS);
+
+		frameTime = elapsed / (double)frames;
+		if(threads == 1)
+		{
+			baseline = frameTime;
+		}
+
+		cout << "  " << threads << " thread(s)" << setw(10) << fixed << setprecision(3) << frameTime * 1000.0 << " ms/frame  "
+			<< setprecision(2) << baseline / frameTime << "x" << endl;
+
+		threadPool->Shutdown();
+		delete threadPool;
+		threadPool = 0;
+	}
+
+	culling->Shutdown();
+	delete culling;
+	culling = 0;
+
+	return true;
+}
+
+
+bool BoxOutside(float planes[CULLING_PLANE_COUNT][4], D3DXVECTOR3& minimum, D3DXVECTOR3& maximum)
+{
+	D3DXVECTOR3 center, extents;
+	float distance, radius;
+	int plane;
+
+
+	// The same test the spatial tree makes of an object's own box.
+	center = (minimum + maximum) * 0.5f;
+	extents = (maximum - minimum) * 0.5f;
+
+	for(plane=0; plane<CULLING_PLANE_COUNT; plane++)
+	{
+		distance = (planes[plane][0] * center.x) + (planes[plane][1] * center.y) + (planes[plane][2] * center.z) + planes[plane][3];
+		radius = (fabsf(planes[plane][0]) * extents.x) + (fabsf(planes[plane][1]) * extents.y) + (fabsf(planes[plane][2]) * extents.z);
+		if(distance < -radius)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+bool RayHitsBox(D3DXVECTOR3& origin, D3DXVECTOR3& inverse, D3DXVECTOR3& minimum, D3DXVECTOR3& maximum, float maxDistance, float& distance)
+{
+	float nearDistance, farDistance, t1, t2;
+	int axis;
+
+
+	// The same slab test the spatial tree makes.
+	nearDistance = 0.0f;
+	farDistance = maxDistance;
+	for(axis=0; axis<3; axis++)
+	{
+		t1 = (((float*)minimum)[axis] - ((float*)origin)[axis]) * ((float*)inverse)[axis];
+		t2 = (((float*)maximum)[axis] - ((float*)origin)[axis]) * ((float*)inverse)[axis];
+
+		nearDistance = max(nearDistance, min(t1, t2));
+		farDistance = min(farDistance, max(t1, t2));
+	}
+
+	distance = nearDistance;
+
+	return nearDistance <= farDistance;
+}
+
+
+bool BenchmarkSpatialTree()
+{
+	SpatialTreeClass* tree;
+	vector<D3DXVECTOR3> minimums, maximums, regions, directions;
+	vector<int> proxies, results;
+	D3DXMATRIX viewMatrix, projectionMatrix;
+	D3DXVECTOR3 eye, at, up, center, extents, offset, regionMaximum, inverse;
+	float planes[CULLING_PLANE_COUNT][4];
+	float distance, nearestDistance, treeDistance, bruteDistance;
+	double start, buildTime, moveTime, treeTime, bruteTime;
+	bool result, hit;
+	int count, i, query, moved, treeCount, bruteCount, object;
+
+
+	cout << "Spatial tree against brute force, " << TREE_QUERY_COUNT << " region and ray queries" << endl;
+
+	// Look down the Z axis from the middle of the world with the same projection as the graphics class.
+	eye = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+	at = D3DXVECTOR3(0.0f, 0.0f, 1.0f);
+	up = D3DXVECTOR3(0.0f, 1.0f, 0.0f);
+	D3DXMatrixLookAtLH(&viewMatrix, &eye, &at, &up);
+	D3DXMatrixPerspectiveFovLH(&projectionMatrix, (float)D3DX_PI / 4.0f, 1.0f, SCREEN_NEAR, SCREEN_DEPTH);
+	CullingClass::ExtractPlanes(viewMatrix, projectionMatrix, planes);
+
+	for(count=TREE_MIN_OBJECTS; count<=TREE_MAX_OBJECTS; count*=10)
+	{
+		// Scatter boxes of random sizes through the world, and pick the regions and rays to query.
+		srand(1);
+		minimums.clear();
+		maximums.clear();
+		for(i=0; i<count; i++)
+		{
+			center = D3DXVECTOR3(RandomFloat(-0.5f, 0.5f), RandomFloat(-0.5f, 0.5f), RandomFloat(-0.5f, 0.5f)) * CULLING_WORLD_SIZE;
+			extents = D3DXVECTOR3(RandomFloat(0.5f, 5.0f), RandomFloat(0.5f, 5.0f), RandomFloat(0.5f, 5.0f));
+			minimums.push_back(center - extents);
+			maximums.push_back(center + extents);
+		}
+
+		regions.clear();
+		directions.clear();
+		for(i=0; i<TREE_QUERY_COUNT; i++)
+		{
+			regions.push_back(D3DXVECTOR3(RandomFloat(-0.5f, 0.5f), RandomFloat(-0.5f, 0.5f), RandomFloat(-0.5f, 0.5f)) * CULLING_WORLD_SIZE);
+			directions.push_back(D3DXVECTOR3(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f)));
+			D3DXVec3Normalize(&directions[i], &directions[i]);
+		}
+
+		// Build the tree one insertion at a time.
+		tree = new SpatialTreeClass;
+		if(!tree)
+		{
+			return false;
+		}
+
+		result = tree->Initialize();
+		if(!result)
+		{
+			return false;
+		}
+
+		proxies.clear();
+		start = GetSeconds();
+		for(i=0; i<count; i++)
+		{
+			proxies.push_back(tree->CreateProxy(minimums[i], maximums[i], i));
+		}
+		buildTime = GetSeconds() - start;
+
+		// Move a tenth of the objects by a small step, the way a frame of moving objects would.
+		moved = 0;
+		start = GetSeconds();
+		for(i=0; i<count; i+=10)
+		{
+			offset = D3DXVECTOR3(RandomFloat(-0.2f, 0.2f), RandomFloat(-0.2f, 0.2f), RandomFloat(-0.2f, 0.2f));
+			minimums[i] += offset;
+			maximums[i] += offset;
+			moved += tree->MoveProxy(proxies[i], minimums[i], maximums[i]) ? 1 : 0;
+		}
+		moveTime = GetSeconds() - start;
+
+		cout << "  " << count << " objects: build " << fixed << setprecision(1) << buildTime * 1000.0 << " ms, move " << count / 10
+			<< " in " << setprecision(2) << moveTime * 1000.0 << " ms (" << moved << " reinserted), height " << tree->GetHeight()
+			<< ", area ratio " << setprecision(1) << tree->GetAreaRatio() << ", " << tree->GetRotationCount() << " rotations" << endl;
+
+		// Frustum query.
+		results.clear();
+		start = GetSeconds();
+		tree->QueryFrustum(planes, results);
+		treeTime = GetSeconds() - start;
+		treeCount = (int)results.size();
+
+		bruteCount = 0;
+		start = GetSeconds();
+		for(i=0; i<count; i++)
+		{
+			bruteCount += BoxOutside(planes, minimums[i], maximums[i]) ? 0 : 1;
+		}
+		bruteTime = GetSeconds() - start;
+
+		if(treeCount != bruteCount)
+		{
+			cout << "  frustum query found " << treeCount << " objects, brute force " << bruteCount << endl;
+			return false;
+		}
+
+		cout << "    frustum " << setw(10) << setprecision(3) << treeTime * 1000.0 << " ms against " << setw(10) << bruteTime * 1000.0
+			<< " ms, " << treeCount << " objects" << endl;
+
+		// Region queries.
+		treeCount = 0;
+		start = GetSeconds();
+		for(query=0; query<TREE_QUERY_COUNT; query++)
+		{
+			results.clear();
+			regionMaximum = regions[query] + D3DXVECTOR3(TREE_REGION_SIZE, TREE_REGION_SIZE, TREE_REGION_SIZE);
+			tree->QueryRegion(regions[query], regionMaximum, results);
+			treeCount += (int)results.size();
+		}
+		treeTime = GetSeconds() - start;
+
+		bruteCount = 0;
+		start = GetSeconds();
+		for(query=0; query<TREE_QUERY_COUNT; query++)
+		{
+			regionMaximum = regions[query] + D3DXVECTOR3(TREE_REGION_SIZE, TREE_REGION_SIZE, TREE_REGION_SIZE);
+			for(i=0; i<count; i++)
+			{
+				if((minimums[i].x <= regionMaximum.x) && (minimums[i].y <= regionMaximum.y) && (minimums[i].z <= regionMaximum.z) &&
+					(regions[query].x <= maximums[i].x) && (regions[query].y <= maximums[i].y) && (regions[query].z <= maximums[i].z))
+				{
+					bruteCount++;
+				}
+			}
+		}
+		bruteTime = GetSeconds() - start;
+
+		if(treeCount != bruteCount)
+		{
+			cout << "  region queries found " << treeCount << " objects, brute force " << bruteCount << endl;
+			return false;
+		}
+
+		cout << "    region  " << setw(10) << setprecision(3) << treeTime * 1000000.0 / TREE_QUERY_COUNT << " us against " << setw(10)
+			<< bruteTime * 1000000.0 / TREE_QUERY_COUNT << " us, " << treeCount << " objects" << endl;
+
+		// Ray casts from the middle of the world.
+		treeDistance = 0.0f;
+		start = GetSeconds();
+		for(query=0; query<TREE_QUERY_COUNT; query++)
+		{
+			if(tree->RayCast(eye, directions[query], SCREEN_DEPTH, object, distance))
+			{
+				treeDistance += distance;
+			}
+		}
+		treeTime = GetSeconds() - start;
+
+		bruteDistance = 0.0f;
+		start = GetSeconds();
+		for(query=0; query<TREE_QUERY_COUNT; query++)
+		{
+			inverse = D3DXVECTOR3(1.0f / directions[query].x, 1.0f / directions[query].y, 1.0f / directions[query].z);
+			hit = false;
+			nearestDistance = SCREEN_DEPTH;
+			for(i=0; i<count; i++)
+			{
+				if(RayHitsBox(eye, inverse, minimums[i], maximums[i], nearestDistance, distance))
+				{
+					nearestDistance = distance;
+					hit = true;
+				}
+			}
+
+			if(hit)
+			{
+				bruteDistance += nearestDistance;
+			}
+		}
+		bruteTime = GetSeconds() - start;
+
+		if(treeDistance != bruteDistance)
+		{
+			cout << "  ray casts hit at " << treeDistance << " in total, brute force " << bruteDistance << endl;
+			return false;
+		}
+
+		cout << "    ray     " << setw(10) << setprecision(3) << treeTime * 1000000.0 / TREE_QUERY_COUNT << " us against " << setw(10)
+			<< bruteTime * 1000000.0 / TREE_QUERY_COUNT << " us" << endl;
+
+		tree->Shutdown();
+		delete tree;
+		tree = 0;
+	}
+
+	return true;
+}
+
+
+bool PointHidden(vector<D3DXVECTOR3>& wallMinimums, vector<D3DXVECTOR3>& wallMaximums, D3DXVECTOR3& point, float margin)
+{
+	float scale, x, y, border;
+	int i;
+
+
+	// The walls face the camera at the origin, so a point is hidden when its ray crosses a wall's rectangle first.
+	// The margin widens the walls by a fraction of their depth, to allow for the buffer's pixels.
+	for(i=0; i<(int)wallMinimums.size(); i++)
+	{
+		if(wallMinimums[i].z >= point.z)
+		{
+			continue;
+		}
+
+		scale = wallMinimums[i].z / point.z;
+		x = point.x * scale;
+		y = point.y * scale;
+		border = margin * wallMinimums[i].z;
+		if((x >= wallMinimums[i].x - border) && (x <= wallMaximums[i].x + border) && (y >= wallMinimums[i].y - border) && (y <= wallMaximums[i].y + border))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+bool BenchmarkOcclusion()
+{
+	OcclusionClass* occlusion;
+	ThreadPoolClass* threadPool;
+	vector<VertexType::Default> wall;
+	vector<D3DXVECTOR3> wallMinimums, wallMaximums, boxMinimums, boxMaximums, corners;
+	vector<int> objects;
+	D3DXMATRIX viewMatrix, projectionMatrix, scaleMatrix, translationMatrix, worldMatrix;
+	D3DXVECTOR3 eye, at, up, center, extents, point;
+	VertexType::Default vertex;
+	double start, elapsed, frameTime, baseline;
+	float x0, y0, x1, y1, z, margin;
+	bool result;
+	int mesh, visibleCount, leaks, threads, frames, i, j, k;
+
+
+	// Tessellate a unit wall facing the camera, clockwise as seen from in front.
+	memset(&vertex, 0, sizeof(vertex));
+	for(j=0; j<OCCLUSION_WALL_DIVISIONS; j++)
+	{
+		for(i=0; i<OCCLUSION_WALL_DIVISIONS; i++)
+		{
+			x0 = (float)i / (float)OCCLUSION_WALL_DIVISIONS;
+			y0 = (float)j / (float)OCCLUSION_WALL_DIVISIONS;
+			x1 = (float)(i + 1) / (float)OCCLUSION_WALL_DIVISIONS;
+			y1 = (float)(j + 1) / (float)OCCLUSION_WALL_DIVISIONS;
+
+			vertex.position = D3DXVECTOR3(x0, y1, 0.0f); wall.push_back(vertex);
+			vertex.position = D3DXVECTOR3(x1, y1, 0.0f); wall.push_back(vertex);
+			vertex.position = D3DXVECTOR3(x1, y0, 0.0f); wall.push_back(vertex);
+			vertex.position = D3DXVECTOR3(x0, y1, 0.0f); wall.push_back(vertex);
+			vertex.position = D3DXVECTOR3(x1, y0, 0.0f); wall.push_back(vertex);
+			vertex.position = D3DXVECTOR3(x0, y0, 0.0f); wall.push_back(vertex);
+		}
+	}
+
+	occlusion = new OcclusionClass;
+	if(!occlusion)
+	{
+		return false;
+	}
+
+	result = occlusion->Initialize();
+	if(!result)
+	{
+		return false;
+	}
+
+	mesh = occlusion->AddMesh(&wall[0], (int)wall.size());
+
+	// Look down the Z axis with the same projection as the graphics class.
+	eye = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+	at = D3DXVECTOR3(0.0f, 0.0f, 1.0f);
+	up = D3DXVECTOR3(0.0f, 1.0f, 0.0f);
+	D3DXMatrixLookAtLH(&viewMatrix, &eye, &at, &up);
+	D3DXMatrixPerspectiveFovLH(&projectionMatrix, (float)D3DX_PI / 4.0f, 2.0f, SCREEN_NEAR, SCREEN_DEPTH);
+
+	// Stand walls of random sizes up across the view like a street of buildings.
+	srand(1);
+	for(i=0; i<OCCLUSION_WALL_COUNT; i++)
+	{
+		z = RandomFloat(30.0f, 300.0f);
+		x0 = RandomFloat(-0.8f, 0.6f) * z;
+		y0 = RandomFloat(-0.4f, -0.1f) * z;
+		x1 = x0 + (RandomFloat(0.1f, 0.4f) * z);
+		y1 = y0 + (RandomFloat(0.2f, 0.5f) * z);
+
+		wallMinimums.push_back(D3DXVECTOR3(x0, y0, z));
+		wallMaximums.push_back(D3DXVECTOR3(x1, y1, z));
+	}
+
+	// Scatter boxes through the view behind and between them.
+	for(i=0; i<OCCLUSION_BOX_COUNT; i++)
+	{
+		z = RandomFloat(10.0f, 500.0f);
+		center = D3DXVECTOR3(RandomFloat(-0.75f, 0.75f) * z, RandomFloat(-0.35f, 0.35f) * z, z);
+		extents = D3DXVECTOR3(RandomFloat(0.5f, 3.0f), RandomFloat(0.5f, 3.0f), RandomFloat(0.5f, 3.0f));
+		boxMinimums.push_back(center - extents);
+		boxMaximums.push_back(center + extents);
+	}
+
+	// Put one box right behind the middle of the nearest wall and one right in front of it.
+	k = 0;
+	for(i=1; i<OCCLUSION_WALL_COUNT; i++)
+	{
+		if(wallMinimums[i].z < wallMinimums[k].z)
+		{
+			k = i;
+		}
+	}
+
+	center = (wallMinimums[k] + wallMaximums[k]) * 0.5f;
+	boxMinimums[0] = center + D3DXVECTOR3(-1.0f, -1.0f, 5.0f);
+	boxMaximums[0] = center + D3DXVECTOR3(1.0f, 1.0f, 7.0f);
+	boxMinimums[1] = center + D3DXVECTOR3(-1.0f, -1.0f, -7.0f);
+	boxMaximums[1] = center + D3DXVECTOR3(1.0f, 1.0f, -5.0f);
+
+	cout << "Occlusion culling, " << OCCLUSION_WALL_COUNT * (int)wall.size() / 3 << " occluder triangles, " << OCCLUSION_BOX_COUNT << " boxes" << endl;
+
+	// Time drawing the occluders across threads.
+	baseline = 0.0;
+	for(threads=1; threads<=MAX_BENCHMARK_THREADS; threads*=2)
+	{
+		threadPool = new ThreadPoolClass;
+		if(!threadPool)
+		{
+			return false;
+		}
+
+		result = threadPool->Initialize(threads - 1);
+		if(!result)
+		{
+			return false;
+		}
+
+		frames = 0;
+		start = GetSeconds();
+		do
+		{
+			occlusion->BeginFrame(viewMatrix, projectionMatrix);
+			for(i=0; i<OCCLUSION_WALL_COUNT; i++)
+			{
+				D3DXMatrixScaling(&scaleMatrix, wallMaximums[i].x - wallMinimums[i].x, wallMaximums[i].y - wallMinimums[i].y, 1.0f);
+				D3DXMatrixTranslation(&translationMatrix, wallMinimums[i].x, wallMinimums[i].y, wallMinimums[i].z);
+				worldMatrix = scaleMatrix * translationMatrix;
+				occlusion->AddOccluder(mesh, worldMatrix);
+			}
+
+			occlusion->Rasterize(threadPool);
+			frames++;
+			elapsed = GetSeconds() - start;
+		}
+		while(elapsed < BENCHMARK_SECONDS);
+
+		frameTime = elapsed / (double)frames;
+		if(threads == 1)
+		{
+			baseline = frameTime;
+		}
+
+		cout << "  " << threads << " thread(s)" << setw(10) << fixed << setprecision(3) << frameTime * 1000.0 << " ms/frame  "
+			<< setprecision(2) << baseline / frameTime << "x" << endl;
+
+		threadPool->Shutdown();
+		delete threadPool;
+		threadPool = 0;
+	}
+
+	// Time testing every box against the buffer the last frame left.
+	frames = 0;
+	start = GetSeconds();
+	do
+	{
+		objects.resize(OCCLUSION_BOX_COUNT);
+		for(i=0; i<OCCLUSION_BOX_COUNT; i++)
+		{
+			objects[i] = i;
+		}
+
+		visibleCount = occlusion->Cull(&objects[0], OCCLUSION_BOX_COUNT, &boxMinimums[0], &boxMaximums[0]);
+		frames++;
+		elapsed = GetSeconds() - start;
+	}
+	while(elapsed < BENCHMARK_SECONDS);
+
+	cout << "  Test" << setw(17) << fixed << setprecision(3) << (elapsed / (double)frames) * 1000.0 << " ms/frame  "
+		<< setprecision(1) << (elapsed / (double)frames) * 1.0e9 / (double)OCCLUSION_BOX_COUNT << " ns/box  "
+		<< OCCLUSION_BOX_COUNT - visibleCount << " occluded (" << setprecision(1)
+		<< 100.0 * (double)(OCCLUSION_BOX_COUNT - visibleCount) / (double)OCCLUSION_BOX_COUNT << "%)" << endl;
+
+	// The buffer must hide the box behind the wall and keep the one in front.
+	if((visibleCount == 0) || (objects[0] == 0) || (objects[0] != 1))
+	{
+		cout << "  Occlusion culled the wrong side of the wall" << endl;
+		return false;
+	}
+
+	// Every culled box must really be hidden, allowing for the half a buffer pixel a wall's edge can be off by.
+	// Check a grid of points on each against the walls.
+	margin = 0.5f * 2.0f * tanf((float)D3DX_PI / 8.0f) / (float)OCCLUSION_HEIGHT;
+	leaks = 0;
+	k = 0;
+	for(i=0; i<OCCLUSION_BOX_COUNT; i++)
+	{
+		if((k < visibleCount) && (objects[k] == i))
+		{
+			k++;
+			continue;
+		}
+
+		for(j=0; j<27; j++)
+		{
+			point.x = boxMinimums[i].x + (boxMaximums[i].x - boxMinimums[i].x) * (float)(j % 3) * 0.5f;
+			point.y = boxMinimums[i].y + (boxMaximums[i].y - boxMinimums[i].y) * (float)((j / 3) % 3) * 0.5f;
+			point.z = boxMinimums[i].z + (boxMaximums[i].z - boxMinimums[i].z) * (float)(j / 9) * 0.5f;
+			if(!PointHidden(wallMinimums, wallMaximums, point, margin))
+			{
+				leaks++;
+				break;
+			}
+		}
+	}
+
+	if(leaks > 0)
+	{
+		cout << "  " << leaks << " culled boxes can be seen" << endl;
+		return false;
+	}
+
+	// Keep the buffer for inspection.
+	if(occlusion->SaveDepth("occlusion.tga"))
+	{
+		cout << "  Depth buffer written to occlusion.tga" << endl;
+	}
+
+	occlusion->Shutdown();
+	delete occlusion;
+	occlusion = 0;
+
+	return true;
+}
+
+
+void JobItemsTask(void* context, int start, int end)
+{
+	JobItemsType* items;
+	float value;
+	int i, j;
+
+
+	items = (JobItemsType*)context;
+
+	// Iterate a short recurrence per item, so the work is all arithmetic and scales with the cores.
+	for(i=start; i<end; i++)
+	{
+		value = items->values[i];
+		for(j=0; j<JOB_ITEM_WORK; j++)
+		{
+			value = value * 0.999f + sqrtf(value + (float)j);
+		}
+		items->values[i] = value;
+	}
+
+	return;
+}
+
+
+void EmptyTask(void* context, int index)
+{
+	return;
+}
+
+
+bool BenchmarkJobs()
+{
+	ThreadPoolClass* threadPool;
+	ThreadPoolClass::CounterType counter;
+	JobItemsType items;
+	double start, elapsed, itemsPerSecond, jobsPerSecond, baseline;
+	int threads, rounds, i;
+	bool result;
+
+
+	items.count = JOB_ITEM_COUNT;
+	items.values = new float[JOB_ITEM_COUNT];
+	if(!items.values)
+	{
+		return false;
+	}
+
+	for(i=0; i<JOB_ITEM_COUNT; i++)
+	{
+		items.values[i] = (float)(i % 1000);
+	}
+
+	cout << "Job system scaling, " << JOB_ITEM_COUNT << " items in jobs of " << JOB_GRAIN_SIZE << endl;
+
+	baseline = 0.0;
+	for(threads=1; threads<=MAX_BENCHMARK_THREADS; threads*=2)
+	{
+		threadPool = new ThreadPoolClass;
+		if(!threadPool)
+		{
+			return false;
+		}
+
+		result = threadPool->Initialize(threads - 1);
+		if(!result)
+		{
+			return false;
+		}
+
+		// Run the loop until enough time has passed for a stable measurement.
+		rounds = 0;
+		start = GetSeconds();
+		do
+		{
+			threadPool->ParallelFor(&JobItemsTask, &items, items.count, JOB_GRAIN_SIZE);
+			rounds++;
+			elapsed = GetSeconds() - start;
+		}
+		while(elapsed < BENCHMARK_SECONDS);
+
+		itemsPerSecond = (double)rounds * JOB_ITEM_COUNT / elapsed;
+
+		// Time jobs that do nothing, to see what a job itself costs.
+		rounds = 0;
+		start = GetSeconds();
+		do
+		{
+			counter = 0;
+			for(i=0; i<JOB_EMPTY_COUNT; i++)
+			{
+				threadPool->Submit(&EmptyTask, 0, i, &counter);
+			}
+			threadPool->Wait(&counter);
+			rounds++;
+			elapsed = GetSeconds() - start;
+		}
+		while(elapsed < BENCHMARK_SECONDS);
+
+		jobsPerSecond = (double)rounds * JOB_EMPTY_COUNT / elapsed;
+
+		if(threads == 1)
+		{
+			baseline = itemsPerSecond;
+		}
+
+		cout << "  " << setw(2) << threads << " threads" << setw(10) << fixed << setprecision(2) << itemsPerSecond / 1000000.0
+			<< " Mitems/s" << setw(8) << setprecision(2) << itemsPerSecond / baseline << "x" << setw(10) << setprecision(2)
+			<< jobsPerSecond / 1000000.0 << " Mjobs/s empty" << endl;
+
+		threadPool->Shutdown();
+		delete threadPool;
+		threadPool = 0;
+	}
+
+	delete [] items.values;
+	items.values = 0;
+
+	return true;
+}
+
+
+void StressParentTask(void* context, int parent)
+{
+	JobStressType* stress;
+	ThreadPoolClass::CounterType counter;
+	int i;
+
+
+	stress = (JobStressType*)context;
+
+	// Spawn children onto this thread's own deque, where idle threads steal them, and wait on them as a
+	// dependency.  Some children queue work for the main thread that the wait also depends on.
+	counter = 0;
+	for(i=0; i<JOB_STRESS_CHILDREN; i++)
+	{
+		stress->threadPool->Submit(&StressChildTask, stress, i, &counter);
+		if(i % JOB_STRESS_MAIN_INTERVAL == 0)
+		{
+			stress->threadPool->SubmitMain(&StressMainTask, stress, i, &counter);
+		}
+	}
+
+	stress->threadPool->Wait(&counter);
+
+	return;
+}
+
+
+void StressChildTask(void* context, int child)
+{
+	JobStressType* stress;
+
+
+	stress = (JobStressType*)context;
+	stress->children++;
+
+	return;
+}
+
+
+void StressMainTask(void* context, int child)
+{
+	JobStressType* stress;
+
+
+	stress = (JobStressType*)context;
+	if(!stress->threadPool->IsMainThread())
+	{
+		stress->wrongThread++;
+	}
+
+	stress->mainJobs++;
+
+	return;
+}
+
+
+bool StressJobs()
+{
+	ThreadPoolClass* threadPool;
+	ThreadPoolClass::CounterType counter;
+	JobStressType stress;
+	double start, elapsed;
+	int expectedChildren, expectedMain, round, i;
+	bool result;
+
+
+	cout << "Job system stress, " << JOB_STRESS_ROUNDS << " rounds of " << JOB_STRESS_PARENTS << " jobs waiting on "
+		<< JOB_STRESS_CHILDREN << " children each, on " << MAX_BENCHMARK_THREADS << " threads" << endl;
+
+	threadPool = new ThreadPoolClass;
+	if(!threadPool)
+	{
+		return false;
+	}
+
+	result = threadPool->Initialize(MAX_BENCHMARK_THREADS - 1);
+	if(!result)
+	{
+		return false;
+	}
+
+	stress.threadPool = threadPool;
+	stress.children = 0;
+	stress.mainJobs = 0;
+	stress.wrongThread = 0;
+
+	// Every round pushes parents from the main thread, which the workers steal and nest under.
+	start = GetSeconds();
+	for(round=0; round<JOB_STRESS_ROUNDS; round++)
+	{
+		counter = 0;
+		for(i=0; i<JOB_STRESS_PARENTS; i++)
+		{
+			threadPool->Submit(&StressParentTask, &stress, i, &counter);
+		}
+
+		threadPool->Wait(&counter);
+	}
+	elapsed = GetSeconds() - start;
+
+	threadPool->Shutdown();
+	delete threadPool;
+	threadPool = 0;
+
+	// Every job must have run exactly once, and the main thread jobs only on the main thread.
+	expectedChildren = JOB_STRESS_ROUNDS * JOB_STRESS_PARENTS * JOB_STRESS_CHILDREN;
+	expectedMain = JOB_STRESS_ROUNDS * JOB_STRESS_PARENTS * ((JOB_STRESS_CHILDREN + JOB_STRESS_MAIN_INTERVAL - 1) / JOB_STRESS_MAIN_INTERVAL);
+
+	cout << "  " << fixed << setprecision(2) << elapsed * 1000.0 << " ms, " << stress.children << "/" << expectedChildren
+		<< " children, " << stress.mainJobs << "/" << expectedMain << " main thread jobs, " << stress.wrongThread
+		<< " on the wrong thread" << endl;
+
+	if((stress.children != expectedChildren) || (stress.mainJobs != expectedMain) || (stress.wrongThread != 0))
+	{
+		cout << "  FAILED" << endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+bool BenchmarkPipeline()
+{
+	GraphicsClass* graphics;
+	GraphicsClass::ModelHandleType model;
+	double start, elapsed, frameTime, baseline;
+	int frames, depth, i;
+	bool result;
+
+
+	cout << "Pipelined frames, " << SCENE_MODEL_COUNT << " models prepared on the workers while the last frame is drawn, on "
+		<< MAX_BENCHMARK_THREADS << " threads" << endl;
+
+	// Build the scene once and change the depth between runs.
+	graphics = new GraphicsClass;
+	if(!graphics)
+	{
+		return false;
+	}
+
+	result = graphics->InitializeHeadless(800, 600, MAX_BENCHMARK_THREADS - 1);
+	if(!result)
+	{
+		return false;
+	}
+
+	for(i=0; i<SCENE_MODEL_COUNT; i++)
+	{
+		model = graphics->LoadModelResource("../Engine/data/swordOpt.bin", L"../Engine/data/seafloor.dds");
+		if(model.value == HANDLE_INVALID)
+		{
+			return false;
+		}
+	}
+
+	baseline = 0.0;
+	for(depth=1; depth<=PIPELINE_MAX_DEPTH; depth++)
+	{
+		result = graphics->SetPipelineDepth(depth);
+		if(!result)
+		{
+			return false;
+		}
+
+		// Draw frames until enough time has passed for a stable measurement.
+		frames = 0;
+		start = GetSeconds();
+		do
+		{
+			result = graphics->Frame(0.6f, 0.3f, 0.0f, -10.0f, 0.0f, 0.0f);
+			if(!result)
+			{
+				return false;
+			}
+			frames++;
+			elapsed = GetSeconds() - start;
+		}
+		while(elapsed < BENCHMARK_SECONDS);
+
+		frameTime = elapsed / (double)frames;
+		if(depth == 1)
+		{
+			baseline = frameTime;
+		}
+
+		cout << "  depth " << depth << setw(10) << fixed << setprecision(2) << frameTime * 1000.0 << " ms/frame" << setw(9)
+			<< setprecision(2) << baseline / frameTime << "x" << endl;
+	}
+
+	graphics->Shutdown();
+	delete graphics;
+	graphics = 0;
+
+	return true;
+}
+
+
+bool BenchmarkFrameAllocator()
+{
+	char* arrays[TRANSIENT_ARRAY_COUNT];
+	double start, heapTime, frameTime;
+	int frame, i;
+	bool result;
+
+
+	cout << "Transient arrays, " << TRANSIENT_ARRAY_COUNT << " of " << TRANSIENT_ARRAY_SIZE << " bytes a frame like the text"
+		<< " overlay's, for " << TRANSIENT_FRAME_COUNT << " frames" << endl;
+
+	// Allocate and free every array each frame, the way the text and bitmap updates used to.
+	start = GetSeconds();
+	for(frame=0; frame<TRANSIENT_FRAME_COUNT; frame++)
+	{
+		for(i=0; i<TRANSIENT_ARRAY_COUNT; i++)
+		{
+			arrays[i] = new char[TRANSIENT_ARRAY_SIZE];
+			arrays[i][0] = (char)i;
+		}
+
+		for(i=0; i<TRANSIENT_ARRAY_COUNT; i++)
+		{
+			delete [] arrays[i];
+		}
+	}
+	heapTime = GetSeconds() - start;
+
+	// Take them from frame memory instead and rewind it at the end of each frame.
+	result = FrameAllocatorClass::Initialize();
+	if(!result)
+	{
+		return false;
+	}
+
+	start = GetSeconds();
+	for(frame=0; frame<TRANSIENT_FRAME_COUNT; frame++)
+	{
+		for(i=0; i<TRANSIENT_ARRAY_COUNT; i++)
+		{
+			arrays[i] = (char*)FrameAllocatorClass::Allocate(TRANSIENT_ARRAY_SIZE);
+			if(!arrays[i])
+			{
+				return false;
+			}
+			arrays[i][0] = (char)i;
+		}
+
+		FrameAllocatorClass::EndFrame();
+	}
+	frameTime = GetSeconds() - start;
+
+	FrameAllocatorClass::Shutdown();
+
+	cout << "  new and delete  " << setw(10) << fixed << setprecision(1) << heapTime * 1000000000.0 / (TRANSIENT_FRAME_COUNT *
+		TRANSIENT_ARRAY_COUNT) << " ns/array" << endl;
+	cout << "  frame allocator " << setw(10) << fixed << setprecision(1) << frameTime * 1000000000.0 / (TRANSIENT_FRAME_COUNT *
+		TRANSIENT_ARRAY_COUNT) << " ns/array" << setw(9) << setprecision(2) << heapTime / frameTime << "x" << endl;
+
+	return true;
+}
+
+
+bool BenchmarkHandles()
+{
+	unordered_map<string, int*> names;
+	vector<string> keys;
+	vector<unsigned int> handles, order;
+	HandleTableClass table;
+	int resources[HANDLE_RESOURCE_COUNT];
+	char key[40];
+	double start, nameTime, handleTime, walkNameTime, walkHandleTime;
+	long long sum;
+	int i, j, stale;
+	bool result;
+
+
+	cout << "Resource lookups, " << HANDLE_LOOKUP_COUNT << " in random order among " << HANDLE_RESOURCE_COUNT << " resources"
+		<< endl;
+
+	// Key every resource both by a string formatted like the RPC UUIDs the resources used to have and by a handle.
+	result = table.Initialize();
+	if(!result)
+	{
+		return false;
+	}
+
+	srand(1);
+	for(i=0; i<HANDLE_RESOURCE_COUNT; i++)
+	{
+		resources[i] = i;
+
+		sprintf_s(key, sizeof(key), "%08x-%04x-%04x-%04x-%04x%08x", rand() * rand(), rand() & 0xffff, rand() & 0xffff,
+			rand() & 0xffff, rand() & 0xffff, rand() * rand());
+		keys.push_back(key);
+		names[key] = &resources[i];
+
+		handles.push_back(table.Add(&resources[i]));
+	}
+
+	order.resize(HANDLE_LOOKUP_COUNT);
+	for(i=0; i<HANDLE_LOOKUP_COUNT; i++)
+	{
+		order[i] = rand() % HANDLE_RESOURCE_COUNT;
+	}
+
+	// Look the resources up by name, then by handle.
+	sum = 0;
+	start = GetSeconds();
+	for(i=0; i<HANDLE_LOOKUP_COUNT; i++)
+	{
+		sum += *names[keys[order[i]]];
+	}
+	nameTime = GetSeconds() - start;
+
+	start = GetSeconds();
+	for(i=0; i<HANDLE_LOOKUP_COUNT; i++)
+	{
+		sum -= *(int*)table.Get(handles[order[i]]);
+	}
+	handleTime = GetSeconds() - start;
+
+	if(sum != 0)
+	{
+		cout << "  lookups disagree" << endl;
+		return false;
+	}
+
+	// Walk every live resource, through the hash buckets and through the dense array.
+	start = GetSeconds();
+	for(i=0; i<HANDLE_LOOKUP_COUNT / HANDLE_RESOURCE_COUNT; i++)
+	{
+		for(auto it = names.begin(); it != names.end(); it++)
+		{
+			sum += *it->second;
+		}
+	}
+	walkNameTime = GetSeconds() - start;
+
+	start = GetSeconds();
+	for(i=0; i<HANDLE_LOOKUP_COUNT / HANDLE_RESOURCE_COUNT; i++)
+	{
+		for(j=0; j<table.GetCount(); j++)
+		{
+			sum -= *(int*)table.GetItem(j);
+		}
+	}
+	walkHandleTime = GetSeconds() - start;
+
+	// Remove every other resource and check that none of their handles still finds anything.
+	for(i=0; i<HANDLE_RESOURCE_COUNT; i+=2)
+	{
+		table.Remove(handles[i]);
+	}
+
+	stale = 0;
+	for(i=0; i<HANDLE_RESOURCE_COUNT; i++)
+	{
+		if((table.Get(handles[i]) != 0) != ((i % 2) == 1))
+		{
+			stale++;
+		}
+	}
+
+	table.Shutdown();
+
+	if((sum != 0) || (stale != 0))
+	{
+		cout << "  walks disagree or " << stale << " handles survived their removal" << endl;
+		return false;
+	}
+
+	cout << "  string lookup   " << setw(10) << fixed << setprecision(1) << nameTime * 1000000000.0 / HANDLE_LOOKUP_COUNT
+		<< " ns/lookup" << endl;
+	cout << "  handle lookup   " << setw(10) << fixed << setprecision(1) << handleTime * 1000000000.0 / HANDLE_LOOKUP_COUNT
+		<< " ns/lookup" << setw(9) << setprecision(2) << nameTime / handleTime << "x" << endl;
+	cout << "  hash map walk   " << setw(10) << fixed << setprecision(1) << walkNameTime * 1000000000.0 / HANDLE_LOOKUP_COUNT
+		<< " ns/resource" << endl;
+	cout << "  dense walk      " << setw(10) << fixed << setprecision(1) << walkHandleTime * 1000000000.0 /
+		HANDLE_LOOKUP_COUNT << " ns/resource" << setw(9) << setprecision(2) << walkNameTime / walkHandleTime << "x" << endl;
+
+	return true;
+}
+
+
+bool BenchmarkSprites()
+{
+	GraphicsClass* graphics;
+	GraphicsClass::BitmapHandleType bitmaps[SPRITE_BITMAP_COUNT];
+	double start, elapsed, frameTime, baseline;
+	int frames, sprites, drawCalls, i;
+	bool result;
+
+
+	cout << "Sprites, " << SPRITE_COUNT << " of " << SPRITE_SIZE << "x" << SPRITE_SIZE << " pixels a frame from " << SPRITE_BITMAP_COUNT
+		<< " bitmaps on " << SPRITE_LAYERS << " layers, software rendered" << endl;
+
+	graphics = new GraphicsClass;
+	if(!graphics)
+	{
+		return false;
+	}
+
+	result = graphics->InitializeHeadless(800, 600, MAX_BENCHMARK_THREADS - 1);
+	if(!result)
+	{
+		return false;
+	}
+
+	for(i=0; i<SPRITE_BITMAP_COUNT; i++)
+	{
+		bitmaps[i] = graphics->LoadBitmapResource(L"../Engine/data/seafloor.dds", SPRITE_SIZE, SPRITE_SIZE);
+		if(bitmaps[i].value == HANDLE_INVALID)
+		{
+			return false;
+		}
+	}
+
+	// Time frames with only the loaded bitmaps first, then with the sprites queued in random order every frame.
+	srand(1);
+	baseline = 0.0;
+	for(sprites=0; sprites<=SPRITE_COUNT; sprites+=SPRITE_COUNT)
+	{
+		frames = 0;
+		drawCalls = 0;
+		start = GetSeconds();
+		do
+		{
+			for(i=0; i<sprites; i++)
+			{
+				result = graphics->AddSprite(bitmaps[rand() % SPRITE_BITMAP_COUNT], rand() % (800 - SPRITE_SIZE),
+					rand() % (600 - SPRITE_SIZE), rand() % SPRITE_LAYERS);
+				if(!result)
+				{
+					return false;
+				}
+			}
+
+			result = graphics->Frame(0.0f, 0.0f, 0.0f, -10.0f, 0.0f, 0.0f);
+			if(!result)
+			{
+				return false;
+			}
+
+			drawCalls = graphics->GetDrawCalls();
+			frames++;
+			elapsed = GetSeconds() - start;
+		}
+		while(elapsed < BENCHMARK_SECONDS);
+
+		frameTime = elapsed / (double)frames;
+		if(sprites == 0)
+		{
+			baseline = frameTime;
+			cout << "  no sprites    " << setw(10) << fixed << setprecision(2) << frameTime * 1000.0 << " ms/frame" << setw(8)
+				<< drawCalls << " draws" << endl;
+		}
+		else
+		{
+			cout << "  " << sprites << " sprites " << setw(10) << fixed << setprecision(2) << frameTime * 1000.0 << " ms/frame" << setw(8)
+				<< drawCalls << " draws" << setw(10) << setprecision(3) << (frameTime - baseline) * 1000000.0 / sprites << " us/sprite"
+				<< endl;
+		}
+	}
+
+	graphics->Shutdown();
+	delete graphics;
+
+	return true;
+}
+
+
+bool BenchmarkText()
+{
+	TextClass* text;
+	unsigned int handles[TEXT_OBJECT_COUNT];
+	char lines[2][TEXT_OBJECT_COUNT][TEXT_LINE_LENGTH];
+	int changes[3] = { 0, 1, TEXT_OBJECT_COUNT };
+	D3DXMATRIX baseViewMatrix;
+	double start, elapsed, frameTime;
+	int frames, variant, i, j;
+	bool result;
+
+
+	cout << "Retained text, " << TEXT_OBJECT_COUNT << " lines updated a frame and packed, laid out without a device" << endl;
+
+	text = new TextClass;
+	if(!text)
+	{
+		return false;
+	}
+
+	D3DXMatrixIdentity(&baseViewMatrix);
+	result = text->Initialize(0, 0, 0, 800, 600, baseViewMatrix);
+	if(!result)
+	{
+		return false;
+	}
+
+	// Give every line two versions of a profiler style summary to switch between.
+	for(i=0; i<TEXT_OBJECT_COUNT; i++)
+	{
+		handles[i] = text->CreateText();
+		if(handles[i] == HANDLE_INVALID)
+		{
+			return false;
+		}
+
+		sprintf_s(lines[0][i], TEXT_LINE_LENGTH, "Zone %d: %.3f ms, %d calls", i, i * 0.125, i * 3);
+		sprintf_s(lines[1][i], TEXT_LINE_LENGTH, "Zone %d: %.3f ms, %d calls", i, i * 0.25, i * 3 + 1);
+	}
+
+	// Time frames that pass every line in again, with none, one or all of them different from the frame before.
+	for(j=0; j<3; j++)
+	{
+		frames = 0;
+		start = GetSeconds();
+		do
+		{
+			variant = frames & 1;
+			for(i=0; i<TEXT_OBJECT_COUNT; i++)
+			{
+				result = text->UpdateText(handles[i], lines[(i < changes[j]) ? variant : 0][i], 10, 10 + i * 16, 1.0f, 1.0f, 0.0f);
+				if(!result)
+				{
+					return false;
+				}
+			}
+
+			result = text->Upload(0);
+			if(!result)
+			{
+				return false;
+			}
+
+			frames++;
+			elapsed = GetSeconds() - start;
+		}
+		while(elapsed < BENCHMARK_SECONDS);
+
+		frameTime = elapsed / (double)frames;
+		cout << "  " << setw(2) << changes[j] << " changed    " << setw(10) << fixed << setprecision(2) << frameTime * 1000000.0
+			<< " us/frame" << setw(8) << text->GetGlyphCount() << " glyphs" << endl;
+	}
+
+	text->Shutdown();
+	delete text;
+
+	return true;
+}
+
+
+bool BenchmarkConstants()
+{
+	ConstantAllocatorClass* allocator;
+	ConstantAllocatorClass::BlockType block;
+	D3DXMATRIX worldMatrix;
+	D3DXMATRIX* dataPtr;
+	double start, elapsed, frameTime;
+	int draws, frames, i;
+	bool result;
+
+
+	cout << "Light constants, a world matrix block for every draw of a frame from the constant ring, without a device" << endl;
+
+	allocator = new ConstantAllocatorClass;
+	if(!allocator)
+	{
+		return false;
+	}
+
+	result = allocator->Initialize(0, 0, 0);
+	if(!result)
+	{
+		return false;
+	}
+
+	// Give every draw a transform of its own, past the blocks the ring starts out with room for in a frame.
+	for(draws=CONSTANT_MIN_DRAWS; draws<=CONSTANT_MAX_DRAWS; draws*=4)
+	{
+		frames = 0;
+		start = GetSeconds();
+		do
+		{
+			allocator->BeginFrame();
+			for(i=0; i<draws; i++)
+			{
+				D3DXMatrixTranslation(&worldMatrix, (float)i, (float)frames, 0.0f);
+
+				dataPtr = (D3DXMATRIX*)allocator->Allocate(sizeof(D3DXMATRIX), block);
+				if(!dataPtr)
+				{
+					cout << "  ran out of constants after " << i << " draws" << endl;
+					return false;
+				}
+
+				D3DXMatrixTranspose(dataPtr, &worldMatrix);
+			}
+
+			result = allocator->Upload();
+			if(!result)
+			{
+				return false;
+			}
+
+			frames++;
+			elapsed = GetSeconds() - start;
+		}
+		while(elapsed < BENCHMARK_SECONDS);
+
+		frameTime = elapsed / (double)frames;
+		cout << "  " << setw(6) << draws << " draws   " << setw(10) << fixed << setprecision(2) << frameTime * 1000000.0 << " us/frame"
+			<< setw(8) << setprecision(1) << frameTime * 1000000000.0 / draws << " ns/draw" << setw(6) << allocator->GetRingSize() / 1048576
+			<< " MB ring" << endl;
+	}
+
+	allocator->Shutdown();
+	delete allocator;
+
+	return true;
+}
+
+
+bool BenchmarkHierarchicalZ()
+{
+	GraphicsClass* graphics;
+	GraphicsClass::ModelHandleType model;
+	vector<unsigned int> frames[2];
+	double start, elapsed, frameTime, baseline;
+	int count, pass, i;
+	bool result;
+
+
+	cout << "Hierarchical depth rejection, " << SCENE_MODEL_COUNT << " models drawn by the software renderer on "
+		<< MAX_BENCHMARK_THREADS << " threads" << endl;
+
+	// Build the scene once and switch the rejection between runs.
+	graphics = new GraphicsClass;
+	if(!graphics)
+	{
+		return false;
+	}
+
+	result = graphics->InitializeHeadless(800, 600, MAX_BENCHMARK_THREADS - 1);
+	if(!result)
+	{
+		return false;
+	}
+
+	for(i=0; i<SCENE_MODEL_COUNT; i++)
+	{
+		model = graphics->LoadModelResource("../Engine/data/swordOpt.bin", L"../Engine/data/seafloor.dds");
+		if(model.value == HANDLE_INVALID)
+		{
+			return false;
+		}
+	}
+
+	baseline = 0.0;
+	for(pass=0; pass<2; pass++)
+	{
+		graphics->SetHierarchicalZ(pass == 1);
+
+		// Draw frames until enough time has passed for a stable measurement.
+		count = 0;
+		start = GetSeconds();
+		do
+		{
+			result = graphics->Frame(0.6f, 0.3f, 0.0f, -10.0f, 0.0f, 0.0f);
+			if(!result)
+			{
+				return false;
+			}
+			count++;
+			elapsed = GetSeconds() - start;
+		}
+		while(elapsed < BENCHMARK_SECONDS);
+
+		// Keep the last frame to check that the rejection did not change the image.
+		result = graphics->GetFrame(frames[pass]);
+		if(!result)
+		{
+			return false;
+		}
+
+		frameTime = elapsed / (double)count;
+		if(pass == 0)
+		{
+			baseline = frameTime;
+		}
+
+		cout << "  " << setw(8) << left << ((pass == 1) ? "hi-z on" : "hi-z off") << right << setw(10) << fixed << setprecision(2)
+			<< frameTime * 1000.0 << " ms/frame" << setw(9) << setprecision(2) << baseline / frameTime << "x" << setw(8)
+			<< setprecision(1) << graphics->GetRejectedPixelRatio() * 100.0f << "% pixels rejected" << endl;
+	}
+
+	graphics->Shutdown();
+	delete graphics;
+	graphics = 0;
+
+	if(frames[0] != frames[1])
+	{
+		cout << "  the frames differ with the rejection on" << endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+bool BenchmarkVertexCache()
+{
+	GraphicsClass* graphics;
+	GraphicsClass::ModelHandleType model;
+	char* filenames[2];
+	char* names[2];
+	double start, elapsed, frameTime;
+	int count, mesh, i;
+	bool result;
+
+
+	cout << "Software vertex cache, " << SCENE_MODEL_COUNT << " models of each sword mesh on " << MAX_BENCHMARK_THREADS
+		<< " threads" << endl;
+
+	// The same sword as exported and after the optimizer rewrote it.
+	filenames[0] = "../Engine/data/sword.bin";
+	filenames[1] = "../Engine/data/swordOpt.bin";
+	names[0] = "sword";
+	names[1] = "swordOpt";
+
+	for(mesh=0; mesh<2; mesh++)
+	{
+		// Build a scene of each mesh in its own headless renderer.
+		graphics = new GraphicsClass;
+		if(!graphics)
+		{
+			return false;
+		}
+
+		result = graphics->InitializeHeadless(800, 600, MAX_BENCHMARK_THREADS - 1);
+		if(!result)
+		{
+			return false;
+		}
+
+		for(i=0; i<SCENE_MODEL_COUNT; i++)
+		{
+			model = graphics->LoadModelResource(filenames[mesh], L"../Engine/data/seafloor.dds");
+			if(model.value == HANDLE_INVALID)
+			{
+				return false;
+			}
+		}
+
+		// Draw frames until enough time has passed for a stable measurement.
+		count = 0;
+		start = GetSeconds();
+		do
+		{
+			result = graphics->Frame(0.6f, 0.3f, 0.0f, -10.0f, 0.0f, 0.0f);
+			if(!result)
+			{
+				return false;
+			}
+			count++;
+			elapsed = GetSeconds() - start;
+		}
+		while(elapsed < BENCHMARK_SECONDS);
+
+		frameTime = elapsed / (double)count;
+		cout << "  " << setw(10) << left << names[mesh] << right << setw(10) << fixed
+			<< setprecision(2) << frameTime * 1000.0 << " ms/frame" << setw(8) << setprecision(2)
+			<< graphics->GetVerticesPerTriangle() << " vertices/triangle" << endl;
+
+		graphics->Shutdown();
+		delete graphics;
+		graphics = 0;
+	}
+
+	return true;
+}
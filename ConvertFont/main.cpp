@@ -0,0 +1,489 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: main.cpp
+// Turns a bitmap font into a signed distance field atlas.  The input is a
+// font data file in the engine's plain format and the uncompressed 32 bit
+// DDS strip of glyphs it describes, drawn as large as possible; the larger
+// the glyphs, the cleaner the edges come out.  Every atlas texel holds the
+// distance to the nearest glyph edge, a half on the edge and more inside,
+// and each glyph keeps a border of distance around it for the shader's edge
+// to fade into.  The atlas is written to fontsdf.dds and its data file, with
+// the distancefield header FontClass looks for, to fontsdfdata.txt.
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <iostream>
+#include <fstream>
+#include <string.h>
+#include <math.h>
+using namespace std;
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int GLYPH_COUNT = 95;
+const int DISTANCE_PADDING = 4;
+const int DDS_HEADER_SIZE = 128;
+
+
+//////////////
+// TYPEDEFS //
+//////////////
+typedef struct
+{
+	float left, right;
+	int size;
+}GlyphType;
+
+
+/////////////////////////
+// FUNCTION PROTOTYPES //
+/////////////////////////
+void GetFilename(char*, char*);
+int GetScale();
+bool LoadFontData(char*, GlyphType*);
+bool LoadTexture(char*, unsigned char*, bool*&, int&, int&);
+bool GenerateAtlas(GlyphType*, bool*, int, int, int, unsigned char*&, int&, int&);
+bool IsInside(bool*, int, int, int, int, int, int);
+unsigned char FindDistance(bool*, int, int, int, int, float, float, int);
+bool WriteTexture(unsigned char*, unsigned char*, int, int);
+bool WriteFontData(GlyphType*, int);
+
+
+//////////////////
+// MAIN PROGRAM //
+//////////////////
+int main()
+{
+	bool result;
+	char dataFilename[256], textureFilename[256];
+	GlyphType glyphs[GLYPH_COUNT];
+	unsigned char header[DDS_HEADER_SIZE];
+	bool* inside;
+	unsigned char* distances;
+	int scale, sourceWidth, sourceHeight, atlasWidth, atlasHeight;
+	char garbage;
+
+
+	// Read in the names of the font files and how far to shrink the glyphs.
+	GetFilename("Enter font data filename: ", dataFilename);
+	GetFilename("Enter font texture filename: ", textureFilename);
+	scale = GetScale();
+
+	// Read in where each glyph is in the texture and how wide it is.
+	result = LoadFontData(dataFilename, glyphs);
+	if(!result)
+	{
+		cout << "Could not read the font data." << endl;
+		return -1;
+	}
+
+	// Read in which texels of the texture are inside a glyph.
+	result = LoadTexture(textureFilename, header, inside, sourceWidth, sourceHeight);
+	if(!result)
+	{
+		cout << "Could not read the font texture, which must be an uncompressed 32 bit DDS." << endl;
+		return -1;
+	}
+
+	// Work out the distance field of every glyph and pack them into the atlas.
+	result = GenerateAtlas(glyphs, inside, sourceWidth, sourceHeight, scale, distances, atlasWidth, atlasHeight);
+	if(!result)
+	{
+		return -1;
+	}
+
+	// Display the sizes to the screen for information purposes.
+	cout << endl;
+	cout << "Texture: " << sourceWidth << "x" << sourceHeight << endl;
+	cout << "Atlas:   " << atlasWidth << "x" << atlasHeight << endl;
+
+	// Write the atlas out as a DDS like the one read in, followed by its font data.
+	result = WriteTexture(header, distances, atlasWidth, atlasHeight);
+	if(!result)
+	{
+		return -1;
+	}
+
+	result = WriteFontData(glyphs, atlasHeight - (2 * DISTANCE_PADDING));
+	if(!result)
+	{
+		return -1;
+	}
+
+	delete [] inside;
+	delete [] distances;
+
+	// Notify the user the font has been converted.
+	cout << "\nFont has been converted." << endl;
+	cout << "\nDo you wish to exit (y/n)? ";
+	cin >> garbage;
+
+	return 0;
+}
+
+
+void GetFilename(char* prompt, char* filename)
+{
+	bool done;
+	ifstream fin;
+
+
+	// Loop until we have a file name.
+	done = false;
+	while(!done)
+	{
+		// Ask the user for the filename.
+		cout << prompt;
+
+		// Read in the filename.
+		cin >> filename;
+
+		// Attempt to open the file.
+		fin.open(filename);
+
+		if(fin.good())
+		{
+			// If the file exists and there are no problems then exit since we have the file name.
+			done = true;
+		}
+		else
+		{
+			// If the file does not exist or there was an issue opening it then notify the user and repeat the process.
+			fin.clear();
+			cout << endl;
+			cout << "File " << filename << " could not be opened." << endl << endl;
+		}
+
+		fin.close();
+	}
+
+	return;
+}
+
+
+int GetScale()
+{
+	int scale;
+
+
+	// Loop until we have a whole number of texture pixels for each atlas pixel.
+	scale = 0;
+	while(scale < 1)
+	{
+		cout << "Enter how many texture pixels make one atlas pixel: ";
+		cin >> scale;
+
+		if(cin.fail())
+		{
+			cin.clear();
+			cin.ignore(256, '\n');
+			scale = 0;
+		}
+	}
+
+	return scale;
+}
+
+
+bool LoadFontData(char* filename, GlyphType* glyphs)
+{
+	ifstream fin;
+	int i;
+	char temp;
+
+
+	fin.open(filename);
+	if(fin.fail())
+	{
+		return false;
+	}
+
+	// Read the lines the same way FontClass does, skipping the character code and the character itself.
+	for(i=0; i<GLYPH_COUNT; i++)
+	{
+		fin.get(temp);
+		while(temp != ' ')
+		{
+			fin.get(temp);
+		}
+		fin.get(temp);
+		while(temp != ' ')
+		{
+			fin.get(temp);
+		}
+
+		fin >> glyphs[i].left;
+		fin >> glyphs[i].right;
+		fin >> glyphs[i].size;
+	}
+
+	if(fin.fail())
+	{
+		return false;
+	}
+
+	fin.close();
+
+	return true;
+}
+
+
+bool LoadTexture(char* filename, unsigned char* header, bool*& inside, int& width, int& height)
+{
+	ifstream fin;
+	unsigned char* pixels;
+	unsigned int flags, bitCount, redMask;
+	int redByte, i;
+
+
+	fin.open(filename, ios_base::in | ios_base::binary);
+	if(fin.fail())
+	{
+		return false;
+	}
+
+	// Read the header, which is kept to write the atlas out with.
+	fin.read((char*)header, DDS_HEADER_SIZE);
+	if(fin.fail() || (memcmp(header, "DDS ", 4) != 0))
+	{
+		return false;
+	}
+
+	memcpy(&height, &header[12], sizeof(int));
+	memcpy(&width, &header[16], sizeof(int));
+	memcpy(&flags, &header[80], sizeof(unsigned int));
+	memcpy(&bitCount, &header[88], sizeof(unsigned int));
+	memcpy(&redMask, &header[92], sizeof(unsigned int));
+
+	// Only plain 32 bit pixels are read, with no compression.
+	if(((flags & 0x40) == 0) || (bitCount != 32) || (redMask == 0))
+	{
+		return false;
+	}
+
+	// Find which byte of each pixel is red, which is where the font draws its glyphs.
+	redByte = 0;
+	while((redMask & 0xff) == 0)
+	{
+		redMask = redMask >> 8;
+		redByte++;
+	}
+
+	pixels = new unsigned char[width * height * 4];
+	if(!pixels)
+	{
+		return false;
+	}
+
+	fin.read((char*)pixels, width * height * 4);
+	if(fin.fail())
+	{
+		return false;
+	}
+
+	fin.close();
+
+	// Count a texel as inside a glyph when it is more than half lit.
+	inside = new bool[width * height];
+	if(!inside)
+	{
+		return false;
+	}
+
+	for(i=0; i<width * height; i++)
+	{
+		inside[i] = pixels[(i * 4) + redByte] > 127;
+	}
+
+	delete [] pixels;
+
+	return true;
+}
+
+
+bool GenerateAtlas(GlyphType* glyphs, bool* inside, int sourceWidth, int sourceHeight, int scale, unsigned char*& distances,
+				   int& atlasWidth, int& atlasHeight)
+{
+	int sizes[GLYPH_COUNT];
+	int sourceLeft, atlasLeft, cellWidth, i, x, y;
+	float sourceX, sourceY;
+
+
+	// Each glyph gets a cell as wide as the glyph shrunk down, with the padding on every side.
+	atlasWidth = 0;
+	for(i=0; i<GLYPH_COUNT; i++)
+	{
+		sizes[i] = (glyphs[i].size + (scale / 2)) / scale;
+		atlasWidth += sizes[i] + (2 * DISTANCE_PADDING);
+	}
+
+	atlasHeight = ((sourceHeight + (scale / 2)) / scale) + (2 * DISTANCE_PADDING);
+
+	distances = new unsigned char[atlasWidth * atlasHeight];
+	if(!distances)
+	{
+		return false;
+	}
+
+	// Fill each cell from the middle of every atlas texel mapped back onto the texture.
+	atlasLeft = 0;
+	for(i=0; i<GLYPH_COUNT; i++)
+	{
+		sourceLeft = (int)((glyphs[i].left * sourceWidth) + 0.5f);
+		cellWidth = sizes[i] + (2 * DISTANCE_PADDING);
+
+		for(y=0; y<atlasHeight; y++)
+		{
+			for(x=0; x<cellWidth; x++)
+			{
+				sourceX = ((float)(x - DISTANCE_PADDING) + 0.5f) * (float)scale;
+				sourceY = ((float)(y - DISTANCE_PADDING) + 0.5f) * (float)scale;
+
+				distances[(y * atlasWidth) + atlasLeft + x] = FindDistance(inside, sourceWidth, sourceHeight, sourceLeft, glyphs[i].size,
+					sourceX, sourceY, DISTANCE_PADDING * scale);
+			}
+		}
+
+		// Point the glyph at its cell in the atlas, and measure it in atlas pixels from now on.
+		glyphs[i].left = (float)atlasLeft / (float)atlasWidth;
+		glyphs[i].right = (float)(atlasLeft + cellWidth) / (float)atlasWidth;
+		glyphs[i].size = sizes[i];
+
+		atlasLeft += cellWidth;
+	}
+
+	return true;
+}
+
+
+bool IsInside(bool* inside, int sourceWidth, int sourceHeight, int sourceLeft, int size, int x, int y)
+{
+	// Anything outside the glyph's own part of the texture counts as outside, so neighbours never bleed in.
+	if((x < 0) || (x >= size) || (y < 0) || (y >= sourceHeight))
+	{
+		return false;
+	}
+
+	return inside[(y * sourceWidth) + sourceLeft + x];
+}
+
+
+unsigned char FindDistance(bool* inside, int sourceWidth, int sourceHeight, int sourceLeft, int size, float sourceX, float sourceY,
+						   int spread)
+{
+	bool centre;
+	int centreX, centreY, x, y;
+	float nearest, distanceX, distanceY, distance;
+
+
+	centreX = (int)floor(sourceX);
+	centreY = (int)floor(sourceY);
+	centre = IsInside(inside, sourceWidth, sourceHeight, sourceLeft, size, centreX, centreY);
+
+	// Search the texels within the spread for the nearest one on the other side of the edge.
+	nearest = (float)(spread * spread);
+	for(y=centreY-spread; y<=centreY+spread; y++)
+	{
+		for(x=centreX-spread; x<=centreX+spread; x++)
+		{
+			if(IsInside(inside, sourceWidth, sourceHeight, sourceLeft, size, x, y) != centre)
+			{
+				distanceX = ((float)x + 0.5f) - sourceX;
+				distanceY = ((float)y + 0.5f) - sourceY;
+				if(((distanceX * distanceX) + (distanceY * distanceY)) < nearest)
+				{
+					nearest = (distanceX * distanceX) + (distanceY * distanceY);
+				}
+			}
+		}
+	}
+
+	// The edge lies half way to that texel, and the distance is positive inside and negative outside.
+	distance = sqrt(nearest) - 0.5f;
+	if(!centre)
+	{
+		distance = -distance;
+	}
+
+	// Map the spread either side of the edge onto the byte, with the edge at a half.
+	distance = 0.5f + (0.5f * distance / (float)spread);
+	if(distance < 0.0f)
+	{
+		distance = 0.0f;
+	}
+	if(distance > 1.0f)
+	{
+		distance = 1.0f;
+	}
+
+	return (unsigned char)((distance * 255.0f) + 0.5f);
+}
+
+
+bool WriteTexture(unsigned char* header, unsigned char* distances, int width, int height)
+{
+	ofstream fout;
+	unsigned char pixel[4];
+	int pitch, mipCount, i;
+
+
+	// Reuse the texture's header with the atlas size and a single mip level.
+	pitch = width * 4;
+	mipCount = 0;
+	memcpy(&header[12], &height, sizeof(int));
+	memcpy(&header[16], &width, sizeof(int));
+	memcpy(&header[20], &pitch, sizeof(int));
+	memcpy(&header[28], &mipCount, sizeof(int));
+
+	fout.open("fontsdf.dds", ios_base::out | ios_base::binary | ios_base::trunc);
+	if(fout.fail())
+	{
+		return false;
+	}
+
+	fout.write((char*)header, DDS_HEADER_SIZE);
+
+	// Write the distance to every channel, so it reads the same whichever one the shader samples.
+	for(i=0; i<width * height; i++)
+	{
+		pixel[0] = distances[i];
+		pixel[1] = distances[i];
+		pixel[2] = distances[i];
+		pixel[3] = distances[i];
+		fout.write((char*)pixel, 4);
+	}
+
+	fout.close();
+
+	return true;
+}
+
+
+bool WriteFontData(GlyphType* glyphs, int height)
+{
+	ofstream fout;
+	int i;
+
+
+	fout.open("fontsdfdata.txt", ios_base::out | ios_base::trunc);
+	if(fout.fail())
+	{
+		return false;
+	}
+
+	// Start with the header that marks the font as a distance field, then the glyphs in the plain format.
+	fout << "distancefield " << height << " " << DISTANCE_PADDING << endl;
+
+	for(i=0; i<GLYPH_COUNT; i++)
+	{
+		fout << (i + 32) << " " << (char)(i + 32) << " " << glyphs[i].left << " " << glyphs[i].right << " " << glyphs[i].size << endl;
+	}
+
+	fout.close();
+
+	return true;
+}
@@ -16,20 +16,19 @@
 // MY CLASS INCLUDES //
 ///////////////////////
 #include "textureclass.h"
+#include "softwaretextureclass.h"
+#include "vertextypes.h"
+#include "memorytrackerclass.h"
 
 
 ////////////////////////////////////////////////////////////////////////////////
 // Class name: BitmapClass
+// A texture drawn flat on the screen at a fixed size in pixels.  A bitmap has
+// no buffers of its own: GetQuad writes the corners for a position, and the
+// sprite batch collects the quads of every bitmap drawn in a frame.
 ////////////////////////////////////////////////////////////////////////////////
 class BitmapClass
 {
-private:
-	struct VertexType
-	{
-		D3DXVECTOR3 position;
-	    D3DXVECTOR2 texture;
-	};
-
 public:
 	BitmapClass();
 	BitmapClass(const BitmapClass&);
@@ -37,29 +36,22 @@ public:
 
 	bool Initialize(ID3D11Device*, WCHAR*, int, int, int, int);
 	void Shutdown();
-	bool Render(ID3D11DeviceContext*, int, int);
 
     void SetScreenDimensions(int, int);
 
-	int GetIndexCount();
 	ID3D11ShaderResourceView* GetTexture();
+	SoftwareTextureClass* GetSoftwareTexture();
+	void GetQuad(int, int, VertexType::Textured*);
 
 private:
-	bool InitializeBuffers(ID3D11Device*);
-	void ShutdownBuffers();
-	bool UpdateBuffers(ID3D11DeviceContext*, int, int);
-	void RenderBuffers(ID3D11DeviceContext*);
-
 	bool LoadTexture(ID3D11Device*, WCHAR*);
 	void ReleaseTexture();
 
 private:
-	ID3D11Buffer *m_vertexBuffer, *m_indexBuffer;
-	int m_vertexCount, m_indexCount;
 	TextureClass* m_Texture;
+	SoftwareTextureClass* m_SoftwareTexture;
     int m_screenWidth, m_screenHeight;
 	int m_bitmapWidth, m_bitmapHeight;
-	int m_previousPosX, m_previousPosY;
 };
 
 #endif
\ No newline at end of file
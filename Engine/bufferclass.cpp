@@ -1,4 +1,5 @@
 #include "bufferclass.h"
+#include <algorithm>
 
 BufferClass::BufferClass()
 {
@@ -12,10 +13,14 @@ BufferClass::BufferClass()
 	m_staticVertexBuffer = 0;
 	m_streamingIndexBuffer = 0;
 	m_streamingVertexBuffer = 0;
+	m_dynamicSliceBuffer = 0;
 
 	m_dynamicVertices = 0;
 	m_staticVertices = 0;
 	m_streamingVertices = 0;
+
+	m_dynamicSlices = 0;
+	m_models = 0;
 }
 
 BufferClass::~BufferClass()
@@ -28,6 +33,11 @@ int BufferClass::GetDynamicIndexCount()
 	return m_dynamicIndexCount;
 }
 
+int BufferClass::GetIndexStart(int model)
+{
+	return (*m_models)[model].indexStart;
+}
+
 bool BufferClass::Initialize(D3DClass* D3D)
 {
 	m_D3D = D3D;
@@ -36,61 +46,111 @@ bool BufferClass::Initialize(D3DClass* D3D)
 	m_staticVertices = new VertexType::Default[0];
 	m_streamingVertices = new VertexType::Default[0];
 
+	m_dynamicSlices = new unsigned int[0];
+	m_models = new std::vector<ModelRangeType>;
+
 	return true;
 }
 
-bool BufferClass::AddModel(VertexType::Default* vertices, int indices)
+bool BufferClass::AddModel(VertexType::Default* vertices, int indices, int group, int slice)
 {
+	MEMORY_TAG(MemoryTrackerClass::TAG_BUFFERS);
 	VertexType::Default *tempVertices;
+	unsigned int *tempSlices;
+	std::vector<ModelRangeType> tempModels;
+	ID3D11Buffer *vertexBuffer, *indexBuffer, *sliceBuffer;
+	ModelRangeType range;
 	int newIndexCount;
-	int offset;
-	int size = sizeof(VertexType::Default);
+	int i;
 
-	// Update the vertex array with the new values (including resizing the array)
+	// Build the vertex array with the new values in a larger copy, so nothing changes until the buffers exist
 	newIndexCount = m_dynamicIndexCount + indices;
-	offset = sizeof(VertexType::Default) * m_dynamicIndexCount;
 	tempVertices = new VertexType::Default[newIndexCount];
-	ZeroMemory(tempVertices, sizeof(VertexType::Default) * newIndexCount);
+	if (!tempVertices)
+	{
+		return false;
+	}
+
 	memcpy(tempVertices, m_dynamicVertices, sizeof(VertexType::Default) * m_dynamicIndexCount);
 	memcpy(tempVertices + m_dynamicIndexCount, vertices, sizeof(VertexType::Default) * indices);
-	m_dynamicIndexCount = newIndexCount;
-	delete m_dynamicVertices;
+
+	// Give each of the model's vertices the slice of its texture in the texture array
+	tempSlices = new unsigned int[newIndexCount];
+	if (!tempSlices)
+	{
+		delete [] tempVertices;
+		return false;
+	}
+
+	memcpy(tempSlices, m_dynamicSlices, sizeof(unsigned int) * m_dynamicIndexCount);
+	for (i = m_dynamicIndexCount; i < newIndexCount; i++)
+	{
+		tempSlices[i] = slice;
+	}
+
+	// Remember the model's vertices and texture array so the index buffer can group it with the others
+	range.vertexStart = m_dynamicIndexCount;
+	range.vertexCount = indices;
+	range.group = group;
+	range.indexStart = 0;
+
+	tempModels = *m_models;
+	tempModels.push_back(range);
+
+	// Create all of the new buffers before any of the old ones are let go
+	vertexBuffer = 0;
+	indexBuffer = 0;
+	sliceBuffer = 0;
+	if (!CreateBuffers(tempVertices, tempModels, newIndexCount, vertexBuffer, indexBuffer) ||
+		!CreateSliceBuffer(tempSlices, newIndexCount, sliceBuffer))
+	{
+		ReleaseBuffer(vertexBuffer);
+		ReleaseBuffer(indexBuffer);
+		delete [] tempVertices;
+		delete [] tempSlices;
+		return false;
+	}
+
+	// Nothing can fail from here, so swap the new arrays and buffers in for the old ones
+	ReleaseBuffer(m_dynamicVertexBuffer);
+	ReleaseBuffer(m_dynamicIndexBuffer);
+	ReleaseBuffer(m_dynamicSliceBuffer);
+	m_dynamicVertexBuffer = vertexBuffer;
+	m_dynamicIndexBuffer = indexBuffer;
+	m_dynamicSliceBuffer = sliceBuffer;
+
+	delete [] m_dynamicVertices;
 	m_dynamicVertices = tempVertices;
+	delete [] m_dynamicSlices;
+	m_dynamicSlices = tempSlices;
 
-	UpdateBuffer(m_dynamicVertexBuffer, m_dynamicIndexBuffer, m_dynamicVertices, m_dynamicIndexCount);
+	m_models->swap(tempModels);
+	m_dynamicIndexCount = newIndexCount;
 
 	return true;
 }
 
-bool BufferClass::UpdateBuffer(ID3D11Buffer*& vertexBuffer, ID3D11Buffer*& indexBuffer, VertexType::Default*& vertices, int& indexCount)
+bool BufferClass::CreateBuffers(VertexType::Default* vertices, std::vector<ModelRangeType>& models, int indexCount,
+								ID3D11Buffer*& vertexBuffer, ID3D11Buffer*& indexBuffer)
 {
 	unsigned long* indices;
 	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
     D3D11_SUBRESOURCE_DATA vertexData, indexData;
 	HRESULT result;
 	ID3D11Device* device;
-	int i;
 
 	device = m_D3D->GetDevice();
 
-	if (vertexBuffer)
-		vertexBuffer->Release();
-
-	if (indexBuffer)
-		indexBuffer->Release();
-
-	// Create the index array.
+	// Create the index array.  It covers every model loaded so far and is only made when one is added, so it comes
+	// from the heap rather than frame memory, which would keep a block that large for every frame after.
 	indices = new unsigned long[indexCount];
 	if(!indices)
 	{
 		return false;
 	}
     
-	// Load the index array with data.
-	for(i = 0; i < indexCount; i++)
-	{
-		indices[i] = i;
-	}
+	// Load the index array with the models' vertices, grouped by texture array.
+	LayoutIndices(models, indices);
     
 	// Set up the description of the static vertex buffer.
     vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
@@ -109,9 +169,13 @@ bool BufferClass::UpdateBuffer(ID3D11Buffer*& vertexBuffer, ID3D11Buffer*& index
     result = device->CreateBuffer(&vertexBufferDesc, &vertexData, &vertexBuffer);
 	if(FAILED(result))
 	{
+		vertexBuffer = 0;
+		delete [] indices;
 		return false;
 	}
 
+	MemoryTrackerClass::AddBuffer(MemoryTrackerClass::TAG_BUFFERS, vertexBuffer);
+
 	// Set up the description of the static index buffer.
     indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
     indexBufferDesc.ByteWidth = sizeof(unsigned long) * indexCount;
@@ -125,31 +189,115 @@ bool BufferClass::UpdateBuffer(ID3D11Buffer*& vertexBuffer, ID3D11Buffer*& index
 	indexData.SysMemPitch = 0;
 	indexData.SysMemSlicePitch = 0;
 
-	// Create the index buffer.
+	// Create the index buffer, after which the index array is no longer needed.
 	result = device->CreateBuffer(&indexBufferDesc, &indexData, &indexBuffer);
+
+	delete [] indices;
+	indices = 0;
+
 	if(FAILED(result))
 	{
+		indexBuffer = 0;
+		ReleaseBuffer(vertexBuffer);
 		return false;
 	}
 
-	delete [] indices;
-	indices = 0;
+	MemoryTrackerClass::AddBuffer(MemoryTrackerClass::TAG_BUFFERS, indexBuffer);
 
 	return true;
 }
 
-void BufferClass::RenderBuffers(ID3D11DeviceContext* deviceContext)
+bool BufferClass::CreateSliceBuffer(unsigned int* slices, int count, ID3D11Buffer*& sliceBuffer)
+{
+	D3D11_BUFFER_DESC sliceBufferDesc;
+	D3D11_SUBRESOURCE_DATA sliceData;
+	HRESULT result;
+
+	// Set up the description of the static slice buffer, which is the second vertex stream.
+	sliceBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	sliceBufferDesc.ByteWidth = sizeof(unsigned int) * count;
+	sliceBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	sliceBufferDesc.CPUAccessFlags = 0;
+	sliceBufferDesc.MiscFlags = 0;
+	sliceBufferDesc.StructureByteStride = 0;
+
+	// Give the subresource structure a pointer to the slice data.
+	sliceData.pSysMem = slices;
+	sliceData.SysMemPitch = 0;
+	sliceData.SysMemSlicePitch = 0;
+
+	// Now create the slice buffer.
+	result = m_D3D->GetDevice()->CreateBuffer(&sliceBufferDesc, &sliceData, &sliceBuffer);
+	if(FAILED(result))
+	{
+		sliceBuffer = 0;
+		return false;
+	}
+
+	MemoryTrackerClass::AddBuffer(MemoryTrackerClass::TAG_BUFFERS, sliceBuffer);
+
+	return true;
+}
+
+void BufferClass::ReleaseBuffer(ID3D11Buffer*& buffer)
+{
+	if (buffer)
+	{
+		MemoryTrackerClass::RemoveBuffer(MemoryTrackerClass::TAG_BUFFERS, buffer);
+		buffer->Release();
+		buffer = 0;
+	}
+
+	return;
+}
+
+void BufferClass::LayoutIndices(std::vector<ModelRangeType>& models, unsigned long* indices)
 {
-	unsigned int stride;
-	unsigned int offset;
+	std::vector<int> order;
+	ModelRangeType* range;
+	int model, vertex, position, i;
 
+	// Order the models by texture array, keeping the order they were added in within each array
+	for (model = 0; model < (int)models.size(); model++)
+	{
+		order.push_back(model);
+	}
 
-	// Set vertex buffer stride and offset.
-	stride = sizeof(VertexType::Default); 
-	offset = 0;
+	std::stable_sort(order.begin(), order.end(), [&models](int a, int b) { return models[a].group < models[b].group; });
+
+	// Lay each model's vertices out in that order and remember where its range starts
+	position = 0;
+	for (i = 0; i < (int)order.size(); i++)
+	{
+		range = &models[order[i]];
+
+		range->indexStart = position;
+		for (vertex = 0; vertex < range->vertexCount; vertex++)
+		{
+			indices[position++] = range->vertexStart + vertex;
+		}
+	}
+
+	return;
+}
+
+void BufferClass::RenderBuffers(ID3D11DeviceContext* deviceContext)
+{
+	ID3D11Buffer* buffers[2];
+	unsigned int strides[2];
+	unsigned int offsets[2];
+
+
+	// Set the strides and offsets of the vertex and slice streams.
+	buffers[0] = m_dynamicVertexBuffer;
+	buffers[1] = m_dynamicSliceBuffer;
+	strides[0] = sizeof(VertexType::Default);
+	strides[1] = sizeof(unsigned int);
+	offsets[0] = 0;
+	offsets[1] = 0;
     
-	// Set the vertex buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetVertexBuffers(0, 1, &m_dynamicVertexBuffer, &stride, &offset);
+	// Set the vertex buffers to active in the input assembler so they can be rendered.
+	deviceContext->IASetVertexBuffers(0, 2, buffers, strides, offsets);
 
     // Set the index buffer to active in the input assembler so it can be rendered.
 	deviceContext->IASetIndexBuffer(m_dynamicIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
@@ -164,39 +312,52 @@ void BufferClass::Shutdown()
 {
 	if (m_dynamicIndexBuffer)
 	{
+		MemoryTrackerClass::RemoveBuffer(MemoryTrackerClass::TAG_BUFFERS, m_dynamicIndexBuffer);
 		m_dynamicIndexBuffer->Release();
 		m_dynamicIndexBuffer = 0;
 	}
 
 	if (m_dynamicVertexBuffer)
 	{
+		MemoryTrackerClass::RemoveBuffer(MemoryTrackerClass::TAG_BUFFERS, m_dynamicVertexBuffer);
 		m_dynamicVertexBuffer->Release();
 		m_dynamicVertexBuffer = 0;
 	}
 
 	if (m_staticIndexBuffer)
 	{
+		MemoryTrackerClass::RemoveBuffer(MemoryTrackerClass::TAG_BUFFERS, m_staticIndexBuffer);
 		m_staticIndexBuffer->Release();
 		m_staticIndexBuffer = 0;
 	}
 
 	if (m_staticVertexBuffer)
 	{
+		MemoryTrackerClass::RemoveBuffer(MemoryTrackerClass::TAG_BUFFERS, m_staticVertexBuffer);
 		m_staticVertexBuffer->Release();
 		m_staticVertexBuffer = 0;
 	}
 		
 	if (m_streamingIndexBuffer)
 	{
+		MemoryTrackerClass::RemoveBuffer(MemoryTrackerClass::TAG_BUFFERS, m_streamingIndexBuffer);
 		m_streamingIndexBuffer->Release();
 		m_streamingIndexBuffer = 0;
 	}
 
 	if (m_streamingVertexBuffer)
 	{
+		MemoryTrackerClass::RemoveBuffer(MemoryTrackerClass::TAG_BUFFERS, m_streamingVertexBuffer);
 		m_streamingVertexBuffer->Release();
 		m_streamingVertexBuffer = 0;
 	}
+
+	if (m_dynamicSliceBuffer)
+	{
+		MemoryTrackerClass::RemoveBuffer(MemoryTrackerClass::TAG_BUFFERS, m_dynamicSliceBuffer);
+		m_dynamicSliceBuffer->Release();
+		m_dynamicSliceBuffer = 0;
+	}
 	
 	if (m_dynamicVertices)
 	{
@@ -215,5 +376,17 @@ void BufferClass::Shutdown()
 		delete[] m_streamingVertices;
 		m_streamingVertices = 0;
 	}
+
+	if (m_dynamicSlices)
+	{
+		delete[] m_dynamicSlices;
+		m_dynamicSlices = 0;
+	}
+
+	if (m_models)
+	{
+		delete m_models;
+		m_models = 0;
+	}
 		
 }
\ No newline at end of file
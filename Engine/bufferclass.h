@@ -8,9 +8,24 @@
 #include "modelclass.h"
 #include "d3dclass.h"
 #include "vertextypes.h"
+#include "memorytrackerclass.h"
 
+// Keeps the models in one vertex buffer and one index buffer.  Each vertex
+// carries the texture array slice of its model in a second stream, and the
+// index buffer lists the models group by group, so models whose textures share
+// an array are next to each other and can be drawn with one call.  A model
+// is only added once all of the new buffers are created, so one that fails
+// leaves the ones already added as they were.
 class BufferClass
 {
+private:
+	struct ModelRangeType
+	{
+		int vertexStart, vertexCount;
+		int group;
+		int indexStart;
+	};
+
 public:
 	BufferClass();
 	BufferClass(const BufferClass&);
@@ -18,22 +33,29 @@ public:
 
 	bool Initialize(D3DClass*);
 
-	bool AddModel(VertexType::Default*, int);
+	bool AddModel(VertexType::Default*, int, int, int);
 
 	int GetDynamicIndexCount();
+	int GetIndexStart(int);
 
-	bool UpdateBuffer(ID3D11Buffer*&, ID3D11Buffer*&, VertexType::Default*&, int&);
 	void RenderBuffers(ID3D11DeviceContext*);
 
 	void Shutdown();
 
+private:
+	bool CreateBuffers(VertexType::Default*, std::vector<ModelRangeType>&, int, ID3D11Buffer*&, ID3D11Buffer*&);
+	bool CreateSliceBuffer(unsigned int*, int, ID3D11Buffer*&);
+	void ReleaseBuffer(ID3D11Buffer*&);
+	void LayoutIndices(std::vector<ModelRangeType>&, unsigned long*);
+
 private:
 	ID3D11Buffer	*m_dynamicVertexBuffer,
 					*m_staticVertexBuffer,
 					*m_streamingVertexBuffer,
 					*m_dynamicIndexBuffer,
 					*m_staticIndexBuffer,
-					*m_streamingIndexBuffer;
+					*m_streamingIndexBuffer,
+					*m_dynamicSliceBuffer;
 
 	int	m_dynamicIndexCount,
 		m_staticIndexCount,
@@ -44,6 +66,9 @@ private:
 	VertexType::Default	*m_dynamicVertices,
 						*m_staticVertices,
 						*m_streamingVertices;
+
+	unsigned int* m_dynamicSlices;
+	std::vector<ModelRangeType>* m_models;
 };
 
 #endif
\ No newline at end of file
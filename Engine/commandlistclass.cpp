@@ -0,0 +1,213 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: commandlistclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "commandlistclass.h"
+#include <string.h>
+
+
+CommandListClass::CommandListClass()
+{
+	m_buffer = 0;
+	m_size = 0;
+	m_capacity = 0;
+	m_commandCount = 0;
+}
+
+
+CommandListClass::CommandListClass(const CommandListClass& other)
+{
+}
+
+
+CommandListClass::~CommandListClass()
+{
+}
+
+
+bool CommandListClass::Initialize(int capacity)
+{
+	// Reserve the starting size of the buffer.  It grows on demand if a frame needs more.
+	m_capacity = (capacity > COMMAND_LIST_ALIGNMENT) ? capacity : COMMAND_LIST_ALIGNMENT;
+	m_buffer = new unsigned char[m_capacity];
+	if(!m_buffer)
+	{
+		return false;
+	}
+
+	m_size = 0;
+	m_commandCount = 0;
+
+	return true;
+}
+
+
+void CommandListClass::Shutdown()
+{
+	// Release the packet buffer.
+	if(m_buffer)
+	{
+		delete [] m_buffer;
+		m_buffer = 0;
+	}
+
+	m_size = 0;
+	m_capacity = 0;
+	m_commandCount = 0;
+
+	return;
+}
+
+
+void CommandListClass::Reset()
+{
+	// Forget the recorded packets but keep the memory for the next frame.
+	m_size = 0;
+	m_commandCount = 0;
+
+	return;
+}
+
+
+void* CommandListClass::Allocate(CommandType type, int size, unsigned long long key)
+{
+	unsigned char* buffer;
+	HeaderType* header;
+	int capacity;
+
+
+	// Round every packet up so the next one starts aligned.
+	size = (size + COMMAND_LIST_ALIGNMENT - 1) & ~(COMMAND_LIST_ALIGNMENT - 1);
+
+	// Double the buffer when the packet does not fit.  Packets are plain data so they can simply be copied.
+	if(m_size + size > m_capacity)
+	{
+		capacity = m_capacity * 2;
+		while(m_size + size > capacity)
+		{
+			capacity *= 2;
+		}
+
+		buffer = new unsigned char[capacity];
+		if(!buffer)
+		{
+			return 0;
+		}
+
+		memcpy(buffer, m_buffer, m_size);
+		delete [] m_buffer;
+		m_buffer = buffer;
+		m_capacity = capacity;
+	}
+
+	// Fill in the header.  The packet stays valid until the next allocation, which may move the buffer.
+	header = (HeaderType*)(m_buffer + m_size);
+	header->type = type;
+	header->size = size;
+	header->key = key;
+
+	m_size += size;
+	m_commandCount++;
+
+	return header;
+}
+
+
+bool CommandListClass::SetDepth(bool enable, unsigned long long key)
+{
+	DepthCommandType* command;
+
+
+	command = (DepthCommandType*)Allocate(COMMAND_DEPTH, sizeof(DepthCommandType), key);
+	if(!command)
+	{
+		return false;
+	}
+
+	command->enable = enable;
+
+	return true;
+}
+
+
+CommandListClass::LightCommandType* CommandListClass::AddLight(unsigned long long key)
+{
+	return (LightCommandType*)Allocate(COMMAND_LIGHT, sizeof(LightCommandType), key);
+}
+
+
+CommandListClass::BitmapCommandType* CommandListClass::AddBitmap(unsigned long long key)
+{
+	return (BitmapCommandType*)Allocate(COMMAND_BITMAP, sizeof(BitmapCommandType), key);
+}
+
+
+bool CommandListClass::CanMerge(LightCommandType* first, LightCommandType* next)
+{
+	// Two draws can be issued as one when they bind the same texture, read neighbouring index ranges and use the same constants.
+	if((next->texture != first->texture) || (next->indexStart != first->indexStart + first->indexCount))
+	{
+		return false;
+	}
+
+	if((next->worldMatrix != first->worldMatrix) || (next->viewMatrix != first->viewMatrix) ||
+		(next->projectionMatrix != first->projectionMatrix) || (next->cameraPosition != first->cameraPosition))
+	{
+		return false;
+	}
+
+	if((next->ambientColor != first->ambientColor) || (next->diffuseColor != first->diffuseColor) ||
+		(next->lightDirection != first->lightDirection) || (next->specularColor != first->specularColor) ||
+		(next->specularPower != first->specularPower))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+bool CommandListClass::CanMerge(BitmapCommandType* first, BitmapCommandType* next)
+{
+	// Two bitmap draws can go out in one batch when they are the same bitmap, so they share a texture, and use the same matrices.
+	return (next->bitmap == first->bitmap) && (next->worldMatrix == first->worldMatrix) && (next->viewMatrix == first->viewMatrix) &&
+		(next->projectionMatrix == first->projectionMatrix);
+}
+
+
+CommandListClass::HeaderType* CommandListClass::GetFirst()
+{
+	if(m_size == 0)
+	{
+		return 0;
+	}
+
+	return (HeaderType*)m_buffer;
+}
+
+
+CommandListClass::HeaderType* CommandListClass::GetNext(HeaderType* command)
+{
+	unsigned char* next;
+
+
+	// Step over the packet, stopping at the end of the recorded data.
+	next = (unsigned char*)command + command->size;
+	if(next >= m_buffer + m_size)
+	{
+		return 0;
+	}
+
+	return (HeaderType*)next;
+}
+
+
+int CommandListClass::GetCommandCount()
+{
+	return m_commandCount;
+}
+
+
+int CommandListClass::GetSize()
+{
+	return m_size;
+}
@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: commandlistclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _COMMANDLISTCLASS_H_
+#define _COMMANDLISTCLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <d3dx10math.h>
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int COMMAND_LIST_ALIGNMENT = 16;
+
+
+//////////////////////////
+// FORWARD DECLARATIONS //
+//////////////////////////
+class BitmapClass;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: CommandListClass
+// A linear buffer of draw packets that does not depend on the backend.  Each
+// packet carries the render state, resource bindings, shader constants and
+// draw range of one draw, with resources named by their model slot or bitmap,
+// so a worker thread can record a list without touching the device.  Every
+// packet is tagged with a sort key when it is allocated.  The owning thread
+// later merges the lists into a DrawQueueClass, sorts them by key and replays
+// them against Direct3D or the software renderer.
+//
+// Packets are plain data packed one after another, so Reset empties the list
+// without freeing its memory and a list that is recorded every frame stops
+// allocating once it has grown to fit.
+////////////////////////////////////////////////////////////////////////////////
+class CommandListClass
+{
+public:
+	enum CommandType
+	{
+		COMMAND_DEPTH,
+		COMMAND_LIGHT,
+		COMMAND_BITMAP
+	};
+
+	// The key orders the packet when the lists are merged into a draw queue.
+	struct HeaderType
+	{
+		CommandType type;
+		int size;
+		unsigned long long key;
+	};
+
+	// Turns depth testing on or off for the commands that follow.
+	struct DepthCommandType
+	{
+		HeaderType header;
+		bool enable;
+	};
+
+	// Draws a range of a model with the light shader.  The texture is the slot the draw binds, which models in the same texture array share.
+	struct LightCommandType
+	{
+		HeaderType header;
+		int model;
+		int texture;
+		int indexCount, indexStart;
+		D3DXMATRIX worldMatrix;
+		D3DXMATRIX viewMatrix;
+		D3DXMATRIX projectionMatrix;
+		D3DXVECTOR4 ambientColor;
+		D3DXVECTOR4 diffuseColor;
+		D3DXVECTOR3 lightDirection;
+		float specularPower;
+		D3DXVECTOR4 specularColor;
+		D3DXVECTOR3 cameraPosition;
+	};
+
+	// Draws a bitmap at a screen position with the texture shader.  Neighbouring packets in the queue that can merge go out in one sprite batch.
+	struct BitmapCommandType
+	{
+		HeaderType header;
+		BitmapClass* bitmap;
+		int positionX, positionY;
+		D3DXMATRIX worldMatrix;
+		D3DXMATRIX viewMatrix;
+		D3DXMATRIX projectionMatrix;
+	};
+
+public:
+	CommandListClass();
+	CommandListClass(const CommandListClass&);
+	~CommandListClass();
+
+	bool Initialize(int);
+	void Shutdown();
+
+	void Reset();
+	void* Allocate(CommandType, int, unsigned long long);
+
+	bool SetDepth(bool, unsigned long long);
+	LightCommandType* AddLight(unsigned long long);
+	BitmapCommandType* AddBitmap(unsigned long long);
+
+	static bool CanMerge(LightCommandType*, LightCommandType*);
+	static bool CanMerge(BitmapCommandType*, BitmapCommandType*);
+
+	HeaderType* GetFirst();
+	HeaderType* GetNext(HeaderType*);
+	int GetCommandCount();
+	int GetSize();
+
+private:
+	unsigned char* m_buffer;
+	int m_size, m_capacity;
+	int m_commandCount;
+};
+
+#endif
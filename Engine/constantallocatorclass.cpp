@@ -0,0 +1,393 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: constantallocatorclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "constantallocatorclass.h"
+#include <string.h>
+
+
+ConstantAllocatorClass::ConstantAllocatorClass()
+{
+	int stage, slot;
+
+
+	m_device = 0;
+	m_deviceContext = 0;
+	m_PipelineState = 0;
+	m_ringBuffer = 0;
+	for(stage=0; stage<2; stage++)
+	{
+		for(slot=0; slot<CONSTANT_FALLBACK_SLOTS; slot++)
+		{
+			m_fallbackBuffers[stage][slot] = 0;
+			m_fallbackBlocks[stage][slot].offset = 0;
+			m_fallbackBlocks[stage][slot].size = 0;
+			m_fallbackBlocks[stage][slot].generation = 0;
+		}
+	}
+	m_shadow = 0;
+	m_ringSize = 0;
+	m_frameSize = 0;
+	m_position = 0;
+	m_uploaded = 0;
+	m_generation = 0;
+	m_discard = false;
+	m_uploadCount = 0;
+	m_allocatedBytes = 0;
+}
+
+
+ConstantAllocatorClass::ConstantAllocatorClass(const ConstantAllocatorClass& other)
+{
+}
+
+
+ConstantAllocatorClass::~ConstantAllocatorClass()
+{
+}
+
+
+bool ConstantAllocatorClass::Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, PipelineStateClass* pipelineState)
+{
+	D3D11_BUFFER_DESC bufferDesc;
+	HRESULT result;
+	int stage, slot;
+
+
+	// Store the device the ring is grown on, the context the buffers are mapped on and the tracker they are bound through.
+	m_device = device;
+	m_deviceContext = deviceContext;
+	m_PipelineState = pipelineState;
+
+	// Create the system memory copy the blocks are written to.
+	m_shadow = new unsigned char[CONSTANT_RING_SIZE];
+	if(!m_shadow)
+	{
+		return false;
+	}
+
+	// Start in the first generation so that a zeroed block is never valid, with the first map discarding.
+	m_ringSize = CONSTANT_RING_SIZE;
+	m_frameSize = CONSTANT_FRAME_SIZE;
+	m_position = 0;
+	m_uploaded = 0;
+	m_generation = 1;
+	m_discard = true;
+
+	// Without a device the blocks are only written to the copy.
+	if(!device)
+	{
+		return true;
+	}
+
+	// Setup the description of the dynamic constant buffers.
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bufferDesc.MiscFlags = 0;
+	bufferDesc.StructureByteStride = 0;
+
+	if(m_PipelineState->SupportsConstantOffsets())
+	{
+		// Create the ring that every block is bound from.
+		bufferDesc.ByteWidth = CONSTANT_RING_SIZE;
+
+		result = device->CreateBuffer(&bufferDesc, NULL, &m_ringBuffer);
+		if(FAILED(result))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		// Without windows each slot gets a buffer of its own that blocks are copied into.
+		bufferDesc.ByteWidth = CONSTANT_BLOCK_MAX_SIZE;
+
+		for(stage=0; stage<2; stage++)
+		{
+			for(slot=0; slot<CONSTANT_FALLBACK_SLOTS; slot++)
+			{
+				result = device->CreateBuffer(&bufferDesc, NULL, &m_fallbackBuffers[stage][slot]);
+				if(FAILED(result))
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+
+void ConstantAllocatorClass::Shutdown()
+{
+	int stage, slot;
+
+
+	// Release the per slot buffers.
+	for(stage=0; stage<2; stage++)
+	{
+		for(slot=0; slot<CONSTANT_FALLBACK_SLOTS; slot++)
+		{
+			if(m_fallbackBuffers[stage][slot])
+			{
+				m_fallbackBuffers[stage][slot]->Release();
+				m_fallbackBuffers[stage][slot] = 0;
+			}
+		}
+	}
+
+	// Release the ring buffer.
+	if(m_ringBuffer)
+	{
+		m_ringBuffer->Release();
+		m_ringBuffer = 0;
+	}
+
+	// Release the system memory copy.
+	if(m_shadow)
+	{
+		delete [] m_shadow;
+		m_shadow = 0;
+	}
+
+	m_device = 0;
+	m_deviceContext = 0;
+	m_PipelineState = 0;
+
+	return;
+}
+
+
+void ConstantAllocatorClass::BeginFrame()
+{
+	// Wrap the ring when it might not fit another frame as large as the largest so far, discarding it on the next upload.
+	if((unsigned int)m_allocatedBytes > m_frameSize)
+	{
+		m_frameSize = m_allocatedBytes;
+	}
+
+	if(m_position + m_frameSize > m_ringSize)
+	{
+		m_position = 0;
+		m_generation++;
+		m_discard = true;
+	}
+
+	// Blocks that were allocated last frame but never uploaded are dropped.
+	m_uploaded = m_position;
+
+	m_uploadCount = 0;
+	m_allocatedBytes = 0;
+
+	return;
+}
+
+
+void* ConstantAllocatorClass::Allocate(int size, BlockType& block)
+{
+	unsigned int alignedSize;
+
+
+	// Round the block up to where the next window may start.
+	alignedSize = (size + CONSTANT_BLOCK_ALIGNMENT - 1) & ~(CONSTANT_BLOCK_ALIGNMENT - 1);
+	if((size <= 0) || (size > CONSTANT_BLOCK_MAX_SIZE))
+	{
+		return 0;
+	}
+
+	// A frame that outgrows the ring makes it larger rather than wrapping over blocks its draws have not used yet.
+	if(m_position + alignedSize > m_ringSize)
+	{
+		if(!Grow(alignedSize))
+		{
+			return 0;
+		}
+	}
+
+	block.offset = m_position;
+	block.size = alignedSize;
+	block.generation = m_generation;
+
+	m_position += alignedSize;
+	m_allocatedBytes += alignedSize;
+
+	return m_shadow + block.offset;
+}
+
+
+bool ConstantAllocatorClass::IsValid(BlockType& block)
+{
+	// A block survives until the ring wraps past it.
+	return (block.generation == m_generation);
+}
+
+
+bool ConstantAllocatorClass::Upload()
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	HRESULT result;
+
+
+	if(m_position == m_uploaded)
+	{
+		return true;
+	}
+
+	// The per slot buffers are filled when a block is bound, so there is nothing to copy here.
+	if(!m_ringBuffer)
+	{
+		m_uploaded = m_position;
+		return true;
+	}
+
+	// Append to the ring without waiting on the draws that read the earlier blocks, unless it has just wrapped.
+	result = m_deviceContext->Map(m_ringBuffer, 0, m_discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mappedResource);
+	if(FAILED(result))
+	{
+		return false;
+	}
+
+	// Copy every block allocated since the last upload.
+	memcpy((unsigned char*)mappedResource.pData + m_uploaded, m_shadow + m_uploaded, m_position - m_uploaded);
+
+	m_deviceContext->Unmap(m_ringBuffer, 0);
+
+	m_uploaded = m_position;
+	m_discard = false;
+	m_uploadCount++;
+
+	return true;
+}
+
+
+bool ConstantAllocatorClass::Bind(StageType stage, int slot, BlockType& block)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	HRESULT result;
+
+
+	// Point the slot at the block's window of the ring, in sixteen byte constants.
+	if(m_ringBuffer)
+	{
+		if(stage == STAGE_VERTEX)
+		{
+			m_PipelineState->SetVSConstantBuffer(slot, m_ringBuffer, block.offset / 16, block.size / 16);
+		}
+		else
+		{
+			m_PipelineState->SetPSConstantBuffer(slot, m_ringBuffer, block.offset / 16, block.size / 16);
+		}
+
+		return true;
+	}
+
+	if(slot >= CONSTANT_FALLBACK_SLOTS)
+	{
+		return false;
+	}
+
+	// Otherwise copy the block into the slot's own buffer, unless it is already there.
+	if((m_fallbackBlocks[stage][slot].offset != block.offset) || (m_fallbackBlocks[stage][slot].generation != block.generation))
+	{
+		result = m_deviceContext->Map(m_fallbackBuffers[stage][slot], 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+		if(FAILED(result))
+		{
+			return false;
+		}
+
+		memcpy(mappedResource.pData, m_shadow + block.offset, block.size);
+
+		m_deviceContext->Unmap(m_fallbackBuffers[stage][slot], 0);
+
+		m_fallbackBlocks[stage][slot] = block;
+		m_uploadCount++;
+	}
+
+	if(stage == STAGE_VERTEX)
+	{
+		m_PipelineState->SetVSConstantBuffer(slot, m_fallbackBuffers[stage][slot]);
+	}
+	else
+	{
+		m_PipelineState->SetPSConstantBuffer(slot, m_fallbackBuffers[stage][slot]);
+	}
+
+	return true;
+}
+
+
+int ConstantAllocatorClass::GetUploadCount()
+{
+	return m_uploadCount;
+}
+
+
+int ConstantAllocatorClass::GetAllocatedBytes()
+{
+	return m_allocatedBytes;
+}
+
+
+int ConstantAllocatorClass::GetRingSize()
+{
+	return m_ringSize;
+}
+
+
+bool ConstantAllocatorClass::Grow(unsigned int size)
+{
+	D3D11_BUFFER_DESC bufferDesc;
+	ID3D11Buffer* ringBuffer;
+	unsigned char* shadow;
+	unsigned int ringSize;
+	HRESULT result;
+
+
+	// Double the ring until the block fits after the ones already allocated.
+	ringSize = m_ringSize;
+	while(m_position + size > ringSize)
+	{
+		ringSize *= 2;
+	}
+
+	// Move the blocks of the current generation to a larger copy, at the same offsets.
+	shadow = new unsigned char[ringSize];
+	if(!shadow)
+	{
+		return false;
+	}
+
+	memcpy(shadow, m_shadow, m_position);
+
+	// Replace the ring buffer with one of the new size.  Draws already issued keep reading the old one.
+	if(m_ringBuffer)
+	{
+		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+		bufferDesc.ByteWidth = ringSize;
+		bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags = 0;
+		bufferDesc.StructureByteStride = 0;
+
+		result = m_device->CreateBuffer(&bufferDesc, NULL, &ringBuffer);
+		if(FAILED(result))
+		{
+			delete [] shadow;
+			return false;
+		}
+
+		m_ringBuffer->Release();
+		m_ringBuffer = ringBuffer;
+	}
+
+	delete [] m_shadow;
+	m_shadow = shadow;
+	m_ringSize = ringSize;
+
+	// The new buffer starts out empty, so the next upload fills it from the start with a discard.
+	m_uploaded = 0;
+	m_discard = true;
+
+	return true;
+}
@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: constantallocatorclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _CONSTANTALLOCATORCLASS_H_
+#define _CONSTANTALLOCATORCLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <d3d11_1.h>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "pipelinestateclass.h"
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int CONSTANT_RING_SIZE = 4194304;
+const int CONSTANT_FRAME_SIZE = 1048576;
+const int CONSTANT_BLOCK_ALIGNMENT = 256;
+const int CONSTANT_BLOCK_MAX_SIZE = 4096;
+const int CONSTANT_FALLBACK_SLOTS = 4;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: ConstantAllocatorClass
+// Hands out shader constants from one large dynamic constant buffer used as a
+// ring.  Blocks are written into a system memory copy of the ring, and Upload
+// copies everything allocated since the last upload in a single map, so a
+// frame that allocates the constants of all its draws up front maps the
+// buffer once.  Bind then points a shader slot at a block's window of the
+// buffer, which the pipeline state tracker filters like any other bind.
+//
+// Blocks are aligned to the 256 bytes that windows have to start on.  The
+// ring only wraps in BeginFrame, when less is left than the largest frame
+// so far has taken, at least CONSTANT_FRAME_SIZE, so a frame's blocks never
+// overlap and the buffer is only ever appended to until the wrap discards
+// it.  Each wrap starts a new generation, and IsValid tells a caller whether
+// a block it kept from an earlier frame is still in the buffer, which is how
+// unchanged data is left where it is.
+//
+// A frame that runs out of room doubles the ring where it is instead of
+// failing.  The blocks keep their offsets and generation in the new buffer,
+// and the next upload copies all of them into it.
+//
+// Without a device only the system memory copy is kept, with nothing to
+// upload or bind.
+//
+// Runtimes before Direct3D 11.1 cannot bind a window of a constant buffer.
+// There each slot gets a small buffer of its own, and Bind copies the block
+// into it, so only blocks that change are mapped.
+////////////////////////////////////////////////////////////////////////////////
+class ConstantAllocatorClass
+{
+public:
+	enum StageType
+	{
+		STAGE_VERTEX,
+		STAGE_PIXEL
+	};
+
+	// Where a block lives in the ring and in which generation of it.
+	struct BlockType
+	{
+		unsigned int offset;
+		unsigned int size;
+		unsigned int generation;
+	};
+
+public:
+	ConstantAllocatorClass();
+	ConstantAllocatorClass(const ConstantAllocatorClass&);
+	~ConstantAllocatorClass();
+
+	bool Initialize(ID3D11Device*, ID3D11DeviceContext*, PipelineStateClass*);
+	void Shutdown();
+
+	void BeginFrame();
+	void* Allocate(int, BlockType&);
+	bool IsValid(BlockType&);
+	bool Upload();
+	bool Bind(StageType, int, BlockType&);
+
+	int GetUploadCount();
+	int GetAllocatedBytes();
+	int GetRingSize();
+
+private:
+	bool Grow(unsigned int);
+
+private:
+	ID3D11Device* m_device;
+	ID3D11DeviceContext* m_deviceContext;
+	PipelineStateClass* m_PipelineState;
+	ID3D11Buffer* m_ringBuffer;
+	ID3D11Buffer* m_fallbackBuffers[2][CONSTANT_FALLBACK_SLOTS];
+	BlockType m_fallbackBlocks[2][CONSTANT_FALLBACK_SLOTS];
+	unsigned char* m_shadow;
+	unsigned int m_ringSize, m_frameSize;
+	unsigned int m_position, m_uploaded, m_generation;
+	bool m_discard;
+	int m_uploadCount, m_allocatedBytes;
+};
+
+#endif
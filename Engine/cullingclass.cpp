@@ -0,0 +1,561 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: cullingclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "cullingclass.h"
+#include <math.h>
+#include <string.h>
+
+
+CullingClass::CullingClass()
+{
+	m_instructionSet = SoftwareShaderClass::INSTRUCTIONS_SCALAR;
+	m_cullKernel = 0;
+	m_centerX = 0;
+	m_centerY = 0;
+	m_centerZ = 0;
+	m_radius = 0;
+	m_extentX = 0;
+	m_extentY = 0;
+	m_extentZ = 0;
+	m_objectCount = 0;
+	m_capacity = 0;
+	m_chunkVisible = 0;
+	m_chunkCounts = 0;
+	m_chunkOffsets = 0;
+	m_visible = 0;
+	m_visibleCount = 0;
+}
+
+
+CullingClass::CullingClass(const CullingClass& other)
+{
+}
+
+
+CullingClass::~CullingClass()
+{
+}
+
+
+bool CullingClass::Initialize(int capacity)
+{
+	// Use the widest kernel this processor can run.
+	if(!SetInstructionSet(SoftwareShaderClass::INSTRUCTIONS_AVX2))
+	{
+		if(!SetInstructionSet(SoftwareShaderClass::INSTRUCTIONS_SSE41))
+		{
+			SetInstructionSet(SoftwareShaderClass::INSTRUCTIONS_SCALAR);
+		}
+	}
+
+	// Create the arrays for the first objects.
+	return Reserve(capacity);
+}
+
+
+void CullingClass::Shutdown()
+{
+	// Release the bounds arrays.
+	_aligned_free(m_centerX);
+	_aligned_free(m_centerY);
+	_aligned_free(m_centerZ);
+	_aligned_free(m_radius);
+	_aligned_free(m_extentX);
+	_aligned_free(m_extentY);
+	_aligned_free(m_extentZ);
+	m_centerX = 0;
+	m_centerY = 0;
+	m_centerZ = 0;
+	m_radius = 0;
+	m_extentX = 0;
+	m_extentY = 0;
+	m_extentZ = 0;
+
+	// Release the visible lists.
+	if(m_chunkVisible)
+	{
+		delete [] m_chunkVisible;
+		m_chunkVisible = 0;
+	}
+
+	if(m_chunkCounts)
+	{
+		delete [] m_chunkCounts;
+		m_chunkCounts = 0;
+	}
+
+	if(m_chunkOffsets)
+	{
+		delete [] m_chunkOffsets;
+		m_chunkOffsets = 0;
+	}
+
+	if(m_visible)
+	{
+		delete [] m_visible;
+		m_visible = 0;
+	}
+
+	m_objectCount = 0;
+	m_capacity = 0;
+	m_visibleCount = 0;
+	m_cullKernel = 0;
+
+	return;
+}
+
+
+bool CullingClass::SetInstructionSet(SoftwareShaderClass::InstructionSetType instructionSet)
+{
+	if(!SoftwareShaderClass::IsSupported(instructionSet))
+	{
+		return false;
+	}
+
+	switch(instructionSet)
+	{
+		case SoftwareShaderClass::INSTRUCTIONS_AVX2:
+		{
+			m_cullKernel = &CullingClass::CullAVX2;
+			break;
+		}
+
+		case SoftwareShaderClass::INSTRUCTIONS_SSE41:
+		{
+			m_cullKernel = &CullingClass::CullSSE41;
+			break;
+		}
+
+		default:
+		{
+			m_cullKernel = &CullingClass::CullScalar;
+			break;
+		}
+	}
+
+	m_instructionSet = instructionSet;
+
+	return true;
+}
+
+
+SoftwareShaderClass::InstructionSetType CullingClass::GetInstructionSet()
+{
+	return m_instructionSet;
+}
+
+
+bool CullingClass::SetObjectCount(int count)
+{
+	// Make room for the objects, keeping the bounds already set.
+	if(!Reserve(count))
+	{
+		return false;
+	}
+
+	m_objectCount = count;
+	m_visibleCount = 0;
+
+	return true;
+}
+
+
+int CullingClass::GetObjectCount()
+{
+	return m_objectCount;
+}
+
+
+void CullingClass::SetBounds(int index, D3DXVECTOR3& center, D3DXVECTOR3& extents, float radius)
+{
+	m_centerX[index] = center.x;
+	m_centerY[index] = center.y;
+	m_centerZ[index] = center.z;
+	m_radius[index] = radius;
+	m_extentX[index] = extents.x;
+	m_extentY[index] = extents.y;
+	m_extentZ[index] = extents.z;
+
+	return;
+}
+
+
+void CullingClass::TransformBounds(D3DXVECTOR3& center, D3DXVECTOR3& extents, float radius, D3DXMATRIX& worldMatrix,
+								   D3DXVECTOR3& worldCenter, D3DXVECTOR3& worldExtents, float& worldRadius)
+{
+	float scale, rowScale;
+	int row;
+
+
+	// Move the center, and grow the box to hold the rotated box by summing the absolute rows each axis maps to.
+	D3DXVec3TransformCoord(&worldCenter, &center, &worldMatrix);
+
+	worldExtents.x = (extents.x * fabsf(worldMatrix._11)) + (extents.y * fabsf(worldMatrix._21)) + (extents.z * fabsf(worldMatrix._31));
+	worldExtents.y = (extents.x * fabsf(worldMatrix._12)) + (extents.y * fabsf(worldMatrix._22)) + (extents.z * fabsf(worldMatrix._32));
+	worldExtents.z = (extents.x * fabsf(worldMatrix._13)) + (extents.y * fabsf(worldMatrix._23)) + (extents.z * fabsf(worldMatrix._33));
+
+	// The sphere only rotates with the object, but grows with the largest scale of the three axes.
+	scale = 0.0f;
+	for(row=0; row<3; row++)
+	{
+		rowScale = (worldMatrix.m[row][0] * worldMatrix.m[row][0]) + (worldMatrix.m[row][1] * worldMatrix.m[row][1]) +
+			(worldMatrix.m[row][2] * worldMatrix.m[row][2]);
+		if(rowScale > scale)
+		{
+			scale = rowScale;
+		}
+	}
+
+	worldRadius = radius * sqrtf(scale);
+
+	return;
+}
+
+
+void CullingClass::SetFrustum(D3DXMATRIX& viewMatrix, D3DXMATRIX& projectionMatrix)
+{
+	int i;
+
+
+	ExtractPlanes(viewMatrix, projectionMatrix, m_planes);
+
+	// Keep the absolute normals for the boxes.
+	for(i=0; i<CULLING_PLANE_COUNT; i++)
+	{
+		m_absolutePlanes[i][0] = fabsf(m_planes[i][0]);
+		m_absolutePlanes[i][1] = fabsf(m_planes[i][1]);
+		m_absolutePlanes[i][2] = fabsf(m_planes[i][2]);
+	}
+
+	return;
+}
+
+
+void CullingClass::ExtractPlanes(D3DXMATRIX& viewMatrix, D3DXMATRIX& projectionMatrix, float planes[CULLING_PLANE_COUNT][4])
+{
+	D3DXMATRIX matrix;
+	float length;
+	int i;
+
+
+	D3DXMatrixMultiply(&matrix, &viewMatrix, &projectionMatrix);
+
+	// Take the planes from the columns of the view projection matrix, with Direct3D's zero to one depth range.
+	planes[0][0] = matrix._14 + matrix._11;
+	planes[0][1] = matrix._24 + matrix._21;
+	planes[0][2] = matrix._34 + matrix._31;
+	planes[0][3] = matrix._44 + matrix._41;
+
+	planes[1][0] = matrix._14 - matrix._11;
+	planes[1][1] = matrix._24 - matrix._21;
+	planes[1][2] = matrix._34 - matrix._31;
+	planes[1][3] = matrix._44 - matrix._41;
+
+	planes[2][0] = matrix._14 + matrix._12;
+	planes[2][1] = matrix._24 + matrix._22;
+	planes[2][2] = matrix._34 + matrix._32;
+	planes[2][3] = matrix._44 + matrix._42;
+
+	planes[3][0] = matrix._14 - matrix._12;
+	planes[3][1] = matrix._24 - matrix._22;
+	planes[3][2] = matrix._34 - matrix._32;
+	planes[3][3] = matrix._44 - matrix._42;
+
+	planes[4][0] = matrix._13;
+	planes[4][1] = matrix._23;
+	planes[4][2] = matrix._33;
+	planes[4][3] = matrix._43;
+
+	planes[5][0] = matrix._14 - matrix._13;
+	planes[5][1] = matrix._24 - matrix._23;
+	planes[5][2] = matrix._34 - matrix._33;
+	planes[5][3] = matrix._44 - matrix._43;
+
+	// Normalize the planes so their distances compare with the radii.
+	for(i=0; i<CULLING_PLANE_COUNT; i++)
+	{
+		length = sqrtf((planes[i][0] * planes[i][0]) + (planes[i][1] * planes[i][1]) + (planes[i][2] * planes[i][2]));
+		if(length > 0.0f)
+		{
+			planes[i][0] /= length;
+			planes[i][1] /= length;
+			planes[i][2] /= length;
+			planes[i][3] /= length;
+		}
+	}
+
+	return;
+}
+
+
+void CullingClass::Cull(ThreadPoolClass* threadPool)
+{
+	PROFILE_ZONE("CullingClass::Cull");
+	int chunkCount, i;
+
+
+	chunkCount = (m_objectCount + CULLING_CHUNK_SIZE - 1) / CULLING_CHUNK_SIZE;
+
+	// Test the chunks in parallel, each into its own part of the scratch list.
+	threadPool->Run(&CullingClass::CullTask, this, chunkCount);
+
+	// Find where every chunk's part goes in the compacted list, then copy them there in parallel.
+	m_visibleCount = 0;
+	for(i=0; i<chunkCount; i++)
+	{
+		m_chunkOffsets[i] = m_visibleCount;
+		m_visibleCount += m_chunkCounts[i];
+	}
+
+	threadPool->Run(&CullingClass::CompactTask, this, chunkCount);
+
+	return;
+}
+
+
+int CullingClass::GetVisibleCount()
+{
+	return m_visibleCount;
+}
+
+
+int* CullingClass::GetVisible()
+{
+	return m_visible;
+}
+
+
+bool CullingClass::Reserve(int count)
+{
+	float** arrays[7];
+	float* newArray;
+	int capacity, chunkCount, i;
+
+
+	if(count <= m_capacity)
+	{
+		return true;
+	}
+
+	// Grow the arrays by doubling, always to a whole number of SIMD iterations.
+	capacity = (m_capacity > 0) ? m_capacity : SOFTWARE_SIMD_WIDTH;
+	while(capacity < count)
+	{
+		capacity *= 2;
+	}
+
+	arrays[0] = &m_centerX;
+	arrays[1] = &m_centerY;
+	arrays[2] = &m_centerZ;
+	arrays[3] = &m_radius;
+	arrays[4] = &m_extentX;
+	arrays[5] = &m_extentY;
+	arrays[6] = &m_extentZ;
+
+	for(i=0; i<7; i++)
+	{
+		newArray = AllocateArray(capacity);
+		if(!newArray)
+		{
+			return false;
+		}
+
+		if(*arrays[i])
+		{
+			memcpy(newArray, *arrays[i], sizeof(float) * m_objectCount);
+			_aligned_free(*arrays[i]);
+		}
+
+		*arrays[i] = newArray;
+	}
+
+	// Every chunk can see all of its objects, so the lists are as long as the arrays.
+	chunkCount = (capacity + CULLING_CHUNK_SIZE - 1) / CULLING_CHUNK_SIZE;
+
+	if(m_chunkVisible)
+	{
+		delete [] m_chunkVisible;
+		delete [] m_chunkCounts;
+		delete [] m_chunkOffsets;
+		delete [] m_visible;
+	}
+
+	m_chunkVisible = new int[capacity];
+	m_chunkCounts = new int[chunkCount];
+	m_chunkOffsets = new int[chunkCount];
+	m_visible = new int[capacity];
+	if(!m_chunkVisible || !m_chunkCounts || !m_chunkOffsets || !m_visible)
+	{
+		return false;
+	}
+
+	m_capacity = capacity;
+
+	return true;
+}
+
+
+float* CullingClass::AllocateArray(int count)
+{
+	return (float*)_aligned_malloc(sizeof(float) * count, CULLING_ALIGNMENT);
+}
+
+
+void CullingClass::CullTask(void* context, int chunk)
+{
+	CullingClass* culling;
+	int begin, end;
+
+
+	culling = (CullingClass*)context;
+
+	begin = chunk * CULLING_CHUNK_SIZE;
+	end = begin + CULLING_CHUNK_SIZE;
+	if(end > culling->m_objectCount)
+	{
+		end = culling->m_objectCount;
+	}
+
+	culling->m_chunkCounts[chunk] = culling->m_cullKernel(culling, begin, end, culling->m_chunkVisible + begin);
+
+	return;
+}
+
+
+void CullingClass::CompactTask(void* context, int chunk)
+{
+	CullingClass* culling;
+
+
+	culling = (CullingClass*)context;
+
+	memcpy(culling->m_visible + culling->m_chunkOffsets[chunk], culling->m_chunkVisible + (chunk * CULLING_CHUNK_SIZE),
+		sizeof(int) * culling->m_chunkCounts[chunk]);
+
+	return;
+}
+
+
+int CullingClass::CullScalar(CullingClass* culling, int begin, int end, int* output)
+{
+	float distance, boxRadius, radius;
+	bool outside;
+	int count, i, plane;
+
+
+	count = 0;
+	for(i=begin; i<end; i++)
+	{
+		outside = false;
+		for(plane=0; plane<CULLING_PLANE_COUNT; plane++)
+		{
+			// Signed distance of the center, and how far the box reaches towards the plane.
+			distance = (culling->m_planes[plane][0] * culling->m_centerX[i]) + (culling->m_planes[plane][1] * culling->m_centerY[i]) +
+				(culling->m_planes[plane][2] * culling->m_centerZ[i]) + culling->m_planes[plane][3];
+			boxRadius = (culling->m_absolutePlanes[plane][0] * culling->m_extentX[i]) + (culling->m_absolutePlanes[plane][1] * culling->m_extentY[i]) +
+				(culling->m_absolutePlanes[plane][2] * culling->m_extentZ[i]);
+
+			// Whichever volume is tighter against this plane decides.
+			radius = (boxRadius < culling->m_radius[i]) ? boxRadius : culling->m_radius[i];
+			if(distance < -radius)
+			{
+				outside = true;
+			}
+		}
+
+		// Write every object and only advance past the visible ones, so there is no branch on the result.
+		output[count] = i;
+		count += outside ? 0 : 1;
+	}
+
+	return count;
+}
+
+
+int CullingClass::CullSSE41(CullingClass* culling, int begin, int end, int* output)
+{
+	__m128 centerX, centerY, centerZ, radius, extentX, extentY, extentZ, distance, boxRadius, outside;
+	int count, i, half, plane, mask, lane;
+
+
+	// Test whole groups of eight as two halves of four, leaving the remainder to the scalar kernel.
+	count = 0;
+	for(i=begin; i + SOFTWARE_SIMD_WIDTH <= end; i+=SOFTWARE_SIMD_WIDTH)
+	{
+		for(half=0; half<SOFTWARE_SIMD_WIDTH; half+=4)
+		{
+			centerX = _mm_load_ps(culling->m_centerX + i + half);
+			centerY = _mm_load_ps(culling->m_centerY + i + half);
+			centerZ = _mm_load_ps(culling->m_centerZ + i + half);
+			radius = _mm_load_ps(culling->m_radius + i + half);
+			extentX = _mm_load_ps(culling->m_extentX + i + half);
+			extentY = _mm_load_ps(culling->m_extentY + i + half);
+			extentZ = _mm_load_ps(culling->m_extentZ + i + half);
+
+			outside = _mm_setzero_ps();
+			for(plane=0; plane<CULLING_PLANE_COUNT; plane++)
+			{
+				distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(culling->m_planes[plane][0]), centerX),
+					_mm_mul_ps(_mm_set1_ps(culling->m_planes[plane][1]), centerY)), _mm_mul_ps(_mm_set1_ps(culling->m_planes[plane][2]), centerZ)),
+					_mm_set1_ps(culling->m_planes[plane][3]));
+				boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(culling->m_absolutePlanes[plane][0]), extentX),
+					_mm_mul_ps(_mm_set1_ps(culling->m_absolutePlanes[plane][1]), extentY)), _mm_mul_ps(_mm_set1_ps(culling->m_absolutePlanes[plane][2]), extentZ));
+
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_sub_ps(_mm_setzero_ps(), _mm_min_ps(boxRadius, radius))));
+			}
+
+			// Append the visible lanes in order.
+			mask = ~_mm_movemask_ps(outside);
+			for(lane=0; lane<4; lane++)
+			{
+				output[count] = i + half + lane;
+				count += (mask >> lane) & 1;
+			}
+		}
+	}
+
+	return count + CullScalar(culling, i, end, output + count);
+}
+
+
+int CullingClass::CullAVX2(CullingClass* culling, int begin, int end, int* output)
+{
+	__m256 centerX, centerY, centerZ, radius, extentX, extentY, extentZ, distance, boxRadius, outside;
+	int count, i, plane, mask, lane;
+
+
+	// Test eight objects per iteration, leaving the remainder to the scalar kernel.
+	count = 0;
+	for(i=begin; i + SOFTWARE_SIMD_WIDTH <= end; i+=SOFTWARE_SIMD_WIDTH)
+	{
+		centerX = _mm256_load_ps(culling->m_centerX + i);
+		centerY = _mm256_load_ps(culling->m_centerY + i);
+		centerZ = _mm256_load_ps(culling->m_centerZ + i);
+		radius = _mm256_load_ps(culling->m_radius + i);
+		extentX = _mm256_load_ps(culling->m_extentX + i);
+		extentY = _mm256_load_ps(culling->m_extentY + i);
+		extentZ = _mm256_load_ps(culling->m_extentZ + i);
+
+		outside = _mm256_setzero_ps();
+		for(plane=0; plane<CULLING_PLANE_COUNT; plane++)
+		{
+			distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(culling->m_planes[plane][0]), centerX),
+				_mm256_mul_ps(_mm256_set1_ps(culling->m_planes[plane][1]), centerY)), _mm256_mul_ps(_mm256_set1_ps(culling->m_planes[plane][2]), centerZ)),
+				_mm256_set1_ps(culling->m_planes[plane][3]));
+			boxRadius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(culling->m_absolutePlanes[plane][0]), extentX),
+				_mm256_mul_ps(_mm256_set1_ps(culling->m_absolutePlanes[plane][1]), extentY)), _mm256_mul_ps(_mm256_set1_ps(culling->m_absolutePlanes[plane][2]), extentZ));
+
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, _mm256_sub_ps(_mm256_setzero_ps(), _mm256_min_ps(boxRadius, radius)), _CMP_LT_OQ));
+		}
+
+		// Append the visible lanes in order.
+		mask = ~_mm256_movemask_ps(outside);
+		for(lane=0; lane<SOFTWARE_SIMD_WIDTH; lane++)
+		{
+			output[count] = i + lane;
+			count += (mask >> lane) & 1;
+		}
+	}
+
+	return count + CullScalar(culling, i, end, output + count);
+}
@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: cullingclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _CULLINGCLASS_H_
+#define _CULLINGCLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <d3dx10math.h>
+#include <intrin.h>
+#include <malloc.h>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "softwareshaderclass.h"
+#include "threadpoolclass.h"
+#include "profilerclass.h"
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int CULLING_PLANE_COUNT = 6;
+const int CULLING_CHUNK_SIZE = 16384;
+const int CULLING_ALIGNMENT = 32;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: CullingClass
+// Tests world space bounds against the six planes of the view frustum and
+// builds a compacted list of the objects that may be visible.  Each object has
+// a bounding sphere and an axis aligned box around the same center, stored as
+// one flat array per component so eight objects load straight into one SIMD
+// register.  An object is culled when either volume is entirely behind one
+// plane, which is the same as testing the plane against the smaller of the
+// sphere's radius and the box's projected radius.
+//
+// Cull splits the objects into chunks that the thread pool tests in
+// parallel.  Every chunk writes its visible objects to its own part of a
+// scratch list, and a second parallel pass copies the parts together once
+// their counts are known, so the list comes out in object order however many
+// threads ran.  The kernels are picked like the software shader's: AVX2
+// tests eight objects per iteration, SSE4.1 two groups of four, and all of
+// them do the same arithmetic in the same order.
+////////////////////////////////////////////////////////////////////////////////
+class CullingClass
+{
+private:
+	typedef int (*CullKernelType)(CullingClass*, int, int, int*);
+
+public:
+	CullingClass();
+	CullingClass(const CullingClass&);
+	~CullingClass();
+
+	bool Initialize(int);
+	void Shutdown();
+
+	bool SetInstructionSet(SoftwareShaderClass::InstructionSetType);
+	SoftwareShaderClass::InstructionSetType GetInstructionSet();
+
+	bool SetObjectCount(int);
+	int GetObjectCount();
+	void SetBounds(int, D3DXVECTOR3&, D3DXVECTOR3&, float);
+	static void TransformBounds(D3DXVECTOR3&, D3DXVECTOR3&, float, D3DXMATRIX&, D3DXVECTOR3&, D3DXVECTOR3&, float&);
+
+	void SetFrustum(D3DXMATRIX&, D3DXMATRIX&);
+	static void ExtractPlanes(D3DXMATRIX&, D3DXMATRIX&, float[CULLING_PLANE_COUNT][4]);
+	void Cull(ThreadPoolClass*);
+
+	int GetVisibleCount();
+	int* GetVisible();
+
+private:
+	bool Reserve(int);
+	float* AllocateArray(int);
+	static void CullTask(void*, int);
+	static void CompactTask(void*, int);
+
+	static int CullScalar(CullingClass*, int, int, int*);
+	static int CullSSE41(CullingClass*, int, int, int*);
+	static int CullAVX2(CullingClass*, int, int, int*);
+
+private:
+	SoftwareShaderClass::InstructionSetType m_instructionSet;
+	CullKernelType m_cullKernel;
+
+	float *m_centerX, *m_centerY, *m_centerZ, *m_radius;
+	float *m_extentX, *m_extentY, *m_extentZ;
+	int m_objectCount, m_capacity;
+
+	float m_planes[CULLING_PLANE_COUNT][4];
+	float m_absolutePlanes[CULLING_PLANE_COUNT][3];
+
+	int* m_chunkVisible;
+	int* m_chunkCounts;
+	int* m_chunkOffsets;
+	int* m_visible;
+	int m_visibleCount;
+};
+
+#endif
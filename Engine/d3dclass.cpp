@@ -9,12 +9,15 @@ D3DClass::D3DClass()
 	m_swapChain = 0;
 	m_device = 0;
 	m_deviceContext = 0;
+	m_PipelineState = 0;
+	m_ConstantAllocator = 0;
 	m_renderTargetView = 0;
 	m_depthStencilBuffer = 0;
 	m_depthStencilState = 0;
 	m_depthStencilView = 0;
 	m_rasterState = 0;
 	m_depthDisabledStencilState = 0;
+	m_alphaEnableBlendingState = 0;
 }
 
 
@@ -49,6 +52,7 @@ bool D3DClass::Initialize(int screenWidth, int screenHeight, bool vsync, HWND hw
 	D3D11_VIEWPORT viewport;
 	float fieldOfView, screenAspect;
 	D3D11_DEPTH_STENCIL_DESC depthDisabledStencilDesc;
+	D3D11_BLEND_DESC blendStateDesc;
 
 
 	// Store the vsync setting.
@@ -210,6 +214,30 @@ bool D3DClass::Initialize(int screenWidth, int screenHeight, bool vsync, HWND hw
 		return false;
 	}
 
+	// Create the pipeline state object that shares state objects and filters redundant binds on the context.
+	m_PipelineState = new PipelineStateClass;
+	if(!m_PipelineState)
+	{
+		return false;
+	}
+
+	if(!m_PipelineState->Initialize(m_device, m_deviceContext))
+	{
+		return false;
+	}
+
+	// Create the allocator that the shaders take their constants from.
+	m_ConstantAllocator = new ConstantAllocatorClass;
+	if(!m_ConstantAllocator)
+	{
+		return false;
+	}
+
+	if(!m_ConstantAllocator->Initialize(m_device, m_deviceContext, m_PipelineState))
+	{
+		return false;
+	}
+
 	// Get the pointer to the back buffer.
 	result = m_swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&backBufferPtr);
 	if(FAILED(result))
@@ -275,15 +303,15 @@ bool D3DClass::Initialize(int screenWidth, int screenHeight, bool vsync, HWND hw
 	depthStencilDesc.BackFace.StencilPassOp = D3D11_STENCIL_OP_KEEP;
 	depthStencilDesc.BackFace.StencilFunc = D3D11_COMPARISON_ALWAYS;
 
-	// Create the depth stencil state.
-	result = m_device->CreateDepthStencilState(&depthStencilDesc, &m_depthStencilState);
-	if(FAILED(result))
+	// Create the depth stencil state.  The pipeline state cache owns it.
+	m_depthStencilState = m_PipelineState->GetDepthStencilState(&depthStencilDesc);
+	if(!m_depthStencilState)
 	{
 		return false;
 	}
 
 	// Set the depth stencil state.
-	m_deviceContext->OMSetDepthStencilState(m_depthStencilState, 1);
+	m_PipelineState->SetDepthStencilState(m_depthStencilState, 1);
 
 	// Initialize the depth stencil view.
 	ZeroMemory(&depthStencilViewDesc, sizeof(depthStencilViewDesc));
@@ -316,14 +344,14 @@ bool D3DClass::Initialize(int screenWidth, int screenHeight, bool vsync, HWND hw
 	rasterDesc.SlopeScaledDepthBias = 0.0f;
 
 	// Create the rasterizer state from the description we just filled out.
-	result = m_device->CreateRasterizerState(&rasterDesc, &m_rasterState);
-	if(FAILED(result))
+	m_rasterState = m_PipelineState->GetRasterizerState(&rasterDesc);
+	if(!m_rasterState)
 	{
 		return false;
 	}
 
 	// Now set the rasterizer state.
-	m_deviceContext->RSSetState(m_rasterState);
+	m_PipelineState->SetRasterizerState(m_rasterState);
 	
 	// Setup the viewport for rendering.
     viewport.Width = (float)screenWidth;
@@ -372,9 +400,29 @@ bool D3DClass::Initialize(int screenWidth, int screenHeight, bool vsync, HWND hw
 	depthDisabledStencilDesc.BackFace.StencilPassOp = D3D11_STENCIL_OP_KEEP;
 	depthDisabledStencilDesc.BackFace.StencilFunc = D3D11_COMPARISON_ALWAYS;
 
-	// Create the state using the device.
-	result = m_device->CreateDepthStencilState(&depthDisabledStencilDesc, &m_depthDisabledStencilState);
-	if(FAILED(result))
+	// Create the state using the pipeline state cache.
+	m_depthDisabledStencilState = m_PipelineState->GetDepthStencilState(&depthDisabledStencilDesc);
+	if(!m_depthDisabledStencilState)
+	{
+		return false;
+	}
+
+	// Clear the blend state description.
+	ZeroMemory(&blendStateDesc, sizeof(D3D11_BLEND_DESC));
+
+	// Create an alpha enabled blend state description, which lays what is drawn over the target by its alpha.
+	blendStateDesc.RenderTarget[0].BlendEnable = TRUE;
+	blendStateDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+	blendStateDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+	blendStateDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+	blendStateDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+	blendStateDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ZERO;
+	blendStateDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	blendStateDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+
+	// Create the blend state using the pipeline state cache.
+	m_alphaEnableBlendingState = m_PipelineState->GetBlendState(&blendStateDesc);
+	if(!m_alphaEnableBlendingState)
 	{
 		return false;
 	}
@@ -391,16 +439,24 @@ void D3DClass::Shutdown()
 		m_swapChain->SetFullscreenState(false, NULL);
 	}
 
-	if(m_depthDisabledStencilState)
+	// The depth stencil, rasterizer and blend states belong to the pipeline state cache.
+	m_alphaEnableBlendingState = 0;
+	m_depthDisabledStencilState = 0;
+	m_rasterState = 0;
+	m_depthStencilState = 0;
+
+	if(m_ConstantAllocator)
 	{
-		m_depthDisabledStencilState->Release();
-		m_depthDisabledStencilState = 0;
+		m_ConstantAllocator->Shutdown();
+		delete m_ConstantAllocator;
+		m_ConstantAllocator = 0;
 	}
 
-	if(m_rasterState)
+	if(m_PipelineState)
 	{
-		m_rasterState->Release();
-		m_rasterState = 0;
+		m_PipelineState->Shutdown();
+		delete m_PipelineState;
+		m_PipelineState = 0;
 	}
 
 	if(m_depthStencilView)
@@ -409,12 +465,6 @@ void D3DClass::Shutdown()
 		m_depthStencilView = 0;
 	}
 
-	if(m_depthStencilState)
-	{
-		m_depthStencilState->Release();
-		m_depthStencilState = 0;
-	}
-
 	if(m_depthStencilBuffer)
 	{
 		m_depthStencilBuffer->Release();
@@ -466,6 +516,10 @@ void D3DClass::BeginScene(float red, float green, float blue, float alpha)
 	// Clear the depth buffer.
 	m_deviceContext->ClearDepthStencilView(m_depthStencilView, D3D11_CLEAR_DEPTH, 1.0f, 0);
 
+	// Start counting the frame's state calls and constant uploads.
+	m_PipelineState->ResetCounters();
+	m_ConstantAllocator->BeginFrame();
+
 	return;
 }
 
@@ -500,6 +554,18 @@ ID3D11DeviceContext* D3DClass::GetDeviceContext()
 }
 
 
+PipelineStateClass* D3DClass::GetPipelineState()
+{
+	return m_PipelineState;
+}
+
+
+ConstantAllocatorClass* D3DClass::GetConstantAllocator()
+{
+	return m_ConstantAllocator;
+}
+
+
 void D3DClass::GetProjectionMatrix(D3DXMATRIX& projectionMatrix)
 {
 	projectionMatrix = m_projectionMatrix;
@@ -536,13 +602,28 @@ void D3DClass::GetVideoCardInfo(char* cardName, int& memory)
 
 void D3DClass::TurnZBufferOn()
 {
-	m_deviceContext->OMSetDepthStencilState(m_depthStencilState, 1);
+	m_PipelineState->SetDepthStencilState(m_depthStencilState, 1);
 	return;
 }
 
 
 void D3DClass::TurnZBufferOff()
 {
-	m_deviceContext->OMSetDepthStencilState(m_depthDisabledStencilState, 1);
+	m_PipelineState->SetDepthStencilState(m_depthDisabledStencilState, 1);
+	return;
+}
+
+
+void D3DClass::TurnOnAlphaBlending()
+{
+	m_PipelineState->SetBlendState(m_alphaEnableBlendingState);
+	return;
+}
+
+
+void D3DClass::TurnOffAlphaBlending()
+{
+	// No blend state is the default, which writes the color straight over the target.
+	m_PipelineState->SetBlendState(0);
 	return;
 }
\ No newline at end of file
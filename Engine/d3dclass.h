@@ -23,6 +23,13 @@
 #include <d3dx10math.h>
 
 
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "pipelinestateclass.h"
+#include "constantallocatorclass.h"
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Class name: D3DClass
 ////////////////////////////////////////////////////////////////////////////////
@@ -41,6 +48,8 @@ public:
 
 	ID3D11Device* GetDevice();
 	ID3D11DeviceContext* GetDeviceContext();
+	PipelineStateClass* GetPipelineState();
+	ConstantAllocatorClass* GetConstantAllocator();
 
 	void GetProjectionMatrix(D3DXMATRIX&);
 	void GetWorldMatrix(D3DXMATRIX&);
@@ -52,6 +61,9 @@ public:
 	void TurnZBufferOn();
 	void TurnZBufferOff();
 
+	void TurnOnAlphaBlending();
+	void TurnOffAlphaBlending();
+
 private:
 	bool m_vsync_enabled;
 	int m_videoCardMemory;
@@ -59,6 +71,8 @@ private:
 	IDXGISwapChain* m_swapChain;
 	ID3D11Device* m_device;
 	ID3D11DeviceContext* m_deviceContext;
+	PipelineStateClass* m_PipelineState;
+	ConstantAllocatorClass* m_ConstantAllocator;
 	ID3D11RenderTargetView* m_renderTargetView;
 	ID3D11Texture2D* m_depthStencilBuffer;
 	ID3D11DepthStencilState* m_depthStencilState;
@@ -69,6 +83,7 @@ private:
 	D3DXMATRIX m_orthoMatrix;
     D3DXMATRIX m_UIWorldMatrix;
 	ID3D11DepthStencilState* m_depthDisabledStencilState;
+	ID3D11BlendState* m_alphaEnableBlendingState;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,322 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: drawqueueclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "drawqueueclass.h"
+#include <string.h>
+
+
+DrawQueueClass::DrawQueueClass()
+{
+	m_items = 0;
+	m_scratch = 0;
+	m_sorted = 0;
+	m_lastState = 0;
+	m_unsortedChanges = 0;
+}
+
+
+DrawQueueClass::DrawQueueClass(const DrawQueueClass& other)
+{
+}
+
+
+DrawQueueClass::~DrawQueueClass()
+{
+}
+
+
+bool DrawQueueClass::Initialize(int capacity)
+{
+	// Create the packet array and the scratch array the radix sort ping-pongs with.
+	m_items = new vector<ItemType>;
+	if(!m_items)
+	{
+		return false;
+	}
+
+	m_scratch = new vector<ItemType>;
+	if(!m_scratch)
+	{
+		return false;
+	}
+
+	m_items->reserve(capacity);
+	m_scratch->reserve(capacity);
+
+	return true;
+}
+
+
+void DrawQueueClass::Shutdown()
+{
+	// Release the arrays.
+	if(m_scratch)
+	{
+		delete m_scratch;
+		m_scratch = 0;
+	}
+
+	if(m_items)
+	{
+		delete m_items;
+		m_items = 0;
+	}
+
+	m_sorted = 0;
+
+	return;
+}
+
+
+void DrawQueueClass::Reset()
+{
+	// Forget last frame's packets but keep the memory.
+	m_items->clear();
+	m_sorted = 0;
+	m_lastState = 0;
+	m_unsortedChanges = 0;
+
+	return;
+}
+
+
+void DrawQueueClass::Add(CommandListClass* commands)
+{
+	CommandListClass::HeaderType* command;
+	ItemType item;
+	unsigned long long state;
+
+
+	// Queue every packet of the list with the key it was recorded with.
+	for(command = commands->GetFirst(); command; command = commands->GetNext(command))
+	{
+		item.key = command->key;
+		item.command = command;
+
+		// Count the state changes the packets would cause in the order they were recorded.
+		state = GetState(item.key);
+		if(m_items->empty() || (state != m_lastState))
+		{
+			m_unsortedChanges++;
+		}
+		m_lastState = state;
+
+		m_items->push_back(item);
+	}
+
+	m_sorted = 0;
+
+	return;
+}
+
+
+void DrawQueueClass::Sort()
+{
+	int shifts[DRAW_QUEUE_RADIX_PASSES];
+	unsigned long long first, varying, key;
+	unsigned int offset, count;
+	ItemType* source;
+	ItemType* destination;
+	ItemType* temp;
+	int itemCount, digitCount, shift, pass, digit, i;
+
+
+	itemCount = (int)m_items->size();
+	if(itemCount == 0)
+	{
+		return;
+	}
+
+	m_scratch->resize(itemCount);
+
+	// Find the bits that differ between any two packets.
+	first = (*m_items)[0].key;
+	varying = 0;
+	for(i=1; i<itemCount; i++)
+	{
+		varying |= (*m_items)[i].key ^ first;
+	}
+
+	// Start a digit at each varying bit not covered by the previous digit, skipping the constant bits in between.
+	digitCount = 0;
+	shift = 0;
+	while((shift < 64) && ((varying >> shift) != 0))
+	{
+		while(((varying >> shift) & 1) == 0)
+		{
+			shift++;
+		}
+
+		shifts[digitCount] = shift;
+		digitCount++;
+		shift += DRAW_QUEUE_RADIX_BITS;
+	}
+
+	// Build the histogram of every digit in a single sweep over the keys.
+	memset(m_counts, 0, sizeof(m_counts));
+
+	for(i=0; i<itemCount; i++)
+	{
+		key = (*m_items)[i].key;
+		for(pass=0; pass<digitCount; pass++)
+		{
+			m_counts[pass][(key >> shifts[pass]) & (DRAW_QUEUE_RADIX_SIZE - 1)]++;
+		}
+	}
+
+	// Scatter by each digit in turn, least significant first.
+	source = &(*m_items)[0];
+	destination = &(*m_scratch)[0];
+
+	for(pass=0; pass<digitCount; pass++)
+	{
+		shift = shifts[pass];
+
+		// Turn the counts into the first output slot of each bucket.
+		offset = 0;
+		for(digit=0; digit<DRAW_QUEUE_RADIX_SIZE; digit++)
+		{
+			count = m_counts[pass][digit];
+			m_counts[pass][digit] = offset;
+			offset += count;
+		}
+
+		for(i=0; i<itemCount; i++)
+		{
+			digit = (int)((source[i].key >> shift) & (DRAW_QUEUE_RADIX_SIZE - 1));
+			destination[m_counts[pass][digit]++] = source[i];
+		}
+
+		temp = source;
+		source = destination;
+		destination = temp;
+	}
+
+	// The sorted packets are in whichever array the last pass wrote to.
+	m_sorted = source;
+
+	return;
+}
+
+
+int DrawQueueClass::GetCount()
+{
+	return (int)m_items->size();
+}
+
+
+CommandListClass::HeaderType* DrawQueueClass::GetCommand(int index)
+{
+	// Before the queue is sorted the packets come back in the order they were added.
+	if(m_sorted)
+	{
+		return m_sorted[index].command;
+	}
+
+	return (*m_items)[index].command;
+}
+
+
+int DrawQueueClass::GetStateChanges(bool sorted)
+{
+	// The sorted order is only counted when it is asked for, so the frame does not pay for it.
+	if(sorted && m_sorted)
+	{
+		return CountStateChanges(m_sorted);
+	}
+
+	return m_unsortedChanges;
+}
+
+
+unsigned long long DrawQueueClass::MakeKey(PassType pass, bool translucent, ShaderType shader, int texture, int buffer, float depth)
+{
+	unsigned long long key, state, depthBits;
+	int depthShift;
+
+
+	// Quantize the depth, which the caller has scaled to the zero to one range.
+	if(depth < 0.0f)
+	{
+		depth = 0.0f;
+	}
+	if(depth > 1.0f)
+	{
+		depth = 1.0f;
+	}
+
+	depthBits = (unsigned long long)(depth * (float)((1 << DRAW_KEY_DEPTH_BITS) - 1));
+
+	// Pack the shader, texture and buffer into the state fields.
+	state = (unsigned long long)shader & ((1 << DRAW_KEY_SHADER_BITS) - 1);
+	state = (state << DRAW_KEY_TEXTURE_BITS) | ((unsigned long long)texture & ((1 << DRAW_KEY_TEXTURE_BITS) - 1));
+	state = (state << DRAW_KEY_BUFFER_BITS) | ((unsigned long long)buffer & ((1 << DRAW_KEY_BUFFER_BITS) - 1));
+
+	// The pass and translucency flag always lead.
+	key = (unsigned long long)pass & ((1 << DRAW_KEY_PASS_BITS) - 1);
+	key = (key << 1) | (translucent ? 1 : 0);
+
+	// Opaque draws group by state and go front to back, translucent draws go back to front and then group by state.
+	depthShift = DRAW_KEY_SHADER_BITS + DRAW_KEY_TEXTURE_BITS + DRAW_KEY_BUFFER_BITS;
+	if(translucent)
+	{
+		depthBits = ((1 << DRAW_KEY_DEPTH_BITS) - 1) - depthBits;
+		key = (key << DRAW_KEY_DEPTH_BITS) | depthBits;
+		key = (key << depthShift) | state;
+	}
+	else
+	{
+		key = (key << depthShift) | state;
+		key = (key << DRAW_KEY_DEPTH_BITS) | depthBits;
+	}
+
+	return key;
+}
+
+
+unsigned long long DrawQueueClass::GetState(unsigned long long key)
+{
+	unsigned long long flags, state;
+	int stateBits;
+
+
+	// Strip the depth out of the key, wherever the translucency flag put it.
+	stateBits = DRAW_KEY_SHADER_BITS + DRAW_KEY_TEXTURE_BITS + DRAW_KEY_BUFFER_BITS;
+	flags = key >> (stateBits + DRAW_KEY_DEPTH_BITS);
+
+	if(flags & 1)
+	{
+		state = key & ((1ULL << stateBits) - 1);
+	}
+	else
+	{
+		state = (key >> DRAW_KEY_DEPTH_BITS) & ((1ULL << stateBits) - 1);
+	}
+
+	return (flags << stateBits) | state;
+}
+
+
+int DrawQueueClass::CountStateChanges(ItemType* items)
+{
+	unsigned long long state, previous;
+	int itemCount, changes, i;
+
+
+	// Every packet whose pass, shader, texture or buffer differs from the one before it changes pipeline state.
+	itemCount = (int)m_items->size();
+	changes = 0;
+	previous = 0;
+
+	for(i=0; i<itemCount; i++)
+	{
+		state = GetState(items[i].key);
+		if((i == 0) || (state != previous))
+		{
+			changes++;
+		}
+		previous = state;
+	}
+
+	return changes;
+}
@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: drawqueueclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _DRAWQUEUECLASS_H_
+#define _DRAWQUEUECLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <vector>
+using namespace std;
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "commandlistclass.h"
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int DRAW_KEY_PASS_BITS = 2;
+const int DRAW_KEY_SHADER_BITS = 5;
+const int DRAW_KEY_TEXTURE_BITS = 16;
+const int DRAW_KEY_BUFFER_BITS = 16;
+const int DRAW_KEY_DEPTH_BITS = 24;
+const int DRAW_QUEUE_RADIX_BITS = 11;
+const int DRAW_QUEUE_RADIX_SIZE = 1 << DRAW_QUEUE_RADIX_BITS;
+const int DRAW_QUEUE_RADIX_PASSES = (64 + DRAW_QUEUE_RADIX_BITS - 1) / DRAW_QUEUE_RADIX_BITS;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: DrawQueueClass
+// Orders the packets of a frame's command lists by a 64-bit sort key before
+// they are submitted.  From the most significant bit down a key holds the
+// pass, the translucency flag, the shader, the texture, the vertex buffer and
+// the view depth quantized to 24 bits.  Opaque draws are therefore grouped by
+// state and then drawn front to back for early depth rejection.  Translucent
+// draws move the depth ahead of the state, inverted, so they blend back to
+// front.
+//
+// The keys are sorted with a least significant digit radix sort of eleven
+// bit digits.  Digits are only placed over bits that differ between the
+// frame's packets, so fields a frame does not use, such as the high bits of
+// the texture and buffer slots, cost no passes.  The histograms of every
+// digit are built in one sweep.  The sort is stable, so packets with equal
+// keys keep the order they were recorded in.
+////////////////////////////////////////////////////////////////////////////////
+class DrawQueueClass
+{
+public:
+	enum PassType
+	{
+		PASS_SCENE,
+		PASS_OVERLAY
+	};
+
+	// State changes have no shader, so they sort ahead of the draws in their pass.
+	enum ShaderType
+	{
+		SHADER_NONE,
+		SHADER_LIGHT,
+		SHADER_TEXTURE
+	};
+
+private:
+	struct ItemType
+	{
+		unsigned long long key;
+		CommandListClass::HeaderType* command;
+	};
+
+public:
+	DrawQueueClass();
+	DrawQueueClass(const DrawQueueClass&);
+	~DrawQueueClass();
+
+	bool Initialize(int);
+	void Shutdown();
+
+	void Reset();
+	void Add(CommandListClass*);
+	void Sort();
+
+	int GetCount();
+	CommandListClass::HeaderType* GetCommand(int);
+	int GetStateChanges(bool);
+
+	static unsigned long long MakeKey(PassType, bool, ShaderType, int, int, float);
+
+private:
+	static unsigned long long GetState(unsigned long long);
+	int CountStateChanges(ItemType*);
+
+private:
+	vector<ItemType>* m_items;
+	vector<ItemType>* m_scratch;
+	ItemType* m_sorted;
+	unsigned int m_counts[DRAW_QUEUE_RADIX_PASSES][DRAW_QUEUE_RADIX_SIZE];
+	unsigned long long m_lastState;
+	int m_unsortedChanges;
+};
+
+#endif
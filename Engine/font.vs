@@ -6,48 +6,82 @@
 /////////////
 // GLOBALS //
 /////////////
-cbuffer PerFrameBuffer
+cbuffer PerFrameBuffer : register(b0)
 {
 	matrix worldMatrix;
 	matrix viewMatrix;
 	matrix projectionMatrix;
 };
 
+// Each glyph's left and right texture coordinates and the width and height of its quad, one for every glyph in FontClass.
+cbuffer GlyphBuffer : register(b1)
+{
+	float4 glyphMetrics[95];
+};
+
+// The corners of the two triangles in a glyph's quad, as fractions of its width and height down from the top left.
+static const float2 quadCorners[6] =
+{
+	float2(0.0f, 0.0f), float2(1.0f, 1.0f), float2(0.0f, 1.0f),
+	float2(0.0f, 0.0f), float2(1.0f, 0.0f), float2(1.0f, 1.0f)
+};
+
 
 //////////////
 // TYPEDEFS //
 //////////////
-struct VertexInputType
+struct GlyphInputType
 {
-    float4 position : POSITION;
-    float2 tex : TEXCOORD0;
+    float2 position : POSITION;
+    uint glyph : TEXCOORD0;
+    float4 color : COLOR;
+    uint corner : SV_VertexID;
 };
 
 struct PixelInputType
 {
     float4 position : SV_POSITION;
     float2 tex : TEXCOORD0;
+    float4 color : COLOR;
 };
 
 
 ////////////////////////////////////////////////////////////////////////////////
 // Vertex Shader
 ////////////////////////////////////////////////////////////////////////////////
-PixelInputType FontVertexShader(VertexInputType input)
+PixelInputType FontVertexShader(GlyphInputType input)
 {
     PixelInputType output;
+    float4 metrics;
+    float2 corner;
+    float scale;
+    float4 position;
     
 
-	// Change the position vector to be 4 units for proper matrix calculations.
-    input.position.w = 1.0f;
+	// The glyph index is in the low 16 bits and its scale in the high 16, as 8.8 fixed point.
+	metrics = glyphMetrics[input.glyph & 0xffff];
+	scale = (float)(input.glyph >> 16) / 256.0f;
+
+	// Find which corner of the quad this is.
+	corner = quadCorners[input.corner];
+
+	// Place the corner from the glyph's top left, with y going up the screen.
+	position.x = input.position.x + (corner.x * metrics.z * scale);
+	position.y = input.position.y - (corner.y * metrics.w * scale);
+	position.z = 0.0f;
+	position.w = 1.0f;
 
 	// Calculate the position of the vertex against the world, view, and projection matrices.
-    output.position = mul(input.position, worldMatrix);
+    output.position = mul(position, worldMatrix);
     output.position = mul(output.position, viewMatrix);
     output.position = mul(output.position, projectionMatrix);
     
-	// Store the texture coordinates for the pixel shader.
-	output.tex = input.tex;
+	// Pick the texture coordinates from the glyph's span of the font texture.
+	output.tex.x = lerp(metrics.x, metrics.y, corner.x);
+	output.tex.y = corner.y;
+
+	// Pass the text color through to the pixel shader.
+	output.color = input.color;
     
     return output;
 }
\ No newline at end of file
@@ -8,6 +8,10 @@ FontClass::FontClass()
 {
 	m_Font = 0;
 	m_Texture = 0;
+	m_SoftwareTexture = 0;
+	m_distanceField = false;
+	m_height = FONT_GLYPH_HEIGHT;
+	m_padding = 0.0f;
 }
 
 
@@ -61,10 +65,11 @@ bool FontClass::LoadFontData(char* filename)
 	ifstream fin;
 	int i;
 	char temp;
+	string header;
 
 
 	// Create the font spacing buffer.
-	m_Font = new FontType[95];
+	m_Font = new FontType[FONT_GLYPH_COUNT];
 	if(!m_Font)
 	{
 		return false;
@@ -77,8 +82,25 @@ bool FontClass::LoadFontData(char* filename)
 		return false;
 	}
 
+	// A distance field font starts with a line giving the height its sizes are measured at and the padding round each glyph.
+	m_distanceField = false;
+	m_height = FONT_GLYPH_HEIGHT;
+	m_padding = 0.0f;
+
+	fin >> ws;
+	if(fin.peek() == 'd')
+	{
+		fin >> header >> m_height >> m_padding;
+		if(fin.fail() || (header != "distancefield"))
+		{
+			return false;
+		}
+
+		m_distanceField = true;
+	}
+
 	// Read in the 95 used ascii characters for text.
-	for(i=0; i<95; i++)
+	for(i=0; i<FONT_GLYPH_COUNT; i++)
 	{
 		fin.get(temp);
 		while(temp != ' ')
@@ -121,6 +143,18 @@ bool FontClass::LoadTexture(ID3D11Device* device, WCHAR* filename)
 	bool result;
 
 
+	// Without a device the text is being drawn by the software renderer, so keep the texture in system memory.
+	if(!device)
+	{
+		m_SoftwareTexture = new SoftwareTextureClass;
+		if(!m_SoftwareTexture)
+		{
+			return false;
+		}
+
+		return m_SoftwareTexture->Initialize(filename);
+	}
+
 	// Create the texture object.
 	m_Texture = new TextureClass;
 	if(!m_Texture)
@@ -149,6 +183,14 @@ void FontClass::ReleaseTexture()
 		m_Texture = 0;
 	}
 
+	// Release the software texture object.
+	if(m_SoftwareTexture)
+	{
+		m_SoftwareTexture->Shutdown();
+		delete m_SoftwareTexture;
+		m_SoftwareTexture = 0;
+	}
+
 	return;
 }
 
@@ -159,22 +201,62 @@ ID3D11ShaderResourceView* FontClass::GetTexture()
 }
 
 
-void FontClass::BuildVertexArray(void* vertices, char* sentence, float drawX, float drawY)
+SoftwareTextureClass* FontClass::GetSoftwareTexture()
+{
+	return m_SoftwareTexture;
+}
+
+
+void FontClass::GetGlyphMetrics(D3DXVECTOR4* metrics)
 {
-	VertexType* vertexPtr;
+	int i;
+
+
+	// Give each glyph its texture span and the size of its quad, which takes in the padding on every side.
+	for(i=0; i<FONT_GLYPH_COUNT; i++)
+	{
+		metrics[i] = D3DXVECTOR4(m_Font[i].left, m_Font[i].right, (float)m_Font[i].size + (2.0f * m_padding),
+			m_height + (2.0f * m_padding));
+	}
+
+	return;
+}
+
+
+bool FontClass::IsDistanceField()
+{
+	return m_distanceField;
+}
+
+
+float FontClass::GetHeight()
+{
+	return m_height;
+}
+
+
+int FontClass::BuildGlyphArray(void* glyphs, char* sentence, float drawX, float drawY, unsigned int color, int height)
+{
+	VertexType::Glyph* glyphPtr;
 	int numLetters, index, i, letter;
+	float scale;
+	unsigned int fixedScale;
 
 
-	// Coerce the input vertices into a VertexType structure.
-	vertexPtr = (VertexType*)vertices;
+	// Coerce the input glyphs into a VertexType::Glyph structure.
+	glyphPtr = (VertexType::Glyph*)glyphs;
 
 	// Get the number of letters in the sentence.
 	numLetters = (int)strlen(sentence);
 
-	// Initialize the index to the vertex array.
+	// Work out how much the glyphs are scaled from the height the font was made at, which goes to the shader as 8.8 fixed point.
+	scale = (float)height / m_height;
+	fixedScale = (unsigned int)(scale * 256.0f + 0.5f);
+
+	// Initialize the index to the glyph array.
 	index = 0;
 
-	// Draw each letter onto a quad.
+	// Write each letter as the top left corner of its quad, padding and all, and which glyph it is at what scale.
 	for(i=0; i<numLetters; i++)
 	{
 		letter = ((int)sentence[i]) - 32;
@@ -182,40 +264,20 @@ void FontClass::BuildVertexArray(void* vertices, char* sentence, float drawX, fl
 		// If the letter is a space then just move over three pixels.
 		if(letter == 0)
 		{
-			drawX = drawX + 3.0f;
+			drawX = drawX + (3.0f * scale);
 		}
 		else
 		{
-			// First triangle in quad.
-			vertexPtr[index].position = D3DXVECTOR3(drawX, drawY, 0.0f);  // Top left.
-			vertexPtr[index].texture = D3DXVECTOR2(m_Font[letter].left, 0.0f);
-			index++;
-
-			vertexPtr[index].position = D3DXVECTOR3((drawX + m_Font[letter].size), (drawY - 16), 0.0f);  // Bottom right.
-			vertexPtr[index].texture = D3DXVECTOR2(m_Font[letter].right, 1.0f);
-			index++;
-
-			vertexPtr[index].position = D3DXVECTOR3(drawX, (drawY - 16), 0.0f);  // Bottom left.
-			vertexPtr[index].texture = D3DXVECTOR2(m_Font[letter].left, 1.0f);
-			index++;
-
-			// Second triangle in quad.
-			vertexPtr[index].position = D3DXVECTOR3(drawX, drawY, 0.0f);  // Top left.
-			vertexPtr[index].texture = D3DXVECTOR2(m_Font[letter].left, 0.0f);
-			index++;
-
-			vertexPtr[index].position = D3DXVECTOR3(drawX + m_Font[letter].size, drawY, 0.0f);  // Top right.
-			vertexPtr[index].texture = D3DXVECTOR2(m_Font[letter].right, 0.0f);
-			index++;
-
-			vertexPtr[index].position = D3DXVECTOR3((drawX + m_Font[letter].size), (drawY - 16), 0.0f);  // Bottom right.
-			vertexPtr[index].texture = D3DXVECTOR2(m_Font[letter].right, 1.0f);
+			glyphPtr[index].position = D3DXVECTOR2(drawX - (m_padding * scale), drawY + (m_padding * scale));
+			glyphPtr[index].glyph = letter | (fixedScale << 16);
+			glyphPtr[index].color = color;
 			index++;
 
 			// Update the x location for drawing by the size of the letter and one pixel.
-			drawX = drawX + m_Font[letter].size + 1.0f;
+			drawX = drawX + ((m_Font[letter].size + 1.0f) * scale);
 		}
 	}
 
-	return;
+	// Spaces leave no glyph, so the count can be short of the letters.
+	return index;
 }
\ No newline at end of file
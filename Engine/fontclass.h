@@ -11,6 +11,7 @@
 #include <d3d11.h>
 #include <d3dx10math.h>
 #include <fstream>
+#include <string>
 using namespace std;
 
 
@@ -18,10 +19,33 @@ using namespace std;
 // MY CLASS INCLUDES //
 ///////////////////////
 #include "textureclass.h"
+#include "softwaretextureclass.h"
+#include "vertextypes.h"
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int FONT_GLYPH_COUNT = 95;
+const float FONT_GLYPH_HEIGHT = 16.0f;
 
 
 ////////////////////////////////////////////////////////////////////////////////
 // Class name: FontClass
+// Loads the glyph table and texture of a font, the printable ASCII
+// characters from space on.  Text is laid out as one compact record a glyph,
+// its pen position, which glyph at what scale and its color, and the shader
+// builds the quad from the glyph's metrics.
+//
+// A plain font data file describes a bitmap font FONT_GLYPH_HEIGHT pixels
+// high, which only looks right at that height.  The ConvertFont tool writes
+// a distance field atlas instead, and starts its data file with a
+// "distancefield <height> <padding>" line giving the height the glyph sizes
+// are measured at and the border of distance kept around every glyph.  Such
+// a font can be drawn at any height from the one atlas.
+//
+// Without a device the texture is kept in system memory for the software
+// renderer.
 ////////////////////////////////////////////////////////////////////////////////
 class FontClass
 {
@@ -32,12 +56,6 @@ private:
 		int size;
 	};
 
-	struct VertexType
-	{
-		D3DXVECTOR3 position;
-	    D3DXVECTOR2 texture;
-	};
-
 public:
 	FontClass();
 	FontClass(const FontClass&);
@@ -47,8 +65,13 @@ public:
 	void Shutdown();
 
 	ID3D11ShaderResourceView* GetTexture();
+	SoftwareTextureClass* GetSoftwareTexture();
+	void GetGlyphMetrics(D3DXVECTOR4*);
+
+	bool IsDistanceField();
+	float GetHeight();
 
-	void BuildVertexArray(void*, char*, float, float);
+	int BuildGlyphArray(void*, char*, float, float, unsigned int, int);
 
 private:
 	bool LoadFontData(char*);
@@ -59,6 +82,9 @@ private:
 private:
 	FontType* m_Font;
 	TextureClass* m_Texture;
+	SoftwareTextureClass* m_SoftwareTexture;
+	bool m_distanceField;
+	float m_height, m_padding;
 };
 
 #endif
\ No newline at end of file
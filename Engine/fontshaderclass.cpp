@@ -6,12 +6,13 @@
 
 FontShaderClass::FontShaderClass()
 {
+	m_PipelineState = 0;
 	m_vertexShader = 0;
 	m_pixelShader = 0;
 	m_layout = 0;
 	m_constantBuffer = 0;
+	m_glyphBuffer = 0;
 	m_sampleState = 0;
-	m_pixelBuffer = 0;
 }
 
 
@@ -25,13 +26,17 @@ FontShaderClass::~FontShaderClass()
 }
 
 
-bool FontShaderClass::Initialize(ID3D11Device* device, HWND hwnd)
+bool FontShaderClass::Initialize(ID3D11Device* device, PipelineStateClass* pipelineState, HWND hwnd, D3DXVECTOR4* glyphMetrics,
+								 bool distanceField)
 {
 	bool result;
 
 
+	// Store the pipeline state object that state is shared and bound through.
+	m_PipelineState = pipelineState;
+
 	// Initialize the vertex and pixel shaders.
-	result = InitializeShader(device, hwnd, L"../Engine/font.vs", L"../Engine/font.ps");
+	result = InitializeShader(device, hwnd, L"../Engine/font.vs", L"../Engine/font.ps", glyphMetrics, distanceField);
 	if(!result)
 	{
 		return false;
@@ -50,37 +55,38 @@ void FontShaderClass::Shutdown()
 }
 
 
-bool FontShaderClass::Render(ID3D11DeviceContext* deviceContext, int indexCount, D3DXMATRIX worldMatrix, D3DXMATRIX viewMatrix, 
-							 D3DXMATRIX projectionMatrix, ID3D11ShaderResourceView* texture, D3DXVECTOR4 pixelColor)
+bool FontShaderClass::Render(ID3D11DeviceContext* deviceContext, int glyphCount, D3DXMATRIX worldMatrix, D3DXMATRIX viewMatrix, 
+							 D3DXMATRIX projectionMatrix, ID3D11ShaderResourceView* texture)
 {
 	bool result;
 
 
 	// Set the shader parameters that it will use for rendering.
-	result = SetShaderParameters(deviceContext, worldMatrix, viewMatrix, projectionMatrix, texture, pixelColor);
+	result = SetShaderParameters(deviceContext, worldMatrix, viewMatrix, projectionMatrix, texture);
 	if(!result)
 	{
 		return false;
 	}
 
-	// Now render the prepared buffers with the shader.
-	RenderShader(deviceContext, indexCount);
+	// Now render the glyphs with the shader.
+	RenderShader(deviceContext, glyphCount);
 
 	return true;
 }
 
 
-bool FontShaderClass::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* vsFilename, WCHAR* psFilename)
+bool FontShaderClass::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* vsFilename, WCHAR* psFilename, D3DXVECTOR4* glyphMetrics,
+									   bool distanceField)
 {
 	HRESULT result;
 	ID3D10Blob* errorMessage;
 	ID3D10Blob* vertexShaderBuffer;
 	ID3D10Blob* pixelShaderBuffer;
-	D3D11_INPUT_ELEMENT_DESC polygonLayout[2];
+	D3D11_INPUT_ELEMENT_DESC polygonLayout[3];
 	unsigned int numElements;
-	D3D11_BUFFER_DESC constantBufferDesc;
+	D3D11_BUFFER_DESC constantBufferDesc, glyphBufferDesc;
+	D3D11_SUBRESOURCE_DATA glyphData;
     D3D11_SAMPLER_DESC samplerDesc;
-	D3D11_BUFFER_DESC pixelBufferDesc;
 
 
 	// Initialize the pointers this function will use to null.
@@ -107,9 +113,9 @@ bool FontShaderClass::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* v
 		return false;
 	}
 
-    // Compile the pixel shader code.
-	result = D3DX11CompileFromFile(psFilename, NULL, NULL, "FontPixelShader", "ps_5_0", D3D10_SHADER_ENABLE_STRICTNESS, 0, NULL, 
-								   &pixelShaderBuffer, &errorMessage, NULL);
+    // Compile the pixel shader code, picking the one that reads the atlas the way the font was made.
+	result = D3DX11CompileFromFile(psFilename, NULL, NULL, distanceField ? "FontDistancePixelShader" : "FontPixelShader", "ps_5_0",
+								   D3D10_SHADER_ENABLE_STRICTNESS, 0, NULL, &pixelShaderBuffer, &errorMessage, NULL);
 	if(FAILED(result))
 	{
 		// If the shader failed to compile it should have writen something to the error message.
@@ -142,23 +148,31 @@ bool FontShaderClass::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* v
 		return false;
 	}
 
-	// Create the vertex input layout description.
-	// This setup needs to match the VertexType stucture in the ModelClass and in the shader.
+	// Create the glyph input layout description, which steps once for each instance rather than each vertex.
+	// This setup needs to match the VertexType::Glyph structure and the shader.
 	polygonLayout[0].SemanticName = "POSITION";
 	polygonLayout[0].SemanticIndex = 0;
-	polygonLayout[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+	polygonLayout[0].Format = DXGI_FORMAT_R32G32_FLOAT;
 	polygonLayout[0].InputSlot = 0;
 	polygonLayout[0].AlignedByteOffset = 0;
-	polygonLayout[0].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	polygonLayout[0].InstanceDataStepRate = 0;
+	polygonLayout[0].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+	polygonLayout[0].InstanceDataStepRate = 1;
 
 	polygonLayout[1].SemanticName = "TEXCOORD";
 	polygonLayout[1].SemanticIndex = 0;
-	polygonLayout[1].Format = DXGI_FORMAT_R32G32_FLOAT;
+	polygonLayout[1].Format = DXGI_FORMAT_R32_UINT;
 	polygonLayout[1].InputSlot = 0;
 	polygonLayout[1].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-	polygonLayout[1].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	polygonLayout[1].InstanceDataStepRate = 0;
+	polygonLayout[1].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+	polygonLayout[1].InstanceDataStepRate = 1;
+
+	polygonLayout[2].SemanticName = "COLOR";
+	polygonLayout[2].SemanticIndex = 0;
+	polygonLayout[2].Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	polygonLayout[2].InputSlot = 0;
+	polygonLayout[2].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
+	polygonLayout[2].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+	polygonLayout[2].InstanceDataStepRate = 1;
 
 	// Get a count of the elements in the layout.
     numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
@@ -193,6 +207,25 @@ bool FontShaderClass::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* v
 		return false;
 	}
 
+	// Setup the description of the glyph metrics buffer, which never changes once the font is loaded.
+	glyphBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	glyphBufferDesc.ByteWidth = sizeof(D3DXVECTOR4) * FONT_GLYPH_COUNT;
+	glyphBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	glyphBufferDesc.CPUAccessFlags = 0;
+	glyphBufferDesc.MiscFlags = 0;
+	glyphBufferDesc.StructureByteStride = 0;
+
+	// Give the subresource structure a pointer to the glyph metrics.
+	glyphData.pSysMem = glyphMetrics;
+	glyphData.SysMemPitch = 0;
+	glyphData.SysMemSlicePitch = 0;
+
+	result = device->CreateBuffer(&glyphBufferDesc, &glyphData, &m_glyphBuffer);
+	if(FAILED(result))
+	{
+		return false;
+	}
+
 	// Create a texture sampler state description.
     samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
     samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
@@ -208,24 +241,9 @@ bool FontShaderClass::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* v
     samplerDesc.MinLOD = 0;
     samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
 
-	// Create the texture sampler state.
-    result = device->CreateSamplerState(&samplerDesc, &m_sampleState);
-	if(FAILED(result))
-	{
-		return false;
-	}
-
-    // Setup the description of the dynamic pixel constant buffer that is in the pixel shader.
-    pixelBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	pixelBufferDesc.ByteWidth = sizeof(PixelBufferType);
-    pixelBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    pixelBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    pixelBufferDesc.MiscFlags = 0;
-	pixelBufferDesc.StructureByteStride = 0;
-
-	// Create the pixel constant buffer pointer so we can access the pixel shader constant buffer from within this class.
-	result = device->CreateBuffer(&pixelBufferDesc, NULL, &m_pixelBuffer);
-	if(FAILED(result))
+	// Get the texture sampler state from the cache, which shares it with any other shader that asks for the same one.
+    m_sampleState = m_PipelineState->GetSamplerState(&samplerDesc);
+	if(!m_sampleState)
 	{
 		return false;
 	}
@@ -236,19 +254,16 @@ bool FontShaderClass::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* v
 
 void FontShaderClass::ShutdownShader()
 {
-	// Release the pixel constant buffer.
-	if(m_pixelBuffer)
+	// Release the glyph metrics buffer.
+	if(m_glyphBuffer)
 	{
-		m_pixelBuffer->Release();
-		m_pixelBuffer = 0;
+		m_glyphBuffer->Release();
+		m_glyphBuffer = 0;
 	}
 
-	// Release the sampler state.
-	if(m_sampleState)
-	{
-		m_sampleState->Release();
-		m_sampleState = 0;
-	}
+	// The sampler state belongs to the pipeline state cache.
+	m_sampleState = 0;
+	m_PipelineState = 0;
 
 	// Release the constant buffer.
 	if(m_constantBuffer)
@@ -319,13 +334,12 @@ void FontShaderClass::OutputShaderErrorMessage(ID3D10Blob* errorMessage, HWND hw
 
 
 bool FontShaderClass::SetShaderParameters(ID3D11DeviceContext* deviceContext, D3DXMATRIX worldMatrix, D3DXMATRIX viewMatrix, 
-										  D3DXMATRIX projectionMatrix, ID3D11ShaderResourceView* texture, D3DXVECTOR4 pixelColor)
+										  D3DXMATRIX projectionMatrix, ID3D11ShaderResourceView* texture)
 {
 	HRESULT result;
     D3D11_MAPPED_SUBRESOURCE mappedResource;
 	ConstantBufferType* dataPtr;
 	unsigned int bufferNumber;
-	PixelBufferType* dataPtr2;
 
 
 	// Lock the constant buffer so it can be written to.
@@ -355,51 +369,32 @@ bool FontShaderClass::SetShaderParameters(ID3D11DeviceContext* deviceContext, D3
 	bufferNumber = 0;
 
 	// Now set the constant buffer in the vertex shader with the updated values.
-    deviceContext->VSSetConstantBuffers(bufferNumber, 1, &m_constantBuffer);
+    m_PipelineState->SetVSConstantBuffer(bufferNumber, m_constantBuffer);
 
-	// Set shader texture resource in the pixel shader.
-	deviceContext->PSSetShaderResources(0, 1, &texture);
+	// Set the glyph metrics after it, for the vertex shader to build the quads with.
+	m_PipelineState->SetVSConstantBuffer(1, m_glyphBuffer);
 
-	// Lock the pixel constant buffer so it can be written to.
-	result = deviceContext->Map(m_pixelBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	if(FAILED(result))
-	{
-		return false;
-	}
-
-	// Get a pointer to the data in the pixel constant buffer.
-	dataPtr2 = (PixelBufferType*)mappedResource.pData;
-
-	// Copy the pixel color into the pixel constant buffer.
-	dataPtr2->pixelColor = pixelColor;
-
-	// Unlock the pixel constant buffer.
-    deviceContext->Unmap(m_pixelBuffer, 0);
-
-	// Set the position of the pixel constant buffer in the pixel shader.
-	bufferNumber = 0;
-
-	// Now set the pixel constant buffer in the pixel shader with the updated value.
-    deviceContext->PSSetConstantBuffers(bufferNumber, 1, &m_pixelBuffer);
+	// Set shader texture resource in the pixel shader.
+	m_PipelineState->SetPSShaderResource(0, texture);
 
 	return true;
 }
 
 
-void FontShaderClass::RenderShader(ID3D11DeviceContext* deviceContext, int indexCount)
+void FontShaderClass::RenderShader(ID3D11DeviceContext* deviceContext, int glyphCount)
 {
 	// Set the vertex input layout.
-	deviceContext->IASetInputLayout(m_layout);
+	m_PipelineState->SetInputLayout(m_layout);
 
     // Set the vertex and pixel shaders that will be used to render the triangles.
-    deviceContext->VSSetShader(m_vertexShader, NULL, 0);
-    deviceContext->PSSetShader(m_pixelShader, NULL, 0);
+    m_PipelineState->SetVertexShader(m_vertexShader);
+    m_PipelineState->SetPixelShader(m_pixelShader);
 
 	// Set the sampler state in the pixel shader.
-	deviceContext->PSSetSamplers(0, 1, &m_sampleState);
+	m_PipelineState->SetPSSampler(0, m_sampleState);
 
-	// Render the triangles.
-	deviceContext->DrawIndexed(indexCount, 0, 0);
+	// Render the six corners of a quad once for each glyph.
+	deviceContext->DrawInstanced(6, glyphCount, 0, 0);
 
 	return;
 }
\ No newline at end of file
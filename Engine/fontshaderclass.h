@@ -15,8 +15,22 @@
 using namespace std;
 
 
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "pipelinestateclass.h"
+#include "fontclass.h"
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Class name: FontShaderClass
+// Draws text as one instance a glyph.  Each instance is the glyph's 16 byte
+// record from FontClass, and the vertex shader expands it into the six
+// corners of a quad with the glyph metrics it keeps in a constant buffer,
+// so nothing per corner is ever uploaded.  The color comes with the glyph
+// rather than from a constant buffer, so text of any number of colors can
+// go out in one draw.  Distance field fonts use their own pixel shader,
+// which finds the glyph's edge from the distance in the atlas.
 ////////////////////////////////////////////////////////////////////////////////
 class FontShaderClass
 {
@@ -28,35 +42,31 @@ private:
 		D3DXMATRIX projection;
 	};
 
-	struct PixelBufferType
-	{
-		D3DXVECTOR4 pixelColor;
-	};
-
 public:
 	FontShaderClass();
 	FontShaderClass(const FontShaderClass&);
 	~FontShaderClass();
 
-	bool Initialize(ID3D11Device*, HWND);
+	bool Initialize(ID3D11Device*, PipelineStateClass*, HWND, D3DXVECTOR4*, bool);
 	void Shutdown();
-	bool Render(ID3D11DeviceContext*, int, D3DXMATRIX, D3DXMATRIX, D3DXMATRIX, ID3D11ShaderResourceView*, D3DXVECTOR4);
+	bool Render(ID3D11DeviceContext*, int, D3DXMATRIX, D3DXMATRIX, D3DXMATRIX, ID3D11ShaderResourceView*);
 
 private:
-	bool InitializeShader(ID3D11Device*, HWND, WCHAR*, WCHAR*);
+	bool InitializeShader(ID3D11Device*, HWND, WCHAR*, WCHAR*, D3DXVECTOR4*, bool);
 	void ShutdownShader();
 	void OutputShaderErrorMessage(ID3D10Blob*, HWND, WCHAR*);
 
-	bool SetShaderParameters(ID3D11DeviceContext*, D3DXMATRIX, D3DXMATRIX, D3DXMATRIX, ID3D11ShaderResourceView*, D3DXVECTOR4);
+	bool SetShaderParameters(ID3D11DeviceContext*, D3DXMATRIX, D3DXMATRIX, D3DXMATRIX, ID3D11ShaderResourceView*);
 	void RenderShader(ID3D11DeviceContext*, int);
 
 private:
+	PipelineStateClass* m_PipelineState;
 	ID3D11VertexShader* m_vertexShader;
 	ID3D11PixelShader* m_pixelShader;
 	ID3D11InputLayout* m_layout;
 	ID3D11Buffer* m_constantBuffer;
+	ID3D11Buffer* m_glyphBuffer;
 	ID3D11SamplerState* m_sampleState;
-	ID3D11Buffer* m_pixelBuffer;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,218 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: frameallocatorclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "frameallocatorclass.h"
+
+
+bool FrameAllocatorClass::m_initialized = false;
+int FrameAllocatorClass::m_generation = 0;
+atomic<int> FrameAllocatorClass::m_frame(0);
+__declspec(thread) FrameAllocatorClass::ArenaType* FrameAllocatorClass::m_threadArena = 0;
+__declspec(thread) int FrameAllocatorClass::m_threadGeneration = 0;
+FrameAllocatorClass::ArenaType* FrameAllocatorClass::m_arenas[FRAME_ALLOCATOR_MAX_THREADS];
+atomic<int> FrameAllocatorClass::m_arenaCount(0);
+atomic<int> FrameAllocatorClass::m_heapAllocations(0);
+int FrameAllocatorClass::m_frameHeapAllocations = 0;
+
+
+bool FrameAllocatorClass::Initialize()
+{
+	int i;
+
+
+	if(m_initialized)
+	{
+		return true;
+	}
+
+	for(i=0; i<FRAME_ALLOCATOR_MAX_THREADS; i++)
+	{
+		m_arenas[i] = 0;
+	}
+
+	m_arenaCount = 0;
+	m_frameHeapAllocations = 0;
+
+	// Blocks from an earlier run are gone, so threads must make new ones.
+	m_generation++;
+	m_initialized = true;
+
+	return true;
+}
+
+
+void FrameAllocatorClass::Shutdown()
+{
+	int i;
+
+
+	// Nothing may be allocating any more when the blocks are released.
+	m_initialized = false;
+
+	for(i=0; i<FRAME_ALLOCATOR_MAX_THREADS; i++)
+	{
+		if(m_arenas[i])
+		{
+			// With no capacity the reset only releases the overflow, without growing the block.
+			m_arenas[i]->capacity = 0;
+			ResetArena(m_arenas[i]);
+			delete [] m_arenas[i]->memory;
+			delete m_arenas[i];
+			m_arenas[i] = 0;
+		}
+	}
+
+	m_arenaCount = 0;
+
+	return;
+}
+
+
+void* FrameAllocatorClass::Allocate(unsigned int size)
+{
+	ArenaType* arena;
+	char* block;
+	unsigned int offset;
+
+
+	arena = GetThreadArena();
+	if(!arena)
+	{
+		return 0;
+	}
+
+	// The first allocation of a new frame rewinds the block, since nothing from the last frame is in use any more.
+	if(arena->frame != m_frame.load(memory_order_relaxed))
+	{
+		ResetArena(arena);
+	}
+
+	// Take the next aligned piece of the block if it fits.
+	offset = (arena->used + FRAME_ALLOCATOR_ALIGNMENT - 1) & ~(FRAME_ALLOCATOR_ALIGNMENT - 1);
+	if(offset + size <= arena->capacity)
+	{
+		arena->used = offset + size;
+		return arena->memory + offset;
+	}
+
+	// Otherwise get it from the heap, with room in front to chain it to the others for release.
+	MEMORY_TAG(MemoryTrackerClass::TAG_TRANSIENT);
+	block = new char[FRAME_ALLOCATOR_ALIGNMENT + size];
+	if(!block)
+	{
+		return 0;
+	}
+
+	*(char**)block = arena->overflow;
+	arena->overflow = block;
+	arena->overflowBytes += FRAME_ALLOCATOR_ALIGNMENT + size;
+
+	return block + FRAME_ALLOCATOR_ALIGNMENT;
+}
+
+
+void FrameAllocatorClass::EndFrame()
+{
+	// Start a new frame, and keep the number of heap allocations the last one made.
+	m_frame++;
+	m_frameHeapAllocations = m_heapAllocations.exchange(0);
+
+	return;
+}
+
+
+void FrameAllocatorClass::CountHeapAllocation()
+{
+	m_heapAllocations.fetch_add(1, memory_order_relaxed);
+}
+
+
+int FrameAllocatorClass::GetHeapAllocations()
+{
+	return m_frameHeapAllocations;
+}
+
+
+FrameAllocatorClass::ArenaType* FrameAllocatorClass::GetThreadArena()
+{
+	ArenaType* arena;
+	int thread;
+
+
+	if(!m_initialized)
+	{
+		return 0;
+	}
+
+	if(m_threadGeneration == m_generation)
+	{
+		return m_threadArena;
+	}
+
+	// The first allocation on a thread claims a slot for its block.  A thread past the last slot cannot allocate.
+	m_threadArena = 0;
+	m_threadGeneration = m_generation;
+
+	thread = m_arenaCount.fetch_add(1);
+	if(thread >= FRAME_ALLOCATOR_MAX_THREADS)
+	{
+		return 0;
+	}
+
+	MEMORY_TAG(MemoryTrackerClass::TAG_TRANSIENT);
+	arena = new ArenaType;
+	if(!arena)
+	{
+		return 0;
+	}
+
+	arena->memory = new char[FRAME_ALLOCATOR_SIZE];
+	if(!arena->memory)
+	{
+		delete arena;
+		return 0;
+	}
+
+	arena->capacity = FRAME_ALLOCATOR_SIZE;
+	arena->used = 0;
+	arena->overflowBytes = 0;
+	arena->overflow = 0;
+	arena->frame = m_frame;
+
+	m_arenas[thread] = arena;
+	m_threadArena = arena;
+
+	return arena;
+}
+
+
+void FrameAllocatorClass::ResetArena(ArenaType* arena)
+{
+	char* block;
+	unsigned int size;
+
+
+	// Release the heap blocks the frame overflowed into.
+	while(arena->overflow)
+	{
+		block = arena->overflow;
+		arena->overflow = *(char**)block;
+		delete [] block;
+	}
+
+	// Grow the block to hold all of a frame that overflowed, so the next one like it fits.
+	size = arena->used + arena->overflowBytes;
+	if((arena->overflowBytes > 0) && (arena->capacity > 0))
+	{
+		MEMORY_TAG(MemoryTrackerClass::TAG_TRANSIENT);
+		delete [] arena->memory;
+		arena->memory = new char[size];
+		arena->capacity = arena->memory ? size : 0;
+	}
+
+	arena->used = 0;
+	arena->overflowBytes = 0;
+	arena->frame = m_frame;
+
+	return;
+}
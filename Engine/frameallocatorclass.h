@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: frameallocatorclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _FRAMEALLOCATORCLASS_H_
+#define _FRAMEALLOCATORCLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <windows.h>
+#include <atomic>
+using namespace std;
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "memorytrackerclass.h"
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int FRAME_ALLOCATOR_MAX_THREADS = 64;
+const int FRAME_ALLOCATOR_SIZE = 262144;
+const int FRAME_ALLOCATOR_ALIGNMENT = 16;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: FrameAllocatorClass
+// Hands out memory that only has to last until the end of the frame, for the
+// arrays hot paths used to new and delete every time they ran.  Each thread
+// allocates from its own block by moving an offset forward, found through a
+// thread local pointer, so allocating never takes a lock and nothing is ever
+// freed on its own.  EndFrame on the main thread starts a new frame, and each
+// thread's block is rewound the next time that thread allocates, so it must
+// be called while no job that allocates is running, or a job could have its
+// own earlier allocations handed out again under it.
+//
+// An allocation that does not fit in the block comes from the heap and is
+// released when the block is rewound, and the block then grows to hold the
+// whole of the frame that overflowed, so after the first few frames a steady
+// frame makes no heap allocations for transient memory at all.
+//
+// In the game's builds with ENGINE_PROFILE defined the memory tracker counts
+// every heap allocation here, and GetHeapAllocations reports how many the
+// last frame made, which should be zero once the frame is steady.
+////////////////////////////////////////////////////////////////////////////////
+class FrameAllocatorClass
+{
+private:
+	// A thread's block, how far into it this frame has allocated, and the heap blocks that did not fit.
+	struct ArenaType
+	{
+		char* memory;
+		unsigned int capacity;
+		unsigned int used;
+		unsigned int overflowBytes;
+		char* overflow;
+		int frame;
+	};
+
+public:
+	static bool Initialize();
+	static void Shutdown();
+
+	static void* Allocate(unsigned int);
+	static void EndFrame();
+
+	static void CountHeapAllocation();
+	static int GetHeapAllocations();
+
+private:
+	static ArenaType* GetThreadArena();
+	static void ResetArena(ArenaType*);
+
+private:
+	static bool m_initialized;
+	static int m_generation;
+	static atomic<int> m_frame;
+	static __declspec(thread) ArenaType* m_threadArena;
+	static __declspec(thread) int m_threadGeneration;
+	static ArenaType* m_arenas[FRAME_ALLOCATOR_MAX_THREADS];
+	static atomic<int> m_arenaCount;
+	static atomic<int> m_heapAllocations;
+	static int m_frameHeapAllocations;
+};
+
+#endif
@@ -6,6 +6,9 @@
 
 GraphicsClass::GraphicsClass()
 {
+	int i;
+
+
 	m_D3D = 0;
 	m_Camera = 0;
 	m_Models = 0;
@@ -14,8 +17,42 @@ GraphicsClass::GraphicsClass()
 	m_Light = 0;
     m_Bitmaps = 0;
 	m_Buffers = 0;
+	m_Software = 0;
 	m_ModelIndices = 0;
-	m_Textures = 0;
+	m_ModelBounds = 0;
+	m_ModelProxies = 0;
+	m_ModelOccluders = 0;
+	m_WorldMinimums = 0;
+	m_WorldMaximums = 0;
+	m_VisibleModels = 0;
+	m_ModelLevels = 0;
+	m_TextureArrays = 0;
+	m_ModelTextures = 0;
+	m_SoftwareTextures = 0;
+	m_ThreadPool = 0;
+	m_Culling = 0;
+	m_SpatialTree = 0;
+	m_Occlusion = 0;
+	m_Lod = 0;
+	m_Text = 0;
+	m_profileLines = 0;
+	m_profileCounter = 0;
+	for(i=0; i<PROFILE_LINE_COUNT; i++)
+	{
+		m_profileTexts[i] = HANDLE_INVALID;
+	}
+	m_showProfile = false;
+	m_Snapshots = 0;
+	m_pipelineDepth = 1;
+	m_framesPrepared = 0;
+	m_framesSubmitted = 0;
+	m_prepareSnapshot = 0;
+	m_DrawQueue = 0;
+	m_LightDraws = 0;
+	m_SpriteBatch = 0;
+	m_Sprites = 0;
+	m_SpriteDraws = 0;
+	m_drawCalls = 0;
 }
 
 
@@ -31,13 +68,18 @@ GraphicsClass::~GraphicsClass()
 
 bool GraphicsClass::Initialize(int screenWidth, int screenHeight, HWND hwnd)
 {
+	D3DXMATRIX baseViewMatrix;
 	bool result;
+	int i;
 
     m_screenWidth = screenWidth;
     m_screenHeight = screenHeight;
 
 	m_ModelIndices = new vector<int>;
-	m_Textures = new vector<ID3D11ShaderResourceView*>;
+	m_ModelBounds = new vector<ModelBoundsType>;
+	m_ModelProxies = new vector<int>;
+	m_ModelOccluders = new vector<int>;
+	m_ModelTextures = new vector<int>;
 
 	// Create the Direct3D object.
 	m_D3D = new D3DClass;
@@ -63,6 +105,26 @@ bool GraphicsClass::Initialize(int screenWidth, int screenHeight, HWND hwnd)
 
 	m_Buffers->Initialize(m_D3D);
 
+	// Create the texture arrays the model textures are grouped into.
+	m_TextureArrays = new TextureArrayClass;
+	if(!m_TextureArrays)
+	{
+		return false;
+	}
+
+	result = m_TextureArrays->Initialize(m_D3D->GetDevice(), m_D3D->GetDeviceContext());
+	if(!result)
+	{
+		return false;
+	}
+
+	// Create the worker threads and a command list for each of them.
+	result = InitializeCommandLists(-1);
+	if(!result)
+	{
+		return false;
+	}
+
 	// Create the camera object.
 	m_Camera = new CameraClass;
 	if(!m_Camera)
@@ -74,12 +136,18 @@ bool GraphicsClass::Initialize(int screenWidth, int screenHeight, HWND hwnd)
 	m_Camera->SetPosition(0.0f, 0.0f, -1.0f);
     m_Camera->SetRotation(0.0f, 0.0f, 0.0f);
 	
-	// Create the model object.
-	m_Models = new unordered_map<string, ModelClass*>;
+	// Create the model table.
+	m_Models = new HandleTableClass;
 	if(!m_Models)
 	{
 		return false;
 	}
+
+	result = m_Models->Initialize();
+	if(!result)
+	{
+		return false;
+	}
     
 	// Create the light shader object.
 	m_LightShader = new LightShaderClass;
@@ -89,7 +157,7 @@ bool GraphicsClass::Initialize(int screenWidth, int screenHeight, HWND hwnd)
 	}
 
     // Initialize the light shader object.
-	result = m_LightShader->Initialize(m_D3D->GetDevice(), hwnd);
+	result = m_LightShader->Initialize(m_D3D->GetDevice(), m_D3D->GetPipelineState(), m_D3D->GetConstantAllocator(), hwnd);
 	if(!result)
 	{
 		MessageBox(hwnd, L"Could not initialize the light shader object.", L"Error", MB_OK);
@@ -104,12 +172,46 @@ bool GraphicsClass::Initialize(int screenWidth, int screenHeight, HWND hwnd)
     }
     
     // Initialize the texture shader object.
-    result = m_TextureShader->Initialize(m_D3D->GetDevice(), hwnd, L"../engine/texture.vs", L"../engine/texture.ps");
+    result = m_TextureShader->Initialize(m_D3D->GetDevice(), m_D3D->GetPipelineState(), hwnd, L"../engine/texture.vs", L"../engine/texture.ps");
     if (!result)
     {
         MessageBox(hwnd, L"Could not initialize the texture shader object.", L"Error", MB_OK);
 		return false;
     }
+
+	// Create the text object the profiler summary is drawn with.
+	m_Text = new TextClass;
+	if(!m_Text)
+	{
+		return false;
+	}
+
+	m_profileLines = new vector<string>;
+	if(!m_profileLines)
+	{
+		return false;
+	}
+
+	// Initialize the text object with the camera's starting view, which the text stays fixed to.
+	m_Camera->Render();
+	m_Camera->GetViewMatrix(baseViewMatrix);
+
+	result = m_Text->Initialize(m_D3D->GetDevice(), m_D3D->GetPipelineState(), hwnd, screenWidth, screenHeight, baseViewMatrix);
+	if(!result)
+	{
+		MessageBox(hwnd, L"Could not initialize the text object.", L"Error", MB_OK);
+		return false;
+	}
+
+	// Create a text object for each line of the profiler summary, kept for as long as the text object is.
+	for(i=0; i<PROFILE_LINE_COUNT; i++)
+	{
+		m_profileTexts[i] = m_Text->CreateText();
+		if(m_profileTexts[i] == HANDLE_INVALID)
+		{
+			return false;
+		}
+	}
     
 	// Create the light object.
 	m_Light = new LightClass;
@@ -118,12 +220,18 @@ bool GraphicsClass::Initialize(int screenWidth, int screenHeight, HWND hwnd)
 		return false;
 	}
     
-    // Create the bitmap object.
-	m_Bitmaps = new unordered_map<string, BitmapClass*>;
+	// Create the bitmap table.
+	m_Bitmaps = new HandleTableClass;
 	if(!m_Bitmaps)
 	{
 		return false;
 	}
+
+	result = m_Bitmaps->Initialize();
+	if(!result)
+	{
+		return false;
+	}
     
 	// Initialize the light object.
     m_Light->SetAmbientColor(0.2f, 0.2f, 0.2f, 1.0f);
@@ -135,82 +243,428 @@ bool GraphicsClass::Initialize(int screenWidth, int screenHeight, HWND hwnd)
 	return true;
 }
 
-string GraphicsClass::LoadModelResource(char* meshPath, WCHAR* texturePath)
+bool GraphicsClass::InitializeHeadless(int screenWidth, int screenHeight, int threadCount)
+{
+	D3DXMATRIX baseViewMatrix;
+	bool result;
+	int i;
+
+    m_screenWidth = screenWidth;
+    m_screenHeight = screenHeight;
+
+	m_ModelIndices = new vector<int>;
+	m_ModelBounds = new vector<ModelBoundsType>;
+	m_ModelProxies = new vector<int>;
+	m_ModelOccluders = new vector<int>;
+	m_SoftwareTextures = new vector<SoftwareTextureClass*>;
+
+	// Create the worker threads and a command list for each of them.  A negative count uses one thread per core.
+	result = InitializeCommandLists(threadCount);
+	if(!result)
+	{
+		return false;
+	}
+
+	// Create the software renderer in place of the Direct3D object.
+	m_Software = new SoftwareRendererClass;
+	if(!m_Software)
+	{
+		return false;
+	}
+
+	// Initialize the software renderer on the same threads.
+	result = m_Software->Initialize(screenWidth, screenHeight, SCREEN_DEPTH, SCREEN_NEAR, m_ThreadPool);
+	if(!result)
+	{
+		return false;
+	}
+
+	// Create the camera object.
+	m_Camera = new CameraClass;
+	if(!m_Camera)
+	{
+		return false;
+	}
+
+	// Set the initial position of the camera.
+	m_Camera->SetPosition(0.0f, 0.0f, -1.0f);
+    m_Camera->SetRotation(0.0f, 0.0f, 0.0f);
+
+	// Create the model table.
+	m_Models = new HandleTableClass;
+	if(!m_Models)
+	{
+		return false;
+	}
+
+	result = m_Models->Initialize();
+	if(!result)
+	{
+		return false;
+	}
+
+	// Create the text object the profiler summary is drawn with, which the software renderer draws without a device.
+	m_Text = new TextClass;
+	if(!m_Text)
+	{
+		return false;
+	}
+
+	m_profileLines = new vector<string>;
+	if(!m_profileLines)
+	{
+		return false;
+	}
+
+	// Initialize the text object with the camera's starting view, which the text stays fixed to.
+	m_Camera->Render();
+	m_Camera->GetViewMatrix(baseViewMatrix);
+
+	result = m_Text->Initialize(0, 0, 0, screenWidth, screenHeight, baseViewMatrix);
+	if(!result)
+	{
+		return false;
+	}
+
+	// Create a text object for each line of the profiler summary.
+	for(i=0; i<PROFILE_LINE_COUNT; i++)
+	{
+		m_profileTexts[i] = m_Text->CreateText();
+		if(m_profileTexts[i] == HANDLE_INVALID)
+		{
+			return false;
+		}
+	}
+
+	// Create the light object.
+	m_Light = new LightClass;
+	if(!m_Light)
+	{
+		return false;
+	}
+
+	// Create the bitmap table.
+	m_Bitmaps = new HandleTableClass;
+	if(!m_Bitmaps)
+	{
+		return false;
+	}
+
+	result = m_Bitmaps->Initialize();
+	if(!result)
+	{
+		return false;
+	}
+
+	// Initialize the light object.
+    m_Light->SetAmbientColor(0.2f, 0.2f, 0.2f, 1.0f);
+    m_Light->SetDiffuseColor(1.0f, 1.0f, 1.0f, 1.0f);
+	m_Light->SetDirection(0.8f, -1.0f, 0.1f);
+	m_Light->SetSpecularColor(0.85f, 1.0f, 0.98f, 1.0f);
+	m_Light->SetSpecularPower(32.0f);
+
+	return true;
+}
+
+GraphicsClass::ModelHandleType GraphicsClass::LoadModelResource(char* meshPath, WCHAR* texturePath, bool occluder)
 {
     ModelClass* model;
-    UUID uuid;
-    char* cuuid;
-    string suuid;
+	ModelHandleType handle;
+	int indexStart;
 
-    // Create the bitmap resource
+	// Models are appended to the end of the shared vertex data, wherever it lives
+	indexStart = m_Software ? m_Software->GetIndexCount() : m_Buffers->GetDynamicIndexCount();
+
+    // Create the bitmap resource.  With Direct3D the texture goes into a texture array instead of the model.
     model = new ModelClass();
-    if (!model->Initialize(m_D3D->GetDevice(), meshPath, texturePath, m_Buffers->GetDynamicIndexCount()))
+    if (!model->Initialize(m_D3D ? m_D3D->GetDevice() : 0, meshPath, m_Software ? texturePath : 0, indexStart))
     {
-		return "error";
+		model->Shutdown();
+		delete model;
+		handle.value = HANDLE_INVALID;
+		return handle;
     }
 
+	return AddModel(model, texturePath, occluder);
+}
+
+bool GraphicsClass::LoadModelResources(int count, char** meshPaths, WCHAR** texturePaths, vector<ModelHandleType>& handles)
+{
+	vector<ModelLoadType> loads;
+	ModelHandleType handle;
+	bool result;
+	int i;
+
+
+	// Read the files and build the models' levels of detail on the worker threads.
+	loads.resize(count);
+	for(i=0; i<count; i++)
+	{
+		loads[i].device = m_D3D ? m_D3D->GetDevice() : 0;
+		loads[i].meshPath = meshPaths[i];
+		loads[i].texturePath = m_Software ? texturePaths[i] : 0;
+		loads[i].model = 0;
+		loads[i].result = false;
+	}
+
+	if(count > 0)
+	{
+		m_ThreadPool->Run(&GraphicsClass::LoadModelTask, &loads[0], count);
+	}
+
+	// Add them to the shared buffers from this thread in the order given, so they get the same handles and places
+	// however the loading was split.
+	result = true;
+	handles.clear();
+	for(i=0; i<count; i++)
+	{
+		handle.value = HANDLE_INVALID;
+		if(loads[i].result)
+		{
+			handle = AddModel(loads[i].model, texturePaths[i], false);
+		}
+		else if(loads[i].model)
+		{
+			loads[i].model->Shutdown();
+			delete loads[i].model;
+		}
+
+		result = result && (handle.value != HANDLE_INVALID);
+		handles.push_back(handle);
+	}
+
+	return result;
+}
+
+GraphicsClass::ModelHandleType GraphicsClass::AddModel(ModelClass* model, WCHAR* texturePath, bool occluder)
+{
+	ModelHandleType handle;
+	ModelBoundsType bounds;
+	D3DXVECTOR3 minimum, maximum;
+	float levelError;
+	int indexStart, group, slice, levelStart, levelCount, i;
+	bool result;
+
+
+	// The frame being prepared reads the scene lists this appends to, and the frames already recorded hold index
+	// ranges that regrouping the index buffer would move, so draw them first.
+	handle.value = HANDLE_INVALID;
+
+	WaitForPrepare();
+
+	result = FlushFrames();
+	if (!result)
+	{
+		model->Shutdown();
+		delete model;
+		return handle;
+	}
+
+	// Models are appended to the end of the shared vertex data, wherever it lives
+	indexStart = m_Software ? m_Software->GetIndexCount() : m_Buffers->GetDynamicIndexCount();
+
+	// The model belongs to the graphics object from here, so it is released on any failure along with its texture slice.
+	group = 0;
+	slice = 0;
+	if (!m_Software)
+	{
+		if (!m_TextureArrays->AddTexture(texturePath, group, slice))
+		{
+			model->Shutdown();
+			delete model;
+			return handle;
+		}
+	}
+
+	// Store the model in the table first, so nothing else is added for it if that fails.  Models are never removed
+	// once added, so its place in the table stays the index the other model lists use for it.
+	handle.value = m_Models->Add(model);
+	if (handle.value == HANDLE_INVALID)
+	{
+		if (!m_Software)
+		{
+			m_TextureArrays->RemoveTexture(group, slice);
+		}
+
+		model->Shutdown();
+		delete model;
+		return handle;
+	}
+
+	// Add the model's mesh data to the vertex buffer manager, taking the model back out of the table if it does not fit.
+	// A failed add leaves the buffer manager as it was.
+	if (m_Software)
+	{
+		result = m_Software->AddModel(model->GetVertices(), model->GetIndexCount());
+	}
+	else
+	{
+		result = m_Buffers->AddModel(model->GetVertices(), model->GetIndexCount(), group, slice);
+	}
+
+	if (!result)
+	{
+		m_Models->Remove(handle.value);
+		if (!m_Software)
+		{
+			m_TextureArrays->RemoveTexture(group, slice);
+		}
+
+		model->Shutdown();
+		delete model;
+		handle.value = HANDLE_INVALID;
+		return handle;
+	}
+
+	// Nothing from here on can fail, so every model list gains its entry together.
 	m_ModelIndices->push_back(model->GetIndexCount());
-	m_ModelIndices->push_back(m_Buffers->GetDynamicIndexCount());
+	m_ModelIndices->push_back(indexStart);
 
-	// Add the model's mesh data to the vertex buffer manager
-	m_Buffers->AddModel(model->GetVertices(), model->GetIndexCount());
-    
-    // Create a unique identifier for this resource
-    UuidCreate(&uuid);
-    UuidToStringA(&uuid, (RPC_CSTR*)&cuuid);
-    suuid = cuuid;
-    RpcStringFreeA((RPC_CSTR*)&cuuid);
+	// Keep the model's bounds for culling, and add it to the spatial index under its handle until the first frame moves
+	// it into place.
+	model->GetBounds(bounds.center, bounds.extents, bounds.radius);
+	m_ModelBounds->push_back(bounds);
+
+	minimum = bounds.center - bounds.extents;
+	maximum = bounds.center + bounds.extents;
+	m_ModelProxies->push_back(m_SpatialTree->CreateProxy(minimum, maximum, (int)handle.value));
+
+	// Give a designated occluder its own copy of the full detail triangles to draw into the occlusion buffer.
+	model->GetLevel(0, levelStart, levelCount, levelError);
+	m_ModelOccluders->push_back(occluder ? m_Occlusion->AddMesh(model->GetVertices() + levelStart, levelCount) : -1);
+
+	// Keep the model's levels of detail to pick from each frame.
+	m_Lod->AddObject(model);
+	m_ModelLevels->push_back(0);
 
-    // Store the bitmap, accessible by the unique id
-    m_Models->insert(make_pair(suuid, model));
+	if (m_Software)
+	{
+		m_SoftwareTextures->push_back(model->GetSoftwareTexture());
+	}
+	else
+	{
+		m_ModelTextures->push_back(group);
 
-	m_Textures->push_back(model->GetTexture());
+		// The index buffer keeps the models of each texture array together, so the earlier models may have moved
+		for (i = 0; i < (int)m_ModelIndices->size() / 2; i++)
+		{
+			(*m_ModelIndices)[(i*2)+1] = m_Buffers->GetIndexStart(i);
+		}
+	}
 
-    // Return a copy of the unique id as a string
-    return suuid;
+	return handle;
 }
 
-string GraphicsClass::LoadBitmapResource(WCHAR* filePath, int bitmapWidth, int bitmapHeight)
+GraphicsClass::BitmapHandleType GraphicsClass::LoadBitmapResource(WCHAR* filePath, int bitmapWidth, int bitmapHeight)
 {
     BitmapClass* bitmap;
-    UUID uuid;
-    char* cuuid;
-    string suuid;
+	BitmapHandleType handle;
+
+	// The frame being prepared walks the bitmaps this adds to.
+	WaitForPrepare();
 
     // Create the bitmap resource
     bitmap = new BitmapClass();
-    if (!bitmap->Initialize(m_D3D->GetDevice(), filePath, bitmapWidth, bitmapHeight, m_screenWidth, m_screenHeight))
+    handle.value = HANDLE_INVALID;
+    if (!bitmap->Initialize(m_D3D ? m_D3D->GetDevice() : 0, filePath, bitmapWidth, bitmapHeight, m_screenWidth, m_screenHeight))
     {
-        return "error";
+        return handle;
     }
-    
-    // Create a unique identifier for this resource
-    UuidCreate(&uuid);
-    UuidToStringA(&uuid, (RPC_CSTR*)&cuuid);
-    suuid = cuuid;
-    RpcStringFreeA((RPC_CSTR*)&cuuid);
 
-    // Store the bitmap, accessible by the unique id
-    m_Bitmaps->insert(make_pair(suuid, bitmap));
+	// Store the bitmap in the table.
+	handle.value = m_Bitmaps->Add(bitmap);
+	if (handle.value == HANDLE_INVALID)
+	{
+		bitmap->Shutdown();
+		delete bitmap;
+	}
+
+	return handle;
+}
+
+bool GraphicsClass::ReleaseBitmapResource(BitmapHandleType handle)
+{
+	BitmapClass* bitmap;
+	bool result;
+
+
+	// Draw the frames already recorded with the bitmap before it goes away.
+	WaitForPrepare();
+
+	result = FlushFrames();
+	if (!result)
+	{
+		return false;
+	}
+
+	// A stale handle finds nothing, so a bitmap cannot be released twice.
+	bitmap = (BitmapClass*)m_Bitmaps->Get(handle.value);
+	if (!bitmap)
+	{
+		return false;
+	}
+
+	m_Bitmaps->Remove(handle.value);
+
+	bitmap->Shutdown();
+	delete bitmap;
+
+	return true;
+}
+
+BitmapClass* GraphicsClass::GetBitmap(BitmapHandleType handle)
+{
+	return (BitmapClass*)m_Bitmaps->Get(handle.value);
+}
+
+ModelClass* GraphicsClass::GetModel(ModelHandleType handle)
+{
+	return (ModelClass*)m_Models->Get(handle.value);
+}
+
+bool GraphicsClass::AddSprite(BitmapHandleType handle, int positionX, int positionY, int layer)
+{
+	SpriteType sprite;
+
+
+	// The sprites and the loaded bitmaps, which are drawn every frame, all have to fit in the sprite batch.
+	if((int)m_Sprites->size() + m_Bitmaps->GetCount() >= SPRITE_BATCH_MAX_SPRITES)
+	{
+		return false;
+	}
+
+	// Queue the sprite for the next frame only.  The bitmap is looked up when the frame is recorded.
+	sprite.bitmap = handle.value;
+	sprite.positionX = positionX;
+	sprite.positionY = positionY;
+	sprite.layer = layer;
+	m_Sprites->push_back(sprite);
 
-    // Return a copy of the unique id as a string
-    return suuid;
+	return true;
 }
 
 
 void GraphicsClass::Shutdown()
 {
+	BitmapClass* bitmap;
+	ModelClass* model;
+	int i;
+
+
+	// Let a frame still being prepared on the workers finish before anything it uses goes away.
+	WaitForPrepare();
+
     // Release all bitmaps
     if (m_Bitmaps)
     {
-        for (auto it = m_Bitmaps->begin(); it != m_Bitmaps->end(); it++)
+        for (i = 0; i < m_Bitmaps->GetCount(); i++)
         {
-            it->second->Shutdown();
-            delete it->second;
-            it->second = 0;
+            bitmap = (BitmapClass*)m_Bitmaps->GetItem(i);
+            bitmap->Shutdown();
+            delete bitmap;
         }
 
-        m_Bitmaps->clear();
+        m_Bitmaps->Shutdown();
         delete m_Bitmaps;
         m_Bitmaps = 0;
     }
@@ -249,14 +703,14 @@ void GraphicsClass::Shutdown()
 	// Release all models
 	if (m_Models)
     {
-        for (auto it = m_Models->begin(); it != m_Models->end(); it++)
+        for (i = 0; i < m_Models->GetCount(); i++)
         {
-            it->second->Shutdown();
-            delete it->second;
-            it->second = 0;
+            model = (ModelClass*)m_Models->GetItem(i);
+            model->Shutdown();
+            delete model;
         }
 
-        m_Models->clear();
+        m_Models->Shutdown();
         delete m_Models;
         m_Models = 0;
     }
@@ -268,11 +722,47 @@ void GraphicsClass::Shutdown()
 		m_ModelIndices = 0;
 	}
 
-	// Release the texture index
-	if (m_Textures)
+	// Release model bounds
+	if (m_ModelBounds)
+	{
+		delete m_ModelBounds;
+		m_ModelBounds = 0;
+	}
+
+	// Release model proxies
+	if (m_ModelProxies)
+	{
+		delete m_ModelProxies;
+		m_ModelProxies = 0;
+	}
+
+	// Release the occluder meshes of the models
+	if (m_ModelOccluders)
+	{
+		delete m_ModelOccluders;
+		m_ModelOccluders = 0;
+	}
+
+	// Release the texture array index
+	if (m_ModelTextures)
+	{
+		delete m_ModelTextures;
+		m_ModelTextures = 0;
+	}
+
+	// Release the texture arrays
+	if (m_TextureArrays)
+	{
+		m_TextureArrays->Shutdown();
+		delete m_TextureArrays;
+		m_TextureArrays = 0;
+	}
+
+	// Release the software texture index
+	if (m_SoftwareTextures)
 	{
-		delete m_Textures;
-		m_Textures = 0;
+		delete m_SoftwareTextures;
+		m_SoftwareTextures = 0;
 	}
 
 	// Release the camera object.
@@ -282,20 +772,175 @@ void GraphicsClass::Shutdown()
 		m_Camera = 0;
 	}
 
-	// Release the D3D object.
-	if(m_D3D)
+	// Release the software renderer.
+	if(m_Software)
 	{
-		m_D3D->Shutdown();
-		delete m_D3D;
-		m_D3D = 0;
+		m_Software->Shutdown();
+		delete m_Software;
+		m_Software = 0;
 	}
 
-	return;
-}
+	// Release the frame snapshots and their command lists.
+	if(m_Snapshots)
+	{
+		for(i = 0; i < PIPELINE_MAX_DEPTH; i++)
+		{
+			if(m_Snapshots[i].commandLists)
+			{
+				for(unsigned int j = 0; j < m_Snapshots[i].commandLists->size(); j++)
+				{
+					(*m_Snapshots[i].commandLists)[j]->Shutdown();
+					delete (*m_Snapshots[i].commandLists)[j];
+				}
 
-bool GraphicsClass::Frame(float rotationX, float rotationY, float rotationZ, float zoom, float moveX, float moveY)
-{
-	bool result;
+				delete m_Snapshots[i].commandLists;
+			}
+
+			if(m_Snapshots[i].recordResults)
+			{
+				delete [] m_Snapshots[i].recordResults;
+			}
+
+			if(m_Snapshots[i].sprites)
+			{
+				delete m_Snapshots[i].sprites;
+			}
+		}
+
+		delete [] m_Snapshots;
+		m_Snapshots = 0;
+	}
+
+	// Release the draw queue.
+	if(m_DrawQueue)
+	{
+		m_DrawQueue->Shutdown();
+		delete m_DrawQueue;
+		m_DrawQueue = 0;
+	}
+
+	if(m_LightDraws)
+	{
+		delete m_LightDraws;
+		m_LightDraws = 0;
+	}
+
+	// Release the sprite batch and the sprite lists.
+	if(m_SpriteBatch)
+	{
+		m_SpriteBatch->Shutdown();
+		delete m_SpriteBatch;
+		m_SpriteBatch = 0;
+	}
+
+	if(m_Sprites)
+	{
+		delete m_Sprites;
+		m_Sprites = 0;
+	}
+
+	if(m_SpriteDraws)
+	{
+		delete m_SpriteDraws;
+		m_SpriteDraws = 0;
+	}
+
+	// Release the culling object.
+	if(m_Culling)
+	{
+		m_Culling->Shutdown();
+		delete m_Culling;
+		m_Culling = 0;
+	}
+
+	// Release the spatial index.
+	if(m_SpatialTree)
+	{
+		m_SpatialTree->Shutdown();
+		delete m_SpatialTree;
+		m_SpatialTree = 0;
+	}
+
+	// Release the occlusion buffer and the lists it filters.
+	if(m_Occlusion)
+	{
+		m_Occlusion->Shutdown();
+		delete m_Occlusion;
+		m_Occlusion = 0;
+	}
+
+	if(m_VisibleModels)
+	{
+		delete m_VisibleModels;
+		m_VisibleModels = 0;
+	}
+
+	// Release the text object.
+	if(m_Text)
+	{
+		m_Text->Shutdown();
+		delete m_Text;
+		m_Text = 0;
+	}
+
+	if(m_profileLines)
+	{
+		delete m_profileLines;
+		m_profileLines = 0;
+	}
+
+	// Release the level of detail selector.
+	if(m_Lod)
+	{
+		m_Lod->Shutdown();
+		delete m_Lod;
+		m_Lod = 0;
+	}
+
+	if(m_ModelLevels)
+	{
+		delete m_ModelLevels;
+		m_ModelLevels = 0;
+	}
+
+	if(m_WorldMaximums)
+	{
+		delete m_WorldMaximums;
+		m_WorldMaximums = 0;
+	}
+
+	if(m_WorldMinimums)
+	{
+		delete m_WorldMinimums;
+		m_WorldMinimums = 0;
+	}
+
+	// Stop the worker threads.
+	if(m_ThreadPool)
+	{
+		m_ThreadPool->Shutdown();
+		delete m_ThreadPool;
+		m_ThreadPool = 0;
+	}
+
+	// Release the frame memory once no thread can be using it.
+	FrameAllocatorClass::Shutdown();
+
+	// Release the D3D object.
+	if(m_D3D)
+	{
+		m_D3D->Shutdown();
+		delete m_D3D;
+		m_D3D = 0;
+	}
+
+	return;
+}
+
+bool GraphicsClass::Frame(float rotationX, float rotationY, float rotationZ, float zoom, float moveX, float moveY)
+{
+	PROFILE_ZONE("GraphicsClass::Frame");
+	bool result;
     D3DXVECTOR3 cameraPos;
     
     cameraPos = m_Camera->GetPosition();
@@ -316,83 +961,1176 @@ bool GraphicsClass::Frame(float rotationX, float rotationY, float rotationZ, flo
 
 bool GraphicsClass::Render(float rotationX, float rotationY, float rotationZ)
 {
-	D3DXMATRIX worldMatrix, viewMatrix, projectionMatrix, orthoMatrix, UIWorldMatrix;
+	PROFILE_ZONE("GraphicsClass::Render");
+	SnapshotType* snapshot;
 	bool result;
 
 
-	// Clear the buffers to begin the scene.
-	m_D3D->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+	// Only one frame is prepared at a time, since they share the culling and level of detail state.
+	WaitForPrepare();
+
+	// No job is running now, so nothing can be allocating from frame memory while a new frame starts and what the
+	// last one allocated is handed out again.
+	FrameAllocatorClass::EndFrame();
+
+	// Take the snapshot of the oldest frame the pipeline holds, which has already been submitted.
+	m_prepareSnapshot = m_framesPrepared % m_pipelineDepth;
+	snapshot = &m_Snapshots[m_prepareSnapshot];
 
 	// Generate the view matrix based on the camera's position.
 	m_Camera->Render();
 
-	// Get the world, view, and projection matrices from the camera and d3d objects.
-	m_Camera->GetViewMatrix(viewMatrix);
-	m_D3D->GetWorldMatrix(worldMatrix);
-	m_D3D->GetProjectionMatrix(projectionMatrix);
-    m_D3D->GetOrthoMatrix(orthoMatrix);
-    m_D3D->GetUIWorldMatrix(UIWorldMatrix);
+	// Get the world, view, and projection matrices from the camera and whichever backend is drawing.
+	m_Camera->GetViewMatrix(snapshot->frame.viewMatrix);
+	if(m_Software)
+	{
+		m_Software->GetWorldMatrix(snapshot->frame.worldMatrix);
+		m_Software->GetProjectionMatrix(snapshot->frame.projectionMatrix);
+		m_Software->GetOrthoMatrix(snapshot->frame.orthoMatrix);
+		m_Software->GetUIWorldMatrix(snapshot->frame.UIWorldMatrix);
+	}
+	else
+	{
+		m_D3D->GetWorldMatrix(snapshot->frame.worldMatrix);
+		m_D3D->GetProjectionMatrix(snapshot->frame.projectionMatrix);
+		m_D3D->GetOrthoMatrix(snapshot->frame.orthoMatrix);
+		m_D3D->GetUIWorldMatrix(snapshot->frame.UIWorldMatrix);
+	}
 
     // Rotate the world matrix by the rotation value so that the triangle will spin.
-    D3DXMatrixRotationYawPitchRoll(&worldMatrix, rotationX, rotationY, rotationZ);
-	/*
-	bool LightShaderClass::Render(ID3D11DeviceContext* deviceContext, int indexCount, D3DXMATRIX worldMatrix, D3DXMATRIX viewMatrix, 
-                              D3DXMATRIX projectionMatrix, ID3D11ShaderResourceView** textures, int numTextures, int** drawIndices,
-							  D3DXVECTOR3 lightDirection, D3DXVECTOR4 ambientColor, D3DXVECTOR4 diffuseColor,
-							  D3DXVECTOR3 cameraPosition, D3DXVECTOR4 specularColor, float specularPower)
-							  */
-	m_Buffers->RenderBuffers(m_D3D->GetDeviceContext());
-	
-	result = m_LightShader->Render(m_D3D->GetDeviceContext(), m_Buffers->GetDynamicIndexCount(), worldMatrix, viewMatrix,
-		projectionMatrix, m_Textures, m_Models->size(), m_ModelIndices, m_Light->GetDirection(),
-		m_Light->GetAmbientColor(), m_Light->GetDiffuseColor(), m_Camera->GetPosition(), m_Light->GetSpecularColor(),
-		m_Light->GetSpecularPower());
-    if(!result)
+    D3DXMatrixRotationYawPitchRoll(&snapshot->frame.worldMatrix, rotationX, rotationY, rotationZ);
+	snapshot->frame.cameraPosition = m_Camera->GetPosition();
+
+	// Hand the sprites queued since the last frame to this one, and start an empty list for the next.
+	snapshot->sprites->swap(*m_Sprites);
+	m_Sprites->clear();
+
+	// Cull and record the frame on the workers from the snapshot of the scene state, while this thread goes on
+	// to submit an earlier frame.
+	snapshot->preparing = 0;
+	m_ThreadPool->Submit(&GraphicsClass::PrepareTask, this, m_prepareSnapshot, &snapshot->preparing);
+	m_framesPrepared++;
+
+	// Submit the oldest frame once the pipeline is full.  With a depth of one that is the frame just started,
+	// so this waits for it, and every extra step of depth adds a frame of latency to keep the workers busy.
+	while(m_framesPrepared - m_framesSubmitted >= m_pipelineDepth)
+	{
+		result = SubmitFrame(m_framesSubmitted % m_pipelineDepth);
+		m_framesSubmitted++;
+		if(!result)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool GraphicsClass::FlushFrames()
+{
+	bool result;
+
+
+	// Submit every frame prepared but not yet drawn, oldest first.
+	while(m_framesSubmitted < m_framesPrepared)
+	{
+		result = SubmitFrame(m_framesSubmitted % m_pipelineDepth);
+		m_framesSubmitted++;
+		if(!result)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool GraphicsClass::SetPipelineDepth(int depth)
+{
+	bool result;
+
+
+	// Finish the frame being prepared and draw every one not yet submitted, along with its sprites, so the pipeline
+	// is empty when the snapshots are renumbered.
+	WaitForPrepare();
+
+	result = FlushFrames();
+	if(!result)
 	{
 		return false;
 	}
 
-	/*
-    // Put all models and index buffers on the graphics pipeline to prepare them for drawing.
-    for (auto it = m_Models->begin(); it != m_Models->end(); it++)
-    {
-        it->second->Render(m_D3D->GetDeviceContext());
-        // Render the model using the light shader.
-        result = m_LightShader->Render(m_D3D->GetDeviceContext(), it->second->GetIndexCount(), worldMatrix, viewMatrix,
-            projectionMatrix, it->second->GetTexture(), m_Light->GetDirection(), m_Light->GetAmbientColor(),
-            m_Light->GetDiffuseColor(), m_Camera->GetPosition(), m_Light->GetSpecularColor(), m_Light->GetSpecularPower());
-        if(!result)
-	    {
-		    return false;
-	    }
-    }
-	*/
+	m_pipelineDepth = min(max(depth, 1), PIPELINE_MAX_DEPTH);
+	m_framesPrepared = 0;
+	m_framesSubmitted = 0;
+
+	return true;
+}
 
-    // Disable the Z buffer for 2D rendering
-    m_D3D->TurnZBufferOff();
+int GraphicsClass::GetPipelineDepth()
+{
+	// Report how many frames are in flight between preparing and submitting.
+	return m_pipelineDepth;
+}
 
-    // Draw every bitmap in the array
-    for (auto it = m_Bitmaps->begin(); it != m_Bitmaps->end(); it++)
-    {
-        // Put the bitmap vertex and index buffers on the graphics pipeline to prepare them for drawing.
-        result = it->second->Render(m_D3D->GetDeviceContext(), 100, 100);
-	    if(!result)
-	    {
-		    return false;
-	    }
-
-	    // Render the bitmap with the texture shader.
-	    result = m_TextureShader->Render(m_D3D->GetDeviceContext(), it->second->GetIndexCount(), UIWorldMatrix, viewMatrix,
-            orthoMatrix, it->second->GetTexture());
-	    if(!result)
-	    {
-		    return false;
-	    }
-    }
-    m_D3D->TurnZBufferOn();
+bool GraphicsClass::SaveFrame(char* filename)
+{
+	// Only the software renderer keeps the frame in system memory.
+	if(!m_Software)
+	{
+		return false;
+	}
+
+	// Draw the frames still in the pipeline, so the file holds the last one rendered.
+	if(!FlushFrames())
+	{
+		return false;
+	}
+
+	return m_Software->SaveFrame(filename);
+}
+
+int GraphicsClass::GetStateChanges(bool sorted)
+{
+	// Report the state changes of the last frame in recorded or submitted order.
+	return m_DrawQueue->GetStateChanges(sorted);
+}
+
+int GraphicsClass::GetDrawCalls()
+{
+	// Report the draws the last frame issued after merging.
+	return m_drawCalls;
+}
+
+void GraphicsClass::QueryRegion(D3DXVECTOR3& minimum, D3DXVECTOR3& maximum, vector<ModelHandleType>& models)
+{
+	vector<int> objects;
+	ModelHandleType handle;
+	unsigned int i;
 
-	// Present the rendered scene to the screen.
-	m_D3D->EndScene();
+
+	// Find the models whose world space boxes touch the region, as of the last frame.
+	WaitForPrepare();
+	m_SpatialTree->QueryRegion(minimum, maximum, objects);
+
+	// The tree keeps each model's handle as its object.
+	for(i = 0; i < objects.size(); i++)
+	{
+		handle.value = (unsigned int)objects[i];
+		models.push_back(handle);
+	}
+}
+
+void GraphicsClass::QueryFrustum(D3DXMATRIX& viewMatrix, D3DXMATRIX& projectionMatrix, vector<ModelHandleType>& models)
+{
+	float planes[CULLING_PLANE_COUNT][4];
+	vector<int> objects;
+	ModelHandleType handle;
+	unsigned int i;
+
+
+	// Find the models inside any view, such as a light's.
+	WaitForPrepare();
+	CullingClass::ExtractPlanes(viewMatrix, projectionMatrix, planes);
+	m_SpatialTree->QueryFrustum(planes, objects);
+
+	for(i = 0; i < objects.size(); i++)
+	{
+		handle.value = (unsigned int)objects[i];
+		models.push_back(handle);
+	}
+}
+
+bool GraphicsClass::RayCast(D3DXVECTOR3& origin, D3DXVECTOR3& direction, ModelHandleType& model, float& distance)
+{
+	int object;
+
+
+	// Find the nearest model box along the ray within the far plane.
+	WaitForPrepare();
+	if(!m_SpatialTree->RayCast(origin, direction, SCREEN_DEPTH, object, distance))
+	{
+		return false;
+	}
+
+	model.value = (unsigned int)object;
+
+	return true;
+}
+
+void GraphicsClass::GetOcclusionStats(int& occluders, int& occludees, int& occluded, float& rasterTime, float& testTime)
+{
+	// Report what the last frame drew into the occlusion buffer and what it hid.
+	WaitForPrepare();
+	occluders = m_Occlusion->GetOccluderCount();
+	occludees = m_Occlusion->GetOccludeeCount();
+	occluded = m_Occlusion->GetOccludedCount();
+	rasterTime = m_Occlusion->GetRasterTime();
+	testTime = m_Occlusion->GetTestTime();
+}
+
+bool GraphicsClass::SaveOcclusionDepth(char* filename)
+{
+	// Write the last frame's occlusion buffer out for debugging.
+	WaitForPrepare();
+	return m_Occlusion->SaveDepth(filename);
+}
+
+void GraphicsClass::SetLodBias(float bias)
+{
+	// Each step of bias doubles the error allowed on screen, and negative steps halve it.
+	WaitForPrepare();
+	m_Lod->SetBias(bias);
+}
+
+void GraphicsClass::GetLodStats(int& triangles, int& fullTriangles, int& levelChanges)
+{
+	// Report the triangles the last frame drew against those at full detail, and how many models changed level.
+	WaitForPrepare();
+	triangles = m_Lod->GetTriangleCount();
+	fullTriangles = m_Lod->GetFullTriangleCount();
+	levelChanges = m_Lod->GetLevelChanges();
+}
+
+void GraphicsClass::ShowProfile(bool show)
+{
+	// Show or hide the profiler's summary of the slowest zones.
+	m_showProfile = show;
+}
+
+void GraphicsClass::SetHierarchicalZ(bool enable)
+{
+	// Switch the software renderer's hierarchical depth rejection, which the GPU does on its own.
+	if(m_Software)
+	{
+		m_Software->SetHierarchicalZ(enable);
+	}
+}
+
+float GraphicsClass::GetRejectedPixelRatio()
+{
+	// Report the share of pixels the last software frame rejected by their block's depth bounds.
+	if(!m_Software)
+	{
+		return 0.0f;
+	}
+
+	return m_Software->GetRejectedPixelRatio();
+}
+
+float GraphicsClass::GetVerticesPerTriangle()
+{
+	// Report how many vertices the last software frame transformed for each triangle of its models.
+	if(!m_Software)
+	{
+		return 0.0f;
+	}
+
+	return m_Software->GetVerticesPerTriangle();
+}
+
+bool GraphicsClass::GetFrame(vector<unsigned int>& pixels)
+{
+	unsigned int* colorBuffer;
+
+
+	// Only the software renderer keeps the frame in system memory.
+	if(!m_Software)
+	{
+		return false;
+	}
+
+	// Draw the frames still in the pipeline, so the copy holds the last one rendered.
+	if(!FlushFrames())
+	{
+		return false;
+	}
+
+	colorBuffer = m_Software->GetColorBuffer();
+	pixels.assign(colorBuffer, colorBuffer + m_Software->GetWidth() * m_Software->GetHeight());
+
+	return true;
+}
+
+bool GraphicsClass::RenderProfile(FrameType& frame)
+{
+	char line[PROFILE_LINE_LENGTH];
+	long long cpuBytes, gpuBytes;
+	bool result, overBudget;
+	int i;
+
+
+	// Update the lines only when the profiler has a new summary, so most frames just draw them.  Each line is
+	// updated on the workers, and only the ones whose text changed are rebuilt and packed again when drawn.
+	if(ProfilerClass::GetSummary(*m_profileLines))
+	{
+		sprintf_s(line, PROFILE_LINE_LENGTH, "Heap allocations: %d per frame", FrameAllocatorClass::GetHeapAllocations());
+		m_profileLines->push_back(line);
+
+		// Follow it with the memory the tracker has counted, all tags together.
+		cpuBytes = 0;
+		gpuBytes = 0;
+		overBudget = false;
+		for(i=0; i<MemoryTrackerClass::TAG_COUNT; i++)
+		{
+			cpuBytes += MemoryTrackerClass::GetCpuBytes((MemoryTrackerClass::TagType)i);
+			gpuBytes += MemoryTrackerClass::GetGpuBytes((MemoryTrackerClass::TagType)i);
+			overBudget = overBudget || MemoryTrackerClass::IsOverBudget((MemoryTrackerClass::TagType)i);
+		}
+
+		sprintf_s(line, PROFILE_LINE_LENGTH, "Memory: %.1f MB cpu, %.1f MB gpu%s", cpuBytes / 1048576.0, gpuBytes / 1048576.0,
+			overBudget ? ", over budget" : "");
+		m_profileLines->push_back(line);
+
+		m_profileCounter = 0;
+		for(i=0; i<PROFILE_LINE_COUNT; i++)
+		{
+			m_ThreadPool->Submit(&GraphicsClass::ProfileLineTask, this, i, &m_profileCounter);
+		}
+
+		m_ThreadPool->Wait(&m_profileCounter);
+
+		for(i=0; i<PROFILE_LINE_COUNT; i++)
+		{
+			if(!m_profileResults[i])
+			{
+				return false;
+			}
+		}
+	}
+
+	// Draw the text over everything else, uploading whatever lines changed first.
+	if(m_Software)
+	{
+		m_Software->TurnZBufferOff();
+		result = m_Text->Render(m_Software, frame.UIWorldMatrix, frame.orthoMatrix);
+		m_Software->TurnZBufferOn();
+	}
+	else
+	{
+		// Blend the glyphs over the scene by their alpha, which is what lets distance field edges fade out smoothly.
+		m_D3D->TurnZBufferOff();
+		m_D3D->TurnOnAlphaBlending();
+		result = m_Text->Render(m_D3D->GetDeviceContext(), frame.UIWorldMatrix, frame.orthoMatrix);
+		m_D3D->TurnOffAlphaBlending();
+		m_D3D->TurnZBufferOn();
+	}
+
+	return result;
+}
+
+void GraphicsClass::ProfileLineTask(void* context, int line)
+{
+	GraphicsClass* graphics;
+	char text[PROFILE_LINE_LENGTH];
+
+
+	graphics = (GraphicsClass*)context;
+
+	// Lines past the end of the summary are left empty.
+	text[0] = '\0';
+	if(line < (int)graphics->m_profileLines->size())
+	{
+		strcpy_s(text, PROFILE_LINE_LENGTH, (*graphics->m_profileLines)[line].substr(0, PROFILE_LINE_LENGTH - 1).c_str());
+	}
+
+	// Each line is its own text object, so the lines can be updated side by side.
+	graphics->m_profileResults[line] = graphics->m_Text->UpdateText(graphics->m_profileTexts[line], text, 10, 10 + line * PROFILE_LINE_HEIGHT,
+		1.0f, 1.0f, 0.0f);
+
+	return;
+}
+
+bool GraphicsClass::CullModels()
+{
+	PROFILE_ZONE("GraphicsClass::CullModels");
+	D3DXVECTOR3 center, extents, minimum, maximum;
+	float radius;
+	int visibleCount, mesh, i;
+
+
+	// Move every model's bounds into world space, in the culling arrays and the spatial index.
+	if(!m_Culling->SetObjectCount((int)m_ModelBounds->size()))
+	{
+		return false;
+	}
+
+	m_WorldMinimums->resize(m_ModelBounds->size());
+	m_WorldMaximums->resize(m_ModelBounds->size());
+
+	for(i = 0; i < (int)m_ModelBounds->size(); i++)
+	{
+		CullingClass::TransformBounds((*m_ModelBounds)[i].center, (*m_ModelBounds)[i].extents, (*m_ModelBounds)[i].radius,
+			m_frame.worldMatrix, center, extents, radius);
+		m_Culling->SetBounds(i, center, extents, radius);
+
+		minimum = center - extents;
+		maximum = center + extents;
+		m_SpatialTree->MoveProxy((*m_ModelProxies)[i], minimum, maximum);
+
+		(*m_WorldMinimums)[i] = minimum;
+		(*m_WorldMaximums)[i] = maximum;
+	}
+
+	// Test them against the planes of the camera's view and the backend's projection.
+	m_Culling->SetFrustum(m_frame.viewMatrix, m_frame.projectionMatrix);
+	m_Culling->Cull(m_ThreadPool);
+
+	visibleCount = m_Culling->GetVisibleCount();
+	m_VisibleModels->assign(m_Culling->GetVisible(), m_Culling->GetVisible() + visibleCount);
+
+	// Draw the occluders left in the frustum into the occlusion buffer.
+	m_Occlusion->BeginFrame(m_frame.viewMatrix, m_frame.projectionMatrix);
+	for(i = 0; i < visibleCount; i++)
+	{
+		mesh = (*m_ModelOccluders)[(*m_VisibleModels)[i]];
+		if(mesh >= 0)
+		{
+			m_Occlusion->AddOccluder(mesh, m_frame.worldMatrix);
+		}
+	}
+
+	// Then drop the models it hides, occluders included, keeping the rest in order.
+	if(m_Occlusion->GetOccluderCount() > 0)
+	{
+		m_Occlusion->Rasterize(m_ThreadPool);
+		visibleCount = m_Occlusion->Cull(&(*m_VisibleModels)[0], visibleCount, &(*m_WorldMinimums)[0], &(*m_WorldMaximums)[0]);
+		m_VisibleModels->resize(visibleCount);
+	}
 
 	return true;
-}
\ No newline at end of file
+}
+
+void GraphicsClass::SelectLevels()
+{
+	PROFILE_ZONE("GraphicsClass::SelectLevels");
+	D3DXVECTOR3 center, offset;
+	float scale, distance;
+	int model, i;
+
+
+	// The models share one world matrix, so their errors all grow by its largest scale.
+	scale = max(D3DXVec3Length((D3DXVECTOR3*)&m_frame.worldMatrix._11), max(D3DXVec3Length((D3DXVECTOR3*)&m_frame.worldMatrix._21),
+		D3DXVec3Length((D3DXVECTOR3*)&m_frame.worldMatrix._31)));
+
+	m_Lod->BeginFrame(m_frame.projectionMatrix, m_screenHeight);
+	for(i = 0; i < (int)m_VisibleModels->size(); i++)
+	{
+		model = (*m_VisibleModels)[i];
+
+		// Measure from the camera to the nearest point of the model's sphere, within the depth range.
+		center = ((*m_WorldMinimums)[model] + (*m_WorldMaximums)[model]) * 0.5f;
+		offset = center - m_frame.cameraPosition;
+		distance = D3DXVec3Length(&offset) - ((*m_ModelBounds)[model].radius * scale);
+		distance = min(max(distance, SCREEN_NEAR), SCREEN_DEPTH);
+
+		(*m_ModelLevels)[model] = m_Lod->Select(model, distance, scale);
+	}
+
+	return;
+}
+
+void GraphicsClass::PrepareTask(void* context, int snapshot)
+{
+	GraphicsClass* graphics = (GraphicsClass*)context;
+
+	graphics->m_Snapshots[snapshot].result = graphics->PrepareFrame(snapshot);
+	return;
+}
+
+bool GraphicsClass::PrepareFrame(int snapshot)
+{
+	PROFILE_ZONE("GraphicsClass::PrepareFrame");
+	bool result;
+	unsigned int i;
+
+
+	// Work from the snapshot's copy of the scene state, which the main thread no longer touches.
+	m_frame = m_Snapshots[snapshot].frame;
+
+	// Find the models inside the view frustum and not hidden by occluders, which are all that get recorded.
+	result = CullModels();
+	if(!result)
+	{
+		return false;
+	}
+
+	// Pick the level of detail each of them is drawn at.
+	SelectLevels();
+
+	// Record the frame's draws into the snapshot's lists on the worker threads.
+	m_ThreadPool->Run(&GraphicsClass::RecordTask, this, (int)m_Snapshots[snapshot].commandLists->size());
+
+	for(i = 0; i < m_Snapshots[snapshot].commandLists->size(); i++)
+	{
+		if(!m_Snapshots[snapshot].recordResults[i])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool GraphicsClass::SubmitFrame(int snapshot)
+{
+	PROFILE_ZONE("GraphicsClass::SubmitFrame");
+	SnapshotType* frame;
+	bool result;
+	unsigned int i;
+
+
+	// Wait until the frame is recorded, which it already is unless the pipeline is one frame deep.
+	frame = &m_Snapshots[snapshot];
+	m_ThreadPool->Wait(&frame->preparing);
+	if(!frame->result)
+	{
+		return false;
+	}
+
+	// Clear the buffers to begin the scene.
+	if(m_Software)
+	{
+		m_Software->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+	else
+	{
+		m_D3D->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	// Merge the lists in a fixed order and sort the packets by key.  The sort is stable, so the frame is the same however the recording was split.
+	m_DrawQueue->Reset();
+	for(i = 0; i < frame->commandLists->size(); i++)
+	{
+		m_DrawQueue->Add((*frame->commandLists)[i]);
+	}
+	m_DrawQueue->Sort();
+
+	// Submit the sorted packets from this thread.
+	result = ExecuteCommands();
+	if(!result)
+	{
+		return false;
+	}
+
+	// Draw the profiler summary over the scene when it is shown.
+	if(m_showProfile)
+	{
+		result = RenderProfile(frame->frame);
+		if(!result)
+		{
+			return false;
+		}
+	}
+
+	// Present the rendered scene to the screen, or rasterize it on the CPU.
+	if(m_Software)
+	{
+		m_Software->EndScene();
+	}
+	else
+	{
+		m_D3D->EndScene();
+	}
+
+	return true;
+}
+
+void GraphicsClass::WaitForPrepare()
+{
+	// The last frame started may still be culling and recording on the workers.
+	if(m_Snapshots && (m_framesPrepared > 0))
+	{
+		m_ThreadPool->Wait(&m_Snapshots[(m_framesPrepared - 1) % m_pipelineDepth].preparing);
+	}
+}
+
+bool GraphicsClass::InitializeCommandLists(int threadCount)
+{
+	CommandListClass* commandList;
+	bool result;
+	int i, j;
+
+
+	// Start the memory every thread takes its transient arrays from, which is rewound each frame.
+	result = FrameAllocatorClass::Initialize();
+	if(!result)
+	{
+		return false;
+	}
+
+	// Create the worker threads.
+	m_ThreadPool = new ThreadPoolClass;
+	if(!m_ThreadPool)
+	{
+		return false;
+	}
+
+	result = m_ThreadPool->Initialize(threadCount);
+	if(!result)
+	{
+		return false;
+	}
+
+	// Create the culling object, which tests the models on the same threads.
+	m_Culling = new CullingClass;
+	if(!m_Culling)
+	{
+		return false;
+	}
+
+	result = m_Culling->Initialize(CULLING_CHUNK_SIZE);
+	if(!result)
+	{
+		return false;
+	}
+
+	// Create the spatial index the scene queries go through.
+	m_SpatialTree = new SpatialTreeClass;
+	if(!m_SpatialTree)
+	{
+		return false;
+	}
+
+	result = m_SpatialTree->Initialize();
+	if(!result)
+	{
+		return false;
+	}
+
+	// Create the occlusion buffer and the lists of world bounds and visible models it works on.
+	m_Occlusion = new OcclusionClass;
+	if(!m_Occlusion)
+	{
+		return false;
+	}
+
+	result = m_Occlusion->Initialize();
+	if(!result)
+	{
+		return false;
+	}
+
+	m_WorldMinimums = new vector<D3DXVECTOR3>;
+	if(!m_WorldMinimums)
+	{
+		return false;
+	}
+
+	m_WorldMaximums = new vector<D3DXVECTOR3>;
+	if(!m_WorldMaximums)
+	{
+		return false;
+	}
+
+	m_VisibleModels = new vector<int>;
+	if(!m_VisibleModels)
+	{
+		return false;
+	}
+
+	// Create the level of detail selector and the level picked for each model.
+	m_Lod = new LodClass;
+	if(!m_Lod)
+	{
+		return false;
+	}
+
+	result = m_Lod->Initialize();
+	if(!result)
+	{
+		return false;
+	}
+
+	m_ModelLevels = new vector<int>;
+	if(!m_ModelLevels)
+	{
+		return false;
+	}
+
+	// Create a snapshot for every frame the pipeline can hold.  Each has one command list for each thread's share
+	// of the scene, plus one for the 2D pass drawn on top.
+	m_Snapshots = new SnapshotType[PIPELINE_MAX_DEPTH];
+	if(!m_Snapshots)
+	{
+		return false;
+	}
+
+	for(i = 0; i < PIPELINE_MAX_DEPTH; i++)
+	{
+		m_Snapshots[i].sprites = 0;
+		m_Snapshots[i].commandLists = 0;
+		m_Snapshots[i].recordResults = 0;
+		m_Snapshots[i].preparing = 0;
+		m_Snapshots[i].result = false;
+	}
+
+	for(i = 0; i < PIPELINE_MAX_DEPTH; i++)
+	{
+		m_Snapshots[i].sprites = new vector<SpriteType>;
+		if(!m_Snapshots[i].sprites)
+		{
+			return false;
+		}
+
+		m_Snapshots[i].commandLists = new vector<CommandListClass*>;
+		if(!m_Snapshots[i].commandLists)
+		{
+			return false;
+		}
+
+		for(j = 0; j < m_ThreadPool->GetThreadCount() + 1; j++)
+		{
+			commandList = new CommandListClass;
+			if(!commandList)
+			{
+				return false;
+			}
+
+			result = commandList->Initialize(COMMAND_LIST_SIZE);
+			if(!result)
+			{
+				return false;
+			}
+
+			m_Snapshots[i].commandLists->push_back(commandList);
+		}
+
+		m_Snapshots[i].recordResults = new bool[m_Snapshots[i].commandLists->size()];
+		if(!m_Snapshots[i].recordResults)
+		{
+			return false;
+		}
+	}
+
+	m_pipelineDepth = PIPELINE_DEPTH;
+	m_framesPrepared = 0;
+	m_framesSubmitted = 0;
+
+	// Create the queue that orders the recorded packets before they are submitted.
+	m_DrawQueue = new DrawQueueClass;
+	if(!m_DrawQueue)
+	{
+		return false;
+	}
+
+	result = m_DrawQueue->Initialize(DRAW_QUEUE_SIZE);
+	if(!result)
+	{
+		return false;
+	}
+
+	// Create the array of merged draws and constant blocks for the queued light packets.
+	m_LightDraws = new vector<LightDrawType>;
+	if(!m_LightDraws)
+	{
+		return false;
+	}
+
+	m_LightDraws->reserve(DRAW_QUEUE_SIZE);
+
+	// Create the sprite batch the bitmaps are drawn through, and the list the sprites are queued in between frames.
+	m_SpriteBatch = new SpriteBatchClass;
+	if(!m_SpriteBatch)
+	{
+		return false;
+	}
+
+	result = m_SpriteBatch->Initialize(m_D3D ? m_D3D->GetDevice() : 0, SPRITE_BATCH_MAX_SPRITES);
+	if(!result)
+	{
+		return false;
+	}
+
+	m_Sprites = new vector<SpriteType>;
+	if(!m_Sprites)
+	{
+		return false;
+	}
+
+	m_SpriteDraws = new vector<int>;
+	if(!m_SpriteDraws)
+	{
+		return false;
+	}
+
+	m_SpriteDraws->reserve(DRAW_QUEUE_SIZE);
+
+	return true;
+}
+
+void GraphicsClass::LoadModelTask(void* context, int index)
+{
+	ModelLoadType* load;
+
+
+	// The model's place in the shared index buffer is only known once it is added, so it starts at zero.
+	load = &((ModelLoadType*)context)[index];
+	load->model = new ModelClass;
+	if(!load->model)
+	{
+		return;
+	}
+
+	load->result = load->model->Initialize(load->device, load->meshPath, load->texturePath, 0);
+
+	return;
+}
+
+void GraphicsClass::RecordTask(void* context, int list)
+{
+	GraphicsClass* graphics = (GraphicsClass*)context;
+
+	graphics->m_Snapshots[graphics->m_prepareSnapshot].recordResults[list] = graphics->RecordCommands(list);
+	return;
+}
+
+bool GraphicsClass::RecordCommands(int list)
+{
+	PROFILE_ZONE("GraphicsClass::RecordCommands");
+	CommandListClass* commands;
+	CommandListClass::LightCommandType* light;
+	vector<SpriteType>* sprites;
+	BitmapClass* bitmap;
+	unsigned long long key;
+	D3DXVECTOR3 center, viewPosition;
+	int sceneLists, modelCount, first, last, visible, texture, buffer, levelStart, levelCount, i;
+
+
+	commands = (*m_Snapshots[m_prepareSnapshot].commandLists)[list];
+	commands->Reset();
+
+	// The last list draws the bitmaps over the scene with the Z buffer disabled.
+	sceneLists = (int)m_Snapshots[m_prepareSnapshot].commandLists->size() - 1;
+	if(list == sceneLists)
+	{
+		key = DrawQueueClass::MakeKey(DrawQueueClass::PASS_OVERLAY, false, DrawQueueClass::SHADER_NONE, 0, 0, 0.0f);
+		if(!commands->SetDepth(false, key))
+		{
+			return false;
+		}
+
+		// Every loaded bitmap is drawn on the bottom layer.
+		for (i = 0; i < m_Bitmaps->GetCount(); i++)
+		{
+			if(!RecordSprite(commands, (BitmapClass*)m_Bitmaps->GetItem(i), m_Bitmaps->GetItemHandle(i), 100, 100, 0))
+			{
+				return false;
+			}
+		}
+
+		// Then the sprites queued for the frame, skipping any whose bitmap has been released since.
+		sprites = m_Snapshots[m_prepareSnapshot].sprites;
+		for (i = 0; i < (int)sprites->size(); i++)
+		{
+			bitmap = (BitmapClass*)m_Bitmaps->Get((*sprites)[i].bitmap);
+			if(!bitmap)
+			{
+				continue;
+			}
+
+			if(!RecordSprite(commands, bitmap, (*sprites)[i].bitmap, (*sprites)[i].positionX, (*sprites)[i].positionY,
+				(*sprites)[i].layer))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Every other list takes an even share of the visible models, in order.
+	modelCount = (int)m_VisibleModels->size();
+	first = (list * modelCount) / sceneLists;
+	last = ((list + 1) * modelCount) / sceneLists;
+
+	for(visible = first; visible < last; visible++)
+	{
+		i = (*m_VisibleModels)[visible];
+
+		// Find the view depth of the model's center, from the world space box culling moved it into.
+		center = ((*m_WorldMinimums)[i] + (*m_WorldMaximums)[i]) * 0.5f;
+		D3DXVec3TransformCoord(&viewPosition, &center, &m_frame.viewMatrix);
+
+		// With Direct3D the models whose textures share an array bind the same texture.  Ordering them by model after that
+		// keeps their index ranges back to back, so the whole group merges into one draw instead of going front to back.
+		// The software renderer has no state to group by, so its models go front to back for the hierarchical Z buffer.
+		texture = m_Software ? 0 : (*m_ModelTextures)[i];
+		buffer = m_Software ? 0 : i;
+
+		key = DrawQueueClass::MakeKey(DrawQueueClass::PASS_SCENE, false, DrawQueueClass::SHADER_LIGHT, texture, buffer, viewPosition.z / SCREEN_DEPTH);
+		light = commands->AddLight(key);
+		if(!light)
+		{
+			return false;
+		}
+
+		// Pack the range of the model's chosen level and the light shader constants.
+		m_Lod->GetRange(i, (*m_ModelLevels)[i], levelStart, levelCount);
+		light->model = i;
+		light->texture = texture;
+		light->indexCount = levelCount;
+		light->indexStart = (*m_ModelIndices)[(i*2)+1] + levelStart;
+		light->worldMatrix = m_frame.worldMatrix;
+		light->viewMatrix = m_frame.viewMatrix;
+		light->projectionMatrix = m_frame.projectionMatrix;
+		light->ambientColor = m_Light->GetAmbientColor();
+		light->diffuseColor = m_Light->GetDiffuseColor();
+		light->lightDirection = m_Light->GetDirection();
+		light->specularPower = m_Light->GetSpecularPower();
+		light->specularColor = m_Light->GetSpecularColor();
+		light->cameraPosition = m_frame.cameraPosition;
+	}
+
+	return true;
+}
+
+bool GraphicsClass::RecordSprite(CommandListClass* commands, BitmapClass* bitmap, unsigned int handle, int positionX, int positionY,
+	int layer)
+{
+	CommandListClass::BitmapCommandType* command;
+	unsigned long long key;
+	float depth;
+
+
+	// Sprites blend over each other, so they are keyed like translucent draws: by layer first, from the bottom up,
+	// and then by the bitmap's slot, which puts the sprites of one bitmap on a layer together for the batch.
+	layer = min(max(layer, 0), SPRITE_LAYER_COUNT - 1);
+	depth = (float)(SPRITE_LAYER_COUNT - 1 - layer) / (float)(SPRITE_LAYER_COUNT - 1);
+	key = DrawQueueClass::MakeKey(DrawQueueClass::PASS_OVERLAY, true, DrawQueueClass::SHADER_TEXTURE, handle & HANDLE_INDEX_MASK, 0, depth);
+
+	command = commands->AddBitmap(key);
+	if(!command)
+	{
+		return false;
+	}
+
+	command->bitmap = bitmap;
+	command->positionX = positionX;
+	command->positionY = positionY;
+	command->worldMatrix = m_frame.UIWorldMatrix;
+	command->viewMatrix = m_frame.viewMatrix;
+	command->projectionMatrix = m_frame.orthoMatrix;
+
+	return true;
+}
+
+bool GraphicsClass::ExecuteCommands()
+{
+	PROFILE_ZONE("GraphicsClass::ExecuteCommands");
+	CommandListClass::HeaderType* command;
+	CommandListClass::DepthCommandType* depth;
+	CommandListClass::LightCommandType* light;
+	CommandListClass::LightCommandType* previous;
+	CommandListClass::BitmapCommandType* bitmap;
+	CommandListClass::BitmapCommandType* previousBitmap;
+	bool result, buffersBound, depthEnable;
+	int run, batch, i;
+
+
+	m_drawCalls = 0;
+
+	// Gather the bitmap packets into sprite batches.  A packet that starts a batch keeps its number and the ones
+	// that joined it are skipped when the queue is submitted.
+	m_SpriteBatch->Begin();
+	m_SpriteDraws->resize(m_DrawQueue->GetCount());
+	previousBitmap = 0;
+
+	for(i = 0; i < m_DrawQueue->GetCount(); i++)
+	{
+		command = m_DrawQueue->GetCommand(i);
+		if(command->type != CommandListClass::COMMAND_BITMAP)
+		{
+			previousBitmap = 0;
+			continue;
+		}
+
+		bitmap = (CommandListClass::BitmapCommandType*)command;
+
+		result = m_SpriteBatch->AddSprite(bitmap->bitmap, bitmap->positionX, bitmap->positionY,
+			previousBitmap && CommandListClass::CanMerge(previousBitmap, bitmap), batch);
+		if(!result)
+		{
+			return false;
+		}
+
+		(*m_SpriteDraws)[i] = batch;
+		previousBitmap = bitmap;
+	}
+
+	if(!m_Software)
+	{
+		result = m_SpriteBatch->Upload(m_D3D->GetDeviceContext());
+		if(!result)
+		{
+			return false;
+		}
+	}
+
+	// Merge neighbouring light draws that can be issued as one and write the constants of the rest before any is submitted,
+	// so they are uploaded in one go.
+	if(!m_Software)
+	{
+		m_LightDraws->resize(m_DrawQueue->GetCount());
+		previous = 0;
+		run = 0;
+
+		for(i = 0; i < m_DrawQueue->GetCount(); i++)
+		{
+			command = m_DrawQueue->GetCommand(i);
+			if(command->type != CommandListClass::COMMAND_LIGHT)
+			{
+				previous = 0;
+				continue;
+			}
+
+			light = (CommandListClass::LightCommandType*)command;
+
+			// A merged packet adds its range to the first draw of the run and is skipped when the queue is submitted.
+			if(previous && CommandListClass::CanMerge(previous, light))
+			{
+				(*m_LightDraws)[run].indexCount += light->indexCount;
+				(*m_LightDraws)[i].indexCount = 0;
+				previous = light;
+				continue;
+			}
+
+			result = m_LightShader->SetConstants(light->worldMatrix, light->viewMatrix, light->projectionMatrix, light->lightDirection,
+				light->ambientColor, light->diffuseColor, light->cameraPosition, light->specularColor, light->specularPower,
+				(*m_LightDraws)[i].constants);
+			if(!result)
+			{
+				return false;
+			}
+
+			(*m_LightDraws)[i].indexCount = light->indexCount;
+			previous = light;
+			run = i;
+		}
+
+		result = m_D3D->GetConstantAllocator()->Upload();
+		if(!result)
+		{
+			return false;
+		}
+	}
+
+	buffersBound = false;
+	depthEnable = true;
+
+	for(i = 0; i < m_DrawQueue->GetCount(); i++)
+	{
+		command = m_DrawQueue->GetCommand(i);
+
+		switch(command->type)
+		{
+			case CommandListClass::COMMAND_DEPTH:
+			{
+				depth = (CommandListClass::DepthCommandType*)command;
+				depthEnable = depth->enable;
+
+				if(m_Software && depth->enable)
+				{
+					m_Software->TurnZBufferOn();
+				}
+				else if(m_Software)
+				{
+					m_Software->TurnZBufferOff();
+				}
+				else if(depth->enable)
+				{
+					m_D3D->TurnZBufferOn();
+				}
+				else
+				{
+					m_D3D->TurnZBufferOff();
+				}
+				break;
+			}
+
+			case CommandListClass::COMMAND_LIGHT:
+			{
+				light = (CommandListClass::LightCommandType*)command;
+
+				// Draw the model's range of the shared vertex data with its own texture.
+				if(m_Software)
+				{
+					result = m_Software->RenderLight(light->indexCount, light->indexStart, light->worldMatrix, light->viewMatrix,
+						light->projectionMatrix, (*m_SoftwareTextures)[light->model], light->lightDirection, light->ambientColor,
+						light->diffuseColor, light->cameraPosition, light->specularColor, light->specularPower);
+				}
+				else
+				{
+					// Skip the packets that were merged into an earlier draw.
+					if((*m_LightDraws)[i].indexCount == 0)
+					{
+						break;
+					}
+
+					// Put the shared model buffers back on the pipeline if a bitmap replaced them.
+					if(!buffersBound)
+					{
+						m_Buffers->RenderBuffers(m_D3D->GetDeviceContext());
+						buffersBound = true;
+					}
+
+					// Draw the whole run with the texture array its models share.
+					result = m_LightShader->Render(m_D3D->GetDeviceContext(), (*m_LightDraws)[i].indexCount, light->indexStart,
+						(*m_LightDraws)[i].constants, m_TextureArrays->GetTexture(light->texture));
+				}
+
+				if(!result)
+				{
+					return false;
+				}
+
+				m_drawCalls++;
+				break;
+			}
+
+			case CommandListClass::COMMAND_BITMAP:
+			{
+				bitmap = (CommandListClass::BitmapCommandType*)command;
+
+				// Skip the packets that joined an earlier batch.
+				batch = (*m_SpriteDraws)[i];
+				if(batch == -1)
+				{
+					break;
+				}
+
+				// Draw the whole batch with the matrices of its first packet, which every packet in it shares.
+				if(m_Software)
+				{
+					result = m_SpriteBatch->Render(m_Software, batch, bitmap->worldMatrix, bitmap->viewMatrix, bitmap->projectionMatrix);
+				}
+				else
+				{
+					result = m_SpriteBatch->Render(m_D3D->GetDeviceContext(), m_TextureShader, batch, bitmap->worldMatrix,
+						bitmap->viewMatrix, bitmap->projectionMatrix);
+					buffersBound = false;
+				}
+
+				if(!result)
+				{
+					return false;
+				}
+
+				m_drawCalls++;
+				break;
+			}
+		}
+	}
+
+	// Leave the Z buffer on for the next frame if a pass turned it off.
+	if(!depthEnable && m_Software)
+	{
+		m_Software->TurnZBufferOn();
+	}
+	else if(!depthEnable)
+	{
+		m_D3D->TurnZBufferOn();
+	}
+
+	return true;
+}
@@ -4,8 +4,6 @@
 #ifndef _GRAPHICSCLASS_H_
 #define _GRAPHICSCLASS_H_
 
-#pragma comment(lib, "rpcrt4.lib")
-
 ///////////////////////
 // MY CLASS INCLUDES //
 ///////////////////////
@@ -17,7 +15,21 @@
 #include "lightclass.h"
 #include "bitmapclass.h"
 #include "bufferclass.h"
-#include <unordered_map>
+#include "texturearrayclass.h"
+#include "softwarerendererclass.h"
+#include "commandlistclass.h"
+#include "drawqueueclass.h"
+#include "threadpoolclass.h"
+#include "cullingclass.h"
+#include "spatialtreeclass.h"
+#include "occlusionclass.h"
+#include "lodclass.h"
+#include "textclass.h"
+#include "profilerclass.h"
+#include "frameallocatorclass.h"
+#include "memorytrackerclass.h"
+#include "handletableclass.h"
+#include "spritebatchclass.h"
 #include <string>
 
 
@@ -28,6 +40,13 @@ const bool FULL_SCREEN = false;
 const bool VSYNC_ENABLED = false;
 const float SCREEN_DEPTH = 1000.0f;
 const float SCREEN_NEAR = 0.1f;
+const int COMMAND_LIST_SIZE = 16384;
+const int DRAW_QUEUE_SIZE = 1024;
+const int PROFILE_LINE_COUNT = 16;
+const int PROFILE_LINE_LENGTH = 64;
+const int PROFILE_LINE_HEIGHT = 16;
+const int PIPELINE_DEPTH = 2;
+const int PIPELINE_MAX_DEPTH = 3;
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -35,16 +54,91 @@ const float SCREEN_NEAR = 0.1f;
 ////////////////////////////////////////////////////////////////////////////////
 class GraphicsClass
 {
+public:
+	// Handles to the resources loaded into the graphics, a different type for each kind so one cannot be passed
+	// for the other.  A value of HANDLE_INVALID means the load failed.
+	struct ModelHandleType
+	{
+		unsigned int value;
+	};
+
+	struct BitmapHandleType
+	{
+		unsigned int value;
+	};
+
+private:
+	// The camera and matrices of the frame being recorded.
+	struct FrameType
+	{
+		D3DXMATRIX worldMatrix;
+		D3DXMATRIX viewMatrix;
+		D3DXMATRIX projectionMatrix;
+		D3DXMATRIX orthoMatrix;
+		D3DXMATRIX UIWorldMatrix;
+		D3DXVECTOR3 cameraPosition;
+	};
+
+	// The volumes a model fits in, around its own origin.
+	struct ModelBoundsType
+	{
+		D3DXVECTOR3 center;
+		D3DXVECTOR3 extents;
+		float radius;
+	};
+
+	// A model being loaded on a worker thread.
+	struct ModelLoadType
+	{
+		ID3D11Device* device;
+		char* meshPath;
+		WCHAR* texturePath;
+		ModelClass* model;
+		bool result;
+	};
+
+	// A bitmap queued to be drawn in the next frame.
+	struct SpriteType
+	{
+		unsigned int bitmap;
+		int positionX, positionY;
+		int layer;
+	};
+
+	// A frame in the pipeline: the scene state it was started with and the draws recorded from it.
+	struct SnapshotType
+	{
+		FrameType frame;
+		vector<SpriteType>* sprites;
+		vector<CommandListClass*>* commandLists;
+		bool* recordResults;
+		ThreadPoolClass::CounterType preparing;
+		bool result;
+	};
+
+	// A queued light draw, with the packets merged into it, and its constants.
+	struct LightDrawType
+	{
+		LightShaderClass::ConstantsType constants;
+		int indexCount;
+	};
+
 public:
 	GraphicsClass();
 	GraphicsClass(const GraphicsClass&);
 	~GraphicsClass();
 
 	bool Initialize(int, int, HWND);
+	bool InitializeHeadless(int, int, int);
 	void Shutdown();
 
-    string LoadBitmapResource(WCHAR*, int, int);
-    string LoadModelResource(char*, WCHAR*);
+	BitmapHandleType LoadBitmapResource(WCHAR*, int, int);
+	ModelHandleType LoadModelResource(char*, WCHAR*, bool = false);
+	bool LoadModelResources(int, char**, WCHAR**, vector<ModelHandleType>&);
+	bool ReleaseBitmapResource(BitmapHandleType);
+	BitmapClass* GetBitmap(BitmapHandleType);
+	ModelClass* GetModel(ModelHandleType);
+	bool AddSprite(BitmapHandleType, int, int, int);
 
     int getScreenWidth();
     int getScreenHeight();
@@ -54,19 +148,89 @@ public:
 
 	bool Frame(float, float, float, float, float, float);
 	bool Render(float, float, float);
+	bool SetPipelineDepth(int);
+	int GetPipelineDepth();
+	bool SaveFrame(char*);
+	int GetStateChanges(bool);
+	int GetDrawCalls();
+
+	void QueryRegion(D3DXVECTOR3&, D3DXVECTOR3&, vector<ModelHandleType>&);
+	void QueryFrustum(D3DXMATRIX&, D3DXMATRIX&, vector<ModelHandleType>&);
+	bool RayCast(D3DXVECTOR3&, D3DXVECTOR3&, ModelHandleType&, float&);
+
+	void GetOcclusionStats(int&, int&, int&, float&, float&);
+	bool SaveOcclusionDepth(char*);
+
+	void SetLodBias(float);
+	void GetLodStats(int&, int&, int&);
+
+	void ShowProfile(bool);
+
+	void SetHierarchicalZ(bool);
+	float GetRejectedPixelRatio();
+	float GetVerticesPerTriangle();
+	bool GetFrame(vector<unsigned int>&);
+
+private:
+	bool InitializeCommandLists(int);
+	static void PrepareTask(void*, int);
+	bool PrepareFrame(int);
+	bool SubmitFrame(int);
+	bool FlushFrames();
+	void WaitForPrepare();
+	ModelHandleType AddModel(ModelClass*, WCHAR*, bool);
+	static void LoadModelTask(void*, int);
+	bool CullModels();
+	void SelectLevels();
+	static void RecordTask(void*, int);
+	bool RecordCommands(int);
+	bool RecordSprite(CommandListClass*, BitmapClass*, unsigned int, int, int, int);
+	bool ExecuteCommands();
+	bool RenderProfile(FrameType&);
+	static void ProfileLineTask(void*, int);
 
 public:
 	D3DClass* m_D3D;
 	BufferClass* m_Buffers;
+	SoftwareRendererClass* m_Software;
     int m_screenWidth, m_screenHeight;
 	CameraClass* m_Camera;
 	LightShaderClass* m_LightShader;
     TextureShaderClass* m_TextureShader;
 	LightClass* m_Light;
-    unordered_map<string, BitmapClass*>* m_Bitmaps;
-    unordered_map<string, ModelClass*>* m_Models;
+	HandleTableClass* m_Bitmaps;
+	HandleTableClass* m_Models;
 	vector<int>* m_ModelIndices;
-	vector<ID3D11ShaderResourceView*>* m_Textures;
+	vector<ModelBoundsType>* m_ModelBounds;
+	vector<int>* m_ModelProxies;
+	vector<int>* m_ModelOccluders;
+	vector<D3DXVECTOR3>* m_WorldMinimums;
+	vector<D3DXVECTOR3>* m_WorldMaximums;
+	vector<int>* m_VisibleModels;
+	vector<int>* m_ModelLevels;
+	TextureArrayClass* m_TextureArrays;
+	vector<int>* m_ModelTextures;
+	vector<SoftwareTextureClass*>* m_SoftwareTextures;
+	ThreadPoolClass* m_ThreadPool;
+	CullingClass* m_Culling;
+	SpatialTreeClass* m_SpatialTree;
+	OcclusionClass* m_Occlusion;
+	LodClass* m_Lod;
+	TextClass* m_Text;
+	vector<string>* m_profileLines;
+	unsigned int m_profileTexts[PROFILE_LINE_COUNT];
+	ThreadPoolClass::CounterType m_profileCounter;
+	bool m_profileResults[PROFILE_LINE_COUNT];
+	bool m_showProfile;
+	SnapshotType* m_Snapshots;
+	int m_pipelineDepth, m_framesPrepared, m_framesSubmitted, m_prepareSnapshot;
+	DrawQueueClass* m_DrawQueue;
+	vector<LightDrawType>* m_LightDraws;
+	SpriteBatchClass* m_SpriteBatch;
+	vector<SpriteType>* m_Sprites;
+	vector<int>* m_SpriteDraws;
+	int m_drawCalls;
+	FrameType m_frame;
 };
 
 #endif
\ No newline at end of file
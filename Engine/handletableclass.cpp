@@ -0,0 +1,212 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: handletableclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "handletableclass.h"
+
+
+HandleTableClass::HandleTableClass()
+{
+	m_slots = 0;
+	m_items = 0;
+	m_itemSlots = 0;
+	m_freeList = -1;
+}
+
+
+HandleTableClass::HandleTableClass(const HandleTableClass& other)
+{
+}
+
+
+HandleTableClass::~HandleTableClass()
+{
+}
+
+
+bool HandleTableClass::Initialize()
+{
+	// Create the slots.
+	m_slots = new vector<SlotType>;
+	if(!m_slots)
+	{
+		return false;
+	}
+
+	m_slots->reserve(HANDLE_TABLE_INITIAL_SLOTS);
+
+	// Create the dense item array and the slot each item belongs to.
+	m_items = new vector<void*>;
+	if(!m_items)
+	{
+		return false;
+	}
+
+	m_items->reserve(HANDLE_TABLE_INITIAL_SLOTS);
+
+	m_itemSlots = new vector<int>;
+	if(!m_itemSlots)
+	{
+		return false;
+	}
+
+	m_itemSlots->reserve(HANDLE_TABLE_INITIAL_SLOTS);
+
+	m_freeList = -1;
+
+	return true;
+}
+
+
+void HandleTableClass::Shutdown()
+{
+	// Release the item arrays.
+	if(m_itemSlots)
+	{
+		delete m_itemSlots;
+		m_itemSlots = 0;
+	}
+
+	if(m_items)
+	{
+		delete m_items;
+		m_items = 0;
+	}
+
+	// Release the slots.
+	if(m_slots)
+	{
+		delete m_slots;
+		m_slots = 0;
+	}
+
+	m_freeList = -1;
+
+	return;
+}
+
+
+unsigned int HandleTableClass::Add(void* item)
+{
+	SlotType slot;
+	int index;
+
+
+	// Reuse a freed slot if there is one, otherwise add a new one while there are indices left.
+	if(m_freeList != -1)
+	{
+		index = m_freeList;
+		m_freeList = (*m_slots)[index].nextFree;
+	}
+	else
+	{
+		if(m_slots->size() > HANDLE_INDEX_MASK)
+		{
+			return HANDLE_INVALID;
+		}
+
+		slot.generation = 1;
+		slot.item = -1;
+		slot.nextFree = -1;
+		m_slots->push_back(slot);
+
+		index = (int)m_slots->size() - 1;
+	}
+
+	// Put the item at the end of the dense array.
+	(*m_slots)[index].item = (int)m_items->size();
+	(*m_slots)[index].nextFree = -1;
+	m_items->push_back(item);
+	m_itemSlots->push_back(index);
+
+	return ((*m_slots)[index].generation << HANDLE_INDEX_BITS) | (unsigned int)index;
+}
+
+
+bool HandleTableClass::Remove(unsigned int handle)
+{
+	int index, item, last;
+
+
+	if(!IsValid(handle))
+	{
+		return false;
+	}
+
+	index = (int)(handle & HANDLE_INDEX_MASK);
+	item = (*m_slots)[index].item;
+
+	// Fill the hole with the last item so the array stays packed.
+	last = (int)m_items->size() - 1;
+	if(item != last)
+	{
+		(*m_items)[item] = (*m_items)[last];
+		(*m_itemSlots)[item] = (*m_itemSlots)[last];
+		(*m_slots)[(*m_itemSlots)[item]].item = item;
+	}
+
+	m_items->pop_back();
+	m_itemSlots->pop_back();
+
+	// Move the slot on a generation, skipping zero when it wraps, so the handles to it go stale.
+	(*m_slots)[index].generation = ((*m_slots)[index].generation + 1) & HANDLE_GENERATION_MASK;
+	if((*m_slots)[index].generation == 0)
+	{
+		(*m_slots)[index].generation = 1;
+	}
+
+	(*m_slots)[index].item = -1;
+	(*m_slots)[index].nextFree = m_freeList;
+	m_freeList = index;
+
+	return true;
+}
+
+
+void* HandleTableClass::Get(unsigned int handle)
+{
+	if(!IsValid(handle))
+	{
+		return 0;
+	}
+
+	return (*m_items)[(*m_slots)[handle & HANDLE_INDEX_MASK].item];
+}
+
+
+bool HandleTableClass::IsValid(unsigned int handle)
+{
+	unsigned int index;
+
+
+	// The slot has to exist, hold an item, and still be on the generation the handle was made with.
+	index = handle & HANDLE_INDEX_MASK;
+	if(index >= m_slots->size())
+	{
+		return false;
+	}
+
+	return ((*m_slots)[index].item != -1) && ((*m_slots)[index].generation == (handle >> HANDLE_INDEX_BITS));
+}
+
+
+int HandleTableClass::GetCount()
+{
+	return (int)m_items->size();
+}
+
+
+void* HandleTableClass::GetItem(int item)
+{
+	return (*m_items)[item];
+}
+
+
+unsigned int HandleTableClass::GetItemHandle(int item)
+{
+	int index;
+
+
+	index = (*m_itemSlots)[item];
+
+	return ((*m_slots)[index].generation << HANDLE_INDEX_BITS) | (unsigned int)index;
+}
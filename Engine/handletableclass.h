@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: handletableclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _HANDLETABLECLASS_H_
+#define _HANDLETABLECLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <vector>
+using namespace std;
+
+
+/////////////
+// GLOBALS //
+/////////////
+const unsigned int HANDLE_INVALID = 0;
+const int HANDLE_INDEX_BITS = 20;
+const unsigned int HANDLE_INDEX_MASK = (1u << HANDLE_INDEX_BITS) - 1;
+const unsigned int HANDLE_GENERATION_MASK = (1u << (32 - HANDLE_INDEX_BITS)) - 1;
+const int HANDLE_TABLE_INITIAL_SLOTS = 64;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: HandleTableClass
+// Hands out 32 bit handles to items, with the low HANDLE_INDEX_BITS picking a
+// slot and the rest holding the slot's generation.  Removing an item bumps
+// its slot's generation, so a handle kept past the removal no longer matches
+// and Get returns null for it instead of whatever reuses the slot.  Slot
+// generations start at one, which leaves zero free to mean no handle.
+//
+// The items themselves are kept packed in a dense array, and each slot holds
+// the item's place in it.  Removal moves the last item into the hole, so
+// walking the live items with GetItem is a straight run through memory.
+// Freed slots are kept on a list for reuse.
+////////////////////////////////////////////////////////////////////////////////
+class HandleTableClass
+{
+private:
+	struct SlotType
+	{
+		unsigned int generation;
+		int item;
+		int nextFree;
+	};
+
+public:
+	HandleTableClass();
+	HandleTableClass(const HandleTableClass&);
+	~HandleTableClass();
+
+	bool Initialize();
+	void Shutdown();
+
+	unsigned int Add(void*);
+	bool Remove(unsigned int);
+	void* Get(unsigned int);
+	bool IsValid(unsigned int);
+
+	int GetCount();
+	void* GetItem(int);
+	unsigned int GetItemHandle(int);
+
+private:
+	vector<SlotType>* m_slots;
+	vector<void*>* m_items;
+	vector<int>* m_itemSlots;
+	int m_freeList;
+};
+
+#endif
@@ -6,15 +6,15 @@
 /////////////
 // GLOBALS //
 /////////////
-cbuffer MatrixBuffer
+cbuffer ObjectBuffer : register(b0)
 {
 	matrix worldMatrix;
-	matrix viewMatrix;
-	matrix projectionMatrix;
 };
 
-cbuffer CameraBuffer
+cbuffer ViewBuffer : register(b1)
 {
+	matrix viewMatrix;
+	matrix projectionMatrix;
     float3 cameraPosition;
     float padding;
 };
@@ -27,6 +27,7 @@ struct VertexInputType
     float4 position : POSITION;
     float2 tex : TEXCOORD0;
 	float3 normal : NORMAL;
+    uint slice : SLICE;
 };
 
 struct PixelInputType
@@ -35,6 +36,7 @@ struct PixelInputType
     float2 tex : TEXCOORD0;
 	float3 normal : NORMAL;
     float3 viewDirection : TEXCOORD1;
+    nointerpolation uint slice : TEXCOORD2;
 };
 
 
@@ -57,6 +59,9 @@ PixelInputType LightVertexShader(VertexInputType input)
     
 	// Store the texture coordinates for the pixel shader.
 	output.tex = input.tex;
+
+    // Pass on the slice of the texture array that holds the model's texture.
+    output.slice = input.slice;
     
 	// Calculate the normal vector against the world matrix only.
     output.normal = mul(input.normal, (float3x3)worldMatrix);
@@ -2,17 +2,18 @@
 // Filename: lightshaderclass.cpp
 ////////////////////////////////////////////////////////////////////////////////
 #include "lightshaderclass.h"
+#include <string.h>
 
 
 LightShaderClass::LightShaderClass()
 {
+	m_PipelineState = 0;
+	m_ConstantAllocator = 0;
 	m_vertexShader = 0;
 	m_pixelShader = 0;
 	m_layout = 0;
 	m_sampleState = 0;
-	m_matrixBuffer = 0;
-    m_cameraBuffer = 0;
-	m_lightBuffer = 0;
+	memset(&m_constants, 0, sizeof(m_constants));
 }
 
 
@@ -26,11 +27,16 @@ LightShaderClass::~LightShaderClass()
 }
 
 
-bool LightShaderClass::Initialize(ID3D11Device* device, HWND hwnd)
+bool LightShaderClass::Initialize(ID3D11Device* device, PipelineStateClass* pipelineState, ConstantAllocatorClass* constantAllocator,
+								  HWND hwnd)
 {
 	bool result;
 
 
+	// Store the pipeline state object that state is shared and bound through, and the allocator the constants come from.
+	m_PipelineState = pipelineState;
+	m_ConstantAllocator = constantAllocator;
+
 	// Initialize the vertex and pixel shaders.
 	result = InitializeShader(device, hwnd, L"../Engine/light.vs", L"../Engine/light.ps");
 	if(!result)
@@ -51,33 +57,121 @@ void LightShaderClass::Shutdown()
 }
 
 
-bool LightShaderClass::Render(ID3D11DeviceContext* deviceContext, int indexCount, D3DXMATRIX worldMatrix, D3DXMATRIX viewMatrix, 
-                              D3DXMATRIX projectionMatrix, vector<ID3D11ShaderResourceView*>* textures, int numTextures, vector<int>* drawIndices,
+bool LightShaderClass::Render(ID3D11DeviceContext* deviceContext, int indexCount, int indexStart, D3DXMATRIX worldMatrix,
+							  D3DXMATRIX viewMatrix, D3DXMATRIX projectionMatrix, ID3D11ShaderResourceView* texture,
 							  D3DXVECTOR3 lightDirection, D3DXVECTOR4 ambientColor, D3DXVECTOR4 diffuseColor,
 							  D3DXVECTOR3 cameraPosition, D3DXVECTOR4 specularColor, float specularPower)
 {
 	bool result;
-	int indexSize, indexOffset;
-	ID3D11ShaderResourceView* res;
+
+
 	// Set the shader parameters that it will use for rendering.
-	result = SetShaderParameters(deviceContext, worldMatrix, viewMatrix, projectionMatrix, lightDirection, ambientColor,
-        diffuseColor, cameraPosition, specularColor, specularPower);
+	result = SetShaderParameters(worldMatrix, viewMatrix, projectionMatrix, lightDirection, ambientColor, diffuseColor,
+		cameraPosition, specularColor, specularPower);
+	if(!result)
+	{
+		return false;
+	}
+
+	// Set shader texture resource in the pixel shader.
+	m_PipelineState->SetPSShaderResource(0, texture);
+
+	// Now render the prepared range of the buffers with the shader.
+	RenderShader(deviceContext, indexCount, indexStart);
+
+	return true;
+}
+
+
+bool LightShaderClass::Render(ID3D11DeviceContext* deviceContext, int indexCount, int indexStart, ConstantsType& constants,
+							  ID3D11ShaderResourceView* texture)
+{
+	bool result;
+
+
+	// Bind the constant blocks that were set and uploaded before the draw.
+	result = BindConstants(constants);
 	if(!result)
 	{
 		return false;
 	}
 
-	for (int i = 0; i < numTextures; i++)
+	// Set shader texture resource in the pixel shader.
+	m_PipelineState->SetPSShaderResource(0, texture);
+
+	// Now render the prepared range of the buffers with the shader.
+	RenderShader(deviceContext, indexCount, indexStart);
+
+	return true;
+}
+
+
+bool LightShaderClass::SetConstants(D3DXMATRIX worldMatrix, D3DXMATRIX viewMatrix, D3DXMATRIX projectionMatrix,
+									D3DXVECTOR3 lightDirection, D3DXVECTOR4 ambientColor, D3DXVECTOR4 diffuseColor,
+									D3DXVECTOR3 cameraPosition, D3DXVECTOR4 specularColor, float specularPower,
+									ConstantsType& constants)
+{
+	ObjectBufferType* dataPtr;
+	ViewBufferType* dataPtr2;
+	LightBufferType* dataPtr3;
+	LightBufferType light;
+
+
+	// Write the world matrix into a new block if it differs from the last one written.
+	if(!m_ConstantAllocator->IsValid(m_constants.object) || (worldMatrix != m_worldMatrix))
+	{
+		dataPtr = (ObjectBufferType*)m_ConstantAllocator->Allocate(sizeof(ObjectBufferType), m_constants.object);
+		if(!dataPtr)
+		{
+			return false;
+		}
+
+		// Transpose the matrix to prepare it for the shader.
+		D3DXMatrixTranspose(&dataPtr->world, &worldMatrix);
+		m_worldMatrix = worldMatrix;
+	}
+
+	// Do the same for the view, projection and camera position, which normally only change once a frame.
+	if(!m_ConstantAllocator->IsValid(m_constants.view) || (viewMatrix != m_viewMatrix) || (projectionMatrix != m_projectionMatrix) ||
+		(cameraPosition != m_cameraPosition))
+	{
+		dataPtr2 = (ViewBufferType*)m_ConstantAllocator->Allocate(sizeof(ViewBufferType), m_constants.view);
+		if(!dataPtr2)
+		{
+			return false;
+		}
+
+		D3DXMatrixTranspose(&dataPtr2->view, &viewMatrix);
+		D3DXMatrixTranspose(&dataPtr2->projection, &projectionMatrix);
+		dataPtr2->cameraPosition = cameraPosition;
+		dataPtr2->padding = 0.0f;
+
+		m_viewMatrix = viewMatrix;
+		m_projectionMatrix = projectionMatrix;
+		m_cameraPosition = cameraPosition;
+	}
+
+	// And for the lighting variables.
+	light.ambientColor = ambientColor;
+	light.diffuseColor = diffuseColor;
+	light.lightDirection = lightDirection;
+	light.specularPower = specularPower;
+	light.specularColor = specularColor;
+
+	if(!m_ConstantAllocator->IsValid(m_constants.light) || (memcmp(&light, &m_light, sizeof(LightBufferType)) != 0))
 	{
-		res = (*textures)[i];
-		// Set shader texture resource in the pixel shader.
-		deviceContext->PSSetShaderResources(0, 1, &res);
+		dataPtr3 = (LightBufferType*)m_ConstantAllocator->Allocate(sizeof(LightBufferType), m_constants.light);
+		if(!dataPtr3)
+		{
+			return false;
+		}
 
-		// Now render the prepared buffers with the shader.
-		indexSize = (*drawIndices)[i*2];
-		RenderShader(deviceContext, (*drawIndices)[i*2], (*drawIndices)[(i*2)+1]);
+		*dataPtr3 = light;
+		m_light = light;
 	}
 
+	constants = m_constants;
+
 	return true;
 }
 
@@ -88,12 +182,9 @@ bool LightShaderClass::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR*
 	ID3D10Blob* errorMessage;
 	ID3D10Blob* vertexShaderBuffer;
 	ID3D10Blob* pixelShaderBuffer;
-	D3D11_INPUT_ELEMENT_DESC polygonLayout[3];
+	D3D11_INPUT_ELEMENT_DESC polygonLayout[4];
 	unsigned int numElements;
     D3D11_SAMPLER_DESC samplerDesc;
-	D3D11_BUFFER_DESC matrixBufferDesc;
-    D3D11_BUFFER_DESC cameraBufferDesc;
-	D3D11_BUFFER_DESC lightBufferDesc;
 
 
 	// Initialize the pointers this function will use to null.
@@ -156,7 +247,7 @@ bool LightShaderClass::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR*
 	}
 
 	// Create the vertex input layout description.
-	// This setup needs to match the VertexType stucture in the ModelClass and in the shader.
+	// This setup needs to match the VertexType stucture in the ModelClass, the slice stream in the BufferClass and the shader.
 	polygonLayout[0].SemanticName = "POSITION";
 	polygonLayout[0].SemanticIndex = 0;
 	polygonLayout[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
@@ -181,6 +272,15 @@ bool LightShaderClass::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR*
 	polygonLayout[2].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	polygonLayout[2].InstanceDataStepRate = 0;
 
+	// The texture array slice comes from a second stream with one value per vertex.
+	polygonLayout[3].SemanticName = "SLICE";
+	polygonLayout[3].SemanticIndex = 0;
+	polygonLayout[3].Format = DXGI_FORMAT_R32_UINT;
+	polygonLayout[3].InputSlot = 1;
+	polygonLayout[3].AlignedByteOffset = 0;
+	polygonLayout[3].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+	polygonLayout[3].InstanceDataStepRate = 0;
+
 	// Get a count of the elements in the layout.
     numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
 
@@ -214,55 +314,9 @@ bool LightShaderClass::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR*
     samplerDesc.MinLOD = 0;
     samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
 
-	// Create the texture sampler state.
-    result = device->CreateSamplerState(&samplerDesc, &m_sampleState);
-	if(FAILED(result))
-	{
-		return false;
-	}
-
-	// Setup the description of the dynamic matrix constant buffer that is in the vertex shader.
-    matrixBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	matrixBufferDesc.ByteWidth = sizeof(MatrixBufferType);
-    matrixBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    matrixBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    matrixBufferDesc.MiscFlags = 0;
-	matrixBufferDesc.StructureByteStride = 0;
-
-	// Create the constant buffer pointer so we can access the vertex shader constant buffer from within this class.
-	result = device->CreateBuffer(&matrixBufferDesc, NULL, &m_matrixBuffer);
-	if(FAILED(result))
-	{
-		return false;
-	}
-
-    // Setup the description of the camera dynamic constant buffer that is in the vertex shader.
-	cameraBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	cameraBufferDesc.ByteWidth = sizeof(CameraBufferType);
-	cameraBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	cameraBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	cameraBufferDesc.MiscFlags = 0;
-	cameraBufferDesc.StructureByteStride = 0;
-
-	// Create the camera constant buffer pointer so we can access the vertex shader constant buffer from within this class.
-	result = device->CreateBuffer(&cameraBufferDesc, NULL, &m_cameraBuffer);
-	if(FAILED(result))
-	{
-		return false;
-	}
-
-	// Setup the description of the light dynamic constant buffer that is in the pixel shader.
-	// Note that ByteWidth always needs to be a multiple of 16 if using D3D11_BIND_CONSTANT_BUFFER or CreateBuffer will fail.
-	lightBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	lightBufferDesc.ByteWidth = sizeof(LightBufferType);
-	lightBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	lightBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	lightBufferDesc.MiscFlags = 0;
-	lightBufferDesc.StructureByteStride = 0;
-
-	// Create the constant buffer pointer so we can access the vertex shader constant buffer from within this class.
-	result = device->CreateBuffer(&lightBufferDesc, NULL, &m_lightBuffer);
-	if(FAILED(result))
+	// Get the texture sampler state from the cache, which shares it with any other shader that asks for the same one.
+    m_sampleState = m_PipelineState->GetSamplerState(&samplerDesc);
+	if(!m_sampleState)
 	{
 		return false;
 	}
@@ -273,33 +327,13 @@ bool LightShaderClass::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR*
 
 void LightShaderClass::ShutdownShader()
 {
-    // Release the camera constant buffer.
-	if(m_cameraBuffer)
-	{
-		m_cameraBuffer->Release();
-		m_cameraBuffer = 0;
-	}
+	// The constant blocks belong to the allocator.
+	memset(&m_constants, 0, sizeof(m_constants));
+	m_ConstantAllocator = 0;
 
-	// Release the light constant buffer.
-	if(m_lightBuffer)
-	{
-		m_lightBuffer->Release();
-		m_lightBuffer = 0;
-	}
-
-	// Release the matrix constant buffer.
-	if(m_matrixBuffer)
-	{
-		m_matrixBuffer->Release();
-		m_matrixBuffer = 0;
-	}
-
-	// Release the sampler state.
-	if(m_sampleState)
-	{
-		m_sampleState->Release();
-		m_sampleState = 0;
-	}
+	// The sampler state belongs to the pipeline state cache.
+	m_sampleState = 0;
+	m_PipelineState = 0;
 
 	// Release the layout.
 	if(m_layout)
@@ -362,96 +396,57 @@ void LightShaderClass::OutputShaderErrorMessage(ID3D10Blob* errorMessage, HWND h
 }
 
 
-bool LightShaderClass::SetShaderParameters(ID3D11DeviceContext* deviceContext, D3DXMATRIX worldMatrix, D3DXMATRIX viewMatrix, 
-										   D3DXMATRIX projectionMatrix, D3DXVECTOR3 lightDirection, D3DXVECTOR4 ambientColor,
-										   D3DXVECTOR4 diffuseColor, D3DXVECTOR3 cameraPosition, D3DXVECTOR4 specularColor,
-										   float specularPower)
+bool LightShaderClass::SetShaderParameters(D3DXMATRIX worldMatrix, D3DXMATRIX viewMatrix, D3DXMATRIX projectionMatrix,
+										   D3DXVECTOR3 lightDirection, D3DXVECTOR4 ambientColor, D3DXVECTOR4 diffuseColor,
+										   D3DXVECTOR3 cameraPosition, D3DXVECTOR4 specularColor, float specularPower)
 {
-	HRESULT result;
-    D3D11_MAPPED_SUBRESOURCE mappedResource;
-	unsigned int bufferNumber;
-	MatrixBufferType* dataPtr;
-	LightBufferType* dataPtr2;
-    CameraBufferType* dataPtr3;
-
+	PROFILE_ZONE("LightShaderClass::SetShaderParameters");
+	ConstantsType constants;
+	bool result;
 
-	// Transpose the matrices to prepare them for the shader.
-	D3DXMatrixTranspose(&worldMatrix, &worldMatrix);
-	D3DXMatrixTranspose(&viewMatrix, &viewMatrix);
-	D3DXMatrixTranspose(&projectionMatrix, &projectionMatrix);
 
-	// Lock the constant buffer so it can be written to.
-	result = deviceContext->Map(m_matrixBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	if(FAILED(result))
+	// Write whichever blocks changed.
+	result = SetConstants(worldMatrix, viewMatrix, projectionMatrix, lightDirection, ambientColor, diffuseColor, cameraPosition,
+		specularColor, specularPower, constants);
+	if(!result)
 	{
 		return false;
 	}
 
-	// Get a pointer to the data in the constant buffer.
-	dataPtr = (MatrixBufferType*)mappedResource.pData;
-
-	// Copy the matrices into the constant buffer.
-	dataPtr->world = worldMatrix;
-	dataPtr->view = viewMatrix;
-	dataPtr->projection = projectionMatrix;
-
-	// Unlock the constant buffer.
-    deviceContext->Unmap(m_matrixBuffer, 0);
-
-	// Set the position of the constant buffer in the vertex shader.
-	bufferNumber = 0;
-
-	// Now set the constant buffer in the vertex shader with the updated values.
-    deviceContext->VSSetConstantBuffers(bufferNumber, 1, &m_matrixBuffer);
-
-    // Lock the camera constant buffer so it can be written to.
-	result = deviceContext->Map(m_cameraBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	if(FAILED(result))
+	// Upload them on their own, since this draw is not part of a batch.
+	result = m_ConstantAllocator->Upload();
+	if(!result)
 	{
 		return false;
 	}
 
-	// Get a pointer to the data in the constant buffer.
-	dataPtr3 = (CameraBufferType*)mappedResource.pData;
-
-	// Copy the camera position into the constant buffer.
-	dataPtr3->cameraPosition = cameraPosition;
-	dataPtr3->padding = 0.0f;
+	return BindConstants(constants);
+}
 
-	// Unlock the camera constant buffer.
-	deviceContext->Unmap(m_cameraBuffer, 0);
 
-    // Set the position of the camera constant buffer in the vertex shader.
-	bufferNumber = 1;
+bool LightShaderClass::BindConstants(ConstantsType& constants)
+{
+	bool result;
 
-	// Now set the camera constant buffer in the vertex shader with the updated values.
-	deviceContext->VSSetConstantBuffers(bufferNumber, 1, &m_cameraBuffer);
 
-	// Lock the light constant buffer so it can be written to.
-	result = deviceContext->Map(m_lightBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	if(FAILED(result))
+	// Bind the object and view blocks in the vertex shader and the light block in the pixel shader.
+	result = m_ConstantAllocator->Bind(ConstantAllocatorClass::STAGE_VERTEX, 0, constants.object);
+	if(!result)
 	{
 		return false;
 	}
 
-	// Get a pointer to the data in the constant buffer.
-	dataPtr2 = (LightBufferType*)mappedResource.pData;
-
-	// Copy the lighting variables into the constant buffer.
-    dataPtr2->ambientColor = ambientColor;
-	dataPtr2->diffuseColor = diffuseColor;
-	dataPtr2->lightDirection = lightDirection;
-    dataPtr2->specularColor = specularColor;
-	dataPtr2->specularPower = specularPower;
-
-	// Unlock the constant buffer.
-	deviceContext->Unmap(m_lightBuffer, 0);
-
-	// Set the position of the light constant buffer in the pixel shader.
-	bufferNumber = 0;
+	result = m_ConstantAllocator->Bind(ConstantAllocatorClass::STAGE_VERTEX, 1, constants.view);
+	if(!result)
+	{
+		return false;
+	}
 
-	// Finally set the light constant buffer in the pixel shader with the updated values.
-	deviceContext->PSSetConstantBuffers(bufferNumber, 1, &m_lightBuffer);
+	result = m_ConstantAllocator->Bind(ConstantAllocatorClass::STAGE_PIXEL, 0, constants.light);
+	if(!result)
+	{
+		return false;
+	}
 
 	return true;
 }
@@ -460,14 +455,14 @@ bool LightShaderClass::SetShaderParameters(ID3D11DeviceContext* deviceContext, D
 void LightShaderClass::RenderShader(ID3D11DeviceContext* deviceContext, int indexCount, int indexStart)
 {
 	// Set the vertex input layout.
-	deviceContext->IASetInputLayout(m_layout);
+	m_PipelineState->SetInputLayout(m_layout);
 
     // Set the vertex and pixel shaders that will be used to render this triangle.
-    deviceContext->VSSetShader(m_vertexShader, NULL, 0);
-    deviceContext->PSSetShader(m_pixelShader, NULL, 0);
+    m_PipelineState->SetVertexShader(m_vertexShader);
+    m_PipelineState->SetPixelShader(m_pixelShader);
 
 	// Set the sampler state in the pixel shader.
-	deviceContext->PSSetSamplers(0, 1, &m_sampleState);
+	m_PipelineState->SetPSSampler(0, m_sampleState);
 
 	// Render the triangle.
 	deviceContext->DrawIndexed(indexCount, indexStart, 0);
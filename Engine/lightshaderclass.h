@@ -17,21 +17,39 @@
 using namespace std;
 
 
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "pipelinestateclass.h"
+#include "constantallocatorclass.h"
+#include "profilerclass.h"
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Class name: LightShaderClass
+// Takes its constants from the ConstantAllocatorClass as three blocks: the
+// world matrix of the object, the view with the camera, and the light.  A
+// block is only written again when its inputs change or the ring has wrapped
+// past it, and the matrices are only transposed when they are written.
+// SetConstants and the Render that takes its result let a caller write the
+// constants of every draw before uploading them all at once.
+//
+// The texture is a texture array, and each vertex picks its slice through
+// the slice stream that BufferClass binds next to the vertices, so a range
+// that covers several models with textures in the same array is one draw.
 ////////////////////////////////////////////////////////////////////////////////
 class LightShaderClass
 {
 private:
-	struct MatrixBufferType
+	struct ObjectBufferType
 	{
 		D3DXMATRIX world;
-		D3DXMATRIX view;
-		D3DXMATRIX projection;
 	};
 
-    struct CameraBufferType
+    struct ViewBufferType
 	{
+		D3DXMATRIX view;
+		D3DXMATRIX projection;
 		D3DXVECTOR3 cameraPosition;
 		float padding;
 	};
@@ -45,33 +63,50 @@ private:
         D3DXVECTOR4 specularColor;
 	};
 
+public:
+	// The constant blocks one draw is bound to.
+	struct ConstantsType
+	{
+		ConstantAllocatorClass::BlockType object;
+		ConstantAllocatorClass::BlockType view;
+		ConstantAllocatorClass::BlockType light;
+	};
+
 public:
 	LightShaderClass();
 	LightShaderClass(const LightShaderClass&);
 	~LightShaderClass();
 
-	bool Initialize(ID3D11Device*, HWND);
+	bool Initialize(ID3D11Device*, PipelineStateClass*, ConstantAllocatorClass*, HWND);
 	void Shutdown();
-	bool Render(ID3D11DeviceContext*, int, D3DXMATRIX, D3DXMATRIX, D3DXMATRIX, vector<ID3D11ShaderResourceView*>*, int, vector<int>*,
+	bool Render(ID3D11DeviceContext*, int, int, D3DXMATRIX, D3DXMATRIX, D3DXMATRIX, ID3D11ShaderResourceView*,
 		D3DXVECTOR3, D3DXVECTOR4, D3DXVECTOR4, D3DXVECTOR3, D3DXVECTOR4, float);
+	bool Render(ID3D11DeviceContext*, int, int, ConstantsType&, ID3D11ShaderResourceView*);
+
+	bool SetConstants(D3DXMATRIX, D3DXMATRIX, D3DXMATRIX, D3DXVECTOR3, D3DXVECTOR4, D3DXVECTOR4, D3DXVECTOR3, D3DXVECTOR4, float,
+		ConstantsType&);
 
 private:
 	bool InitializeShader(ID3D11Device*, HWND, WCHAR*, WCHAR*);
 	void ShutdownShader();
 	void OutputShaderErrorMessage(ID3D10Blob*, HWND, WCHAR*);
 
-	bool SetShaderParameters(ID3D11DeviceContext*, D3DXMATRIX, D3DXMATRIX, D3DXMATRIX, D3DXVECTOR3,
-        D3DXVECTOR4, D3DXVECTOR4, D3DXVECTOR3, D3DXVECTOR4, float);
+	bool SetShaderParameters(D3DXMATRIX, D3DXMATRIX, D3DXMATRIX, D3DXVECTOR3, D3DXVECTOR4, D3DXVECTOR4, D3DXVECTOR3,
+        D3DXVECTOR4, float);
+	bool BindConstants(ConstantsType&);
 	void RenderShader(ID3D11DeviceContext*, int, int);
 
 private:
+	PipelineStateClass* m_PipelineState;
+	ConstantAllocatorClass* m_ConstantAllocator;
 	ID3D11VertexShader* m_vertexShader;
 	ID3D11PixelShader* m_pixelShader;
 	ID3D11InputLayout* m_layout;
 	ID3D11SamplerState* m_sampleState;
-	ID3D11Buffer* m_matrixBuffer;
-    ID3D11Buffer* m_cameraBuffer;
-	ID3D11Buffer* m_lightBuffer;
+	ConstantsType m_constants;
+	D3DXMATRIX m_worldMatrix, m_viewMatrix, m_projectionMatrix;
+	D3DXVECTOR3 m_cameraPosition;
+	LightBufferType m_light;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,194 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: lodclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "lodclass.h"
+#include <math.h>
+
+
+LodClass::LodClass()
+{
+	m_levels = 0;
+	m_objects = 0;
+	m_bias = 0.0f;
+	m_threshold = LOD_PIXEL_ERROR;
+	m_pixelScale = 0.0f;
+	m_triangleCount = 0;
+	m_fullTriangleCount = 0;
+	m_levelChanges = 0;
+}
+
+
+LodClass::LodClass(const LodClass& other)
+{
+}
+
+
+LodClass::~LodClass()
+{
+}
+
+
+bool LodClass::Initialize()
+{
+	m_levels = new vector<LevelType>;
+	if(!m_levels)
+	{
+		return false;
+	}
+
+	m_objects = new vector<ObjectType>;
+	if(!m_objects)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+void LodClass::Shutdown()
+{
+	if(m_objects)
+	{
+		delete m_objects;
+		m_objects = 0;
+	}
+
+	if(m_levels)
+	{
+		delete m_levels;
+		m_levels = 0;
+	}
+
+	return;
+}
+
+
+int LodClass::AddObject(ModelClass* model)
+{
+	ObjectType object;
+	LevelType level;
+	int i;
+
+
+	// Copy the model's levels, finest first, and start the object at full detail.
+	object.firstLevel = (int)m_levels->size();
+	object.levelCount = model->GetLevelCount();
+	object.level = 0;
+
+	for(i=0; i<object.levelCount; i++)
+	{
+		model->GetLevel(i, level.indexStart, level.indexCount, level.error);
+		m_levels->push_back(level);
+	}
+
+	m_objects->push_back(object);
+
+	return (int)m_objects->size() - 1;
+}
+
+
+void LodClass::SetBias(float bias)
+{
+	m_bias = bias;
+	return;
+}
+
+
+float LodClass::GetBias()
+{
+	return m_bias;
+}
+
+
+void LodClass::BeginFrame(D3DXMATRIX& projectionMatrix, int screenHeight)
+{
+	// A unit of length one unit in front of the camera covers this many pixels.
+	m_pixelScale = projectionMatrix._22 * 0.5f * (float)screenHeight;
+	m_threshold = LOD_PIXEL_ERROR * powf(2.0f, m_bias);
+
+	m_triangleCount = 0;
+	m_fullTriangleCount = 0;
+	m_levelChanges = 0;
+
+	return;
+}
+
+
+int LodClass::Select(int index, float distance, float scale)
+{
+	ObjectType* object;
+	LevelType* levels;
+	int level;
+
+
+	object = &(*m_objects)[index];
+	levels = &(*m_levels)[object->firstLevel];
+	level = object->level;
+
+	// Step to finer levels while the current one is clearly too coarse, otherwise to coarser ones while
+	// the next is clearly fine enough.  Between the two bounds the object keeps the level it had.
+	if(GetPixelError(levels[level], distance, scale) > m_threshold * (1.0f + LOD_HYSTERESIS))
+	{
+		while((level > 0) && (GetPixelError(levels[level], distance, scale) > m_threshold))
+		{
+			level--;
+		}
+	}
+	else
+	{
+		while((level + 1 < object->levelCount) && (GetPixelError(levels[level + 1], distance, scale) <= m_threshold * (1.0f - LOD_HYSTERESIS)))
+		{
+			level++;
+		}
+	}
+
+	if(level != object->level)
+	{
+		m_levelChanges++;
+		object->level = level;
+	}
+
+	m_triangleCount += levels[level].indexCount / 3;
+	m_fullTriangleCount += levels[0].indexCount / 3;
+
+	return level;
+}
+
+
+void LodClass::GetRange(int index, int level, int& indexStart, int& indexCount)
+{
+	LevelType* selected;
+
+
+	selected = &(*m_levels)[(*m_objects)[index].firstLevel + level];
+	indexStart = selected->indexStart;
+	indexCount = selected->indexCount;
+
+	return;
+}
+
+
+int LodClass::GetTriangleCount()
+{
+	return m_triangleCount;
+}
+
+
+int LodClass::GetFullTriangleCount()
+{
+	return m_fullTriangleCount;
+}
+
+
+int LodClass::GetLevelChanges()
+{
+	return m_levelChanges;
+}
+
+
+float LodClass::GetPixelError(LevelType& level, float distance, float scale)
+{
+	// The error grows with the object's scale and shrinks with its distance, which is kept off zero.
+	return (level.error * scale * m_pixelScale) / max(distance, 0.0001f);
+}
@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: lodclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _LODCLASS_H_
+#define _LODCLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <d3dx10math.h>
+#include <vector>
+using namespace std;
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "modelclass.h"
+
+
+/////////////
+// GLOBALS //
+/////////////
+const float LOD_PIXEL_ERROR = 1.0f;
+const float LOD_HYSTERESIS = 0.25f;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: LodClass
+// Picks a level of detail for every object each frame from the levels its
+// model was built with.  Each level stores how far its surface strays from
+// the full model, and projecting that distance with the camera's field of
+// view gives the error in pixels at the object's distance.  The coarsest
+// level whose error stays under LOD_PIXEL_ERROR is the one drawn.
+//
+// An object near the distance where two levels meet would flicker between
+// them, so the selection is sticky: moving to a coarser level needs its error
+// LOD_HYSTERESIS below the threshold, and moving back to a finer one needs
+// the current level's error that far above it.  The bias scales the
+// threshold by a power of two, so each step up halves the detail.
+////////////////////////////////////////////////////////////////////////////////
+class LodClass
+{
+private:
+	struct LevelType
+	{
+		int indexStart;
+		int indexCount;
+		float error;
+	};
+
+	// An object's levels and the level it was last drawn at.
+	struct ObjectType
+	{
+		int firstLevel;
+		int levelCount;
+		int level;
+	};
+
+public:
+	LodClass();
+	LodClass(const LodClass&);
+	~LodClass();
+
+	bool Initialize();
+	void Shutdown();
+
+	int AddObject(ModelClass*);
+	void SetBias(float);
+	float GetBias();
+
+	void BeginFrame(D3DXMATRIX&, int);
+	int Select(int, float, float);
+	void GetRange(int, int, int&, int&);
+
+	int GetTriangleCount();
+	int GetFullTriangleCount();
+	int GetLevelChanges();
+
+private:
+	float GetPixelError(LevelType&, float, float);
+
+private:
+	vector<LevelType>* m_levels;
+	vector<ObjectType>* m_objects;
+	float m_bias, m_threshold, m_pixelScale;
+	int m_triangleCount, m_fullTriangleCount, m_levelChanges;
+};
+
+#endif
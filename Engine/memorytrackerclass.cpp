@@ -0,0 +1,436 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: memorytrackerclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "memorytrackerclass.h"
+#include "frameallocatorclass.h"
+#include <stdlib.h>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+
+MemoryTrackerClass::UsageType MemoryTrackerClass::m_usage[TAG_COUNT];
+long long MemoryTrackerClass::m_budgets[TAG_COUNT] = { 0, MEMORY_BUDGET_MODELS, MEMORY_BUDGET_TEXTURES, MEMORY_BUDGET_BUFFERS,
+	MEMORY_BUDGET_TEXT, MEMORY_BUDGET_UI, MEMORY_BUDGET_TRANSIENT };
+char* MemoryTrackerClass::m_tagNames[TAG_COUNT] = { "other", "models", "textures", "buffers", "text", "ui", "transient" };
+__declspec(thread) int MemoryTrackerClass::m_threadTag = 0;
+
+
+void* MemoryTrackerClass::Allocate(size_t size)
+{
+	HeaderType* header;
+	char* memory;
+
+
+	FrameAllocatorClass::CountHeapAllocation();
+
+	// Put the tag and size in front of the allocation, where Free can find them.
+	memory = (char*)malloc(MEMORY_TRACKER_HEADER_SIZE + size);
+	if(!memory)
+	{
+		return 0;
+	}
+
+	header = (HeaderType*)memory;
+	header->tag = m_threadTag;
+	header->size = size;
+
+	TrackCpu(header->tag, (long long)size);
+
+	return memory + MEMORY_TRACKER_HEADER_SIZE;
+}
+
+
+void MemoryTrackerClass::Free(void* memory)
+{
+	HeaderType* header;
+
+
+	if(!memory)
+	{
+		return;
+	}
+
+	header = (HeaderType*)((char*)memory - MEMORY_TRACKER_HEADER_SIZE);
+	TrackCpu(header->tag, -(long long)header->size);
+
+	free(header);
+
+	return;
+}
+
+
+void* MemoryTrackerClass::AllocateAligned(size_t size, size_t alignment)
+{
+	HeaderType* header;
+	char* memory;
+
+
+	FrameAllocatorClass::CountHeapAllocation();
+
+	// Spend a whole alignment step on the header so the allocation after it stays aligned.
+	alignment = max(alignment, (size_t)MEMORY_TRACKER_HEADER_SIZE);
+	memory = (char*)_aligned_malloc(alignment + size, alignment);
+	if(!memory)
+	{
+		return 0;
+	}
+
+	header = (HeaderType*)(memory + alignment - MEMORY_TRACKER_HEADER_SIZE);
+	header->tag = m_threadTag;
+	header->size = size;
+	header->offset = (int)alignment;
+
+	TrackCpu(header->tag, (long long)size);
+
+	return memory + alignment;
+}
+
+
+void MemoryTrackerClass::FreeAligned(void* memory)
+{
+	HeaderType* header;
+
+
+	if(!memory)
+	{
+		return;
+	}
+
+	header = (HeaderType*)((char*)memory - MEMORY_TRACKER_HEADER_SIZE);
+	TrackCpu(header->tag, -(long long)header->size);
+
+	_aligned_free((char*)memory - header->offset);
+
+	return;
+}
+
+
+void MemoryTrackerClass::AddBuffer(TagType tag, ID3D11Buffer* buffer)
+{
+	D3D11_BUFFER_DESC desc;
+
+
+	if(buffer)
+	{
+		buffer->GetDesc(&desc);
+		TrackGpu(tag, desc.ByteWidth);
+	}
+
+	return;
+}
+
+
+void MemoryTrackerClass::RemoveBuffer(TagType tag, ID3D11Buffer* buffer)
+{
+	D3D11_BUFFER_DESC desc;
+
+
+	if(buffer)
+	{
+		buffer->GetDesc(&desc);
+		TrackGpu(tag, -(long long)desc.ByteWidth);
+	}
+
+	return;
+}
+
+
+void MemoryTrackerClass::AddTexture(TagType tag, ID3D11ShaderResourceView* view)
+{
+	ID3D11Resource* resource;
+	ID3D11Texture2D* texture;
+	D3D11_TEXTURE2D_DESC desc;
+	HRESULT result;
+
+
+	if(!view)
+	{
+		return;
+	}
+
+	// Only two dimensional textures are counted, which is all the engine loads.
+	view->GetResource(&resource);
+	result = resource->QueryInterface(__uuidof(ID3D11Texture2D), (void**)&texture);
+	resource->Release();
+	if(FAILED(result))
+	{
+		return;
+	}
+
+	texture->GetDesc(&desc);
+	texture->Release();
+
+	AddTexture(tag, desc);
+
+	return;
+}
+
+
+void MemoryTrackerClass::RemoveTexture(TagType tag, ID3D11ShaderResourceView* view)
+{
+	ID3D11Resource* resource;
+	ID3D11Texture2D* texture;
+	D3D11_TEXTURE2D_DESC desc;
+	HRESULT result;
+
+
+	if(!view)
+	{
+		return;
+	}
+
+	view->GetResource(&resource);
+	result = resource->QueryInterface(__uuidof(ID3D11Texture2D), (void**)&texture);
+	resource->Release();
+	if(FAILED(result))
+	{
+		return;
+	}
+
+	texture->GetDesc(&desc);
+	texture->Release();
+
+	RemoveTexture(tag, desc);
+
+	return;
+}
+
+
+void MemoryTrackerClass::AddTexture(TagType tag, D3D11_TEXTURE2D_DESC& desc)
+{
+	TrackGpu(tag, GetTextureBytes(desc));
+}
+
+
+void MemoryTrackerClass::RemoveTexture(TagType tag, D3D11_TEXTURE2D_DESC& desc)
+{
+	TrackGpu(tag, -GetTextureBytes(desc));
+}
+
+
+void MemoryTrackerClass::SetBudget(TagType tag, long long bytes)
+{
+	m_budgets[tag] = bytes;
+}
+
+
+long long MemoryTrackerClass::GetCpuBytes(TagType tag)
+{
+	return m_usage[tag].cpuBytes;
+}
+
+
+long long MemoryTrackerClass::GetGpuBytes(TagType tag)
+{
+	return m_usage[tag].gpuBytes;
+}
+
+
+long long MemoryTrackerClass::GetPeakBytes(TagType tag)
+{
+	return m_usage[tag].peakBytes;
+}
+
+
+bool MemoryTrackerClass::IsOverBudget(TagType tag)
+{
+	// A budget of zero means the tag has none.
+	return (m_budgets[tag] > 0) && (m_usage[tag].cpuBytes + m_usage[tag].gpuBytes > m_budgets[tag]);
+}
+
+
+void MemoryTrackerClass::GetReport(vector<string>& lines)
+{
+	ostringstream line;
+	long long cpuTotal, gpuTotal;
+	int tag;
+
+
+	lines.clear();
+
+	// One line per tag, in megabytes, with its high-water mark and budget.
+	cpuTotal = 0;
+	gpuTotal = 0;
+	for(tag=0; tag<TAG_COUNT; tag++)
+	{
+		line.str("");
+		line << left << setw(10) << m_tagNames[tag] << right << fixed << setprecision(2)
+			<< setw(9) << m_usage[tag].cpuBytes / 1048576.0 << " MB cpu"
+			<< setw(9) << m_usage[tag].gpuBytes / 1048576.0 << " MB gpu"
+			<< setw(9) << m_usage[tag].peakBytes / 1048576.0 << " MB peak";
+
+		if(m_budgets[tag] > 0)
+		{
+			line << setw(9) << m_budgets[tag] / 1048576.0 << " MB budget";
+		}
+
+		if(IsOverBudget((TagType)tag))
+		{
+			line << "  OVER BUDGET";
+		}
+
+		lines.push_back(line.str());
+
+		cpuTotal += m_usage[tag].cpuBytes;
+		gpuTotal += m_usage[tag].gpuBytes;
+	}
+
+	line.str("");
+	line << left << setw(10) << "total" << right << fixed << setprecision(2) << setw(9) << cpuTotal / 1048576.0 << " MB cpu"
+		<< setw(9) << gpuTotal / 1048576.0 << " MB gpu";
+	lines.push_back(line.str());
+
+	return;
+}
+
+
+bool MemoryTrackerClass::WriteReport(char* filename)
+{
+	vector<string> lines;
+	ofstream fout;
+	unsigned int i;
+
+
+	GetReport(lines);
+
+	fout.open(filename);
+	if(fout.fail())
+	{
+		return false;
+	}
+
+	for(i=0; i<lines.size(); i++)
+	{
+		fout << lines[i] << endl;
+	}
+
+	fout.close();
+
+	return true;
+}
+
+
+MemoryTrackerClass::TagType MemoryTrackerClass::SetThreadTag(TagType tag)
+{
+	int previous;
+
+
+	previous = m_threadTag;
+	m_threadTag = tag;
+
+	return (TagType)previous;
+}
+
+
+void MemoryTrackerClass::TrackCpu(int tag, long long bytes)
+{
+	m_usage[tag].cpuBytes.fetch_add(bytes, memory_order_relaxed);
+	if(bytes > 0)
+	{
+		UpdatePeak(tag);
+	}
+
+	return;
+}
+
+
+void MemoryTrackerClass::TrackGpu(int tag, long long bytes)
+{
+	m_usage[tag].gpuBytes.fetch_add(bytes, memory_order_relaxed);
+	if(bytes > 0)
+	{
+		UpdatePeak(tag);
+	}
+
+	return;
+}
+
+
+void MemoryTrackerClass::UpdatePeak(int tag)
+{
+	long long total, peak;
+
+
+	// Raise the high-water mark unless another thread has already raised it further.
+	total = m_usage[tag].cpuBytes.load(memory_order_relaxed) + m_usage[tag].gpuBytes.load(memory_order_relaxed);
+	peak = m_usage[tag].peakBytes.load(memory_order_relaxed);
+	while((total > peak) && !m_usage[tag].peakBytes.compare_exchange_weak(peak, total, memory_order_relaxed))
+	{
+	}
+
+	return;
+}
+
+
+long long MemoryTrackerClass::GetTextureBytes(D3D11_TEXTURE2D_DESC& desc)
+{
+	long long bytes;
+	unsigned int width, height, mip;
+	int bits;
+	bool compressed;
+
+
+	// Add up every mip level of every slice.  Block compressed levels are stored in whole 4x4 blocks.
+	bits = GetBitsPerPixel(desc.Format, compressed);
+	bytes = 0;
+	width = desc.Width;
+	height = desc.Height;
+	for(mip=0; mip<max(desc.MipLevels, 1u); mip++)
+	{
+		if(compressed)
+		{
+			bytes += (long long)((width + 3) & ~3u) * ((height + 3) & ~3u) * bits / 8;
+		}
+		else
+		{
+			bytes += (long long)width * height * bits / 8;
+		}
+
+		width = max(width / 2, 1u);
+		height = max(height / 2, 1u);
+	}
+
+	return bytes * max(desc.ArraySize, 1u);
+}
+
+
+int MemoryTrackerClass::GetBitsPerPixel(DXGI_FORMAT format, bool& compressed)
+{
+	compressed = false;
+
+	switch(format)
+	{
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+		case DXGI_FORMAT_BC4_UNORM:
+			compressed = true;
+			return 4;
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+		case DXGI_FORMAT_BC5_UNORM:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			compressed = true;
+			return 8;
+		case DXGI_FORMAT_R8_UNORM:
+		case DXGI_FORMAT_A8_UNORM:
+			return 8;
+		case DXGI_FORMAT_R8G8_UNORM:
+		case DXGI_FORMAT_R16_FLOAT:
+		case DXGI_FORMAT_R16_UNORM:
+			return 16;
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		case DXGI_FORMAT_R16G16B16A16_UNORM:
+		case DXGI_FORMAT_R32G32_FLOAT:
+			return 64;
+		case DXGI_FORMAT_R32G32B32_FLOAT:
+			return 96;
+		case DXGI_FORMAT_R32G32B32A32_FLOAT:
+			return 128;
+		default:
+			return 32;
+	}
+}
@@ -0,0 +1,158 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: memorytrackerclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _MEMORYTRACKERCLASS_H_
+#define _MEMORYTRACKERCLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <windows.h>
+#include <d3d11.h>
+#include <atomic>
+#include <string>
+#include <vector>
+using namespace std;
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int MEMORY_TRACKER_HEADER_SIZE = 16;
+const long long MEMORY_BUDGET_MODELS = 64ll * 1024 * 1024;
+const long long MEMORY_BUDGET_TEXTURES = 256ll * 1024 * 1024;
+const long long MEMORY_BUDGET_BUFFERS = 128ll * 1024 * 1024;
+const long long MEMORY_BUDGET_TEXT = 1ll * 1024 * 1024;
+const long long MEMORY_BUDGET_UI = 4ll * 1024 * 1024;
+const long long MEMORY_BUDGET_TRANSIENT = 16ll * 1024 * 1024;
+
+
+////////////
+// MACROS //
+////////////
+// Heap allocations are only tagged in builds with ENGINE_PROFILE defined.
+// The game replaces the global operator new in those builds so every
+// allocation reaches Allocate and Free, and the library leaves it alone for
+// anything else that links it.  Without ENGINE_PROFILE MEMORY_TAG expands to
+// nothing and only the GPU estimates are tracked.
+#ifdef ENGINE_PROFILE
+#define MEMORY_TAG_CONCAT_INNER(a, b) a##b
+#define MEMORY_TAG_CONCAT(a, b) MEMORY_TAG_CONCAT_INNER(a, b)
+#define MEMORY_TAG(tag) MemoryTagClass MEMORY_TAG_CONCAT(memoryTag, __LINE__)(tag)
+#else
+#define MEMORY_TAG(tag)
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: MemoryTrackerClass
+// Keeps count of the memory each subsystem holds, on the CPU heap and on the
+// GPU.  Heap allocations are charged to the tag of the innermost MEMORY_TAG
+// scope on the thread that makes them, or to TAG_OTHER outside any scope.
+// Each one carries a small header with its tag and size in front of it, so
+// the bytes go back to the same tag however far from the scope it is freed.
+// Memory that needs a wider alignment than new gives goes through
+// AllocateAligned and FreeAligned, which keep the same header.
+//
+// The GPU cannot be counted like that, so buffers and textures are added and
+// removed by hand where they are created and released, at the size their
+// descriptions work out to.  That is an estimate, since the driver pads and
+// aligns as it likes.
+//
+// Every tag has a budget and a high-water mark.  GetReport turns the tags into
+// lines of text, marking any over budget, and WriteReport saves them to a file.
+////////////////////////////////////////////////////////////////////////////////
+class MemoryTrackerClass
+{
+public:
+	enum TagType
+	{
+		TAG_OTHER,
+		TAG_MODELS,
+		TAG_TEXTURES,
+		TAG_BUFFERS,
+		TAG_TEXT,
+		TAG_UI,
+		TAG_TRANSIENT,
+		TAG_COUNT
+	};
+
+private:
+	struct UsageType
+	{
+		atomic<long long> cpuBytes;
+		atomic<long long> gpuBytes;
+		atomic<long long> peakBytes;
+	};
+
+	// Written in front of every tracked heap allocation, padded so the allocation keeps its alignment.
+	struct HeaderType
+	{
+		size_t size;
+		int tag;
+		int offset;
+	};
+
+public:
+	static void* Allocate(size_t);
+	static void Free(void*);
+	static void* AllocateAligned(size_t, size_t);
+	static void FreeAligned(void*);
+
+	static void AddBuffer(TagType, ID3D11Buffer*);
+	static void RemoveBuffer(TagType, ID3D11Buffer*);
+	static void AddTexture(TagType, ID3D11ShaderResourceView*);
+	static void RemoveTexture(TagType, ID3D11ShaderResourceView*);
+	static void AddTexture(TagType, D3D11_TEXTURE2D_DESC&);
+	static void RemoveTexture(TagType, D3D11_TEXTURE2D_DESC&);
+
+	static void SetBudget(TagType, long long);
+	static long long GetCpuBytes(TagType);
+	static long long GetGpuBytes(TagType);
+	static long long GetPeakBytes(TagType);
+	static bool IsOverBudget(TagType);
+
+	static void GetReport(vector<string>&);
+	static bool WriteReport(char*);
+
+	static TagType SetThreadTag(TagType);
+
+private:
+	static void TrackCpu(int, long long);
+	static void TrackGpu(int, long long);
+	static void UpdatePeak(int);
+	static long long GetTextureBytes(D3D11_TEXTURE2D_DESC&);
+	static int GetBitsPerPixel(DXGI_FORMAT, bool&);
+
+private:
+	static UsageType m_usage[TAG_COUNT];
+	static long long m_budgets[TAG_COUNT];
+	static char* m_tagNames[TAG_COUNT];
+	static __declspec(thread) int m_threadTag;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: MemoryTagClass
+// Charges the heap allocations made on this thread to a tag for as long as
+// it is in scope.  Use it through MEMORY_TAG.
+////////////////////////////////////////////////////////////////////////////////
+class MemoryTagClass
+{
+public:
+	MemoryTagClass(MemoryTrackerClass::TagType tag)
+	{
+		m_previousTag = MemoryTrackerClass::SetThreadTag(tag);
+	}
+
+	~MemoryTagClass()
+	{
+		MemoryTrackerClass::SetThreadTag(m_previousTag);
+	}
+
+private:
+	MemoryTrackerClass::TagType m_previousTag;
+};
+
+#endif
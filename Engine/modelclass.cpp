@@ -3,14 +3,20 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include "modelclass.h"
 #include <sstream>
+#include <string.h>
 
 ModelClass::ModelClass()
 {
 	m_vertexBuffer = 0;
 	m_indexBuffer = 0;
 	m_Texture = 0;
+	m_SoftwareTexture = 0;
 	m_model = 0;
 	m_indexOffset = 0;
+	m_boundsCenter = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+	m_boundsExtents = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+	m_boundsRadius = 0.0f;
+	m_levelCount = 0;
 }
 
 
@@ -26,6 +32,7 @@ ModelClass::~ModelClass()
 
 bool ModelClass::Initialize(ID3D11Device* device, char* modelFilename, WCHAR* textureFilename, int indexOffset)
 {
+	MEMORY_TAG(MemoryTrackerClass::TAG_MODELS);
 	bool result;
 
 	// Load in the model data,
@@ -80,14 +87,49 @@ int ModelClass::GetIndexCount()
 
 ID3D11ShaderResourceView* ModelClass::GetTexture()
 {
+	if(!m_Texture)
+	{
+		return 0;
+	}
+
 	return m_Texture->GetTexture();
 }
 
+
+SoftwareTextureClass* ModelClass::GetSoftwareTexture()
+{
+	return m_SoftwareTexture;
+}
+
 VertexType::Default* ModelClass::GetVertices()
 {
 	return m_model;
 }
 
+
+void ModelClass::GetBounds(D3DXVECTOR3& center, D3DXVECTOR3& extents, float& radius)
+{
+	center = m_boundsCenter;
+	extents = m_boundsExtents;
+	radius = m_boundsRadius;
+	return;
+}
+
+
+int ModelClass::GetLevelCount()
+{
+	return m_levelCount;
+}
+
+
+void ModelClass::GetLevel(int level, int& indexStart, int& indexCount, float& error)
+{
+	indexStart = m_levels[level].indexStart;
+	indexCount = m_levels[level].indexCount;
+	error = m_levels[level].error;
+	return;
+}
+
 bool ModelClass::InitializeBuffers(ID3D11Device* device)
 {
 	return true;
@@ -141,6 +183,24 @@ bool ModelClass::LoadTexture(ID3D11Device* device, WCHAR* filename)
 	bool result;
 
 
+	// Without a device the model is being drawn by the software renderer, so keep the texture in system memory.
+	if(!device)
+	{
+		m_SoftwareTexture = new SoftwareTextureClass;
+		if(!m_SoftwareTexture)
+		{
+			return false;
+		}
+
+		return m_SoftwareTexture->Initialize(filename);
+	}
+
+	// Without a file the texture is kept by the caller, in a texture array.
+	if(!filename)
+	{
+		return true;
+	}
+
 	// Create the texture object.
 	m_Texture = new TextureClass;
 	if(!m_Texture)
@@ -169,6 +229,14 @@ void ModelClass::ReleaseTexture()
 		m_Texture = 0;
 	}
 
+	// Release the software texture object.
+	if(m_SoftwareTexture)
+	{
+		m_SoftwareTexture->Shutdown();
+		delete m_SoftwareTexture;
+		m_SoftwareTexture = 0;
+	}
+
 	return;
 }
 
@@ -198,12 +266,196 @@ bool ModelClass::LoadModel(char* filename)
     // Fill the array with the model's vertex data
     fin.read(reinterpret_cast<char*>(m_model), sizeof(VertexType::Default) * m_vertexCount);
 
+    // A file shorter than its header says would leave the rest of the vertices uninitialized.
+    if(fin.fail())
+    {
+        fin.close();
+        return false;
+    }
+
     fin.close();
 
+	// Find the volumes the model fits in for culling.
+	CalculateBounds();
+
+	// Append coarser versions of the model after the full one.
+	BuildLevels();
+
 	return true;
 }
 
 
+void ModelClass::CalculateBounds()
+{
+	D3DXVECTOR3 minimum, maximum, offset;
+	float radius;
+	int i;
+
+
+	if(m_vertexCount <= 0)
+	{
+		return;
+	}
+
+	// Find the box around the vertices.
+	minimum = m_model[0].position;
+	maximum = m_model[0].position;
+	for(i=1; i<m_vertexCount; i++)
+	{
+		D3DXVec3Minimize(&minimum, &minimum, &m_model[i].position);
+		D3DXVec3Maximize(&maximum, &maximum, &m_model[i].position);
+	}
+
+	m_boundsCenter = (minimum + maximum) * 0.5f;
+	m_boundsExtents = (maximum - minimum) * 0.5f;
+
+	// The sphere around the box's center only needs to reach the furthest vertex, which is often well inside the corners.
+	m_boundsRadius = 0.0f;
+	for(i=0; i<m_vertexCount; i++)
+	{
+		offset = m_model[i].position - m_boundsCenter;
+		radius = D3DXVec3Length(&offset);
+		if(radius > m_boundsRadius)
+		{
+			m_boundsRadius = radius;
+		}
+	}
+
+	return;
+}
+
+
+void ModelClass::BuildLevels()
+{
+	unordered_map<int, int> cellClusters;
+	vector<D3DXVECTOR3> clusterPositions;
+	vector<int> clusterCounts, vertexClusters;
+	vector<VertexType::Default> vertices;
+	D3DXVECTOR3 minimum, cell, offset;
+	VertexType::Default* model;
+	float cellSize, error, distance;
+	int fullCount, previousCount, resolution, x, y, z, key, cluster, i, j;
+
+
+	// The full model is the first level.
+	fullCount = m_vertexCount - (m_vertexCount % 3);
+	m_levels[0].indexStart = 0;
+	m_levels[0].indexCount = fullCount;
+	m_levels[0].error = 0.0f;
+	m_levelCount = 1;
+
+	if(fullCount <= 0)
+	{
+		return;
+	}
+
+	vertices.assign(m_model, m_model + m_vertexCount);
+	vertexClusters.resize(fullCount);
+
+	// Cluster the vertices on coarser and coarser grids over the bounds.  Every vertex moves to the
+	// middle of its cell's vertices and the triangles left with two corners in one cell are dropped.
+	minimum = m_boundsCenter - m_boundsExtents;
+	cellSize = 2.0f * max(m_boundsExtents.x, max(m_boundsExtents.y, m_boundsExtents.z)) / (float)MODEL_LEVEL_RESOLUTION;
+	previousCount = fullCount;
+	for(resolution=MODEL_LEVEL_RESOLUTION; (resolution >= 2) && (m_levelCount < MODEL_MAX_LEVELS); resolution/=2, cellSize*=2.0f)
+	{
+		if(cellSize <= 0.0f)
+		{
+			break;
+		}
+
+		cellClusters.clear();
+		clusterPositions.clear();
+		clusterCounts.clear();
+		for(i=0; i<fullCount; i++)
+		{
+			cell = (m_model[i].position - minimum) / cellSize;
+			x = min(max((int)cell.x, 0), resolution - 1);
+			y = min(max((int)cell.y, 0), resolution - 1);
+			z = min(max((int)cell.z, 0), resolution - 1);
+			key = (((x * resolution) + y) * resolution) + z;
+
+			auto found = cellClusters.find(key);
+			if(found == cellClusters.end())
+			{
+				cluster = (int)clusterPositions.size();
+				cellClusters.insert(make_pair(key, cluster));
+				clusterPositions.push_back(D3DXVECTOR3(0.0f, 0.0f, 0.0f));
+				clusterCounts.push_back(0);
+			}
+			else
+			{
+				cluster = found->second;
+			}
+
+			clusterPositions[cluster] += m_model[i].position;
+			clusterCounts[cluster]++;
+			vertexClusters[i] = cluster;
+		}
+
+		for(i=0; i<(int)clusterPositions.size(); i++)
+		{
+			clusterPositions[i] = clusterPositions[i] / (float)clusterCounts[i];
+		}
+
+		// The level's error is the furthest any vertex moved.
+		error = 0.0f;
+		for(i=0; i<fullCount; i++)
+		{
+			offset = m_model[i].position - clusterPositions[vertexClusters[i]];
+			distance = D3DXVec3Length(&offset);
+			error = max(error, distance);
+		}
+
+		// Keep the triangles that still have three distinct corners.  Only the positions move, so the
+		// texture coordinates and normals stay those of the full model.
+		m_levels[m_levelCount].indexStart = (int)vertices.size();
+		for(i=0; i<fullCount; i+=3)
+		{
+			if((vertexClusters[i] == vertexClusters[i+1]) || (vertexClusters[i+1] == vertexClusters[i+2]) || (vertexClusters[i] == vertexClusters[i+2]))
+			{
+				continue;
+			}
+
+			for(j=0; j<3; j++)
+			{
+				vertices.push_back(m_model[i+j]);
+				vertices.back().position = clusterPositions[vertexClusters[i+j]];
+			}
+		}
+
+		m_levels[m_levelCount].indexCount = (int)vertices.size() - m_levels[m_levelCount].indexStart;
+		m_levels[m_levelCount].error = error;
+
+		// A level is only worth keeping if it is well below the one before it.
+		if((m_levels[m_levelCount].indexCount == 0) || ((float)m_levels[m_levelCount].indexCount > (float)previousCount * MODEL_LEVEL_REDUCTION))
+		{
+			vertices.resize(m_levels[m_levelCount].indexStart);
+			continue;
+		}
+
+		previousCount = m_levels[m_levelCount].indexCount;
+		m_levelCount++;
+	}
+
+	// Replace the model data with all of the levels back to back.
+	model = new VertexType::Default[vertices.size()];
+	if(!model)
+	{
+		m_levelCount = 1;
+		return;
+	}
+
+	memcpy(model, &vertices[0], sizeof(VertexType::Default) * vertices.size());
+	delete [] m_model;
+	m_model = model;
+	m_vertexCount = (int)vertices.size();
+	m_indexCount = m_vertexCount;
+
+	return;
+}
+
+
 void ModelClass::ReleaseModel()
 {
 	if(m_model)
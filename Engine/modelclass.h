@@ -12,6 +12,8 @@
 #include <D3D11.h>
 #include <d3dx10math.h>
 #include <fstream>
+#include <unordered_map>
+#include <vector>
 using namespace std;
 
 
@@ -19,14 +21,34 @@ using namespace std;
 // MY CLASS INCLUDES //
 ///////////////////////
 #include "textureclass.h"
+#include "softwaretextureclass.h"
 #include "bufferclass.h"
 #include "vertextypes.h"
+#include "memorytrackerclass.h"
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int MODEL_MAX_LEVELS = 4;
+const int MODEL_LEVEL_RESOLUTION = 64;
+const float MODEL_LEVEL_REDUCTION = 0.6f;
+
 
 ////////////////////////////////////////////////////////////////////////////////
 // Class name: ModelClass
 ////////////////////////////////////////////////////////////////////////////////
 class ModelClass
 {
+private:
+	// A level of detail's range of the vertex data and how far it strays from the full model.
+	struct LevelType
+	{
+		int indexStart;
+		int indexCount;
+		float error;
+	};
+
 public:
 	ModelClass();
 	ModelClass(const ModelClass&);
@@ -39,6 +61,10 @@ public:
 	int GetIndexCount();
 	VertexType::Default* GetVertices();
 	ID3D11ShaderResourceView* GetTexture();
+	SoftwareTextureClass* GetSoftwareTexture();
+	void GetBounds(D3DXVECTOR3&, D3DXVECTOR3&, float&);
+	int GetLevelCount();
+	void GetLevel(int, int&, int&, float&);
 
 
 private:
@@ -50,6 +76,8 @@ private:
 	void ReleaseTexture();
 
 	bool LoadModel(char*);
+	void CalculateBounds();
+	void BuildLevels();
 	void ReleaseModel();
 
 private:
@@ -57,7 +85,12 @@ private:
 	int m_vertexCount, m_indexCount;
 	int m_indexOffset;
 	TextureClass* m_Texture;
+	SoftwareTextureClass* m_SoftwareTexture;
 	VertexType::Default* m_model;
+	D3DXVECTOR3 m_boundsCenter, m_boundsExtents;
+	float m_boundsRadius;
+	LevelType m_levels[MODEL_MAX_LEVELS];
+	int m_levelCount;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,669 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: occlusionclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "occlusionclass.h"
+#include <math.h>
+#include <string.h>
+
+
+OcclusionClass::OcclusionClass()
+{
+	m_meshes = 0;
+	m_occluders = 0;
+	m_triangles = 0;
+	m_tiles = 0;
+	m_triangleCount = 0;
+	m_occludeeCount = 0;
+	m_occludedCount = 0;
+	m_rasterTime = 0.0f;
+	m_testTime = 0.0f;
+}
+
+
+OcclusionClass::OcclusionClass(const OcclusionClass& other)
+{
+}
+
+
+OcclusionClass::~OcclusionClass()
+{
+}
+
+
+bool OcclusionClass::Initialize()
+{
+	// Create the occluder meshes and the queue of occluders for a frame.
+	m_meshes = new vector<vector<D3DXVECTOR3>>;
+	if(!m_meshes)
+	{
+		return false;
+	}
+
+	m_occluders = new vector<OccluderType>;
+	if(!m_occluders)
+	{
+		return false;
+	}
+
+	m_triangles = new vector<TriangleType>;
+	if(!m_triangles)
+	{
+		return false;
+	}
+
+	// Create the tiles and clear them to the far plane.
+	m_tiles = new TileType[OCCLUSION_TILES_X * OCCLUSION_TILES_Y];
+	if(!m_tiles)
+	{
+		return false;
+	}
+
+	D3DXMatrixIdentity(&m_viewProjection);
+	ClearTiles();
+
+	return true;
+}
+
+
+void OcclusionClass::Shutdown()
+{
+	if(m_tiles)
+	{
+		delete [] m_tiles;
+		m_tiles = 0;
+	}
+
+	if(m_triangles)
+	{
+		delete m_triangles;
+		m_triangles = 0;
+	}
+
+	if(m_occluders)
+	{
+		delete m_occluders;
+		m_occluders = 0;
+	}
+
+	if(m_meshes)
+	{
+		delete m_meshes;
+		m_meshes = 0;
+	}
+
+	m_triangleCount = 0;
+
+	return;
+}
+
+
+int OcclusionClass::AddMesh(VertexType::Default* vertices, int vertexCount)
+{
+	int mesh, i;
+
+
+	// Keep only the positions of whole triangles.
+	mesh = (int)m_meshes->size();
+	m_meshes->push_back(vector<D3DXVECTOR3>());
+	(*m_meshes)[mesh].reserve(vertexCount - (vertexCount % 3));
+	for(i=0; i<vertexCount - (vertexCount % 3); i++)
+	{
+		(*m_meshes)[mesh].push_back(vertices[i].position);
+	}
+
+	return mesh;
+}
+
+
+void OcclusionClass::BeginFrame(D3DXMATRIX& viewMatrix, D3DXMATRIX& projectionMatrix)
+{
+	m_viewProjection = viewMatrix * projectionMatrix;
+
+	// Start the frame with no occluders and nothing in front of the far plane.
+	m_occluders->clear();
+	m_triangleCount = 0;
+	ClearTiles();
+
+	m_occludeeCount = 0;
+	m_occludedCount = 0;
+	m_rasterTime = 0.0f;
+	m_testTime = 0.0f;
+
+	return;
+}
+
+
+void OcclusionClass::AddOccluder(int mesh, D3DXMATRIX& worldMatrix)
+{
+	OccluderType occluder;
+
+
+	if((mesh < 0) || (mesh >= (int)m_meshes->size()))
+	{
+		return;
+	}
+
+	occluder.mesh = mesh;
+	occluder.worldMatrix = worldMatrix;
+	occluder.firstTriangle = m_triangleCount;
+	m_occluders->push_back(occluder);
+
+	m_triangleCount += (int)(*m_meshes)[mesh].size() / 3;
+
+	return;
+}
+
+
+void OcclusionClass::Rasterize(ThreadPoolClass* threadPool)
+{
+	PROFILE_ZONE("OcclusionClass::Rasterize");
+	LARGE_INTEGER start, end;
+
+
+	QueryPerformanceCounter(&start);
+
+	// Transform and set up the occluder triangles in parallel chunks.
+	m_triangles->resize(m_triangleCount);
+	threadPool->Run(&OcclusionClass::SetupTask, this, (m_triangleCount + OCCLUSION_SETUP_TRIANGLES - 1) / OCCLUSION_SETUP_TRIANGLES);
+
+	// Draw them into the tiles a band of tile rows per task.
+	if(m_triangleCount > 0)
+	{
+		threadPool->Run(&OcclusionClass::RasterizeTask, this, OCCLUSION_BANDS);
+	}
+
+	QueryPerformanceCounter(&end);
+	m_rasterTime += GetMilliseconds(start, end);
+
+	return;
+}
+
+
+bool OcclusionClass::IsVisible(D3DXVECTOR3& minimum, D3DXVECTOR3& maximum)
+{
+	TileType* tile;
+	float corner[3], x, y, z, w, minX, minY, maxX, maxY, nearest, depth;
+	unsigned int columns, rows, mask;
+	int left, top, right, bottom, tileX, tileY, first, last, i;
+
+
+	m_occludeeCount++;
+
+	// Project the corners of the box and find its screen rectangle and nearest depth.
+	minX = (float)OCCLUSION_WIDTH;
+	minY = (float)OCCLUSION_HEIGHT;
+	maxX = 0.0f;
+	maxY = 0.0f;
+	nearest = 1.0f;
+	for(i=0; i<8; i++)
+	{
+		corner[0] = (i & 1) ? maximum.x : minimum.x;
+		corner[1] = (i & 2) ? maximum.y : minimum.y;
+		corner[2] = (i & 4) ? maximum.z : minimum.z;
+
+		x = (corner[0] * m_viewProjection._11) + (corner[1] * m_viewProjection._21) + (corner[2] * m_viewProjection._31) + m_viewProjection._41;
+		y = (corner[0] * m_viewProjection._12) + (corner[1] * m_viewProjection._22) + (corner[2] * m_viewProjection._32) + m_viewProjection._42;
+		z = (corner[0] * m_viewProjection._13) + (corner[1] * m_viewProjection._23) + (corner[2] * m_viewProjection._33) + m_viewProjection._43;
+		w = (corner[0] * m_viewProjection._14) + (corner[1] * m_viewProjection._24) + (corner[2] * m_viewProjection._34) + m_viewProjection._44;
+
+		// A box reaching past the near plane covers the camera, so it can never be hidden.
+		if((w < OCCLUSION_NEAR_W) || (z < 0.0f))
+		{
+			return true;
+		}
+
+		x = ((x / w) * 0.5f + 0.5f) * (float)OCCLUSION_WIDTH;
+		y = (0.5f - (y / w) * 0.5f) * (float)OCCLUSION_HEIGHT;
+		z = z / w;
+
+		minX = min(minX, x);
+		minY = min(minY, y);
+		maxX = max(maxX, x);
+		maxY = max(maxY, y);
+		nearest = min(nearest, z);
+	}
+
+	// Take every pixel the rectangle touches.  A box off the screen is left to frustum culling.
+	left = max((int)floorf(minX), 0);
+	top = max((int)floorf(minY), 0);
+	right = min((int)floorf(maxX), OCCLUSION_WIDTH - 1);
+	bottom = min((int)floorf(maxY), OCCLUSION_HEIGHT - 1);
+	if((left > right) || (top > bottom))
+	{
+		return true;
+	}
+
+	// The box is visible if any tile under it may be further than its nearest point.  Where all of the
+	// box's pixels in a tile are in the working mask the working depth is the tighter bound.
+	for(tileY=top / OCCLUSION_TILE_HEIGHT; tileY<=bottom / OCCLUSION_TILE_HEIGHT; tileY++)
+	{
+		first = max(top - (tileY * OCCLUSION_TILE_HEIGHT), 0);
+		last = min(bottom - (tileY * OCCLUSION_TILE_HEIGHT), OCCLUSION_TILE_HEIGHT - 1);
+		rows = 0;
+		for(i=first; i<=last; i++)
+		{
+			rows |= 0xffu << (i * OCCLUSION_TILE_WIDTH);
+		}
+
+		for(tileX=left / OCCLUSION_TILE_WIDTH; tileX<=right / OCCLUSION_TILE_WIDTH; tileX++)
+		{
+			first = max(left - (tileX * OCCLUSION_TILE_WIDTH), 0);
+			last = min(right - (tileX * OCCLUSION_TILE_WIDTH), OCCLUSION_TILE_WIDTH - 1);
+			columns = (0xffu << first) & (0xffu >> (OCCLUSION_TILE_WIDTH - 1 - last));
+			mask = rows & (columns * 0x01010101u);
+
+			tile = &m_tiles[(tileY * OCCLUSION_TILES_X) + tileX];
+			depth = ((tile->mask != 0) && ((mask & ~tile->mask) == 0)) ? tile->workingDepth : tile->referenceDepth;
+			if(nearest <= depth)
+			{
+				return true;
+			}
+		}
+	}
+
+	m_occludedCount++;
+
+	return false;
+}
+
+
+int OcclusionClass::Cull(int* objects, int count, D3DXVECTOR3* minimums, D3DXVECTOR3* maximums)
+{
+	PROFILE_ZONE("OcclusionClass::Cull");
+	LARGE_INTEGER start, end;
+	int visibleCount, i;
+
+
+	QueryPerformanceCounter(&start);
+
+	// Keep the objects that may be visible in place and in order.  The bounds are indexed by object.
+	visibleCount = 0;
+	for(i=0; i<count; i++)
+	{
+		if(IsVisible(minimums[objects[i]], maximums[objects[i]]))
+		{
+			objects[visibleCount] = objects[i];
+			visibleCount++;
+		}
+	}
+
+	QueryPerformanceCounter(&end);
+	m_testTime += GetMilliseconds(start, end);
+
+	return visibleCount;
+}
+
+
+int OcclusionClass::GetOccluderCount()
+{
+	return (int)m_occluders->size();
+}
+
+
+int OcclusionClass::GetOccluderTriangleCount()
+{
+	return m_triangleCount;
+}
+
+
+int OcclusionClass::GetOccludeeCount()
+{
+	return m_occludeeCount;
+}
+
+
+int OcclusionClass::GetOccludedCount()
+{
+	return m_occludedCount;
+}
+
+
+float OcclusionClass::GetRasterTime()
+{
+	return m_rasterTime;
+}
+
+
+float OcclusionClass::GetTestTime()
+{
+	return m_testTime;
+}
+
+
+bool OcclusionClass::SaveDepth(char* filename)
+{
+	ofstream fout;
+	unsigned char header[18];
+	unsigned char row[OCCLUSION_WIDTH];
+	TileType* tile;
+	float depth, nearest;
+	int x, y, bit, i;
+
+
+	fout.open(filename, ios_base::out | ios_base::binary);
+	if(fout.fail())
+	{
+		return false;
+	}
+
+	// Write an uncompressed 8-bit grayscale TGA header with a top-left origin.
+	memset(header, 0, sizeof(header));
+	header[2] = 3;
+	header[12] = (unsigned char)(OCCLUSION_WIDTH & 0xff);
+	header[13] = (unsigned char)(OCCLUSION_WIDTH >> 8);
+	header[14] = (unsigned char)(OCCLUSION_HEIGHT & 0xff);
+	header[15] = (unsigned char)(OCCLUSION_HEIGHT >> 8);
+	header[16] = 8;
+	header[17] = 0x20;
+	fout.write((char*)header, sizeof(header));
+
+	// Projected depth crowds up against the far plane, so stretch the nearest depth written to white.
+	nearest = 1.0f;
+	for(i=0; i<OCCLUSION_TILES_X * OCCLUSION_TILES_Y; i++)
+	{
+		nearest = min(nearest, m_tiles[i].referenceDepth);
+		if(m_tiles[i].mask != 0)
+		{
+			nearest = min(nearest, m_tiles[i].workingDepth);
+		}
+	}
+
+	// Each pixel shows the bound its tile gives it, the far plane in black.
+	for(y=0; y<OCCLUSION_HEIGHT; y++)
+	{
+		for(x=0; x<OCCLUSION_WIDTH; x++)
+		{
+			tile = &m_tiles[((y / OCCLUSION_TILE_HEIGHT) * OCCLUSION_TILES_X) + (x / OCCLUSION_TILE_WIDTH)];
+			bit = ((y % OCCLUSION_TILE_HEIGHT) * OCCLUSION_TILE_WIDTH) + (x % OCCLUSION_TILE_WIDTH);
+			depth = (tile->mask & (1u << bit)) ? tile->workingDepth : tile->referenceDepth;
+
+			row[x] = (nearest < 1.0f) ? (unsigned char)(255.0f * (1.0f - depth) / (1.0f - nearest)) : 0;
+		}
+
+		fout.write((char*)row, sizeof(row));
+	}
+
+	fout.close();
+
+	return true;
+}
+
+
+void OcclusionClass::ClearTiles()
+{
+	int i;
+
+
+	for(i=0; i<OCCLUSION_TILES_X * OCCLUSION_TILES_Y; i++)
+	{
+		m_tiles[i].referenceDepth = 1.0f;
+		m_tiles[i].workingDepth = 0.0f;
+		m_tiles[i].mask = 0;
+	}
+
+	return;
+}
+
+
+void OcclusionClass::SetupTask(void* context, int chunk)
+{
+	((OcclusionClass*)context)->SetupTriangles(chunk);
+	return;
+}
+
+
+void OcclusionClass::RasterizeTask(void* context, int band)
+{
+	PROFILE_ZONE("OcclusionClass::RasterizeBand");
+	((OcclusionClass*)context)->RasterizeBand(band);
+	return;
+}
+
+
+void OcclusionClass::SetupTriangles(int chunk)
+{
+	D3DXMATRIX worldViewProjection;
+	D3DXVECTOR3* position;
+	TriangleType* triangle;
+	float x[3], y[3], z[3], w, area, minX, minY, maxX, maxY;
+	int first, last, occluder, low, high, middle, index, i, j, k;
+	bool valid;
+
+
+	first = chunk * OCCLUSION_SETUP_TRIANGLES;
+	last = min(first + OCCLUSION_SETUP_TRIANGLES, m_triangleCount);
+
+	// Find the occluder the chunk starts in.
+	low = 0;
+	high = (int)m_occluders->size() - 1;
+	while(low < high)
+	{
+		middle = (low + high + 1) / 2;
+		if((*m_occluders)[middle].firstTriangle <= first)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle - 1;
+		}
+	}
+
+	occluder = low;
+	worldViewProjection = (*m_occluders)[occluder].worldMatrix * m_viewProjection;
+
+	for(index=first; index<last; index++)
+	{
+		// Move on to the next occluder once this one's triangles are done.
+		while((occluder + 1 < (int)m_occluders->size()) && ((*m_occluders)[occluder + 1].firstTriangle <= index))
+		{
+			occluder++;
+			worldViewProjection = (*m_occluders)[occluder].worldMatrix * m_viewProjection;
+		}
+
+		triangle = &(*m_triangles)[index];
+		triangle->valid = false;
+
+		// Project the corners to pixels.  A triangle reaching past the near plane is skipped rather
+		// than clipped, which only loses occlusion.
+		valid = true;
+		position = &(*m_meshes)[(*m_occluders)[occluder].mesh][(index - (*m_occluders)[occluder].firstTriangle) * 3];
+		for(i=0; i<3; i++)
+		{
+			x[i] = (position[i].x * worldViewProjection._11) + (position[i].y * worldViewProjection._21) + (position[i].z * worldViewProjection._31) + worldViewProjection._41;
+			y[i] = (position[i].x * worldViewProjection._12) + (position[i].y * worldViewProjection._22) + (position[i].z * worldViewProjection._32) + worldViewProjection._42;
+			z[i] = (position[i].x * worldViewProjection._13) + (position[i].y * worldViewProjection._23) + (position[i].z * worldViewProjection._33) + worldViewProjection._43;
+			w = (position[i].x * worldViewProjection._14) + (position[i].y * worldViewProjection._24) + (position[i].z * worldViewProjection._34) + worldViewProjection._44;
+
+			if((w < OCCLUSION_NEAR_W) || (z[i] < 0.0f))
+			{
+				valid = false;
+				break;
+			}
+
+			x[i] = ((x[i] / w) * 0.5f + 0.5f) * (float)OCCLUSION_WIDTH;
+			y[i] = (0.5f - (y[i] / w) * 0.5f) * (float)OCCLUSION_HEIGHT;
+			z[i] = z[i] / w;
+		}
+
+		if(!valid)
+		{
+			continue;
+		}
+
+		// Front faces are clockwise on screen.  Cull back faces and degenerate triangles.
+		area = ((x[1] - x[0]) * (y[2] - y[0])) - ((x[2] - x[0]) * (y[1] - y[0]));
+		if(area <= 0.0f)
+		{
+			continue;
+		}
+
+		// Only pixels whose centers are inside the bounding rectangle can be covered.
+		minX = min(x[0], min(x[1], x[2]));
+		minY = min(y[0], min(y[1], y[2]));
+		maxX = max(x[0], max(x[1], x[2]));
+		maxY = max(y[0], max(y[1], y[2]));
+		triangle->minX = max((int)floorf(minX - 0.5f), 0);
+		triangle->minY = max((int)floorf(minY - 0.5f), 0);
+		triangle->maxX = min((int)floorf(maxX - 0.5f), OCCLUSION_WIDTH - 1);
+		triangle->maxY = min((int)floorf(maxY - 0.5f), OCCLUSION_HEIGHT - 1);
+		if((triangle->minX > triangle->maxX) || (triangle->minY > triangle->maxY))
+		{
+			continue;
+		}
+
+		// Set up the edges to be sampled at pixel centers from integer pixel positions.  A center on an edge
+		// counts for the triangles on both sides, so a mesh's shared edges leave no gaps.
+		for(i=0; i<3; i++)
+		{
+			j = (i + 1) % 3;
+			triangle->edgeA[i] = y[i] - y[j];
+			triangle->edgeB[i] = x[j] - x[i];
+			triangle->edgeC[i] = -((triangle->edgeA[i] * x[i]) + (triangle->edgeB[i] * y[i]));
+			triangle->edgeC[i] += 0.5f * (triangle->edgeA[i] + triangle->edgeB[i]);
+		}
+
+		// Set up the depth plane so the furthest depth over a tile can be found from its corners.
+		triangle->depthA = (((z[1] - z[0]) * (y[2] - y[0])) - ((z[2] - z[0]) * (y[1] - y[0]))) / area;
+		triangle->depthB = (((x[1] - x[0]) * (z[2] - z[0])) - ((x[2] - x[0]) * (z[1] - z[0]))) / area;
+		triangle->depthC = z[0] - (triangle->depthA * x[0]) - (triangle->depthB * y[0]);
+		triangle->maxDepth = z[0];
+		for(k=1; k<3; k++)
+		{
+			triangle->maxDepth = max(triangle->maxDepth, z[k]);
+		}
+
+		triangle->valid = true;
+	}
+
+	return;
+}
+
+
+void OcclusionClass::RasterizeBand(int band)
+{
+	TriangleType* triangle;
+	TileType* tile;
+	__m128 offsets, columns, rowEdge[3], edgeA[3], inside;
+	float left, right, top, bottom, depth;
+	unsigned int coverage;
+	int bandTop, bandBottom, tileLeft, tileRight, tileTop, tileBottom, tileX, tileY, row, half, i, j;
+
+
+	bandTop = band * OCCLUSION_BAND_TILES;
+	bandBottom = bandTop + OCCLUSION_BAND_TILES - 1;
+	offsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+	// Draw the triangles in submission order, so every band sees them in the same order.
+	for(i=0; i<m_triangleCount; i++)
+	{
+		triangle = &(*m_triangles)[i];
+		if(!triangle->valid)
+		{
+			continue;
+		}
+
+		tileTop = max(triangle->minY / OCCLUSION_TILE_HEIGHT, bandTop);
+		tileBottom = min(triangle->maxY / OCCLUSION_TILE_HEIGHT, bandBottom);
+		if(tileTop > tileBottom)
+		{
+			continue;
+		}
+
+		tileLeft = triangle->minX / OCCLUSION_TILE_WIDTH;
+		tileRight = triangle->maxX / OCCLUSION_TILE_WIDTH;
+
+		for(j=0; j<3; j++)
+		{
+			edgeA[j] = _mm_set1_ps(triangle->edgeA[j]);
+		}
+
+		for(tileY=tileTop; tileY<=tileBottom; tileY++)
+		{
+			top = (float)(tileY * OCCLUSION_TILE_HEIGHT);
+			bottom = top + (float)OCCLUSION_TILE_HEIGHT;
+
+			for(tileX=tileLeft; tileX<=tileRight; tileX++)
+			{
+				tile = &m_tiles[(tileY * OCCLUSION_TILES_X) + tileX];
+
+				// The furthest the plane reaches over the tile, but never past the triangle's furthest corner.
+				left = (float)(tileX * OCCLUSION_TILE_WIDTH);
+				right = left + (float)OCCLUSION_TILE_WIDTH;
+				depth = triangle->depthC + max(triangle->depthA * left, triangle->depthA * right) + max(triangle->depthB * top, triangle->depthB * bottom);
+				depth = min(depth, triangle->maxDepth);
+				if(depth >= tile->referenceDepth)
+				{
+					continue;
+				}
+
+				// Test the tile's pixels four at a time against all three edges.
+				coverage = 0;
+				for(row=0; row<OCCLUSION_TILE_HEIGHT; row++)
+				{
+					for(j=0; j<3; j++)
+					{
+						rowEdge[j] = _mm_set1_ps((triangle->edgeB[j] * (top + (float)row)) + triangle->edgeC[j]);
+					}
+
+					for(half=0; half<OCCLUSION_TILE_WIDTH / 4; half++)
+					{
+						columns = _mm_add_ps(_mm_set1_ps(left + (float)(half * 4)), offsets);
+						inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], columns), rowEdge[0]), _mm_setzero_ps());
+						inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], columns), rowEdge[1]), _mm_setzero_ps()));
+						inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], columns), rowEdge[2]), _mm_setzero_ps()));
+						coverage |= (unsigned int)_mm_movemask_ps(inside) << ((row * OCCLUSION_TILE_WIDTH) + (half * 4));
+					}
+				}
+
+				if(coverage != 0)
+				{
+					UpdateTile(*tile, coverage, depth);
+				}
+			}
+		}
+	}
+
+	return;
+}
+
+
+void OcclusionClass::UpdateTile(TileType& tile, unsigned int coverage, float depth)
+{
+	// Nothing is gained from a triangle behind what the whole tile already hides.
+	if(depth >= tile.referenceDepth)
+	{
+		return;
+	}
+
+	// A triangle much nearer than the working layer would only be held back by it, so start the layer over.
+	if((tile.mask != 0) && ((tile.workingDepth - depth) > (tile.referenceDepth - tile.workingDepth)))
+	{
+		tile.workingDepth = 0.0f;
+		tile.mask = 0;
+	}
+
+	tile.workingDepth = max(tile.workingDepth, depth);
+	tile.mask |= coverage;
+
+	// Once every pixel is covered the working layer bounds the whole tile.
+	if(tile.mask == 0xffffffffu)
+	{
+		tile.referenceDepth = tile.workingDepth;
+		tile.workingDepth = 0.0f;
+		tile.mask = 0;
+	}
+
+	return;
+}
+
+
+float OcclusionClass::GetMilliseconds(LARGE_INTEGER& start, LARGE_INTEGER& end)
+{
+	LARGE_INTEGER frequency;
+
+
+	QueryPerformanceFrequency(&frequency);
+
+	return (float)((double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart);
+}
@@ -0,0 +1,135 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: occlusionclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _OCCLUSIONCLASS_H_
+#define _OCCLUSIONCLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <windows.h>
+#include <d3dx10math.h>
+#include <intrin.h>
+#include <fstream>
+#include <vector>
+using namespace std;
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "vertextypes.h"
+#include "threadpoolclass.h"
+#include "profilerclass.h"
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int OCCLUSION_WIDTH = 256;
+const int OCCLUSION_HEIGHT = 128;
+const int OCCLUSION_TILE_WIDTH = 8;
+const int OCCLUSION_TILE_HEIGHT = 4;
+const int OCCLUSION_TILES_X = OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH;
+const int OCCLUSION_TILES_Y = OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT;
+const int OCCLUSION_BAND_TILES = 4;
+const int OCCLUSION_BANDS = OCCLUSION_TILES_Y / OCCLUSION_BAND_TILES;
+const int OCCLUSION_SETUP_TRIANGLES = 1024;
+const float OCCLUSION_NEAR_W = 0.0001f;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: OcclusionClass
+// Culls objects hidden behind designated occluder meshes with a coarse depth
+// buffer drawn on the CPU.  The buffer is split into tiles of 8x4 pixels, and
+// instead of a depth per pixel each tile keeps a mask of 32 coverage bits and
+// two depths: a reference depth that the whole tile is known to be in front
+// of, and a working depth for the pixels in the mask.  A triangle ORs its
+// coverage into the mask and pushes the working depth back to its own.  Once
+// the mask is full the working depth becomes the reference depth and the
+// mask starts over, and the working layer is dropped when a triangle is much
+// nearer than it, as it would only hold the reference back.
+//
+// Occluder triangles are set up in parallel and then drawn by horizontal
+// bands of tiles on the thread pool, so no two threads write the same tile.
+// Coverage is tested four pixels at a time at the pixel centers, like the GPU
+// does, and the depth a triangle writes to a tile is the furthest its plane
+// reaches there.  An object is only culled if every tile its screen rectangle
+// touches is nearer than the object's nearest point, so apart from slivers
+// under half a buffer pixel wide along an occluder's silhouette, nothing that
+// can be seen is culled.
+////////////////////////////////////////////////////////////////////////////////
+class OcclusionClass
+{
+private:
+	struct TileType
+	{
+		float referenceDepth;
+		float workingDepth;
+		unsigned int mask;
+	};
+
+	struct OccluderType
+	{
+		int mesh;
+		D3DXMATRIX worldMatrix;
+		int firstTriangle;
+	};
+
+	// A triangle in pixels with its edge functions and depth plane.
+	struct TriangleType
+	{
+		float edgeA[3], edgeB[3], edgeC[3];
+		float depthA, depthB, depthC;
+		float maxDepth;
+		int minX, minY, maxX, maxY;
+		bool valid;
+	};
+
+public:
+	OcclusionClass();
+	OcclusionClass(const OcclusionClass&);
+	~OcclusionClass();
+
+	bool Initialize();
+	void Shutdown();
+
+	int AddMesh(VertexType::Default*, int);
+
+	void BeginFrame(D3DXMATRIX&, D3DXMATRIX&);
+	void AddOccluder(int, D3DXMATRIX&);
+	void Rasterize(ThreadPoolClass*);
+	bool IsVisible(D3DXVECTOR3&, D3DXVECTOR3&);
+	int Cull(int*, int, D3DXVECTOR3*, D3DXVECTOR3*);
+
+	int GetOccluderCount();
+	int GetOccluderTriangleCount();
+	int GetOccludeeCount();
+	int GetOccludedCount();
+	float GetRasterTime();
+	float GetTestTime();
+
+	bool SaveDepth(char*);
+
+private:
+	void ClearTiles();
+	static void SetupTask(void*, int);
+	static void RasterizeTask(void*, int);
+	void SetupTriangles(int);
+	void RasterizeBand(int);
+	void UpdateTile(TileType&, unsigned int, float);
+	static float GetMilliseconds(LARGE_INTEGER&, LARGE_INTEGER&);
+
+private:
+	vector<vector<D3DXVECTOR3>>* m_meshes;
+	vector<OccluderType>* m_occluders;
+	vector<TriangleType>* m_triangles;
+	TileType* m_tiles;
+	D3DXMATRIX m_viewProjection;
+	int m_triangleCount;
+	int m_occludeeCount, m_occludedCount;
+	float m_rasterTime, m_testTime;
+};
+
+#endif
@@ -0,0 +1,562 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: pipelinestateclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "pipelinestateclass.h"
+#include <string.h>
+
+
+PipelineStateClass::PipelineStateClass()
+{
+	int i;
+
+
+	m_device = 0;
+	m_deviceContext = 0;
+	m_deviceContext1 = 0;
+	m_states = 0;
+
+	m_layout = 0;
+	m_vertexShader = 0;
+	m_pixelShader = 0;
+	for(i=0; i<PIPELINE_STATE_SLOTS; i++)
+	{
+		m_vsConstantBuffers[i] = 0;
+		m_psConstantBuffers[i] = 0;
+		m_vsConstantRanges[i][0] = 0;
+		m_vsConstantRanges[i][1] = 0;
+		m_psConstantRanges[i][0] = 0;
+		m_psConstantRanges[i][1] = 0;
+		m_psShaderResources[i] = 0;
+		m_psSamplers[i] = 0;
+	}
+	m_rasterizerState = 0;
+	m_depthStencilState = 0;
+	m_stencilRef = 0;
+	m_blendState = 0;
+
+	m_issuedCalls = 0;
+	m_filteredCalls = 0;
+}
+
+
+PipelineStateClass::PipelineStateClass(const PipelineStateClass& other)
+{
+}
+
+
+PipelineStateClass::~PipelineStateClass()
+{
+}
+
+
+bool PipelineStateClass::Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext)
+{
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options;
+	HRESULT result;
+
+
+	// Store the device the state objects are created on and the context they are bound to.
+	m_device = device;
+	m_deviceContext = deviceContext;
+
+	// Create the state object cache.
+	m_states = new unordered_multimap<unsigned int, EntryType>;
+	if(!m_states)
+	{
+		return false;
+	}
+
+	// Constant buffer windows need the 11.1 context, and the runtime has to allow appending to a buffer that is in use.
+	result = m_deviceContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&m_deviceContext1);
+	if(FAILED(result))
+	{
+		m_deviceContext1 = 0;
+	}
+
+	if(m_deviceContext1)
+	{
+		result = m_device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+		if(FAILED(result) || !options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer)
+		{
+			m_deviceContext1->Release();
+			m_deviceContext1 = 0;
+		}
+	}
+
+	return true;
+}
+
+
+void PipelineStateClass::Shutdown()
+{
+	// Release every cached state object.
+	if(m_states)
+	{
+		for (auto it = m_states->begin(); it != m_states->end(); it++)
+		{
+			it->second.state->Release();
+			it->second.state = 0;
+		}
+
+		m_states->clear();
+		delete m_states;
+		m_states = 0;
+	}
+
+	// Release the 11.1 interface of the context.
+	if(m_deviceContext1)
+	{
+		m_deviceContext1->Release();
+		m_deviceContext1 = 0;
+	}
+
+	m_device = 0;
+	m_deviceContext = 0;
+
+	return;
+}
+
+
+ID3D11SamplerState* PipelineStateClass::GetSamplerState(D3D11_SAMPLER_DESC* desc)
+{
+	EntryType entry;
+	ID3D11SamplerState* state;
+	unsigned int hash;
+	HRESULT result;
+
+
+	// The sampler description has no padding, so it can be copied as a whole.
+	memset(&entry, 0, sizeof(entry));
+	entry.kind = STATE_SAMPLER;
+	entry.desc.sampler = *desc;
+
+	state = (ID3D11SamplerState*)FindState(entry, hash);
+	if(state)
+	{
+		return state;
+	}
+
+	// Create the sampler the first time it is asked for.
+	result = m_device->CreateSamplerState(desc, &state);
+	if(FAILED(result))
+	{
+		return 0;
+	}
+
+	entry.state = state;
+	AddState(entry, hash);
+
+	return state;
+}
+
+
+ID3D11RasterizerState* PipelineStateClass::GetRasterizerState(D3D11_RASTERIZER_DESC* desc)
+{
+	EntryType entry;
+	ID3D11RasterizerState* state;
+	unsigned int hash;
+	HRESULT result;
+
+
+	// The rasterizer description has no padding, so it can be copied as a whole.
+	memset(&entry, 0, sizeof(entry));
+	entry.kind = STATE_RASTERIZER;
+	entry.desc.rasterizer = *desc;
+
+	state = (ID3D11RasterizerState*)FindState(entry, hash);
+	if(state)
+	{
+		return state;
+	}
+
+	// Create the rasterizer state the first time it is asked for.
+	result = m_device->CreateRasterizerState(desc, &state);
+	if(FAILED(result))
+	{
+		return 0;
+	}
+
+	entry.state = state;
+	AddState(entry, hash);
+
+	return state;
+}
+
+
+ID3D11DepthStencilState* PipelineStateClass::GetDepthStencilState(D3D11_DEPTH_STENCIL_DESC* desc)
+{
+	EntryType entry;
+	ID3D11DepthStencilState* state;
+	unsigned int hash;
+	HRESULT result;
+
+
+	// Copy the fields one at a time so the padding after the stencil masks stays zero.
+	memset(&entry, 0, sizeof(entry));
+	entry.kind = STATE_DEPTH_STENCIL;
+	entry.desc.depthStencil.DepthEnable = desc->DepthEnable;
+	entry.desc.depthStencil.DepthWriteMask = desc->DepthWriteMask;
+	entry.desc.depthStencil.DepthFunc = desc->DepthFunc;
+	entry.desc.depthStencil.StencilEnable = desc->StencilEnable;
+	entry.desc.depthStencil.StencilReadMask = desc->StencilReadMask;
+	entry.desc.depthStencil.StencilWriteMask = desc->StencilWriteMask;
+	entry.desc.depthStencil.FrontFace = desc->FrontFace;
+	entry.desc.depthStencil.BackFace = desc->BackFace;
+
+	state = (ID3D11DepthStencilState*)FindState(entry, hash);
+	if(state)
+	{
+		return state;
+	}
+
+	// Create the depth stencil state the first time it is asked for.
+	result = m_device->CreateDepthStencilState(desc, &state);
+	if(FAILED(result))
+	{
+		return 0;
+	}
+
+	entry.state = state;
+	AddState(entry, hash);
+
+	return state;
+}
+
+
+ID3D11BlendState* PipelineStateClass::GetBlendState(D3D11_BLEND_DESC* desc)
+{
+	EntryType entry;
+	ID3D11BlendState* state;
+	unsigned int hash;
+	HRESULT result;
+	int i;
+
+
+	// Copy the fields one at a time so the padding after each write mask stays zero.
+	memset(&entry, 0, sizeof(entry));
+	entry.kind = STATE_BLEND;
+	entry.desc.blend.AlphaToCoverageEnable = desc->AlphaToCoverageEnable;
+	entry.desc.blend.IndependentBlendEnable = desc->IndependentBlendEnable;
+	for(i=0; i<8; i++)
+	{
+		entry.desc.blend.RenderTarget[i].BlendEnable = desc->RenderTarget[i].BlendEnable;
+		entry.desc.blend.RenderTarget[i].SrcBlend = desc->RenderTarget[i].SrcBlend;
+		entry.desc.blend.RenderTarget[i].DestBlend = desc->RenderTarget[i].DestBlend;
+		entry.desc.blend.RenderTarget[i].BlendOp = desc->RenderTarget[i].BlendOp;
+		entry.desc.blend.RenderTarget[i].SrcBlendAlpha = desc->RenderTarget[i].SrcBlendAlpha;
+		entry.desc.blend.RenderTarget[i].DestBlendAlpha = desc->RenderTarget[i].DestBlendAlpha;
+		entry.desc.blend.RenderTarget[i].BlendOpAlpha = desc->RenderTarget[i].BlendOpAlpha;
+		entry.desc.blend.RenderTarget[i].RenderTargetWriteMask = desc->RenderTarget[i].RenderTargetWriteMask;
+	}
+
+	state = (ID3D11BlendState*)FindState(entry, hash);
+	if(state)
+	{
+		return state;
+	}
+
+	// Create the blend state the first time it is asked for.
+	result = m_device->CreateBlendState(desc, &state);
+	if(FAILED(result))
+	{
+		return 0;
+	}
+
+	entry.state = state;
+	AddState(entry, hash);
+
+	return state;
+}
+
+
+int PipelineStateClass::GetStateObjectCount()
+{
+	return (int)m_states->size();
+}
+
+
+void PipelineStateClass::SetInputLayout(ID3D11InputLayout* layout)
+{
+	if(Filter(layout != m_layout))
+	{
+		m_deviceContext->IASetInputLayout(layout);
+		m_layout = layout;
+	}
+
+	return;
+}
+
+
+void PipelineStateClass::SetVertexShader(ID3D11VertexShader* vertexShader)
+{
+	if(Filter(vertexShader != m_vertexShader))
+	{
+		m_deviceContext->VSSetShader(vertexShader, NULL, 0);
+		m_vertexShader = vertexShader;
+	}
+
+	return;
+}
+
+
+void PipelineStateClass::SetPixelShader(ID3D11PixelShader* pixelShader)
+{
+	if(Filter(pixelShader != m_pixelShader))
+	{
+		m_deviceContext->PSSetShader(pixelShader, NULL, 0);
+		m_pixelShader = pixelShader;
+	}
+
+	return;
+}
+
+
+void PipelineStateClass::SetVSConstantBuffer(int slot, ID3D11Buffer* buffer)
+{
+	// A buffer stays bound when it is mapped with discard, so rebinding after an update is never needed.
+	if(slot >= PIPELINE_STATE_SLOTS)
+	{
+		Filter(true);
+		m_deviceContext->VSSetConstantBuffers(slot, 1, &buffer);
+		return;
+	}
+
+	// Binding the whole buffer also replaces a window of it.
+	if(Filter((buffer != m_vsConstantBuffers[slot]) || (m_vsConstantRanges[slot][1] != 0)))
+	{
+		m_deviceContext->VSSetConstantBuffers(slot, 1, &buffer);
+		m_vsConstantBuffers[slot] = buffer;
+		m_vsConstantRanges[slot][0] = 0;
+		m_vsConstantRanges[slot][1] = 0;
+	}
+
+	return;
+}
+
+
+void PipelineStateClass::SetPSConstantBuffer(int slot, ID3D11Buffer* buffer)
+{
+	if(slot >= PIPELINE_STATE_SLOTS)
+	{
+		Filter(true);
+		m_deviceContext->PSSetConstantBuffers(slot, 1, &buffer);
+		return;
+	}
+
+	if(Filter((buffer != m_psConstantBuffers[slot]) || (m_psConstantRanges[slot][1] != 0)))
+	{
+		m_deviceContext->PSSetConstantBuffers(slot, 1, &buffer);
+		m_psConstantBuffers[slot] = buffer;
+		m_psConstantRanges[slot][0] = 0;
+		m_psConstantRanges[slot][1] = 0;
+	}
+
+	return;
+}
+
+
+void PipelineStateClass::SetVSConstantBuffer(int slot, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int constantCount)
+{
+	// The window is given in sixteen byte constants, with the first a multiple of sixteen.
+	if(slot >= PIPELINE_STATE_SLOTS)
+	{
+		Filter(true);
+		m_deviceContext1->VSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount);
+		return;
+	}
+
+	if(Filter((buffer != m_vsConstantBuffers[slot]) || (firstConstant != m_vsConstantRanges[slot][0]) ||
+		(constantCount != m_vsConstantRanges[slot][1])))
+	{
+		m_deviceContext1->VSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount);
+		m_vsConstantBuffers[slot] = buffer;
+		m_vsConstantRanges[slot][0] = firstConstant;
+		m_vsConstantRanges[slot][1] = constantCount;
+	}
+
+	return;
+}
+
+
+void PipelineStateClass::SetPSConstantBuffer(int slot, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int constantCount)
+{
+	if(slot >= PIPELINE_STATE_SLOTS)
+	{
+		Filter(true);
+		m_deviceContext1->PSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount);
+		return;
+	}
+
+	if(Filter((buffer != m_psConstantBuffers[slot]) || (firstConstant != m_psConstantRanges[slot][0]) ||
+		(constantCount != m_psConstantRanges[slot][1])))
+	{
+		m_deviceContext1->PSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount);
+		m_psConstantBuffers[slot] = buffer;
+		m_psConstantRanges[slot][0] = firstConstant;
+		m_psConstantRanges[slot][1] = constantCount;
+	}
+
+	return;
+}
+
+
+bool PipelineStateClass::SupportsConstantOffsets()
+{
+	return (m_deviceContext1 != 0);
+}
+
+
+void PipelineStateClass::SetPSShaderResource(int slot, ID3D11ShaderResourceView* resource)
+{
+	if(slot >= PIPELINE_STATE_SLOTS)
+	{
+		Filter(true);
+		m_deviceContext->PSSetShaderResources(slot, 1, &resource);
+		return;
+	}
+
+	if(Filter(resource != m_psShaderResources[slot]))
+	{
+		m_deviceContext->PSSetShaderResources(slot, 1, &resource);
+		m_psShaderResources[slot] = resource;
+	}
+
+	return;
+}
+
+
+void PipelineStateClass::SetPSSampler(int slot, ID3D11SamplerState* sampler)
+{
+	if(slot >= PIPELINE_STATE_SLOTS)
+	{
+		Filter(true);
+		m_deviceContext->PSSetSamplers(slot, 1, &sampler);
+		return;
+	}
+
+	if(Filter(sampler != m_psSamplers[slot]))
+	{
+		m_deviceContext->PSSetSamplers(slot, 1, &sampler);
+		m_psSamplers[slot] = sampler;
+	}
+
+	return;
+}
+
+
+void PipelineStateClass::SetRasterizerState(ID3D11RasterizerState* state)
+{
+	if(Filter(state != m_rasterizerState))
+	{
+		m_deviceContext->RSSetState(state);
+		m_rasterizerState = state;
+	}
+
+	return;
+}
+
+
+void PipelineStateClass::SetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef)
+{
+	if(Filter((state != m_depthStencilState) || (stencilRef != m_stencilRef)))
+	{
+		m_deviceContext->OMSetDepthStencilState(state, stencilRef);
+		m_depthStencilState = state;
+		m_stencilRef = stencilRef;
+	}
+
+	return;
+}
+
+
+void PipelineStateClass::SetBlendState(ID3D11BlendState* state)
+{
+	// Every blend state in the engine uses a constant blend factor of zero and the full sample mask.
+	if(Filter(state != m_blendState))
+	{
+		m_deviceContext->OMSetBlendState(state, NULL, 0xffffffff);
+		m_blendState = state;
+	}
+
+	return;
+}
+
+
+void PipelineStateClass::ResetCounters()
+{
+	m_issuedCalls = 0;
+	m_filteredCalls = 0;
+
+	return;
+}
+
+
+int PipelineStateClass::GetIssuedCalls()
+{
+	return m_issuedCalls;
+}
+
+
+int PipelineStateClass::GetFilteredCalls()
+{
+	return m_filteredCalls;
+}
+
+
+ID3D11DeviceChild* PipelineStateClass::FindState(EntryType& entry, unsigned int& hash)
+{
+	unsigned char* bytes;
+	unsigned int i;
+
+
+	// Hash the kind and the zero padded description with FNV-1a.
+	hash = 2166136261U;
+
+	bytes = (unsigned char*)&entry.kind;
+	for(i=0; i<sizeof(entry.kind); i++)
+	{
+		hash = (hash ^ bytes[i]) * 16777619U;
+	}
+
+	bytes = (unsigned char*)&entry.desc;
+	for(i=0; i<sizeof(entry.desc); i++)
+	{
+		hash = (hash ^ bytes[i]) * 16777619U;
+	}
+
+	// Compare the whole description against every entry with the same hash.
+	auto range = m_states->equal_range(hash);
+	for (auto it = range.first; it != range.second; it++)
+	{
+		if((it->second.kind == entry.kind) && (memcmp(&it->second.desc, &entry.desc, sizeof(entry.desc)) == 0))
+		{
+			return it->second.state;
+		}
+	}
+
+	return 0;
+}
+
+
+void PipelineStateClass::AddState(EntryType& entry, unsigned int hash)
+{
+	m_states->insert(make_pair(hash, entry));
+
+	return;
+}
+
+
+bool PipelineStateClass::Filter(bool changed)
+{
+	// Count the call as issued when the binding changes and as filtered when it is already in place.
+	if(changed)
+	{
+		m_issuedCalls++;
+	}
+	else
+	{
+		m_filteredCalls++;
+	}
+
+	return changed;
+}
@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: pipelinestateclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _PIPELINESTATECLASS_H_
+#define _PIPELINESTATECLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <d3d11_1.h>
+#include <unordered_map>
+using namespace std;
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int PIPELINE_STATE_SLOTS = 8;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: PipelineStateClass
+// Shares state objects between the shader classes and keeps them from binding
+// state that is already in place.
+//
+// The Get functions hash a state description and return the existing object
+// when an identical one was asked for before, so every shader that wants a
+// linear wrap sampler gets the same sampler.  The cache owns the objects and
+// releases them on Shutdown, so callers must not release what they are given.
+//
+// The Set functions remember what is bound to the device context and only
+// forward a call when the binding actually changes.  Tracking starts from
+// the empty state of a new context, so everything that binds these states has
+// to go through here.  Slots past PIPELINE_STATE_SLOTS are always forwarded.
+// Constant buffers can also be bound as a window of sixteen byte constants
+// into a larger buffer when the runtime is Direct3D 11.1 or later, which
+// SupportsConstantOffsets reports.
+// The counters of issued and filtered calls are reset by ResetCounters,
+// which D3DClass calls at the start of every frame.
+////////////////////////////////////////////////////////////////////////////////
+class PipelineStateClass
+{
+private:
+	enum StateKindType
+	{
+		STATE_SAMPLER,
+		STATE_RASTERIZER,
+		STATE_DEPTH_STENCIL,
+		STATE_BLEND
+	};
+
+	// A cached state object with the description it was created from, zero padded so descriptions compare bytewise.
+	struct EntryType
+	{
+		StateKindType kind;
+		union
+		{
+			D3D11_SAMPLER_DESC sampler;
+			D3D11_RASTERIZER_DESC rasterizer;
+			D3D11_DEPTH_STENCIL_DESC depthStencil;
+			D3D11_BLEND_DESC blend;
+		} desc;
+		ID3D11DeviceChild* state;
+	};
+
+public:
+	PipelineStateClass();
+	PipelineStateClass(const PipelineStateClass&);
+	~PipelineStateClass();
+
+	bool Initialize(ID3D11Device*, ID3D11DeviceContext*);
+	void Shutdown();
+
+	ID3D11SamplerState* GetSamplerState(D3D11_SAMPLER_DESC*);
+	ID3D11RasterizerState* GetRasterizerState(D3D11_RASTERIZER_DESC*);
+	ID3D11DepthStencilState* GetDepthStencilState(D3D11_DEPTH_STENCIL_DESC*);
+	ID3D11BlendState* GetBlendState(D3D11_BLEND_DESC*);
+	int GetStateObjectCount();
+
+	void SetInputLayout(ID3D11InputLayout*);
+	void SetVertexShader(ID3D11VertexShader*);
+	void SetPixelShader(ID3D11PixelShader*);
+	void SetVSConstantBuffer(int, ID3D11Buffer*);
+	void SetPSConstantBuffer(int, ID3D11Buffer*);
+	void SetVSConstantBuffer(int, ID3D11Buffer*, unsigned int, unsigned int);
+	void SetPSConstantBuffer(int, ID3D11Buffer*, unsigned int, unsigned int);
+	bool SupportsConstantOffsets();
+	void SetPSShaderResource(int, ID3D11ShaderResourceView*);
+	void SetPSSampler(int, ID3D11SamplerState*);
+	void SetRasterizerState(ID3D11RasterizerState*);
+	void SetDepthStencilState(ID3D11DepthStencilState*, unsigned int);
+	void SetBlendState(ID3D11BlendState*);
+
+	void ResetCounters();
+	int GetIssuedCalls();
+	int GetFilteredCalls();
+
+private:
+	ID3D11DeviceChild* FindState(EntryType&, unsigned int&);
+	void AddState(EntryType&, unsigned int);
+	bool Filter(bool);
+
+private:
+	ID3D11Device* m_device;
+	ID3D11DeviceContext* m_deviceContext;
+	ID3D11DeviceContext1* m_deviceContext1;
+	unordered_multimap<unsigned int, EntryType>* m_states;
+
+	ID3D11InputLayout* m_layout;
+	ID3D11VertexShader* m_vertexShader;
+	ID3D11PixelShader* m_pixelShader;
+	ID3D11Buffer* m_vsConstantBuffers[PIPELINE_STATE_SLOTS];
+	ID3D11Buffer* m_psConstantBuffers[PIPELINE_STATE_SLOTS];
+	unsigned int m_vsConstantRanges[PIPELINE_STATE_SLOTS][2];
+	unsigned int m_psConstantRanges[PIPELINE_STATE_SLOTS][2];
+	ID3D11ShaderResourceView* m_psShaderResources[PIPELINE_STATE_SLOTS];
+	ID3D11SamplerState* m_psSamplers[PIPELINE_STATE_SLOTS];
+	ID3D11RasterizerState* m_rasterizerState;
+	ID3D11DepthStencilState* m_depthStencilState;
+	unsigned int m_stencilRef;
+	ID3D11BlendState* m_blendState;
+
+	int m_issuedCalls, m_filteredCalls;
+};
+
+#endif
@@ -0,0 +1,392 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: profilerclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "profilerclass.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+
+bool ProfilerClass::m_initialized = false;
+int ProfilerClass::m_generation = 0;
+__declspec(thread) ProfilerClass::ThreadBufferType* ProfilerClass::m_threadBuffer = 0;
+__declspec(thread) int ProfilerClass::m_threadGeneration = 0;
+ProfilerClass::ThreadBufferType* ProfilerClass::m_threads[PROFILER_MAX_THREADS];
+atomic<int> ProfilerClass::m_threadCount(0);
+unsigned long long ProfilerClass::m_startTicks = 0;
+LARGE_INTEGER ProfilerClass::m_startCounter;
+unordered_map<const char*, ProfilerClass::ZoneStatsType>* ProfilerClass::m_zones = 0;
+int ProfilerClass::m_frameCount = 0;
+int ProfilerClass::m_summaryCount = -1;
+
+
+bool ProfilerClass::Initialize()
+{
+	int i;
+
+
+	if(m_initialized)
+	{
+		return true;
+	}
+
+	for(i=0; i<PROFILER_MAX_THREADS; i++)
+	{
+		m_threads[i] = 0;
+	}
+
+	m_threadCount = 0;
+	m_frameCount = 0;
+	m_summaryCount = -1;
+
+	m_zones = new unordered_map<const char*, ZoneStatsType>;
+	if(!m_zones)
+	{
+		return false;
+	}
+
+	// Remember when recording started in both clocks, to find the time stamp counter's rate later.
+	m_startTicks = __rdtsc();
+	QueryPerformanceCounter(&m_startCounter);
+
+	// Buffers from an earlier run are gone, so threads must make new ones.
+	m_generation++;
+	m_initialized = true;
+
+	return true;
+}
+
+
+void ProfilerClass::Shutdown()
+{
+	int i;
+
+
+	// Nothing may be recording any more when the buffers are released.
+	m_initialized = false;
+
+	for(i=0; i<PROFILER_MAX_THREADS; i++)
+	{
+		if(m_threads[i])
+		{
+			delete [] m_threads[i]->events;
+			delete m_threads[i];
+			m_threads[i] = 0;
+		}
+	}
+
+	m_threadCount = 0;
+
+	if(m_zones)
+	{
+		delete m_zones;
+		m_zones = 0;
+	}
+
+	return;
+}
+
+
+void ProfilerClass::BeginZone(const char* name)
+{
+	ThreadBufferType* buffer;
+
+
+	buffer = GetThreadBuffer();
+	if(!buffer)
+	{
+		return;
+	}
+
+	// Zones nested too deeply are not recorded, but still counted so the closes match.
+	if(buffer->depth < PROFILER_MAX_DEPTH)
+	{
+		buffer->openNames[buffer->depth] = name;
+		buffer->openStarts[buffer->depth] = __rdtsc();
+	}
+
+	buffer->depth++;
+
+	return;
+}
+
+
+void ProfilerClass::EndZone()
+{
+	ThreadBufferType* buffer;
+	EventType* event;
+	unsigned int written;
+
+
+	buffer = GetThreadBuffer();
+	if(!buffer || (buffer->depth == 0))
+	{
+		return;
+	}
+
+	buffer->depth--;
+	if(buffer->depth >= PROFILER_MAX_DEPTH)
+	{
+		return;
+	}
+
+	// Write the zone to the next slot, then publish it by moving the count on.
+	written = buffer->written.load(memory_order_relaxed);
+	event = &buffer->events[written & (PROFILER_RING_SIZE - 1)];
+	event->name = buffer->openNames[buffer->depth];
+	event->start = buffer->openStarts[buffer->depth];
+	event->end = __rdtsc();
+	buffer->written.store(written + 1, memory_order_release);
+
+	return;
+}
+
+
+void ProfilerClass::EndFrame()
+{
+	ThreadBufferType* buffer;
+	EventType* event;
+	ZoneStatsType* stats;
+	unsigned int written, index;
+	int threadCount, i;
+
+
+	if(!m_initialized)
+	{
+		return;
+	}
+
+	// Add up the zones every thread finished since the last frame.  Zones the ring has already
+	// overwritten are skipped.
+	threadCount = min(m_threadCount.load(), PROFILER_MAX_THREADS);
+	for(i=0; i<threadCount; i++)
+	{
+		buffer = m_threads[i];
+		if(!buffer)
+		{
+			continue;
+		}
+
+		written = buffer->written.load(memory_order_acquire);
+		index = buffer->summarized;
+		if(written - index > (unsigned int)PROFILER_RING_SIZE)
+		{
+			index = written - PROFILER_RING_SIZE;
+		}
+
+		for(; index!=written; index++)
+		{
+			event = &buffer->events[index & (PROFILER_RING_SIZE - 1)];
+			stats = &(*m_zones)[event->name];
+			stats->frameTicks += (double)(event->end - event->start);
+			stats->frameCalls++;
+		}
+
+		buffer->summarized = written;
+	}
+
+	// Fold the frame into every zone's moving average, so zones that stop running fade out.
+	for(auto it = m_zones->begin(); it != m_zones->end(); it++)
+	{
+		stats = &it->second;
+		stats->averageTicks += (stats->frameTicks - stats->averageTicks) * PROFILER_SUMMARY_SMOOTHING;
+		stats->averageCalls += ((double)stats->frameCalls - stats->averageCalls) * PROFILER_SUMMARY_SMOOTHING;
+		stats->frameTicks = 0.0;
+		stats->frameCalls = 0;
+	}
+
+	m_frameCount++;
+
+	return;
+}
+
+
+bool ProfilerClass::ExportTrace(char* filename)
+{
+	ofstream fout;
+	ThreadBufferType* buffer;
+	EventType* event;
+	double ticksPerMicrosecond;
+	unsigned int written, index;
+	int threadCount, i;
+	bool first;
+
+
+	if(!m_initialized)
+	{
+		return false;
+	}
+
+	fout.open(filename, ios_base::out);
+	if(fout.fail())
+	{
+		return false;
+	}
+
+	ticksPerMicrosecond = GetTicksPerMicrosecond();
+	fout << fixed << setprecision(3);
+	fout << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	// Name every thread's track, then write its zones as complete events in microseconds.
+	first = true;
+	threadCount = min(m_threadCount.load(), PROFILER_MAX_THREADS);
+	for(i=0; i<threadCount; i++)
+	{
+		buffer = m_threads[i];
+		if(!buffer)
+		{
+			continue;
+		}
+
+		fout << (first ? "\n" : ",\n");
+		fout << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread
+			<< ",\"args\":{\"name\":\"Thread " << buffer->thread << "\"}}";
+		first = false;
+
+		written = buffer->written.load(memory_order_acquire);
+		index = (written > (unsigned int)PROFILER_RING_SIZE) ? written - PROFILER_RING_SIZE : 0;
+		for(; index!=written; index++)
+		{
+			event = &buffer->events[index & (PROFILER_RING_SIZE - 1)];
+
+			fout << ",\n{\"name\":\"";
+			WriteName(fout, event->name);
+			fout << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread
+				<< ",\"ts\":" << (double)(event->start - m_startTicks) / ticksPerMicrosecond
+				<< ",\"dur\":" << (double)(event->end - event->start) / ticksPerMicrosecond << "}";
+		}
+	}
+
+	fout << "\n]}\n";
+	fout.close();
+
+	return true;
+}
+
+
+bool ProfilerClass::GetSummary(vector<string>& lines)
+{
+	vector<pair<double, const char*>> order;
+	ostringstream line;
+	double ticksPerMillisecond;
+	int i;
+
+
+	// Only make new text every few frames, so it can be read and is cheap to keep on screen.
+	if(!m_initialized || (m_frameCount / PROFILER_SUMMARY_INTERVAL == m_summaryCount))
+	{
+		return false;
+	}
+
+	m_summaryCount = m_frameCount / PROFILER_SUMMARY_INTERVAL;
+
+	// List the zones that take the longest in an average frame.
+	for(auto it = m_zones->begin(); it != m_zones->end(); it++)
+	{
+		order.push_back(make_pair(it->second.averageTicks, it->first));
+	}
+
+	sort(order.begin(), order.end(), [](const pair<double, const char*>& a, const pair<double, const char*>& b) { return a.first > b.first; });
+
+	ticksPerMillisecond = GetTicksPerMicrosecond() * 1000.0;
+	lines.clear();
+	for(i=0; (i<(int)order.size()) && (i<PROFILER_SUMMARY_LINES); i++)
+	{
+		line.str("");
+		line << fixed << setprecision(2) << setw(7) << order[i].first / ticksPerMillisecond << " ms  "
+			<< setprecision(1) << setw(4) << (*m_zones)[order[i].second].averageCalls << "x  " << order[i].second;
+		lines.push_back(line.str());
+	}
+
+	return true;
+}
+
+
+ProfilerClass::ThreadBufferType* ProfilerClass::GetThreadBuffer()
+{
+	ThreadBufferType* buffer;
+	int thread;
+
+
+	if(!m_initialized)
+	{
+		return 0;
+	}
+
+	if(m_threadGeneration == m_generation)
+	{
+		return m_threadBuffer;
+	}
+
+	// The first zone on a thread claims a slot for its buffer.  A thread past the last slot is not recorded.
+	m_threadBuffer = 0;
+	m_threadGeneration = m_generation;
+
+	thread = m_threadCount.fetch_add(1);
+	if(thread >= PROFILER_MAX_THREADS)
+	{
+		return 0;
+	}
+
+	buffer = new ThreadBufferType;
+	if(!buffer)
+	{
+		return 0;
+	}
+
+	buffer->events = new EventType[PROFILER_RING_SIZE];
+	if(!buffer->events)
+	{
+		delete buffer;
+		return 0;
+	}
+
+	buffer->written = 0;
+	buffer->summarized = 0;
+	buffer->depth = 0;
+	buffer->thread = thread;
+
+	m_threads[thread] = buffer;
+	m_threadBuffer = buffer;
+
+	return buffer;
+}
+
+
+double ProfilerClass::GetTicksPerMicrosecond()
+{
+	LARGE_INTEGER counter, frequency;
+	unsigned long long ticks;
+	double microseconds;
+
+
+	// Time the time stamp counter against the performance counter over everything recorded so far.
+	ticks = __rdtsc();
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+
+	microseconds = (double)(counter.QuadPart - m_startCounter.QuadPart) * 1000000.0 / (double)frequency.QuadPart;
+	if((microseconds <= 0.0) || (ticks <= m_startTicks))
+	{
+		return 1.0;
+	}
+
+	return (double)(ticks - m_startTicks) / microseconds;
+}
+
+
+void ProfilerClass::WriteName(ofstream& fout, const char* name)
+{
+	// Escape the characters JSON strings cannot hold as they are.
+	for(; *name; name++)
+	{
+		if((*name == '"') || (*name == '\\'))
+		{
+			fout << '\\';
+		}
+
+		fout << *name;
+	}
+
+	return;
+}
@@ -0,0 +1,147 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: profilerclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _PROFILERCLASS_H_
+#define _PROFILERCLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <windows.h>
+#include <intrin.h>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+using namespace std;
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int PROFILER_MAX_THREADS = 64;
+const int PROFILER_MAX_DEPTH = 32;
+const int PROFILER_RING_SIZE = 32768;
+const int PROFILER_SUMMARY_LINES = 8;
+const int PROFILER_SUMMARY_INTERVAL = 30;
+const double PROFILER_SUMMARY_SMOOTHING = 0.05;
+
+
+////////////
+// MACROS //
+////////////
+// Zones only exist in builds with ENGINE_PROFILE defined, which the Debug
+// configurations of the engine and game are.  Without it the macros expand
+// to nothing, so the zones cost nothing at all in Release.
+#ifdef ENGINE_PROFILE
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZoneClass PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FRAME() ProfilerClass::EndFrame()
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FRAME()
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: ProfilerClass
+// Records how long named zones of code take on every thread.  A zone is
+// opened with PROFILE_ZONE at the top of a scope and closed when the scope
+// ends, and zones nest.  Each thread writes its finished zones to its own
+// ring buffer, found through a thread local pointer, so recording never
+// takes a lock or touches memory another thread writes.  A thread's buffer
+// is made the first time it opens a zone, and the oldest zones are
+// overwritten once it wraps.  Timestamps are read from the processor's time
+// stamp counter and converted against the performance counter on export.
+//
+// ExportTrace writes every zone still in the buffers as Chrome trace JSON,
+// which chrome://tracing and Perfetto both open.  PROFILE_FRAME at the end of
+// each frame folds the zones finished since the last frame into a moving
+// average per zone name, and GetSummary turns the slowest of those into lines
+// of text for the screen every PROFILER_SUMMARY_INTERVAL frames.  The class
+// is static so any code can open zones without being handed an object, and
+// nothing is recorded until Initialize is called.
+////////////////////////////////////////////////////////////////////////////////
+class ProfilerClass
+{
+private:
+	// A finished zone.  The name is not copied, so it must be a string literal.
+	struct EventType
+	{
+		const char* name;
+		unsigned long long start;
+		unsigned long long end;
+	};
+
+	// The zones a thread has open and the ring it writes them to when they close.
+	struct ThreadBufferType
+	{
+		EventType* events;
+		atomic<unsigned int> written;
+		unsigned int summarized;
+		const char* openNames[PROFILER_MAX_DEPTH];
+		unsigned long long openStarts[PROFILER_MAX_DEPTH];
+		int depth;
+		int thread;
+	};
+
+	struct ZoneStatsType
+	{
+		double frameTicks;
+		double averageTicks;
+		int frameCalls;
+		double averageCalls;
+	};
+
+public:
+	static bool Initialize();
+	static void Shutdown();
+
+	static void BeginZone(const char*);
+	static void EndZone();
+	static void EndFrame();
+
+	static bool ExportTrace(char*);
+	static bool GetSummary(vector<string>&);
+
+private:
+	static ThreadBufferType* GetThreadBuffer();
+	static double GetTicksPerMicrosecond();
+	static void WriteName(ofstream&, const char*);
+
+private:
+	static bool m_initialized;
+	static int m_generation;
+	static __declspec(thread) ThreadBufferType* m_threadBuffer;
+	static __declspec(thread) int m_threadGeneration;
+	static ThreadBufferType* m_threads[PROFILER_MAX_THREADS];
+	static atomic<int> m_threadCount;
+	static unsigned long long m_startTicks;
+	static LARGE_INTEGER m_startCounter;
+	static unordered_map<const char*, ZoneStatsType>* m_zones;
+	static int m_frameCount, m_summaryCount;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: ProfileZoneClass
+// Opens a zone for as long as it is in scope.  Use it through PROFILE_ZONE.
+////////////////////////////////////////////////////////////////////////////////
+class ProfileZoneClass
+{
+public:
+	ProfileZoneClass(const char* name)
+	{
+		ProfilerClass::BeginZone(name);
+	}
+
+	~ProfileZoneClass()
+	{
+		ProfilerClass::EndZone();
+	}
+};
+
+#endif
@@ -0,0 +1,1483 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: softwarerendererclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "softwarerendererclass.h"
+#include <math.h>
+#include <algorithm>
+
+
+// Orders model vertices by their bytes so identical vertices end up next to each other for welding.
+struct VertexOrderType
+{
+	VertexType::Default* vertices;
+
+	bool operator()(int a, int b) const
+	{
+		return memcmp(&vertices[a], &vertices[b], sizeof(VertexType::Default)) < 0;
+	}
+};
+
+
+SoftwareRendererClass::SoftwareRendererClass()
+{
+	m_colorBuffer = 0;
+	m_depthBuffer = 0;
+	m_clearColor = 0;
+	m_depthEnable = true;
+	m_hierarchicalZ = true;
+	m_rejectedPixelRatio = 0.0f;
+	m_ThreadPool = 0;
+	m_Shader = 0;
+	m_vertices = 0;
+	m_indices = 0;
+	m_batches = 0;
+	m_transformedVertices = 0;
+	m_indexedTriangles = 0;
+	m_draws = 0;
+	m_triangles = 0;
+	m_bins = 0;
+	m_statistics = 0;
+}
+
+
+SoftwareRendererClass::SoftwareRendererClass(const SoftwareRendererClass& other)
+{
+}
+
+
+SoftwareRendererClass::~SoftwareRendererClass()
+{
+}
+
+
+bool SoftwareRendererClass::Initialize(int screenWidth, int screenHeight, float screenDepth, float screenNear,
+									   ThreadPoolClass* threadPool)
+{
+	bool result;
+	float fieldOfView, screenAspect;
+
+
+	// The fixed point edge functions only stay inside 32 bits up to this size.
+	if((screenWidth > 2048) || (screenHeight > 2048))
+	{
+		return false;
+	}
+
+	m_screenWidth = screenWidth;
+	m_screenHeight = screenHeight;
+
+	// Work out how many tiles cover the screen, rounding up for partial tiles on the right and bottom.
+	m_tilesX = (m_screenWidth + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+	m_tilesY = (m_screenHeight + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+
+	// Create the color and depth buffers.
+	m_colorBuffer = new unsigned int[m_screenWidth * m_screenHeight];
+	if(!m_colorBuffer)
+	{
+		return false;
+	}
+
+	m_depthBuffer = new float[m_screenWidth * m_screenHeight];
+	if(!m_depthBuffer)
+	{
+		return false;
+	}
+
+	// Keep the thread pool that transforms the batches and rasterizes the tiles.  It belongs to the caller.
+	m_ThreadPool = threadPool;
+
+	// Create the pixel shading kernels for this processor.
+	m_Shader = new SoftwareShaderClass;
+	if(!m_Shader)
+	{
+		return false;
+	}
+
+	result = m_Shader->Initialize();
+	if(!result)
+	{
+		return false;
+	}
+
+	// Create the vertex and index stores, the vertex batches, the per frame draw and triangle lists and one bin and
+	// set of statistics per tile.
+	m_vertices = new vector<VertexType::Default>;
+	m_indices = new vector<unsigned int>;
+	m_batches = new vector<BatchType>;
+	m_draws = new vector<DrawType>;
+	m_triangles = new vector<TriangleType>;
+	m_bins = new vector<int>[m_tilesX * m_tilesY];
+	m_statistics = new StatisticsType[m_tilesX * m_tilesY];
+	if(!m_vertices || !m_indices || !m_batches || !m_draws || !m_triangles || !m_bins || !m_statistics)
+	{
+		return false;
+	}
+
+	// Build the same matrices as the Direct3D object so both backends frame the scene identically.
+	fieldOfView = (float)D3DX_PI / 4.0f;
+	screenAspect = (float)screenWidth / (float)screenHeight;
+
+	D3DXMatrixPerspectiveFovLH(&m_projectionMatrix, fieldOfView, screenAspect, screenNear, screenDepth);
+	D3DXMatrixIdentity(&m_worldMatrix);
+	D3DXMatrixIdentity(&m_UIWorldMatrix);
+	D3DXMatrixOrthoLH(&m_orthoMatrix, (float)screenWidth, (float)screenHeight, screenNear, screenDepth);
+
+	m_depthEnable = true;
+
+	return true;
+}
+
+
+void SoftwareRendererClass::Shutdown()
+{
+	// Let go of the caller's thread pool.
+	m_ThreadPool = 0;
+
+	// Release the shading kernels.
+	if(m_Shader)
+	{
+		m_Shader->Shutdown();
+		delete m_Shader;
+		m_Shader = 0;
+	}
+
+	// Release the tile statistics.
+	if(m_statistics)
+	{
+		delete [] m_statistics;
+		m_statistics = 0;
+	}
+
+	// Release the tile bins.
+	if(m_bins)
+	{
+		delete [] m_bins;
+		m_bins = 0;
+	}
+
+	// Release the triangle list.
+	if(m_triangles)
+	{
+		delete m_triangles;
+		m_triangles = 0;
+	}
+
+	// Release the draw list.
+	if(m_draws)
+	{
+		delete m_draws;
+		m_draws = 0;
+	}
+
+	// Release the vertex batches.
+	if(m_batches)
+	{
+		delete m_batches;
+		m_batches = 0;
+	}
+
+	// Release the index store.
+	if(m_indices)
+	{
+		delete m_indices;
+		m_indices = 0;
+	}
+
+	// Release the vertex store.
+	if(m_vertices)
+	{
+		delete m_vertices;
+		m_vertices = 0;
+	}
+
+	// Release the depth buffer.
+	if(m_depthBuffer)
+	{
+		delete [] m_depthBuffer;
+		m_depthBuffer = 0;
+	}
+
+	// Release the color buffer.
+	if(m_colorBuffer)
+	{
+		delete [] m_colorBuffer;
+		m_colorBuffer = 0;
+	}
+
+	return;
+}
+
+
+void SoftwareRendererClass::BeginScene(float red, float green, float blue, float alpha)
+{
+	// Remember the clear color.  Each tile clears itself when it is rasterized so the clear runs in parallel too.
+	m_clearColor = ((unsigned int)(red * 255.0f + 0.5f)) | ((unsigned int)(green * 255.0f + 0.5f) << 8) |
+		((unsigned int)(blue * 255.0f + 0.5f) << 16) | ((unsigned int)(alpha * 255.0f + 0.5f) << 24);
+
+	m_draws->clear();
+	m_triangles->clear();
+
+	m_transformedVertices = 0;
+	m_indexedTriangles = 0;
+
+	return;
+}
+
+
+void SoftwareRendererClass::EndScene()
+{
+	PROFILE_ZONE("SoftwareRendererClass::EndScene");
+	double tested, rejected;
+	int i;
+
+
+	// Rasterize every tile on the thread pool.
+	m_ThreadPool->Run(&SoftwareRendererClass::RasterizeTileTask, this, m_tilesX * m_tilesY);
+
+	// Empty the bins for the next frame, keeping their memory, and total up the tile statistics.
+	tested = 0.0;
+	rejected = 0.0;
+	for(i=0; i<m_tilesX * m_tilesY; i++)
+	{
+		m_bins[i].clear();
+
+		tested += (double)m_statistics[i].testedPixels;
+		rejected += (double)m_statistics[i].rejectedPixels;
+	}
+
+	m_rejectedPixelRatio = ((tested + rejected) > 0.0) ? (float)(rejected / (tested + rejected)) : 0.0f;
+
+	return;
+}
+
+
+bool SoftwareRendererClass::AddModel(VertexType::Default* vertices, int indices)
+{
+	MEMORY_TAG(MemoryTrackerClass::TAG_BUFFERS);
+	VertexOrderType order;
+	int* sorted;
+	int* remap;
+	int i;
+
+
+	// The model files store three vertices per face.  Sort the vertices so identical ones are neighbours.
+	sorted = new int[indices];
+	if(!sorted)
+	{
+		return false;
+	}
+
+	remap = new int[indices];
+	if(!remap)
+	{
+		return false;
+	}
+
+	for(i=0; i<indices; i++)
+	{
+		sorted[i] = i;
+	}
+
+	order.vertices = vertices;
+	sort(sorted, sorted + indices, order);
+
+	// Weld each run of identical vertices into one entry of the vertex store.
+	for(i=0; i<indices; i++)
+	{
+		if((i == 0) || memcmp(&vertices[sorted[i]], &vertices[sorted[i - 1]], sizeof(VertexType::Default)) != 0)
+		{
+			m_vertices->push_back(vertices[sorted[i]]);
+		}
+
+		remap[sorted[i]] = (int)m_vertices->size() - 1;
+	}
+
+	// Append the indices in the original order so draws use the same index ranges as the GPU buffer.
+	for(i=0; i<indices; i++)
+	{
+		m_indices->push_back((unsigned int)remap[i]);
+	}
+
+	delete [] remap;
+	remap = 0;
+
+	delete [] sorted;
+	sorted = 0;
+
+	return true;
+}
+
+
+int SoftwareRendererClass::GetIndexCount()
+{
+	return (int)m_indices->size();
+}
+
+
+bool SoftwareRendererClass::RenderLight(int indexCount, int indexStart, D3DXMATRIX worldMatrix, D3DXMATRIX viewMatrix,
+										D3DXMATRIX projectionMatrix, SoftwareTextureClass* texture, D3DXVECTOR3 lightDirection,
+										D3DXVECTOR4 ambientColor, D3DXVECTOR4 diffuseColor, D3DXVECTOR3 cameraPosition,
+										D3DXVECTOR4 specularColor, float specularPower)
+{
+	DrawType draw;
+	int drawIndex, batchCount, i, j;
+
+
+	if((indexStart < 0) || (indexStart + indexCount > (int)m_indices->size()))
+	{
+		return false;
+	}
+
+	// Record the pixel shader state for this draw.
+	draw.shader = SHADER_LIGHT;
+	draw.texture = texture;
+	draw.depthEnable = m_depthEnable;
+	draw.lightConstants.ambientColor[0] = ambientColor.x;
+	draw.lightConstants.ambientColor[1] = ambientColor.y;
+	draw.lightConstants.ambientColor[2] = ambientColor.z;
+	draw.lightConstants.ambientColor[3] = ambientColor.w;
+	draw.lightConstants.diffuseColor[0] = diffuseColor.x;
+	draw.lightConstants.diffuseColor[1] = diffuseColor.y;
+	draw.lightConstants.diffuseColor[2] = diffuseColor.z;
+	draw.lightConstants.diffuseColor[3] = diffuseColor.w;
+	draw.lightConstants.lightDirection[0] = lightDirection.x;
+	draw.lightConstants.lightDirection[1] = lightDirection.y;
+	draw.lightConstants.lightDirection[2] = lightDirection.z;
+	draw.lightConstants.specularPower = specularPower;
+	draw.lightConstants.specularColor[0] = specularColor.x;
+	draw.lightConstants.specularColor[1] = specularColor.y;
+	draw.lightConstants.specularColor[2] = specularColor.z;
+	draw.lightConstants.specularColor[3] = specularColor.w;
+
+	drawIndex = (int)m_draws->size();
+	m_draws->push_back(draw);
+
+	m_vertexStage.draw = drawIndex;
+	m_vertexStage.worldMatrix = worldMatrix;
+	m_vertexStage.worldViewProjection = worldMatrix * viewMatrix * projectionMatrix;
+	m_vertexStage.cameraPosition = cameraPosition;
+
+	// Split the draw into batches of triangles.
+	batchCount = ((indexCount / 3) + SOFTWARE_BATCH_TRIANGLES - 1) / SOFTWARE_BATCH_TRIANGLES;
+	if((int)m_batches->size() < batchCount)
+	{
+		m_batches->resize(batchCount);
+	}
+
+	for(i=0; i<batchCount; i++)
+	{
+		(*m_batches)[i].indexStart = indexStart + (i * SOFTWARE_BATCH_TRIANGLES * 3);
+		(*m_batches)[i].indexCount = min(SOFTWARE_BATCH_TRIANGLES * 3, ((indexCount / 3) * 3) - (i * SOFTWARE_BATCH_TRIANGLES * 3));
+	}
+
+	// Transform, clip and set up the batches in parallel.
+	m_ThreadPool->Run(&SoftwareRendererClass::TransformBatchTask, this, batchCount);
+
+	// Bin the results in submission order so the tiles draw the triangles in the same order on any number of threads.
+	for(i=0; i<batchCount; i++)
+	{
+		BatchType& batch = (*m_batches)[i];
+
+		for(j=0; j<(int)batch.triangles.size(); j++)
+		{
+			m_triangles->push_back(batch.triangles[j]);
+			BinTriangle((int)m_triangles->size() - 1);
+		}
+
+		m_transformedVertices += (unsigned int)batch.vertices.size();
+		m_indexedTriangles += (unsigned int)(batch.indexCount / 3);
+	}
+
+	return true;
+}
+
+
+bool SoftwareRendererClass::RenderTexture(VertexType::Textured* input, int vertexCount, D3DXMATRIX worldMatrix, D3DXMATRIX viewMatrix,
+										  D3DXMATRIX projectionMatrix, SoftwareTextureClass* texture)
+{
+	return RenderTextured(input, vertexCount, worldMatrix, viewMatrix, projectionMatrix, texture, SHADER_TEXTURE);
+}
+
+
+bool SoftwareRendererClass::RenderFont(VertexType::Glyph* glyphs, int glyphCount, D3DXVECTOR4* glyphMetrics, D3DXMATRIX worldMatrix,
+									   D3DXMATRIX viewMatrix, D3DXMATRIX projectionMatrix, SoftwareTextureClass* texture, bool distanceField)
+{
+	// The corners of the two triangles in a glyph's quad, as fractions of its width and height down from the top left.
+	static const float quadCorners[6][2] =
+	{
+		{ 0.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f },
+		{ 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }
+	};
+	DrawType draw;
+	D3DXMATRIX worldViewProjection;
+	ClipVertexType vertices[3];
+	D3DXVECTOR4 metrics, color;
+	D3DXVECTOR3 position;
+	float scale;
+	int drawIndex, firstTriangle, corner, i, j, k;
+
+
+	// Record the pixel shader state for this draw.
+	draw.shader = distanceField ? SHADER_FONT_DISTANCE : SHADER_FONT;
+	draw.texture = texture;
+	draw.depthEnable = m_depthEnable;
+
+	drawIndex = (int)m_draws->size();
+	m_draws->push_back(draw);
+
+	worldViewProjection = worldMatrix * viewMatrix * projectionMatrix;
+
+	// Expand each glyph into its quad the way the font vertex shader does.
+	firstTriangle = (int)m_triangles->size();
+	for(i=0; i<glyphCount; i++)
+	{
+		// The glyph index is in the low 16 bits and its scale in the high 16, as 8.8 fixed point.
+		metrics = glyphMetrics[glyphs[i].glyph & 0xffff];
+		scale = (float)(glyphs[i].glyph >> 16) / 256.0f;
+
+		// Unpack the color, red in the low byte, the way the input layout reads it.
+		color.x = (float)(glyphs[i].color & 0xff) / 255.0f;
+		color.y = (float)((glyphs[i].color >> 8) & 0xff) / 255.0f;
+		color.z = (float)((glyphs[i].color >> 16) & 0xff) / 255.0f;
+		color.w = (float)(glyphs[i].color >> 24) / 255.0f;
+
+		for(j=0; j<6; j+=3)
+		{
+			for(k=0; k<3; k++)
+			{
+				corner = j + k;
+
+				// Place the corner from the glyph's top left, with y going up the screen.
+				position.x = glyphs[i].position.x + (quadCorners[corner][0] * metrics.z * scale);
+				position.y = glyphs[i].position.y - (quadCorners[corner][1] * metrics.w * scale);
+				position.z = 0.0f;
+
+				D3DXVec3Transform(&vertices[k].position, &position, &worldViewProjection);
+
+				// Pick the texture coordinates from the glyph's span of the font texture, and pass the color through.
+				vertices[k].attributes[0] = metrics.x + ((metrics.y - metrics.x) * quadCorners[corner][0]);
+				vertices[k].attributes[1] = quadCorners[corner][1];
+				vertices[k].attributes[2] = color.x;
+				vertices[k].attributes[3] = color.y;
+				vertices[k].attributes[4] = color.z;
+				vertices[k].attributes[5] = color.w;
+				vertices[k].attributes[6] = 0.0f;
+				vertices[k].attributes[7] = 0.0f;
+			}
+
+			SubmitTriangle(drawIndex, vertices, *m_triangles);
+		}
+	}
+
+	// Text is only a few hundred quads, so they are set up in place and binned straight away.
+	for(i=firstTriangle; i<(int)m_triangles->size(); i++)
+	{
+		BinTriangle(i);
+	}
+
+	return true;
+}
+
+
+void SoftwareRendererClass::GetProjectionMatrix(D3DXMATRIX& projectionMatrix)
+{
+	projectionMatrix = m_projectionMatrix;
+	return;
+}
+
+
+void SoftwareRendererClass::GetWorldMatrix(D3DXMATRIX& worldMatrix)
+{
+	worldMatrix = m_worldMatrix;
+	return;
+}
+
+
+void SoftwareRendererClass::GetOrthoMatrix(D3DXMATRIX& orthoMatrix)
+{
+	orthoMatrix = m_orthoMatrix;
+	return;
+}
+
+
+void SoftwareRendererClass::GetUIWorldMatrix(D3DXMATRIX& UIWorldMatrix)
+{
+	UIWorldMatrix = m_UIWorldMatrix;
+	return;
+}
+
+
+void SoftwareRendererClass::TurnZBufferOn()
+{
+	m_depthEnable = true;
+	return;
+}
+
+
+void SoftwareRendererClass::TurnZBufferOff()
+{
+	m_depthEnable = false;
+	return;
+}
+
+
+int SoftwareRendererClass::GetWidth()
+{
+	return m_screenWidth;
+}
+
+
+int SoftwareRendererClass::GetHeight()
+{
+	return m_screenHeight;
+}
+
+
+unsigned int* SoftwareRendererClass::GetColorBuffer()
+{
+	return m_colorBuffer;
+}
+
+
+SoftwareShaderClass* SoftwareRendererClass::GetShader()
+{
+	return m_Shader;
+}
+
+
+void SoftwareRendererClass::SetHierarchicalZ(bool enable)
+{
+	m_hierarchicalZ = enable;
+	return;
+}
+
+
+bool SoftwareRendererClass::GetHierarchicalZ()
+{
+	return m_hierarchicalZ;
+}
+
+
+float SoftwareRendererClass::GetRejectedPixelRatio()
+{
+	// The share of the pixels inside triangle bounds that the depth hierarchy skipped in the last frame.
+	return m_rejectedPixelRatio;
+}
+
+
+float SoftwareRendererClass::GetVerticesPerTriangle()
+{
+	// Vertex shader runs per triangle of the indexed draws in the current frame.  Three means no vertex was
+	// shared, and a well ordered mesh gets close to 0.5.
+	if(m_indexedTriangles == 0)
+	{
+		return 0.0f;
+	}
+
+	return (float)m_transformedVertices / (float)m_indexedTriangles;
+}
+
+
+bool SoftwareRendererClass::SaveFrame(char* filename)
+{
+	ofstream fout;
+	unsigned char header[18];
+	unsigned int* row;
+	unsigned int pixel;
+	int x, y;
+
+
+	fout.open(filename, ios_base::out | ios_base::binary);
+	if(fout.fail())
+	{
+		return false;
+	}
+
+	// Write an uncompressed 32-bit true color TGA header with a top-left origin.
+	memset(header, 0, sizeof(header));
+	header[2] = 2;
+	header[12] = (unsigned char)(m_screenWidth & 0xff);
+	header[13] = (unsigned char)(m_screenWidth >> 8);
+	header[14] = (unsigned char)(m_screenHeight & 0xff);
+	header[15] = (unsigned char)(m_screenHeight >> 8);
+	header[16] = 32;
+	header[17] = 0x28;
+	fout.write((char*)header, sizeof(header));
+
+	row = new unsigned int[m_screenWidth];
+	if(!row)
+	{
+		return false;
+	}
+
+	// TGA stores BGRA so swap the red and blue channels of every pixel.
+	for(y=0; y<m_screenHeight; y++)
+	{
+		for(x=0; x<m_screenWidth; x++)
+		{
+			pixel = m_colorBuffer[(y * m_screenWidth) + x];
+			row[x] = (pixel & 0xff00ff00) | ((pixel & 0xff) << 16) | ((pixel >> 16) & 0xff);
+		}
+
+		fout.write((char*)row, sizeof(unsigned int) * m_screenWidth);
+	}
+
+	delete [] row;
+	row = 0;
+
+	fout.close();
+
+	return true;
+}
+
+
+bool SoftwareRendererClass::RenderTextured(VertexType::Textured* input, int vertexCount, D3DXMATRIX worldMatrix,
+										   D3DXMATRIX viewMatrix, D3DXMATRIX projectionMatrix, SoftwareTextureClass* texture,
+										   ShaderType shader)
+{
+	DrawType draw;
+	D3DXMATRIX worldViewProjection;
+	ClipVertexType vertices[3];
+	int drawIndex, firstTriangle, i, j, k;
+
+
+	// Record the pixel shader state for this draw.
+	draw.shader = shader;
+	draw.texture = texture;
+	draw.depthEnable = m_depthEnable;
+
+	drawIndex = (int)m_draws->size();
+	m_draws->push_back(draw);
+
+	worldViewProjection = worldMatrix * viewMatrix * projectionMatrix;
+
+	// The texture vertex shader only transforms the position and passes the texture coordinates through.
+	firstTriangle = (int)m_triangles->size();
+	for(i=0; i+2<vertexCount; i+=3)
+	{
+		for(j=0; j<3; j++)
+		{
+			D3DXVec3Transform(&vertices[j].position, &input[i + j].position, &worldViewProjection);
+
+			vertices[j].attributes[0] = input[i + j].texture.x;
+			vertices[j].attributes[1] = input[i + j].texture.y;
+			for(k=2; k<SOFTWARE_ATTRIBUTE_COUNT; k++)
+			{
+				vertices[j].attributes[k] = 0.0f;
+			}
+		}
+
+		SubmitTriangle(drawIndex, vertices, *m_triangles);
+	}
+
+	// These draws are only a few quads, so they are set up in place and binned straight away.
+	for(i=firstTriangle; i<(int)m_triangles->size(); i++)
+	{
+		BinTriangle(i);
+	}
+
+	return true;
+}
+
+
+void SoftwareRendererClass::TransformBatchTask(void* context, int batch)
+{
+	PROFILE_ZONE("SoftwareRendererClass::TransformBatch");
+	((SoftwareRendererClass*)context)->TransformBatch(batch);
+	return;
+}
+
+
+void SoftwareRendererClass::TransformBatch(int index)
+{
+	BatchType& batch = (*m_batches)[index];
+	ClipVertexType vertices[3];
+	unsigned int vertex, hash, mask;
+	int i, j;
+
+
+	mask = (1 << SOFTWARE_VERTEX_CACHE_BITS) - 1;
+
+	// Empty the cache and the previous draw's output, keeping their memory.
+	batch.cacheKeys.assign(1 << SOFTWARE_VERTEX_CACHE_BITS, -1);
+	batch.cacheSlots.resize(1 << SOFTWARE_VERTEX_CACHE_BITS);
+	batch.slots.resize(batch.indexCount);
+	batch.sources.clear();
+	batch.triangles.clear();
+
+	// Give each distinct vertex index a slot, probing the cache linearly from its hash.
+	for(i=0; i<batch.indexCount; i++)
+	{
+		vertex = (*m_indices)[batch.indexStart + i];
+		hash = (vertex * 2654435761u) >> (32 - SOFTWARE_VERTEX_CACHE_BITS);
+
+		while((batch.cacheKeys[hash] != -1) && (batch.cacheKeys[hash] != (int)vertex))
+		{
+			hash = (hash + 1) & mask;
+		}
+
+		if(batch.cacheKeys[hash] == -1)
+		{
+			batch.cacheKeys[hash] = (int)vertex;
+			batch.cacheSlots[hash] = (int)batch.sources.size();
+			batch.sources.push_back(vertex);
+		}
+
+		batch.slots[i] = batch.cacheSlots[hash];
+	}
+
+	// Run the vertex shader once per slot.
+	TransformVertices(batch);
+
+	// Assemble the triangles from the transformed vertices, then clip, cull and set them up.
+	for(i=0; i<batch.indexCount; i+=3)
+	{
+		for(j=0; j<3; j++)
+		{
+			vertices[j] = batch.vertices[batch.slots[i + j]];
+		}
+
+		SubmitTriangle(m_vertexStage.draw, vertices, batch.triangles);
+	}
+
+	return;
+}
+
+
+// Normalizes the xyz part of a vector, leaving a zero vector alone.
+static __m128 Normalize3(__m128 vector)
+{
+	__m128 square, length;
+
+
+	square = _mm_mul_ps(vector, vector);
+	length = _mm_add_ss(_mm_add_ss(square, _mm_shuffle_ps(square, square, _MM_SHUFFLE(1, 1, 1, 1))),
+		_mm_shuffle_ps(square, square, _MM_SHUFFLE(2, 2, 2, 2)));
+	length = _mm_sqrt_ss(length);
+
+	if(_mm_cvtss_f32(length) == 0.0f)
+	{
+		return vector;
+	}
+
+	return _mm_div_ps(vector, _mm_shuffle_ps(length, length, _MM_SHUFFLE(0, 0, 0, 0)));
+}
+
+
+void SoftwareRendererClass::TransformVertices(BatchType& batch)
+{
+	__m128 worldRows[4], clipRows[4], camera, mask, x, y, z, result;
+	float output[4];
+	VertexType::Default* input;
+	ClipVertexType* vertex;
+	unsigned int i;
+	int r;
+
+
+	// Load the matrix rows once for the whole batch.  Each vertex is then a weighted sum of rows, one SSE
+	// register per vector.
+	for(r=0; r<4; r++)
+	{
+		worldRows[r] = _mm_loadu_ps(m_vertexStage.worldMatrix.m[r]);
+		clipRows[r] = _mm_loadu_ps(m_vertexStage.worldViewProjection.m[r]);
+	}
+
+	camera = _mm_setr_ps(m_vertexStage.cameraPosition.x, m_vertexStage.cameraPosition.y, m_vertexStage.cameraPosition.z, 0.0f);
+	mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+
+	batch.vertices.resize(batch.sources.size());
+
+	for(i=0; i<batch.sources.size(); i++)
+	{
+		input = &(*m_vertices)[batch.sources[i]];
+		vertex = &batch.vertices[i];
+
+		// Calculate the position of the vertex against the world, view, and projection matrices.
+		x = _mm_set1_ps(input->position.x);
+		y = _mm_set1_ps(input->position.y);
+		z = _mm_set1_ps(input->position.z);
+		result = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, clipRows[0]), _mm_mul_ps(y, clipRows[1])),
+			_mm_add_ps(_mm_mul_ps(z, clipRows[2]), clipRows[3]));
+		_mm_storeu_ps(&vertex->position.x, result);
+
+		// Determine the normalized viewing direction from the vertex's world position to the camera.
+		result = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, worldRows[0]), _mm_mul_ps(y, worldRows[1])),
+			_mm_add_ps(_mm_mul_ps(z, worldRows[2]), worldRows[3]));
+		result = Normalize3(_mm_and_ps(_mm_sub_ps(camera, result), mask));
+		_mm_storeu_ps(output, result);
+		vertex->attributes[5] = output[0];
+		vertex->attributes[6] = output[1];
+		vertex->attributes[7] = output[2];
+
+		// Calculate the normal vector against the world matrix only and normalize it.
+		x = _mm_set1_ps(input->normal.x);
+		y = _mm_set1_ps(input->normal.y);
+		z = _mm_set1_ps(input->normal.z);
+		result = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, worldRows[0]), _mm_mul_ps(y, worldRows[1])), _mm_mul_ps(z, worldRows[2]));
+		result = Normalize3(_mm_and_ps(result, mask));
+		_mm_storeu_ps(output, result);
+		vertex->attributes[2] = output[0];
+		vertex->attributes[3] = output[1];
+		vertex->attributes[4] = output[2];
+
+		// Store the texture coordinates for the pixel shader.
+		vertex->attributes[0] = input->texture.x;
+		vertex->attributes[1] = input->texture.y;
+	}
+
+	return;
+}
+
+
+// Signed distance of a clip space vertex to each of the six frustum planes, positive on the inside.
+static float ClipDistance(D3DXVECTOR4& position, int plane)
+{
+	switch(plane)
+	{
+		case 0: return position.w + position.x;
+		case 1: return position.w - position.x;
+		case 2: return position.w + position.y;
+		case 3: return position.w - position.y;
+		case 4: return position.z;
+		default: return position.w - position.z;
+	}
+}
+
+
+void SoftwareRendererClass::SubmitTriangle(int draw, ClipVertexType* vertices, vector<TriangleType>& output)
+{
+	ClipVertexType polygon[9], scratch[9];
+	int outside[3], plane, i, count;
+
+
+	// Build an outcode for each vertex with one bit per frustum plane it is outside of.
+	for(i=0; i<3; i++)
+	{
+		outside[i] = 0;
+		for(plane=0; plane<6; plane++)
+		{
+			if(ClipDistance(vertices[i].position, plane) < 0.0f)
+			{
+				outside[i] |= (1 << plane);
+			}
+		}
+	}
+
+	// Throw the triangle away if all three vertices are outside the same plane.
+	if(outside[0] & outside[1] & outside[2])
+	{
+		return;
+	}
+
+	// Triangles completely inside the frustum go straight to setup.
+	if(!(outside[0] | outside[1] | outside[2]))
+	{
+		SetupTriangle(draw, &vertices[0], &vertices[1], &vertices[2], output);
+		return;
+	}
+
+	// Otherwise clip it and split the remaining polygon into a triangle fan.
+	for(i=0; i<3; i++)
+	{
+		polygon[i] = vertices[i];
+	}
+
+	count = ClipPolygon(polygon, 3, scratch);
+	for(i=1; i+1<count; i++)
+	{
+		SetupTriangle(draw, &polygon[0], &polygon[i], &polygon[i + 1], output);
+	}
+
+	return;
+}
+
+
+int SoftwareRendererClass::ClipPolygon(ClipVertexType* polygon, int count, ClipVertexType* scratch)
+{
+	int plane, i, next, outputCount, k;
+	float distance, nextDistance, t;
+	ClipVertexType* current;
+	ClipVertexType* following;
+
+
+	// Sutherland-Hodgman against each plane in turn.  Every plane adds at most one vertex, so nine is enough.
+	for(plane=0; plane<6; plane++)
+	{
+		outputCount = 0;
+
+		for(i=0; i<count; i++)
+		{
+			next = (i + 1) % count;
+			current = &polygon[i];
+			following = &polygon[next];
+
+			distance = ClipDistance(current->position, plane);
+			nextDistance = ClipDistance(following->position, plane);
+
+			if(distance >= 0.0f)
+			{
+				scratch[outputCount++] = *current;
+			}
+
+			// Add the intersection point when the edge crosses the plane.
+			if((distance >= 0.0f) != (nextDistance >= 0.0f))
+			{
+				t = distance / (distance - nextDistance);
+
+				scratch[outputCount].position = current->position + (following->position - current->position) * t;
+				for(k=0; k<SOFTWARE_ATTRIBUTE_COUNT; k++)
+				{
+					scratch[outputCount].attributes[k] = current->attributes[k] +
+						(following->attributes[k] - current->attributes[k]) * t;
+				}
+				outputCount++;
+			}
+		}
+
+		for(i=0; i<outputCount; i++)
+		{
+			polygon[i] = scratch[i];
+		}
+
+		count = outputCount;
+		if(count < 3)
+		{
+			return 0;
+		}
+	}
+
+	return count;
+}
+
+
+void SoftwareRendererClass::SetupTriangle(int draw, ClipVertexType* v0, ClipVertexType* v1, ClipVertexType* v2,
+										  vector<TriangleType>& output)
+{
+	TriangleType triangle;
+	ClipVertexType* vertices[3];
+	float invW, screenX, screenY, weightX, weightY;
+	int area, minX, minY, maxX, maxY, i, k, a, b;
+
+
+	vertices[0] = v0;
+	vertices[1] = v1;
+	vertices[2] = v2;
+
+	triangle.draw = draw;
+
+	// Project each vertex to the viewport and snap it to the sub-pixel grid.
+	for(i=0; i<3; i++)
+	{
+		invW = 1.0f / vertices[i]->position.w;
+
+		screenX = (vertices[i]->position.x * invW + 1.0f) * 0.5f * (float)m_screenWidth;
+		screenY = (1.0f - vertices[i]->position.y * invW) * 0.5f * (float)m_screenHeight;
+
+		triangle.x[i] = (int)floorf(screenX * (float)(1 << SOFTWARE_SUBPIXEL_BITS) + 0.5f);
+		triangle.y[i] = (int)floorf(screenY * (float)(1 << SOFTWARE_SUBPIXEL_BITS) + 0.5f);
+		triangle.z[i] = vertices[i]->position.z * invW;
+		triangle.invW[i] = invW;
+
+		// Pre-divide the attributes by w so they interpolate linearly in screen space.
+		for(k=0; k<SOFTWARE_ATTRIBUTE_COUNT; k++)
+		{
+			triangle.attributes[i][k] = vertices[i]->attributes[k] * invW;
+		}
+	}
+
+	// Front faces are clockwise on screen.  Cull back faces and degenerate triangles like the rasterizer state does.
+	area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) -
+		(triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+	if(area <= 0)
+	{
+		return;
+	}
+
+	triangle.invArea = 1.0f / (float)area;
+
+	// Depth interpolates linearly in screen space, so the vertices bound the depth of every pixel.
+	triangle.minZ = min(triangle.z[0], min(triangle.z[1], triangle.z[2]));
+	triangle.maxZ = max(triangle.z[0], max(triangle.z[1], triangle.z[2]));
+
+	// Find the screen space gradients of u/w, v/w and 1/w.  Each weight changes by its edge function's step
+	// per pixel, so the gradients let the sampler pick a mip level without looking at neighbouring pixels.
+	for(k=0; k<3; k++)
+	{
+		triangle.gradientX[k] = 0.0f;
+		triangle.gradientY[k] = 0.0f;
+	}
+
+	for(i=0; i<3; i++)
+	{
+		a = (i + 1) % 3;
+		b = (i + 2) % 3;
+		weightX = (float)(-(triangle.y[b] - triangle.y[a]) << SOFTWARE_SUBPIXEL_BITS) * triangle.invArea;
+		weightY = (float)((triangle.x[b] - triangle.x[a]) << SOFTWARE_SUBPIXEL_BITS) * triangle.invArea;
+
+		triangle.gradientX[0] += weightX * triangle.attributes[i][0];
+		triangle.gradientX[1] += weightX * triangle.attributes[i][1];
+		triangle.gradientX[2] += weightX * triangle.invW[i];
+		triangle.gradientY[0] += weightY * triangle.attributes[i][0];
+		triangle.gradientY[1] += weightY * triangle.attributes[i][1];
+		triangle.gradientY[2] += weightY * triangle.invW[i];
+	}
+
+	// Find the range of pixel centers the triangle can touch, clamped to the screen.
+	minX = min(triangle.x[0], min(triangle.x[1], triangle.x[2]));
+	minY = min(triangle.y[0], min(triangle.y[1], triangle.y[2]));
+	maxX = max(triangle.x[0], max(triangle.x[1], triangle.x[2]));
+	maxY = max(triangle.y[0], max(triangle.y[1], triangle.y[2]));
+
+	triangle.minX = max((minX - (1 << (SOFTWARE_SUBPIXEL_BITS - 1)) + (1 << SOFTWARE_SUBPIXEL_BITS) - 1) >> SOFTWARE_SUBPIXEL_BITS, 0);
+	triangle.minY = max((minY - (1 << (SOFTWARE_SUBPIXEL_BITS - 1)) + (1 << SOFTWARE_SUBPIXEL_BITS) - 1) >> SOFTWARE_SUBPIXEL_BITS, 0);
+	triangle.maxX = min((maxX - (1 << (SOFTWARE_SUBPIXEL_BITS - 1))) >> SOFTWARE_SUBPIXEL_BITS, m_screenWidth - 1);
+	triangle.maxY = min((maxY - (1 << (SOFTWARE_SUBPIXEL_BITS - 1))) >> SOFTWARE_SUBPIXEL_BITS, m_screenHeight - 1);
+
+	// Skip triangles too small to cover any pixel center.
+	if((triangle.minX > triangle.maxX) || (triangle.minY > triangle.maxY))
+	{
+		return;
+	}
+
+	output.push_back(triangle);
+
+	return;
+}
+
+
+void SoftwareRendererClass::BinTriangle(int index)
+{
+	TriangleType& triangle = (*m_triangles)[index];
+	int tileX, tileY, e, a, b, dx, dy, cornerX, cornerY, half;
+	bool covered;
+
+
+	half = 1 << (SOFTWARE_SUBPIXEL_BITS - 1);
+
+	// Add the triangle to every tile its bounding box overlaps, unless one of its edges rejects the whole tile.
+	for(tileY=triangle.minY / SOFTWARE_TILE_SIZE; tileY<=triangle.maxY / SOFTWARE_TILE_SIZE; tileY++)
+	{
+		for(tileX=triangle.minX / SOFTWARE_TILE_SIZE; tileX<=triangle.maxX / SOFTWARE_TILE_SIZE; tileX++)
+		{
+			covered = true;
+
+			for(e=0; (e<3) && covered; e++)
+			{
+				a = (e + 1) % 3;
+				b = (e + 2) % 3;
+				dx = triangle.x[b] - triangle.x[a];
+				dy = triangle.y[b] - triangle.y[a];
+
+				// Test the pixel center in the tile that is furthest inside this edge.
+				cornerX = (dy < 0) ? min((tileX + 1) * SOFTWARE_TILE_SIZE, m_screenWidth) - 1 : tileX * SOFTWARE_TILE_SIZE;
+				cornerY = (dx > 0) ? min((tileY + 1) * SOFTWARE_TILE_SIZE, m_screenHeight) - 1 : tileY * SOFTWARE_TILE_SIZE;
+				cornerX = (cornerX << SOFTWARE_SUBPIXEL_BITS) + half;
+				cornerY = (cornerY << SOFTWARE_SUBPIXEL_BITS) + half;
+
+				if((dx * (cornerY - triangle.y[a]) - dy * (cornerX - triangle.x[a])) < 0)
+				{
+					covered = false;
+				}
+			}
+
+			if(covered)
+			{
+				m_bins[(tileY * m_tilesX) + tileX].push_back(index);
+			}
+		}
+	}
+
+	return;
+}
+
+
+void SoftwareRendererClass::RasterizeTileTask(void* context, int tile)
+{
+	PROFILE_ZONE("SoftwareRendererClass::RasterizeTile");
+	((SoftwareRendererClass*)context)->RasterizeTile(tile);
+	return;
+}
+
+
+void SoftwareRendererClass::RasterizeTile(int tile)
+{
+	int tileMinX, tileMinY, tileMaxX, tileMaxY, minX, minY, maxX, maxY, startX, x, y, e, a, b, dx, dy, half, index, lane;
+	int firstLane, lastLane, blockX, blockY, blockMinX, blockMinY, blockMaxX, blockMaxY, block;
+	int bias[3], stepX[3], stepY[3], origin[3], edge[3], value[3];
+	float weights[3][SOFTWARE_SIMD_WIDTH], depth[SOFTWARE_SIMD_WIDTH], weight[3], pixelDepth, nearest, farthest;
+	float blockMin[SOFTWARE_HIZ_BLOCKS * SOFTWARE_HIZ_BLOCKS], blockMax[SOFTWARE_HIZ_BLOCKS * SOFTWARE_HIZ_BLOCKS];
+	bool blockDirty[SOFTWARE_HIZ_BLOCKS * SOFTWARE_HIZ_BLOCKS];
+	vector<int>& bin = m_bins[tile];
+	StatisticsType& statistics = m_statistics[tile];
+	unsigned int n, mask;
+	bool hierarchicalZ, acceptAll;
+
+
+	// Find the pixel rectangle this tile covers.
+	tileMinX = (tile % m_tilesX) * SOFTWARE_TILE_SIZE;
+	tileMinY = (tile / m_tilesX) * SOFTWARE_TILE_SIZE;
+	tileMaxX = min(tileMinX + SOFTWARE_TILE_SIZE, m_screenWidth) - 1;
+	tileMaxY = min(tileMinY + SOFTWARE_TILE_SIZE, m_screenHeight) - 1;
+
+	// Clear the tile to the BeginScene color and the far plane.
+	for(y=tileMinY; y<=tileMaxY; y++)
+	{
+		for(x=tileMinX; x<=tileMaxX; x++)
+		{
+			m_colorBuffer[(y * m_screenWidth) + x] = m_clearColor;
+			m_depthBuffer[(y * m_screenWidth) + x] = 1.0f;
+		}
+	}
+
+	// Every block of the depth hierarchy starts at the far plane too.
+	for(block=0; block<SOFTWARE_HIZ_BLOCKS * SOFTWARE_HIZ_BLOCKS; block++)
+	{
+		blockMin[block] = 1.0f;
+		blockMax[block] = 1.0f;
+		blockDirty[block] = false;
+	}
+
+	statistics.testedPixels = 0;
+	statistics.rejectedPixels = 0;
+
+	// Start every lane on a valid weight so the pixels a span does not cover still interpolate to finite values.
+	for(lane=0; lane<SOFTWARE_SIMD_WIDTH; lane++)
+	{
+		weights[0][lane] = 1.0f;
+		weights[1][lane] = 0.0f;
+		weights[2][lane] = 0.0f;
+	}
+
+	half = 1 << (SOFTWARE_SUBPIXEL_BITS - 1);
+
+	// Draw the binned triangles in the order they were submitted.
+	for(n=0; n<bin.size(); n++)
+	{
+		TriangleType& triangle = (*m_triangles)[bin[n]];
+		DrawType& draw = (*m_draws)[triangle.draw];
+
+		minX = max(triangle.minX, tileMinX);
+		minY = max(triangle.minY, tileMinY);
+		maxX = min(triangle.maxX, tileMaxX);
+		maxY = min(triangle.maxY, tileMaxY);
+
+		// The hierarchy only applies to draws that test depth.  Nothing closer than the nearest possible pixel
+		// depth, less the interpolation error, can pass the depth test.
+		hierarchicalZ = m_hierarchicalZ && draw.depthEnable;
+		nearest = triangle.minZ - SOFTWARE_HIZ_EPSILON;
+
+		// Drop the whole triangle when it is behind every block it overlaps.  A block only needs its bounds
+		// refreshed when the triangle is not already in front of its nearest depth.
+		if(hierarchicalZ)
+		{
+			farthest = 0.0f;
+			for(blockY=(minY - tileMinY) / SOFTWARE_HIZ_BLOCK_SIZE; blockY<=(maxY - tileMinY) / SOFTWARE_HIZ_BLOCK_SIZE; blockY++)
+			{
+				for(blockX=(minX - tileMinX) / SOFTWARE_HIZ_BLOCK_SIZE; blockX<=(maxX - tileMinX) / SOFTWARE_HIZ_BLOCK_SIZE; blockX++)
+				{
+					block = (blockY * SOFTWARE_HIZ_BLOCKS) + blockX;
+					if(blockDirty[block] && (nearest >= blockMin[block]))
+					{
+						RefreshBlock(tileMinX + (blockX * SOFTWARE_HIZ_BLOCK_SIZE), tileMinY + (blockY * SOFTWARE_HIZ_BLOCK_SIZE),
+							&blockMin[block], &blockMax[block]);
+						blockDirty[block] = false;
+					}
+
+					farthest = max(farthest, blockMax[block]);
+				}
+			}
+
+			if(nearest >= farthest)
+			{
+				statistics.rejectedPixels += (maxX - minX + 1) * (maxY - minY + 1);
+				continue;
+			}
+		}
+
+		// Set up the three edge functions at the first pixel center.  Edge e is opposite vertex e, so its
+		// value scaled by the inverse area is that vertex's barycentric weight.  Spans start on a block
+		// boundary so each one falls inside a single block.
+		startX = minX - ((minX - tileMinX) % SOFTWARE_HIZ_BLOCK_SIZE);
+		for(e=0; e<3; e++)
+		{
+			a = (e + 1) % 3;
+			b = (e + 2) % 3;
+			dx = triangle.x[b] - triangle.x[a];
+			dy = triangle.y[b] - triangle.y[a];
+
+			// Top-left fill rule: pixels exactly on a right or bottom edge belong to the neighbouring triangle.
+			bias[e] = ((dy < 0) || ((dy == 0) && (dx > 0))) ? 0 : -1;
+
+			stepX[e] = -dy << SOFTWARE_SUBPIXEL_BITS;
+			stepY[e] = dx << SOFTWARE_SUBPIXEL_BITS;
+			origin[e] = dx * (((minY << SOFTWARE_SUBPIXEL_BITS) + half) - triangle.y[a]) -
+				dy * (((startX << SOFTWARE_SUBPIXEL_BITS) + half) - triangle.x[a]) + bias[e];
+		}
+
+		// Walk the blocks the triangle overlaps.
+		for(blockMinY=minY; blockMinY<=maxY; blockMinY=blockMaxY + 1)
+		{
+			blockMaxY = min(blockMinY - ((blockMinY - tileMinY) % SOFTWARE_HIZ_BLOCK_SIZE) + SOFTWARE_HIZ_BLOCK_SIZE - 1, maxY);
+			blockY = (blockMinY - tileMinY) / SOFTWARE_HIZ_BLOCK_SIZE;
+
+			for(blockMinX=startX; blockMinX<=maxX; blockMinX+=SOFTWARE_HIZ_BLOCK_SIZE)
+			{
+				blockMaxX = min(blockMinX + SOFTWARE_HIZ_BLOCK_SIZE - 1, maxX);
+				blockX = (blockMinX - tileMinX) / SOFTWARE_HIZ_BLOCK_SIZE;
+				block = (blockY * SOFTWARE_HIZ_BLOCKS) + blockX;
+
+				firstLane = max(minX - blockMinX, 0);
+				lastLane = blockMaxX - blockMinX;
+
+				// Skip the block when the triangle is behind all of it.  When the triangle is in front of all of
+				// it instead, every pixel it covers passes the depth test without reading the depth buffer.
+				acceptAll = false;
+				if(hierarchicalZ)
+				{
+					if(blockDirty[block] && (nearest >= blockMin[block]))
+					{
+						RefreshBlock(tileMinX + (blockX * SOFTWARE_HIZ_BLOCK_SIZE), tileMinY + (blockY * SOFTWARE_HIZ_BLOCK_SIZE),
+							&blockMin[block], &blockMax[block]);
+						blockDirty[block] = false;
+					}
+
+					if(nearest >= blockMax[block])
+					{
+						statistics.rejectedPixels += (lastLane - firstLane + 1) * (blockMaxY - blockMinY + 1);
+						continue;
+					}
+
+					acceptAll = (triangle.maxZ + SOFTWARE_HIZ_EPSILON) < blockMin[block];
+				}
+
+				statistics.testedPixels += (lastLane - firstLane + 1) * (blockMaxY - blockMinY + 1);
+
+				for(y=blockMinY; y<=blockMaxY; y++)
+				{
+					index = (y * m_screenWidth) + blockMinX;
+					mask = 0;
+
+					for(e=0; e<3; e++)
+					{
+						edge[e] = origin[e] + ((blockMinX - startX) * stepX[e]) + ((y - minY) * stepY[e]);
+					}
+
+					// Find the pixels inside the triangle that pass the depth test.
+					for(lane=firstLane; lane<=lastLane; lane++)
+					{
+						value[0] = edge[0] + lane * stepX[0];
+						value[1] = edge[1] + lane * stepX[1];
+						value[2] = edge[2] + lane * stepX[2];
+
+						// The pixel is inside when no edge function is negative.
+						if((value[0] | value[1] | value[2]) >= 0)
+						{
+							weight[0] = (float)(value[0] - bias[0]) * triangle.invArea;
+							weight[1] = (float)(value[1] - bias[1]) * triangle.invArea;
+							weight[2] = (float)(value[2] - bias[2]) * triangle.invArea;
+
+							pixelDepth = weight[0] * triangle.z[0] + weight[1] * triangle.z[1] + weight[2] * triangle.z[2];
+
+							if(!draw.depthEnable || acceptAll || (pixelDepth < m_depthBuffer[index + lane]))
+							{
+								weights[0][lane] = weight[0];
+								weights[1][lane] = weight[1];
+								weights[2][lane] = weight[2];
+								depth[lane] = pixelDepth;
+								mask |= 1 << lane;
+							}
+						}
+					}
+
+					if(mask)
+					{
+						ShadeSpan(draw, triangle, index, mask, weights, depth);
+
+						// The block's nearest depth can only come closer.  Its farthest depth may move either way
+						// so it is recomputed the next time it is needed.
+						if(draw.depthEnable)
+						{
+							for(lane=firstLane; lane<=lastLane; lane++)
+							{
+								if(mask & (1 << lane))
+								{
+									blockMin[block] = min(blockMin[block], depth[lane]);
+								}
+							}
+							blockDirty[block] = true;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return;
+}
+
+
+void SoftwareRendererClass::RefreshBlock(int blockMinX, int blockMinY, float* minDepth, float* maxDepth)
+{
+	int x, y, blockMaxX, blockMaxY;
+	float depth;
+
+
+	blockMaxX = min(blockMinX + SOFTWARE_HIZ_BLOCK_SIZE, m_screenWidth) - 1;
+	blockMaxY = min(blockMinY + SOFTWARE_HIZ_BLOCK_SIZE, m_screenHeight) - 1;
+
+	// Scan the block's depth buffer for its nearest and farthest depths.
+	*minDepth = 1.0f;
+	*maxDepth = 0.0f;
+	for(y=blockMinY; y<=blockMaxY; y++)
+	{
+		for(x=blockMinX; x<=blockMaxX; x++)
+		{
+			depth = m_depthBuffer[(y * m_screenWidth) + x];
+			*minDepth = min(*minDepth, depth);
+			*maxDepth = max(*maxDepth, depth);
+		}
+	}
+
+	return;
+}
+
+
+void SoftwareRendererClass::ShadeSpan(DrawType& draw, TriangleType& triangle, int index, unsigned int mask,
+									  float weights[3][SOFTWARE_SIMD_WIDTH], float* depth)
+{
+	SoftwareShaderClass::LightInputType input;
+	SoftwareTextureClass::SampleInputType sampleInput;
+	float attributes[SOFTWARE_ATTRIBUTE_COUNT][SOFTWARE_SIMD_WIDTH], w[SOFTWARE_SIMD_WIDTH];
+	unsigned int colors[SOFTWARE_SIMD_WIDTH];
+	int lane, k;
+
+
+	// Recover the perspective correct attributes of the whole span at once.
+	for(lane=0; lane<SOFTWARE_SIMD_WIDTH; lane++)
+	{
+		w[lane] = 1.0f / (weights[0][lane] * triangle.invW[0] + weights[1][lane] * triangle.invW[1] +
+			weights[2][lane] * triangle.invW[2]);
+	}
+
+	for(k=0; k<SOFTWARE_ATTRIBUTE_COUNT; k++)
+	{
+		for(lane=0; lane<SOFTWARE_SIMD_WIDTH; lane++)
+		{
+			attributes[k][lane] = (weights[0][lane] * triangle.attributes[0][k] + weights[1][lane] * triangle.attributes[1][k] +
+				weights[2][lane] * triangle.attributes[2][k]) * w[lane];
+		}
+	}
+
+	// Sample the texture for the whole span.  The derivatives of u and v follow from the quotient rule on the
+	// gradients of u/w, v/w and 1/w.  An unbound texture reads as zero, as it does on the GPU.
+	if(draw.texture)
+	{
+		for(lane=0; lane<SOFTWARE_SIMD_WIDTH; lane++)
+		{
+			sampleInput.u[lane] = attributes[0][lane];
+			sampleInput.v[lane] = attributes[1][lane];
+			sampleInput.dudx[lane] = (triangle.gradientX[0] - attributes[0][lane] * triangle.gradientX[2]) * w[lane];
+			sampleInput.dvdx[lane] = (triangle.gradientX[1] - attributes[1][lane] * triangle.gradientX[2]) * w[lane];
+			sampleInput.dudy[lane] = (triangle.gradientY[0] - attributes[0][lane] * triangle.gradientY[2]) * w[lane];
+			sampleInput.dvdy[lane] = (triangle.gradientY[1] - attributes[1][lane] * triangle.gradientY[2]) * w[lane];
+		}
+
+		draw.texture->SampleSpan(&sampleInput, input.texture);
+	}
+	else
+	{
+		memset(input.texture, 0, sizeof(input.texture));
+	}
+
+	if(draw.shader == SHADER_LIGHT)
+	{
+		// The normal and view direction are already laid out one row per channel.
+		memcpy(input.normal, attributes[2], sizeof(input.normal));
+		memcpy(input.viewDirection, attributes[5], sizeof(input.viewDirection));
+
+		m_Shader->ShadeLight(&input, &draw.lightConstants, colors);
+	}
+	else
+	{
+		// The texture and font shaders are cheap enough to run a pixel at a time.
+		for(lane=0; lane<SOFTWARE_SIMD_WIDTH; lane++)
+		{
+			if(mask & (1 << lane))
+			{
+				colors[lane] = ShadePixel(draw, D3DXVECTOR4(input.texture[0][lane], input.texture[1][lane],
+					input.texture[2][lane], input.texture[3][lane]), D3DXVECTOR4(attributes[2][lane], attributes[3][lane],
+					attributes[4][lane], attributes[5][lane]));
+
+				// Leave the pixels around the glyphs as they were.
+				if((draw.shader != SHADER_TEXTURE) && ((colors[lane] >> 24) == 0))
+				{
+					mask &= ~(1 << lane);
+				}
+			}
+		}
+	}
+
+	// Write out the pixels that passed the depth test.
+	for(lane=0; lane<SOFTWARE_SIMD_WIDTH; lane++)
+	{
+		if(mask & (1 << lane))
+		{
+			m_colorBuffer[index + lane] = colors[lane];
+			if(draw.depthEnable)
+			{
+				m_depthBuffer[index + lane] = depth[lane];
+			}
+		}
+	}
+
+	return;
+}
+
+
+static float Saturate(float value)
+{
+	return (value < 0.0f) ? 0.0f : ((value > 1.0f) ? 1.0f : value);
+}
+
+
+unsigned int SoftwareRendererClass::ShadePixel(DrawType& draw, D3DXVECTOR4 textureColor, D3DXVECTOR4 vertexColor)
+{
+	D3DXVECTOR4 color;
+
+
+	switch(draw.shader)
+	{
+		case SHADER_FONT:
+		{
+			// Black texels are transparent, everything else takes the text color.  Filtering leaves a trace of the
+			// neighbouring texels where the GPU's would round to zero, so anything under half a step of the 8 bit texture is black.
+			if(textureColor.x < (0.5f / 255.0f))
+			{
+				color = D3DXVECTOR4(textureColor.x, textureColor.y, textureColor.z, 0.0f);
+			}
+			else
+			{
+				color = D3DXVECTOR4(vertexColor.x, vertexColor.y, vertexColor.z, 1.0f);
+			}
+			break;
+		}
+
+		case SHADER_FONT_DISTANCE:
+		{
+			// Red holds the distance to the glyph's edge, where a half is on the edge and more is inside.  There are no
+			// derivatives of it here to smooth the edge over, so it is cut at the half instead of blended.
+			color = D3DXVECTOR4(vertexColor.x, vertexColor.y, vertexColor.z, (textureColor.x >= 0.5f) ? 1.0f : 0.0f);
+			break;
+		}
+
+		default:
+		{
+			color = textureColor;
+			break;
+		}
+	}
+
+	// Convert to the R8G8B8A8_UNORM render target format.
+	return ((unsigned int)(Saturate(color.x) * 255.0f + 0.5f)) | ((unsigned int)(Saturate(color.y) * 255.0f + 0.5f) << 8) |
+		((unsigned int)(Saturate(color.z) * 255.0f + 0.5f) << 16) | ((unsigned int)(Saturate(color.w) * 255.0f + 0.5f) << 24);
+}
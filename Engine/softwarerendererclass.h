@@ -0,0 +1,221 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: softwarerendererclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _SOFTWARERENDERERCLASS_H_
+#define _SOFTWARERENDERERCLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <d3dx10math.h>
+#include <fstream>
+#include <vector>
+using namespace std;
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "softwaretextureclass.h"
+#include "softwareshaderclass.h"
+#include "threadpoolclass.h"
+#include "profilerclass.h"
+#include "vertextypes.h"
+#include "memorytrackerclass.h"
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int SOFTWARE_TILE_SIZE = 64;
+const int SOFTWARE_SUBPIXEL_BITS = 4;
+const int SOFTWARE_ATTRIBUTE_COUNT = 8;
+const int SOFTWARE_HIZ_BLOCK_SIZE = 8;
+const int SOFTWARE_HIZ_BLOCKS = SOFTWARE_TILE_SIZE / SOFTWARE_HIZ_BLOCK_SIZE;
+const float SOFTWARE_HIZ_EPSILON = 0.00001f;
+const int SOFTWARE_BATCH_TRIANGLES = 256;
+const int SOFTWARE_VERTEX_CACHE_BITS = 11;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: SoftwareRendererClass
+// CPU implementation of the light, texture and font pipelines for machines
+// without a GPU.  Draw calls are transformed, clipped and set up as they are
+// submitted, then binned into screen tiles.  Models are welded into indexed
+// meshes when they are added.  Indexed draws are split into batches that run
+// on the thread pool, and each batch transforms every vertex it references
+// exactly once, then clips and culls its triangles before they are binned in
+// submission order.  EndScene rasterizes the tiles in
+// parallel on the thread pool, each tile walking its triangles in submission
+// order so the output does not depend on the number of threads.  Tiles are
+// walked in spans of eight pixels, which the light path shades together with
+// the SIMD kernels in SoftwareShaderClass.  Text is drawn from the same
+// glyph records the GPU gets, each expanded to its quad the way the font
+// vertex shader does it.
+//
+// Each tile keeps the minimum and maximum depth of its 8x8 pixel blocks.
+// A triangle whose nearest depth is behind every block it overlaps is dropped
+// before any edge is evaluated, and blocks it cannot win are skipped one by
+// one.  The bounds are refreshed lazily after a block is written, and the
+// tests keep a small margin over the interpolation error so rejection never
+// changes the image.
+//
+// Edges are evaluated in 28.4 fixed point.  Triangles are clipped to the view
+// frustum first, which keeps every edge function inside 32 bits for targets up
+// to 2048x2048.
+////////////////////////////////////////////////////////////////////////////////
+class SoftwareRendererClass
+{
+private:
+	enum ShaderType
+	{
+		SHADER_LIGHT,
+		SHADER_TEXTURE,
+		SHADER_FONT,
+		SHADER_FONT_DISTANCE
+	};
+
+	struct DrawType
+	{
+		ShaderType shader;
+		SoftwareTextureClass* texture;
+		bool depthEnable;
+		SoftwareShaderClass::LightConstantsType lightConstants;
+	};
+
+	// Output of the vertex stage.  The attributes are the texture coordinate,
+	// then the normal and view direction, or the color of a glyph, laid out
+	// flat so clipping can lerp them.
+	struct ClipVertexType
+	{
+		D3DXVECTOR4 position;
+		float attributes[SOFTWARE_ATTRIBUTE_COUNT];
+	};
+
+	// Pixel counts of one tile, summed over the tiles at the end of the frame.
+	struct StatisticsType
+	{
+		unsigned int testedPixels;
+		unsigned int rejectedPixels;
+	};
+
+	struct TriangleType
+	{
+		int draw;
+		int x[3], y[3];
+		int minX, minY, maxX, maxY;
+		float z[3];
+		float minZ, maxZ;
+		float invW[3];
+		float attributes[3][SOFTWARE_ATTRIBUTE_COUNT];
+		float invArea;
+		float gradientX[3], gradientY[3];
+	};
+
+	// A run of triangles from an indexed draw.  The cache maps a vertex index to
+	// its slot in the transformed vertices, so shared vertices are only run
+	// through the vertex shader once per batch.
+	struct BatchType
+	{
+		int indexStart, indexCount;
+		vector<int> cacheKeys;
+		vector<int> cacheSlots;
+		vector<int> slots;
+		vector<unsigned int> sources;
+		vector<ClipVertexType> vertices;
+		vector<TriangleType> triangles;
+	};
+
+	// Vertex shader state of the indexed draw being transformed.
+	struct VertexStageType
+	{
+		int draw;
+		D3DXMATRIX worldMatrix;
+		D3DXMATRIX worldViewProjection;
+		D3DXVECTOR3 cameraPosition;
+	};
+
+public:
+	SoftwareRendererClass();
+	SoftwareRendererClass(const SoftwareRendererClass&);
+	~SoftwareRendererClass();
+
+	bool Initialize(int, int, float, float, ThreadPoolClass*);
+	void Shutdown();
+
+	void BeginScene(float, float, float, float);
+	void EndScene();
+
+	bool AddModel(VertexType::Default*, int);
+	int GetIndexCount();
+
+	bool RenderLight(int, int, D3DXMATRIX, D3DXMATRIX, D3DXMATRIX, SoftwareTextureClass*, D3DXVECTOR3, D3DXVECTOR4, D3DXVECTOR4,
+		D3DXVECTOR3, D3DXVECTOR4, float);
+	bool RenderTexture(VertexType::Textured*, int, D3DXMATRIX, D3DXMATRIX, D3DXMATRIX, SoftwareTextureClass*);
+	bool RenderFont(VertexType::Glyph*, int, D3DXVECTOR4*, D3DXMATRIX, D3DXMATRIX, D3DXMATRIX, SoftwareTextureClass*, bool);
+
+	void GetProjectionMatrix(D3DXMATRIX&);
+	void GetWorldMatrix(D3DXMATRIX&);
+	void GetOrthoMatrix(D3DXMATRIX&);
+	void GetUIWorldMatrix(D3DXMATRIX&);
+
+	void TurnZBufferOn();
+	void TurnZBufferOff();
+
+	int GetWidth();
+	int GetHeight();
+	unsigned int* GetColorBuffer();
+	SoftwareShaderClass* GetShader();
+	void SetHierarchicalZ(bool);
+	bool GetHierarchicalZ();
+	float GetRejectedPixelRatio();
+	float GetVerticesPerTriangle();
+	bool SaveFrame(char*);
+
+private:
+	bool RenderTextured(VertexType::Textured*, int, D3DXMATRIX, D3DXMATRIX, D3DXMATRIX, SoftwareTextureClass*, ShaderType);
+	static void TransformBatchTask(void*, int);
+	void TransformBatch(int);
+	void TransformVertices(BatchType&);
+	void SubmitTriangle(int, ClipVertexType*, vector<TriangleType>&);
+	int ClipPolygon(ClipVertexType*, int, ClipVertexType*);
+	void SetupTriangle(int, ClipVertexType*, ClipVertexType*, ClipVertexType*, vector<TriangleType>&);
+	void BinTriangle(int);
+
+	static void RasterizeTileTask(void*, int);
+	void RasterizeTile(int);
+	void RefreshBlock(int, int, float*, float*);
+	void ShadeSpan(DrawType&, TriangleType&, int, unsigned int, float[3][SOFTWARE_SIMD_WIDTH], float*);
+	unsigned int ShadePixel(DrawType&, D3DXVECTOR4, D3DXVECTOR4);
+
+private:
+	int m_screenWidth, m_screenHeight;
+	int m_tilesX, m_tilesY;
+	unsigned int* m_colorBuffer;
+	float* m_depthBuffer;
+	unsigned int m_clearColor;
+	bool m_depthEnable;
+	bool m_hierarchicalZ;
+	float m_rejectedPixelRatio;
+
+	ThreadPoolClass* m_ThreadPool;
+	SoftwareShaderClass* m_Shader;
+
+	vector<VertexType::Default>* m_vertices;
+	vector<unsigned int>* m_indices;
+	vector<BatchType>* m_batches;
+	VertexStageType m_vertexStage;
+	unsigned int m_transformedVertices, m_indexedTriangles;
+	vector<DrawType>* m_draws;
+	vector<TriangleType>* m_triangles;
+	vector<int>* m_bins;
+	StatisticsType* m_statistics;
+
+	D3DXMATRIX m_projectionMatrix;
+	D3DXMATRIX m_worldMatrix;
+	D3DXMATRIX m_orthoMatrix;
+	D3DXMATRIX m_UIWorldMatrix;
+};
+
+#endif
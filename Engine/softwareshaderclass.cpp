@@ -0,0 +1,517 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: softwareshaderclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "softwareshaderclass.h"
+#include <string.h>
+
+
+/////////////
+// GLOBALS //
+/////////////
+// Coefficients of log2(m) = 2/ln(2) * atanh((m - 1) / (m + 1)) for the mantissa range [sqrt(0.5), sqrt(2)).
+static const float LOG2_C1 = 2.88539008f;
+static const float LOG2_C3 = 0.96179669f;
+static const float LOG2_C5 = 0.57707802f;
+static const float LOG2_C7 = 0.41219858f;
+
+// Taylor series of 2^f = e^(f ln(2)) for the fraction range [0, 1).
+static const float EXP2_C1 = 0.69314718f;
+static const float EXP2_C2 = 0.24022651f;
+static const float EXP2_C3 = 0.05550411f;
+static const float EXP2_C4 = 0.00961813f;
+static const float EXP2_C5 = 0.00133336f;
+static const float EXP2_C6 = 0.00015404f;
+
+static const float SQRT2 = 1.41421356f;
+static const float SMALLEST_NORMAL = 1.17549435e-38f;
+static const float SMALLEST_LENGTH = 1.0e-30f;
+
+
+SoftwareShaderClass::SoftwareShaderClass()
+{
+	m_instructionSet = INSTRUCTIONS_SCALAR;
+	m_lightKernel = 0;
+}
+
+
+SoftwareShaderClass::SoftwareShaderClass(const SoftwareShaderClass& other)
+{
+}
+
+
+SoftwareShaderClass::~SoftwareShaderClass()
+{
+}
+
+
+bool SoftwareShaderClass::Initialize()
+{
+	// Use the widest kernels this processor can run.
+	if(SetInstructionSet(INSTRUCTIONS_AVX2))
+	{
+		return true;
+	}
+
+	if(SetInstructionSet(INSTRUCTIONS_SSE41))
+	{
+		return true;
+	}
+
+	return SetInstructionSet(INSTRUCTIONS_SCALAR);
+}
+
+
+void SoftwareShaderClass::Shutdown()
+{
+	m_lightKernel = 0;
+
+	return;
+}
+
+
+bool SoftwareShaderClass::SetInstructionSet(InstructionSetType instructionSet)
+{
+	if(!IsSupported(instructionSet))
+	{
+		return false;
+	}
+
+	switch(instructionSet)
+	{
+		case INSTRUCTIONS_AVX2:
+		{
+			m_lightKernel = &SoftwareShaderClass::ShadeLightAVX2;
+			break;
+		}
+
+		case INSTRUCTIONS_SSE41:
+		{
+			m_lightKernel = &SoftwareShaderClass::ShadeLightSSE41;
+			break;
+		}
+
+		default:
+		{
+			m_lightKernel = &SoftwareShaderClass::ShadeLightScalar;
+			break;
+		}
+	}
+
+	m_instructionSet = instructionSet;
+
+	return true;
+}
+
+
+SoftwareShaderClass::InstructionSetType SoftwareShaderClass::GetInstructionSet()
+{
+	return m_instructionSet;
+}
+
+
+const char* SoftwareShaderClass::GetInstructionSetName()
+{
+	switch(m_instructionSet)
+	{
+		case INSTRUCTIONS_AVX2: return "AVX2";
+		case INSTRUCTIONS_SSE41: return "SSE4.1";
+		default: return "Scalar";
+	}
+}
+
+
+bool SoftwareShaderClass::IsSupported(InstructionSetType instructionSet)
+{
+	int info[4], maxLeaf;
+
+
+	if(instructionSet == INSTRUCTIONS_SCALAR)
+	{
+		return true;
+	}
+
+	// Read the highest supported CPUID leaf and the feature flags.
+	__cpuid(info, 0);
+	maxLeaf = info[0];
+
+	__cpuid(info, 1);
+
+	// SSE4.1 is bit 19 of ECX.
+	if(instructionSet == INSTRUCTIONS_SSE41)
+	{
+		return (info[2] & (1 << 19)) != 0;
+	}
+
+	// AVX needs both the CPU flag and the OS saving the YMM registers on a context switch.
+	if(!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)))
+	{
+		return false;
+	}
+
+	if((_xgetbv(0) & 0x6) != 0x6)
+	{
+		return false;
+	}
+
+	// AVX2 is bit 5 of EBX in leaf 7.
+	if(maxLeaf < 7)
+	{
+		return false;
+	}
+
+	__cpuidex(info, 7, 0);
+
+	return (info[1] & (1 << 5)) != 0;
+}
+
+
+void SoftwareShaderClass::ShadeLight(LightInputType* input, LightConstantsType* constants, unsigned int* output)
+{
+	m_lightKernel(input, constants, output);
+	return;
+}
+
+
+static float Saturate(float value)
+{
+	return (value < 0.0f) ? 0.0f : ((value > 1.0f) ? 1.0f : value);
+}
+
+
+// Scalar forms of the vector pow approximation below, kept step for step identical so every kernel agrees.
+static float Log2Scalar(float x)
+{
+	int bits;
+	float exponent, mantissa, t, t2;
+
+
+	memcpy(&bits, &x, sizeof(bits));
+
+	exponent = (float)((int)((unsigned int)bits >> 23) - 127);
+	bits = (bits & 0x007fffff) | 0x3f800000;
+	memcpy(&mantissa, &bits, sizeof(mantissa));
+
+	if(mantissa > SQRT2)
+	{
+		mantissa = mantissa * 0.5f;
+		exponent = exponent + 1.0f;
+	}
+
+	t = (mantissa - 1.0f) / (mantissa + 1.0f);
+	t2 = t * t;
+
+	return exponent + t * (LOG2_C1 + t2 * (LOG2_C3 + t2 * (LOG2_C5 + t2 * LOG2_C7)));
+}
+
+
+static float Exp2Scalar(float y)
+{
+	float whole, fraction, scale, result;
+	int bits;
+
+
+	y = (y < -126.0f) ? -126.0f : y;
+	whole = floorf(y);
+	fraction = y - whole;
+
+	result = 1.0f + fraction * (EXP2_C1 + fraction * (EXP2_C2 + fraction * (EXP2_C3 + fraction * (EXP2_C4 + fraction *
+		(EXP2_C5 + fraction * EXP2_C6)))));
+
+	bits = ((int)whole + 127) << 23;
+	memcpy(&scale, &bits, sizeof(scale));
+
+	return result * scale;
+}
+
+
+static float PowScalar(float x, float power)
+{
+	if(!(x > SMALLEST_NORMAL))
+	{
+		return 0.0f;
+	}
+
+	return Exp2Scalar(power * Log2Scalar(x));
+}
+
+
+void SoftwareShaderClass::ShadeLightScalar(LightInputType* input, LightConstantsType* constants, unsigned int* output)
+{
+	float lightDir[3], normal[3], reflection[3], lightIntensity, scale, length, specular, color;
+	unsigned int pixel;
+	int i, c;
+
+
+	// Invert the light direction for calculations.
+	lightDir[0] = -constants->lightDirection[0];
+	lightDir[1] = -constants->lightDirection[1];
+	lightDir[2] = -constants->lightDirection[2];
+
+	for(i=0; i<SOFTWARE_SIMD_WIDTH; i++)
+	{
+		normal[0] = input->normal[0][i];
+		normal[1] = input->normal[1][i];
+		normal[2] = input->normal[2][i];
+
+		// Calculate the amount of light on this pixel.
+		lightIntensity = Saturate(normal[0] * lightDir[0] + normal[1] * lightDir[1] + normal[2] * lightDir[2]);
+
+		// Calculate the reflection vector based on the light intensity, normal vector, and light direction.
+		scale = 2.0f * lightIntensity;
+		reflection[0] = scale * normal[0] - lightDir[0];
+		reflection[1] = scale * normal[1] - lightDir[1];
+		reflection[2] = scale * normal[2] - lightDir[2];
+
+		length = sqrtf(reflection[0] * reflection[0] + reflection[1] * reflection[1] + reflection[2] * reflection[2]);
+		length = (length > SMALLEST_LENGTH) ? length : SMALLEST_LENGTH;
+		reflection[0] = reflection[0] / length;
+		reflection[1] = reflection[1] / length;
+		reflection[2] = reflection[2] / length;
+
+		// Determine the amount of specular light, which only unlit pixels go without.
+		specular = 0.0f;
+		if(lightIntensity > 0.0f)
+		{
+			specular = PowScalar(Saturate(reflection[0] * input->viewDirection[0][i] + reflection[1] * input->viewDirection[1][i] +
+				reflection[2] * input->viewDirection[2][i]), constants->specularPower);
+		}
+
+		// Light, modulate by the texture and add the specular component for each channel, then pack to R8G8B8A8.
+		pixel = 0;
+		for(c=0; c<4; c++)
+		{
+			color = (constants->ambientColor[c] + constants->diffuseColor[c] * lightIntensity) * input->texture[c][i] +
+				constants->specularColor[c] * specular;
+			pixel |= (unsigned int)(Saturate(color) * 255.0f + 0.5f) << (c * 8);
+		}
+
+		output[i] = pixel;
+	}
+
+	return;
+}
+
+
+static __m128 SaturateSSE(__m128 value)
+{
+	return _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+
+static __m128 PowSSE(__m128 x, __m128 power)
+{
+	__m128i bits, wholeBits;
+	__m128 exponent, mantissa, large, t, t2, y, whole, fraction, result;
+
+
+	// Split x into its exponent and a mantissa in [sqrt(0.5), sqrt(2)) and evaluate log2.
+	bits = _mm_castps_si128(x);
+	exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+	mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+
+	large = _mm_cmpgt_ps(mantissa, _mm_set1_ps(SQRT2));
+	mantissa = _mm_blendv_ps(mantissa, _mm_mul_ps(mantissa, _mm_set1_ps(0.5f)), large);
+	exponent = _mm_add_ps(exponent, _mm_and_ps(large, _mm_set1_ps(1.0f)));
+
+	t = _mm_div_ps(_mm_sub_ps(mantissa, _mm_set1_ps(1.0f)), _mm_add_ps(mantissa, _mm_set1_ps(1.0f)));
+	t2 = _mm_mul_ps(t, t);
+	y = _mm_add_ps(_mm_set1_ps(LOG2_C5), _mm_mul_ps(t2, _mm_set1_ps(LOG2_C7)));
+	y = _mm_add_ps(_mm_set1_ps(LOG2_C3), _mm_mul_ps(t2, y));
+	y = _mm_add_ps(_mm_set1_ps(LOG2_C1), _mm_mul_ps(t2, y));
+	y = _mm_add_ps(exponent, _mm_mul_ps(t, y));
+
+	// Scale by the power and raise two to the result, building the whole part straight into the exponent bits.
+	y = _mm_max_ps(_mm_mul_ps(power, y), _mm_set1_ps(-126.0f));
+	whole = _mm_floor_ps(y);
+	fraction = _mm_sub_ps(y, whole);
+
+	result = _mm_add_ps(_mm_set1_ps(EXP2_C5), _mm_mul_ps(fraction, _mm_set1_ps(EXP2_C6)));
+	result = _mm_add_ps(_mm_set1_ps(EXP2_C4), _mm_mul_ps(fraction, result));
+	result = _mm_add_ps(_mm_set1_ps(EXP2_C3), _mm_mul_ps(fraction, result));
+	result = _mm_add_ps(_mm_set1_ps(EXP2_C2), _mm_mul_ps(fraction, result));
+	result = _mm_add_ps(_mm_set1_ps(EXP2_C1), _mm_mul_ps(fraction, result));
+	result = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(fraction, result));
+
+	wholeBits = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(whole), _mm_set1_epi32(127)), 23);
+	result = _mm_mul_ps(result, _mm_castsi128_ps(wholeBits));
+
+	// pow(0, p) is zero.
+	return _mm_and_ps(result, _mm_cmpgt_ps(x, _mm_set1_ps(SMALLEST_NORMAL)));
+}
+
+
+void SoftwareShaderClass::ShadeLightSSE41(LightInputType* input, LightConstantsType* constants, unsigned int* output)
+{
+	__m128 lightDirX, lightDirY, lightDirZ, normalX, normalY, normalZ, lightIntensity, lit, scale, reflectionX, reflectionY,
+		reflectionZ, length, specular, color;
+	__m128i pixel;
+	int i, c;
+
+
+	// Invert the light direction for calculations.
+	lightDirX = _mm_set1_ps(-constants->lightDirection[0]);
+	lightDirY = _mm_set1_ps(-constants->lightDirection[1]);
+	lightDirZ = _mm_set1_ps(-constants->lightDirection[2]);
+
+	// Shade the span as two groups of four pixels.
+	for(i=0; i<SOFTWARE_SIMD_WIDTH; i+=4)
+	{
+		normalX = _mm_loadu_ps(&input->normal[0][i]);
+		normalY = _mm_loadu_ps(&input->normal[1][i]);
+		normalZ = _mm_loadu_ps(&input->normal[2][i]);
+
+		// Calculate the amount of light on each pixel.
+		lightIntensity = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, lightDirX), _mm_mul_ps(normalY, lightDirY)),
+			_mm_mul_ps(normalZ, lightDirZ));
+		lightIntensity = SaturateSSE(lightIntensity);
+		lit = _mm_cmpgt_ps(lightIntensity, _mm_setzero_ps());
+
+		// Calculate the reflection vector based on the light intensity, normal vector, and light direction.
+		scale = _mm_mul_ps(_mm_set1_ps(2.0f), lightIntensity);
+		reflectionX = _mm_sub_ps(_mm_mul_ps(scale, normalX), lightDirX);
+		reflectionY = _mm_sub_ps(_mm_mul_ps(scale, normalY), lightDirY);
+		reflectionZ = _mm_sub_ps(_mm_mul_ps(scale, normalZ), lightDirZ);
+
+		length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(reflectionX, reflectionX), _mm_mul_ps(reflectionY, reflectionY)),
+			_mm_mul_ps(reflectionZ, reflectionZ)));
+		length = _mm_max_ps(length, _mm_set1_ps(SMALLEST_LENGTH));
+		reflectionX = _mm_div_ps(reflectionX, length);
+		reflectionY = _mm_div_ps(reflectionY, length);
+		reflectionZ = _mm_div_ps(reflectionZ, length);
+
+		// Determine the amount of specular light, masking off the unlit pixels.
+		specular = _mm_add_ps(_mm_add_ps(_mm_mul_ps(reflectionX, _mm_loadu_ps(&input->viewDirection[0][i])),
+			_mm_mul_ps(reflectionY, _mm_loadu_ps(&input->viewDirection[1][i]))),
+			_mm_mul_ps(reflectionZ, _mm_loadu_ps(&input->viewDirection[2][i])));
+		specular = _mm_and_ps(PowSSE(SaturateSSE(specular), _mm_set1_ps(constants->specularPower)), lit);
+
+		// Light, modulate by the texture and add the specular component for each channel, then pack to R8G8B8A8.
+		pixel = _mm_setzero_si128();
+		for(c=0; c<4; c++)
+		{
+			color = _mm_add_ps(_mm_set1_ps(constants->ambientColor[c]), _mm_mul_ps(_mm_set1_ps(constants->diffuseColor[c]), lightIntensity));
+			color = _mm_add_ps(_mm_mul_ps(color, _mm_loadu_ps(&input->texture[c][i])),
+				_mm_mul_ps(_mm_set1_ps(constants->specularColor[c]), specular));
+			color = _mm_add_ps(_mm_mul_ps(SaturateSSE(color), _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f));
+
+			pixel = _mm_or_si128(pixel, _mm_slli_epi32(_mm_cvttps_epi32(color), c * 8));
+		}
+
+		_mm_storeu_si128((__m128i*)&output[i], pixel);
+	}
+
+	return;
+}
+
+
+static __m256 SaturateAVX2(__m256 value)
+{
+	return _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+}
+
+
+static __m256 PowAVX2(__m256 x, __m256 power)
+{
+	__m256i bits, wholeBits;
+	__m256 exponent, mantissa, large, t, t2, y, whole, fraction, result;
+
+
+	// Split x into its exponent and a mantissa in [sqrt(0.5), sqrt(2)) and evaluate log2.
+	bits = _mm256_castps_si256(x);
+	exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+	mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+		_mm256_set1_epi32(0x3f800000)));
+
+	large = _mm256_cmp_ps(mantissa, _mm256_set1_ps(SQRT2), _CMP_GT_OQ);
+	mantissa = _mm256_blendv_ps(mantissa, _mm256_mul_ps(mantissa, _mm256_set1_ps(0.5f)), large);
+	exponent = _mm256_add_ps(exponent, _mm256_and_ps(large, _mm256_set1_ps(1.0f)));
+
+	t = _mm256_div_ps(_mm256_sub_ps(mantissa, _mm256_set1_ps(1.0f)), _mm256_add_ps(mantissa, _mm256_set1_ps(1.0f)));
+	t2 = _mm256_mul_ps(t, t);
+	y = _mm256_add_ps(_mm256_set1_ps(LOG2_C5), _mm256_mul_ps(t2, _mm256_set1_ps(LOG2_C7)));
+	y = _mm256_add_ps(_mm256_set1_ps(LOG2_C3), _mm256_mul_ps(t2, y));
+	y = _mm256_add_ps(_mm256_set1_ps(LOG2_C1), _mm256_mul_ps(t2, y));
+	y = _mm256_add_ps(exponent, _mm256_mul_ps(t, y));
+
+	// Scale by the power and raise two to the result, building the whole part straight into the exponent bits.
+	y = _mm256_max_ps(_mm256_mul_ps(power, y), _mm256_set1_ps(-126.0f));
+	whole = _mm256_floor_ps(y);
+	fraction = _mm256_sub_ps(y, whole);
+
+	result = _mm256_add_ps(_mm256_set1_ps(EXP2_C5), _mm256_mul_ps(fraction, _mm256_set1_ps(EXP2_C6)));
+	result = _mm256_add_ps(_mm256_set1_ps(EXP2_C4), _mm256_mul_ps(fraction, result));
+	result = _mm256_add_ps(_mm256_set1_ps(EXP2_C3), _mm256_mul_ps(fraction, result));
+	result = _mm256_add_ps(_mm256_set1_ps(EXP2_C2), _mm256_mul_ps(fraction, result));
+	result = _mm256_add_ps(_mm256_set1_ps(EXP2_C1), _mm256_mul_ps(fraction, result));
+	result = _mm256_add_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(fraction, result));
+
+	wholeBits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(whole), _mm256_set1_epi32(127)), 23);
+	result = _mm256_mul_ps(result, _mm256_castsi256_ps(wholeBits));
+
+	// pow(0, p) is zero.
+	return _mm256_and_ps(result, _mm256_cmp_ps(x, _mm256_set1_ps(SMALLEST_NORMAL), _CMP_GT_OQ));
+}
+
+
+void SoftwareShaderClass::ShadeLightAVX2(LightInputType* input, LightConstantsType* constants, unsigned int* output)
+{
+	__m256 lightDirX, lightDirY, lightDirZ, normalX, normalY, normalZ, lightIntensity, lit, scale, reflectionX, reflectionY,
+		reflectionZ, length, specular, color;
+	__m256i pixel;
+	int c;
+
+
+	// Invert the light direction for calculations.
+	lightDirX = _mm256_set1_ps(-constants->lightDirection[0]);
+	lightDirY = _mm256_set1_ps(-constants->lightDirection[1]);
+	lightDirZ = _mm256_set1_ps(-constants->lightDirection[2]);
+
+	normalX = _mm256_loadu_ps(input->normal[0]);
+	normalY = _mm256_loadu_ps(input->normal[1]);
+	normalZ = _mm256_loadu_ps(input->normal[2]);
+
+	// Calculate the amount of light on each pixel.
+	lightIntensity = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normalX, lightDirX), _mm256_mul_ps(normalY, lightDirY)),
+		_mm256_mul_ps(normalZ, lightDirZ));
+	lightIntensity = SaturateAVX2(lightIntensity);
+	lit = _mm256_cmp_ps(lightIntensity, _mm256_setzero_ps(), _CMP_GT_OQ);
+
+	// Calculate the reflection vector based on the light intensity, normal vector, and light direction.
+	scale = _mm256_mul_ps(_mm256_set1_ps(2.0f), lightIntensity);
+	reflectionX = _mm256_sub_ps(_mm256_mul_ps(scale, normalX), lightDirX);
+	reflectionY = _mm256_sub_ps(_mm256_mul_ps(scale, normalY), lightDirY);
+	reflectionZ = _mm256_sub_ps(_mm256_mul_ps(scale, normalZ), lightDirZ);
+
+	length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(reflectionX, reflectionX),
+		_mm256_mul_ps(reflectionY, reflectionY)), _mm256_mul_ps(reflectionZ, reflectionZ)));
+	length = _mm256_max_ps(length, _mm256_set1_ps(SMALLEST_LENGTH));
+	reflectionX = _mm256_div_ps(reflectionX, length);
+	reflectionY = _mm256_div_ps(reflectionY, length);
+	reflectionZ = _mm256_div_ps(reflectionZ, length);
+
+	// Determine the amount of specular light, masking off the unlit pixels.
+	specular = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(reflectionX, _mm256_loadu_ps(input->viewDirection[0])),
+		_mm256_mul_ps(reflectionY, _mm256_loadu_ps(input->viewDirection[1]))),
+		_mm256_mul_ps(reflectionZ, _mm256_loadu_ps(input->viewDirection[2])));
+	specular = _mm256_and_ps(PowAVX2(SaturateAVX2(specular), _mm256_set1_ps(constants->specularPower)), lit);
+
+	// Light, modulate by the texture and add the specular component for each channel, then pack to R8G8B8A8.
+	pixel = _mm256_setzero_si256();
+	for(c=0; c<4; c++)
+	{
+		color = _mm256_add_ps(_mm256_set1_ps(constants->ambientColor[c]),
+			_mm256_mul_ps(_mm256_set1_ps(constants->diffuseColor[c]), lightIntensity));
+		color = _mm256_add_ps(_mm256_mul_ps(color, _mm256_loadu_ps(input->texture[c])),
+			_mm256_mul_ps(_mm256_set1_ps(constants->specularColor[c]), specular));
+		color = _mm256_add_ps(_mm256_mul_ps(SaturateAVX2(color), _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f));
+
+		pixel = _mm256_or_si256(pixel, _mm256_slli_epi32(_mm256_cvttps_epi32(color), c * 8));
+	}
+
+	_mm256_storeu_si256((__m256i*)output, pixel);
+
+	// Clear the upper halves of the YMM registers so the SSE code that follows does not pay a transition penalty.
+	_mm256_zeroupper();
+
+	return;
+}
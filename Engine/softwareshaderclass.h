@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: softwareshaderclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _SOFTWARESHADERCLASS_H_
+#define _SOFTWARESHADERCLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <intrin.h>
+#include <math.h>
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int SOFTWARE_SIMD_WIDTH = 8;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: SoftwareShaderClass
+// Pixel shading kernels for the software renderer.  Each call shades a span of
+// eight pixels held in structure-of-arrays form, so every input channel loads
+// straight into one SIMD register.
+//
+// Initialize picks the widest kernel the processor supports: AVX2 shades all
+// eight pixels at once, SSE4.1 shades them as two groups of four, and the
+// scalar kernel is the fallback.  The kernels perform the same operations in
+// the same order, including the pow approximation, so the choice does not
+// change the rendered image.
+////////////////////////////////////////////////////////////////////////////////
+class SoftwareShaderClass
+{
+public:
+	enum InstructionSetType
+	{
+		INSTRUCTIONS_SCALAR,
+		INSTRUCTIONS_SSE41,
+		INSTRUCTIONS_AVX2
+	};
+
+	// Interpolated inputs of the light pixel shader and the sampled texture color, one row per channel.
+	struct LightInputType
+	{
+		float normal[3][SOFTWARE_SIMD_WIDTH];
+		float viewDirection[3][SOFTWARE_SIMD_WIDTH];
+		float texture[4][SOFTWARE_SIMD_WIDTH];
+	};
+
+	// The LightBuffer constant buffer of light.ps.
+	struct LightConstantsType
+	{
+		float ambientColor[4];
+		float diffuseColor[4];
+		float lightDirection[3];
+		float specularPower;
+		float specularColor[4];
+	};
+
+	typedef void (*LightKernelType)(LightInputType*, LightConstantsType*, unsigned int*);
+
+public:
+	SoftwareShaderClass();
+	SoftwareShaderClass(const SoftwareShaderClass&);
+	~SoftwareShaderClass();
+
+	bool Initialize();
+	void Shutdown();
+
+	bool SetInstructionSet(InstructionSetType);
+	InstructionSetType GetInstructionSet();
+	const char* GetInstructionSetName();
+
+	static bool IsSupported(InstructionSetType);
+
+	void ShadeLight(LightInputType*, LightConstantsType*, unsigned int*);
+
+private:
+	static void ShadeLightScalar(LightInputType*, LightConstantsType*, unsigned int*);
+	static void ShadeLightSSE41(LightInputType*, LightConstantsType*, unsigned int*);
+	static void ShadeLightAVX2(LightInputType*, LightConstantsType*, unsigned int*);
+
+private:
+	InstructionSetType m_instructionSet;
+	LightKernelType m_lightKernel;
+};
+
+#endif
@@ -0,0 +1,820 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: softwaretextureclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "softwaretextureclass.h"
+#include <wincodec.h>
+#include <malloc.h>
+#include <math.h>
+
+
+/////////////
+// GLOBALS //
+/////////////
+// Coefficients of a quadratic fit of log2 over the mantissa range [1, 2), plenty for a level of detail.
+static const float LOD_LOG2_C1 = 1.33333333f;
+static const float LOD_LOG2_C2 = 0.33333333f;
+
+
+SoftwareTextureClass::SoftwareTextureClass()
+{
+	m_texels = 0;
+	m_width = 0;
+	m_height = 0;
+	m_levelCount = 0;
+	m_layout = LAYOUT_SWIZZLED;
+	m_useAVX2 = false;
+}
+
+
+SoftwareTextureClass::SoftwareTextureClass(const SoftwareTextureClass& other)
+{
+}
+
+
+SoftwareTextureClass::~SoftwareTextureClass()
+{
+}
+
+
+bool SoftwareTextureClass::Initialize(WCHAR* filename)
+{
+	MEMORY_TAG(MemoryTrackerClass::TAG_TEXTURES);
+	WCHAR* extension;
+	unsigned int* pixels;
+	bool result;
+
+
+	pixels = 0;
+
+	// DDS files are read directly, everything else goes through the Windows Imaging Component.
+	extension = wcsrchr(filename, L'.');
+	if(extension && (_wcsicmp(extension, L".dds") == 0))
+	{
+		result = LoadDDS(filename, pixels);
+	}
+	else
+	{
+		result = LoadImageFile(filename, pixels);
+	}
+
+	// Build the mip chain from the top level, then release the loaded pixels.
+	if(result)
+	{
+		result = BuildLevels(pixels);
+	}
+
+	if(pixels)
+	{
+		delete [] pixels;
+		pixels = 0;
+	}
+
+	return result;
+}
+
+
+bool SoftwareTextureClass::Initialize(int width, int height, unsigned int* pixels)
+{
+	MEMORY_TAG(MemoryTrackerClass::TAG_TEXTURES);
+
+
+	// Build the texture from pixel data that was generated in memory.
+	m_width = width;
+	m_height = height;
+
+	return BuildLevels(pixels);
+}
+
+
+void SoftwareTextureClass::Shutdown()
+{
+	// Release the texel data.
+	if(m_texels)
+	{
+		MemoryTrackerClass::FreeAligned(m_texels);
+		m_texels = 0;
+	}
+
+	m_levelCount = 0;
+
+	return;
+}
+
+
+bool SoftwareTextureClass::SetLayout(LayoutType layout)
+{
+	MEMORY_TAG(MemoryTrackerClass::TAG_TEXTURES);
+	unsigned int* levels[SOFTWARE_TEXTURE_MAX_LEVELS];
+	int level, x, y;
+	bool result;
+
+
+	if(layout == m_layout)
+	{
+		return true;
+	}
+
+	// Read every level back out to a linear copy.
+	for(level=0; level<m_levelCount; level++)
+	{
+		levels[level] = new unsigned int[m_levelWidth[level] * m_levelHeight[level]];
+		if(!levels[level])
+		{
+			return false;
+		}
+
+		for(y=0; y<m_levelHeight[level]; y++)
+		{
+			for(x=0; x<m_levelWidth[level]; x++)
+			{
+				levels[level][(y * m_levelWidth[level]) + x] = m_texels[GetTexelIndex(level, x, y)];
+			}
+		}
+	}
+
+	// Store the levels again in the new layout.
+	MemoryTrackerClass::FreeAligned(m_texels);
+	m_texels = 0;
+
+	m_layout = layout;
+	result = StoreLevels(levels);
+
+	for(level=0; level<m_levelCount; level++)
+	{
+		delete [] levels[level];
+		levels[level] = 0;
+	}
+
+	return result;
+}
+
+
+SoftwareTextureClass::LayoutType SoftwareTextureClass::GetLayout()
+{
+	return m_layout;
+}
+
+
+int SoftwareTextureClass::GetWidth()
+{
+	return m_width;
+}
+
+
+int SoftwareTextureClass::GetHeight()
+{
+	return m_height;
+}
+
+
+int SoftwareTextureClass::GetLevelCount()
+{
+	return m_levelCount;
+}
+
+
+int SoftwareTextureClass::GetTexelIndex(int level, int x, int y)
+{
+	int morton;
+
+
+	if(m_layout == LAYOUT_LINEAR)
+	{
+		return m_levelOffset[level] + (y * m_levelPitch[level]) + x;
+	}
+
+	// Find the 8x8 tile, then interleave the low three bits of x and y to find the texel inside it.
+	morton = (x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2) | ((x & 4) << 2) | ((y & 4) << 3);
+
+	return m_levelOffset[level] + ((((y >> 3) * m_levelPitch[level]) + (x >> 3)) << 6) + morton;
+}
+
+
+unsigned int* SoftwareTextureClass::GetTexels()
+{
+	return m_texels;
+}
+
+
+D3DXVECTOR4 SoftwareTextureClass::Sample(float u, float v, float lod)
+{
+	float levelFloor, fraction, color[4], next[4];
+	int level, nextLevel, c;
+
+
+	// Clamp the level of detail to the mip chain.  Anything below zero is magnified from the top level.
+	lod = (lod > 0.0f) ? lod : 0.0f;
+	lod = (lod < (float)(m_levelCount - 1)) ? lod : (float)(m_levelCount - 1);
+
+	levelFloor = floorf(lod);
+	fraction = lod - levelFloor;
+	level = (int)levelFloor;
+	nextLevel = min(level + 1, m_levelCount - 1);
+
+	// Filter the two nearest levels and blend between them.
+	SampleBilinear(level, u, v, color);
+	if(fraction > 0.0f)
+	{
+		SampleBilinear(nextLevel, u, v, next);
+		for(c=0; c<4; c++)
+		{
+			color[c] = color[c] + (next[c] - color[c]) * fraction;
+		}
+	}
+
+	return D3DXVECTOR4(color[0], color[1], color[2], color[3]);
+}
+
+
+void SoftwareTextureClass::SampleSpan(SampleInputType* input, float output[4][SOFTWARE_SIMD_WIDTH])
+{
+	D3DXVECTOR4 color;
+	int i;
+
+
+	if(m_useAVX2)
+	{
+		SampleSpanAVX2(input, output);
+		return;
+	}
+
+	for(i=0; i<SOFTWARE_SIMD_WIDTH; i++)
+	{
+		color = Sample(input->u[i], input->v[i], GetLevelOfDetail(input->dudx[i], input->dvdx[i], input->dudy[i], input->dvdy[i]));
+
+		output[0][i] = color.x;
+		output[1][i] = color.y;
+		output[2][i] = color.z;
+		output[3][i] = color.w;
+	}
+
+	return;
+}
+
+
+bool SoftwareTextureClass::LoadDDS(WCHAR* filename, unsigned int*& pixels)
+{
+	ifstream fin;
+	unsigned int magic, header[31], bitCount, masks[4], shifts[4], pixel, value;
+	unsigned char* row;
+	int i, x, y, bytesPerPixel, channel;
+
+
+	fin.open(filename, ios_base::in | ios_base::binary);
+	if(fin.fail())
+	{
+		return false;
+	}
+
+	// Read the magic number and the 124 byte DDS_HEADER.
+	fin.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+	fin.read(reinterpret_cast<char*>(header), sizeof(header));
+	if(fin.fail() || (magic != 0x20534444))
+	{
+		return false;
+	}
+
+	m_height = (int)header[2];
+	m_width = (int)header[3];
+
+	// Only uncompressed RGB formats are supported; the pixel format flags live at dword 19 of the header.  The
+	// file's own mip levels are skipped since BuildLevels generates the chain.
+	bitCount = header[21];
+	if(!(header[19] & 0x40) || ((bitCount != 24) && (bitCount != 32)))
+	{
+		return false;
+	}
+
+	masks[0] = header[22];
+	masks[1] = header[23];
+	masks[2] = header[24];
+	masks[3] = (header[19] & 0x1) ? header[25] : 0;
+
+	// Work out how far each channel mask is shifted from the bottom byte.
+	for(i=0; i<4; i++)
+	{
+		shifts[i] = 0;
+		while(masks[i] && !((masks[i] >> shifts[i]) & 0x1))
+		{
+			shifts[i]++;
+		}
+	}
+
+	pixels = new unsigned int[m_width * m_height];
+	if(!pixels)
+	{
+		return false;
+	}
+
+	bytesPerPixel = bitCount / 8;
+	row = new unsigned char[m_width * bytesPerPixel];
+	if(!row)
+	{
+		return false;
+	}
+
+	// Convert each row of the top mip level to RGBA.
+	for(y=0; y<m_height; y++)
+	{
+		fin.read(reinterpret_cast<char*>(row), m_width * bytesPerPixel);
+
+		for(x=0; x<m_width; x++)
+		{
+			value = 0;
+			memcpy(&value, &row[x * bytesPerPixel], bytesPerPixel);
+
+			pixel = 0;
+			for(channel=0; channel<4; channel++)
+			{
+				if(masks[channel])
+				{
+					pixel |= (((value & masks[channel]) >> shifts[channel]) & 0xff) << (channel * 8);
+				}
+				else if(channel == 3)
+				{
+					pixel |= 0xff000000;
+				}
+			}
+
+			pixels[(y * m_width) + x] = pixel;
+		}
+	}
+
+	delete [] row;
+	row = 0;
+
+	fin.close();
+
+	return true;
+}
+
+
+bool SoftwareTextureClass::LoadImageFile(WCHAR* filename, unsigned int*& pixels)
+{
+	HRESULT result;
+	IWICImagingFactory* factory;
+	IWICBitmapDecoder* decoder;
+	IWICBitmapFrameDecode* frame;
+	IWICFormatConverter* converter;
+	UINT width, height;
+
+
+	factory = 0;
+	decoder = 0;
+	frame = 0;
+	converter = 0;
+
+	// WIC is a COM library; this is a no-op if COM is already initialized on this thread.
+	CoInitializeEx(NULL, COINIT_MULTITHREADED);
+
+	// Decode the first frame of the image and convert it to 32-bit RGBA.
+	result = CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_IWICImagingFactory, (LPVOID*)&factory);
+	if(SUCCEEDED(result))
+	{
+		result = factory->CreateDecoderFromFilename(filename, NULL, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder);
+	}
+	if(SUCCEEDED(result))
+	{
+		result = decoder->GetFrame(0, &frame);
+	}
+	if(SUCCEEDED(result))
+	{
+		result = factory->CreateFormatConverter(&converter);
+	}
+	if(SUCCEEDED(result))
+	{
+		result = converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, NULL, 0.0,
+			WICBitmapPaletteTypeCustom);
+	}
+	if(SUCCEEDED(result))
+	{
+		result = converter->GetSize(&width, &height);
+	}
+	if(SUCCEEDED(result))
+	{
+		m_width = (int)width;
+		m_height = (int)height;
+		pixels = new unsigned int[m_width * m_height];
+
+		result = converter->CopyPixels(NULL, width * 4, width * height * 4, (BYTE*)pixels);
+	}
+
+	// Release the WIC objects.
+	if(converter)
+	{
+		converter->Release();
+		converter = 0;
+	}
+
+	if(frame)
+	{
+		frame->Release();
+		frame = 0;
+	}
+
+	if(decoder)
+	{
+		decoder->Release();
+		decoder = 0;
+	}
+
+	if(factory)
+	{
+		factory->Release();
+		factory = 0;
+	}
+
+	return SUCCEEDED(result);
+}
+
+
+bool SoftwareTextureClass::BuildLevels(unsigned int* pixels)
+{
+	unsigned int* levels[SOFTWARE_TEXTURE_MAX_LEVELS];
+	unsigned int* parent;
+	unsigned int sum, texel[4];
+	int level, width, height, parentWidth, parentHeight, x, y, x0, x1, y0, y1, i, channel;
+	bool result;
+
+
+	// Halve the size for each level until it reaches 1x1.
+	width = m_width;
+	height = m_height;
+	m_levelCount = 0;
+	while(m_levelCount < SOFTWARE_TEXTURE_MAX_LEVELS)
+	{
+		m_levelWidth[m_levelCount] = width;
+		m_levelHeight[m_levelCount] = height;
+		m_levelCount++;
+
+		if((width == 1) && (height == 1))
+		{
+			break;
+		}
+
+		width = max(width / 2, 1);
+		height = max(height / 2, 1);
+	}
+
+	// The top level is the loaded image.  Each smaller level box filters 2x2 texels of the one above it.
+	levels[0] = pixels;
+	for(level=1; level<m_levelCount; level++)
+	{
+		levels[level] = new unsigned int[m_levelWidth[level] * m_levelHeight[level]];
+		if(!levels[level])
+		{
+			return false;
+		}
+
+		parent = levels[level - 1];
+		parentWidth = m_levelWidth[level - 1];
+		parentHeight = m_levelHeight[level - 1];
+
+		for(y=0; y<m_levelHeight[level]; y++)
+		{
+			for(x=0; x<m_levelWidth[level]; x++)
+			{
+				x0 = min(x * 2, parentWidth - 1);
+				x1 = min((x * 2) + 1, parentWidth - 1);
+				y0 = min(y * 2, parentHeight - 1);
+				y1 = min((y * 2) + 1, parentHeight - 1);
+
+				texel[0] = parent[(y0 * parentWidth) + x0];
+				texel[1] = parent[(y0 * parentWidth) + x1];
+				texel[2] = parent[(y1 * parentWidth) + x0];
+				texel[3] = parent[(y1 * parentWidth) + x1];
+
+				levels[level][(y * m_levelWidth[level]) + x] = 0;
+				for(channel=0; channel<4; channel++)
+				{
+					sum = 2;
+					for(i=0; i<4; i++)
+					{
+						sum += (texel[i] >> (channel * 8)) & 0xff;
+					}
+
+					levels[level][(y * m_levelWidth[level]) + x] |= (sum / 4) << (channel * 8);
+				}
+			}
+		}
+	}
+
+	result = StoreLevels(levels);
+
+	// Release the generated levels.
+	for(level=1; level<m_levelCount; level++)
+	{
+		delete [] levels[level];
+		levels[level] = 0;
+	}
+
+	// Use the gather based sampler when the processor has it.
+	m_useAVX2 = SoftwareShaderClass::IsSupported(SoftwareShaderClass::INSTRUCTIONS_AVX2);
+
+	return result;
+}
+
+
+bool SoftwareTextureClass::StoreLevels(unsigned int** levels)
+{
+	int size, level, x, y;
+
+
+	// Allocate the texels on a cache line boundary so every 4x4 block of a tile is exactly one line.
+	size = LayoutLevels();
+	m_texels = (unsigned int*)MemoryTrackerClass::AllocateAligned(sizeof(unsigned int) * size, 64);
+	if(!m_texels)
+	{
+		return false;
+	}
+
+	// Clear the padding of partial tiles, then copy each level into place.
+	memset(m_texels, 0, sizeof(unsigned int) * size);
+
+	for(level=0; level<m_levelCount; level++)
+	{
+		for(y=0; y<m_levelHeight[level]; y++)
+		{
+			for(x=0; x<m_levelWidth[level]; x++)
+			{
+				m_texels[GetTexelIndex(level, x, y)] = levels[level][(y * m_levelWidth[level]) + x];
+			}
+		}
+	}
+
+	return true;
+}
+
+
+int SoftwareTextureClass::LayoutLevels()
+{
+	int level, offset, tilesX, tilesY;
+
+
+	// Place the levels one after another.  The pitch is in texels for the linear layout and in tiles when swizzled.
+	offset = 0;
+	for(level=0; level<m_levelCount; level++)
+	{
+		m_levelOffset[level] = offset;
+
+		if(m_layout == LAYOUT_LINEAR)
+		{
+			m_levelPitch[level] = m_levelWidth[level];
+			offset += m_levelWidth[level] * m_levelHeight[level];
+		}
+		else
+		{
+			tilesX = (m_levelWidth[level] + SOFTWARE_TEXTURE_TILE_SIZE - 1) / SOFTWARE_TEXTURE_TILE_SIZE;
+			tilesY = (m_levelHeight[level] + SOFTWARE_TEXTURE_TILE_SIZE - 1) / SOFTWARE_TEXTURE_TILE_SIZE;
+
+			m_levelPitch[level] = tilesX;
+			offset += tilesX * tilesY * SOFTWARE_TEXTURE_TILE_SIZE * SOFTWARE_TEXTURE_TILE_SIZE;
+		}
+	}
+
+	return offset;
+}
+
+
+float SoftwareTextureClass::GetLevelOfDetail(float dudx, float dvdx, float dudy, float dvdy)
+{
+	float x, y, lengthX, lengthY, rho, exponent, mantissa;
+	int bits;
+
+
+	// Measure how many texels of the top level one pixel step covers along each screen axis and keep the larger.
+	x = dudx * (float)m_width;
+	y = dvdx * (float)m_height;
+	lengthX = x * x + y * y;
+
+	x = dudy * (float)m_width;
+	y = dvdy * (float)m_height;
+	lengthY = x * x + y * y;
+
+	rho = (lengthX > lengthY) ? lengthX : lengthY;
+
+	// The level of detail is log2 of the length, which is half the log2 of the squared length.
+	memcpy(&bits, &rho, sizeof(bits));
+	exponent = (float)((int)((unsigned int)bits >> 23) - 127);
+	bits = (bits & 0x007fffff) | 0x3f800000;
+	memcpy(&mantissa, &bits, sizeof(mantissa));
+	mantissa = mantissa - 1.0f;
+
+	return 0.5f * (exponent + mantissa * (LOD_LOG2_C1 - LOD_LOG2_C2 * mantissa));
+}
+
+
+void SoftwareTextureClass::SampleBilinear(int level, float u, float v, float* color)
+{
+	float width, height, x, y, x0, y0, fx, fy, weight[4];
+	int ix0, iy0, ix1, iy1, i, c;
+	unsigned int texel[4];
+
+
+	width = (float)m_levelWidth[level];
+	height = (float)m_levelHeight[level];
+
+	// Move to texel space with texel centers on the half coordinates, like the hardware sampler.
+	x = u * width - 0.5f;
+	y = v * height - 0.5f;
+
+	x0 = floorf(x);
+	y0 = floorf(y);
+	fx = x - x0;
+	fy = y - y0;
+
+	// Wrap the top left texel into the level.  The clamp only guards against coordinates too large to wrap exactly.
+	x0 = x0 - floorf(x0 / width) * width;
+	y0 = y0 - floorf(y0 / height) * height;
+	x0 = (x0 < 0.0f) ? x0 + width : x0;
+	y0 = (y0 < 0.0f) ? y0 + height : y0;
+	x0 = (x0 >= width) ? x0 - width : x0;
+	y0 = (y0 >= height) ? y0 - height : y0;
+
+	ix0 = min(max((int)x0, 0), m_levelWidth[level] - 1);
+	iy0 = min(max((int)y0, 0), m_levelHeight[level] - 1);
+	ix1 = (ix0 + 1 == m_levelWidth[level]) ? 0 : ix0 + 1;
+	iy1 = (iy0 + 1 == m_levelHeight[level]) ? 0 : iy0 + 1;
+
+	texel[0] = m_texels[GetTexelIndex(level, ix0, iy0)];
+	texel[1] = m_texels[GetTexelIndex(level, ix1, iy0)];
+	texel[2] = m_texels[GetTexelIndex(level, ix0, iy1)];
+	texel[3] = m_texels[GetTexelIndex(level, ix1, iy1)];
+
+	weight[0] = (1.0f - fx) * (1.0f - fy);
+	weight[1] = fx * (1.0f - fy);
+	weight[2] = (1.0f - fx) * fy;
+	weight[3] = fx * fy;
+
+	// Blend the texels and convert from 8-bit to the 0-1 range.
+	for(c=0; c<4; c++)
+	{
+		color[c] = weight[0] * (float)((texel[0] >> (c * 8)) & 0xff);
+		for(i=1; i<4; i++)
+		{
+			color[c] = color[c] + weight[i] * (float)((texel[i] >> (c * 8)) & 0xff);
+		}
+		color[c] = color[c] * (1.0f / 255.0f);
+	}
+
+	return;
+}
+
+
+void SoftwareTextureClass::SampleSpanAVX2(SampleInputType* input, float output[4][SOFTWARE_SIMD_WIDTH])
+{
+	__m256 u, v, x, y, lengthX, lengthY, rho, exponent, mantissa, lod, levelFloor, fraction, color[4], next[4];
+	__m256i bits, level, nextLevel, lastLevel;
+	int c;
+
+
+	u = _mm256_loadu_ps(input->u);
+	v = _mm256_loadu_ps(input->v);
+
+	// Measure how many texels of the top level one pixel step covers along each screen axis and keep the larger.
+	x = _mm256_mul_ps(_mm256_loadu_ps(input->dudx), _mm256_set1_ps((float)m_width));
+	y = _mm256_mul_ps(_mm256_loadu_ps(input->dvdx), _mm256_set1_ps((float)m_height));
+	lengthX = _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y));
+
+	x = _mm256_mul_ps(_mm256_loadu_ps(input->dudy), _mm256_set1_ps((float)m_width));
+	y = _mm256_mul_ps(_mm256_loadu_ps(input->dvdy), _mm256_set1_ps((float)m_height));
+	lengthY = _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y));
+
+	rho = _mm256_max_ps(lengthY, lengthX);
+
+	// The level of detail is log2 of the length, which is half the log2 of the squared length.
+	bits = _mm256_castps_si256(rho);
+	exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+	mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+		_mm256_set1_epi32(0x3f800000)));
+	mantissa = _mm256_sub_ps(mantissa, _mm256_set1_ps(1.0f));
+
+	lod = _mm256_sub_ps(_mm256_set1_ps(LOD_LOG2_C1), _mm256_mul_ps(_mm256_set1_ps(LOD_LOG2_C2), mantissa));
+	lod = _mm256_mul_ps(_mm256_set1_ps(0.5f), _mm256_add_ps(exponent, _mm256_mul_ps(mantissa, lod)));
+
+	// Clamp the level of detail to the mip chain and split it into a level and a blend fraction.
+	lod = _mm256_max_ps(lod, _mm256_setzero_ps());
+	lod = _mm256_min_ps(lod, _mm256_set1_ps((float)(m_levelCount - 1)));
+
+	levelFloor = _mm256_floor_ps(lod);
+	fraction = _mm256_sub_ps(lod, levelFloor);
+	lastLevel = _mm256_set1_epi32(m_levelCount - 1);
+	level = _mm256_cvttps_epi32(levelFloor);
+	nextLevel = _mm256_min_epi32(_mm256_add_epi32(level, _mm256_set1_epi32(1)), lastLevel);
+
+	// Filter the two nearest levels and blend between them.  Magnified spans only need the top level.
+	SampleBilinearAVX2(u, v, level, color);
+	if(_mm256_movemask_ps(_mm256_cmp_ps(fraction, _mm256_setzero_ps(), _CMP_GT_OQ)))
+	{
+		SampleBilinearAVX2(u, v, nextLevel, next);
+		for(c=0; c<4; c++)
+		{
+			color[c] = _mm256_add_ps(color[c], _mm256_mul_ps(_mm256_sub_ps(next[c], color[c]), fraction));
+		}
+	}
+
+	for(c=0; c<4; c++)
+	{
+		_mm256_storeu_ps(output[c], color[c]);
+	}
+
+	// Clear the upper halves of the YMM registers so the SSE code that follows does not pay a transition penalty.
+	_mm256_zeroupper();
+
+	return;
+}
+
+
+void SoftwareTextureClass::SampleBilinearAVX2(__m256 u, __m256 v, __m256i level, __m256* color)
+{
+	__m256i levelWidth, levelHeight, pitch, offset, ix0, iy0, ix1, iy1, tileX, tileY, morton, index[4], texel[4], one, byteMask;
+	__m256 width, height, x, y, x0, y0, fx, fy, weight[4];
+	int i, c;
+
+
+	// Look up the size and position of each lane's level.
+	levelWidth = _mm256_i32gather_epi32(m_levelWidth, level, 4);
+	levelHeight = _mm256_i32gather_epi32(m_levelHeight, level, 4);
+	pitch = _mm256_i32gather_epi32(m_levelPitch, level, 4);
+	offset = _mm256_i32gather_epi32(m_levelOffset, level, 4);
+
+	width = _mm256_cvtepi32_ps(levelWidth);
+	height = _mm256_cvtepi32_ps(levelHeight);
+
+	// Move to texel space with texel centers on the half coordinates, like the hardware sampler.
+	x = _mm256_sub_ps(_mm256_mul_ps(u, width), _mm256_set1_ps(0.5f));
+	y = _mm256_sub_ps(_mm256_mul_ps(v, height), _mm256_set1_ps(0.5f));
+
+	x0 = _mm256_floor_ps(x);
+	y0 = _mm256_floor_ps(y);
+	fx = _mm256_sub_ps(x, x0);
+	fy = _mm256_sub_ps(y, y0);
+
+	// Wrap the top left texel into the level.  The clamp only guards against coordinates too large to wrap exactly.
+	x0 = _mm256_sub_ps(x0, _mm256_mul_ps(_mm256_floor_ps(_mm256_div_ps(x0, width)), width));
+	y0 = _mm256_sub_ps(y0, _mm256_mul_ps(_mm256_floor_ps(_mm256_div_ps(y0, height)), height));
+	x0 = _mm256_add_ps(x0, _mm256_and_ps(_mm256_cmp_ps(x0, _mm256_setzero_ps(), _CMP_LT_OQ), width));
+	y0 = _mm256_add_ps(y0, _mm256_and_ps(_mm256_cmp_ps(y0, _mm256_setzero_ps(), _CMP_LT_OQ), height));
+	x0 = _mm256_sub_ps(x0, _mm256_and_ps(_mm256_cmp_ps(x0, width, _CMP_GE_OQ), width));
+	y0 = _mm256_sub_ps(y0, _mm256_and_ps(_mm256_cmp_ps(y0, height, _CMP_GE_OQ), height));
+
+	one = _mm256_set1_epi32(1);
+	byteMask = _mm256_set1_epi32(0xff);
+	ix0 = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvttps_epi32(x0), _mm256_setzero_si256()), _mm256_sub_epi32(levelWidth, one));
+	iy0 = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvttps_epi32(y0), _mm256_setzero_si256()), _mm256_sub_epi32(levelHeight, one));
+	ix1 = _mm256_add_epi32(ix0, one);
+	iy1 = _mm256_add_epi32(iy0, one);
+	ix1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(ix1, levelWidth), ix1);
+	iy1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(iy1, levelHeight), iy1);
+
+	// Turn the four texel coordinates into indices for the current layout.
+	if(m_layout == LAYOUT_LINEAR)
+	{
+		index[0] = _mm256_add_epi32(offset, _mm256_add_epi32(_mm256_mullo_epi32(iy0, pitch), ix0));
+		index[1] = _mm256_add_epi32(offset, _mm256_add_epi32(_mm256_mullo_epi32(iy0, pitch), ix1));
+		index[2] = _mm256_add_epi32(offset, _mm256_add_epi32(_mm256_mullo_epi32(iy1, pitch), ix0));
+		index[3] = _mm256_add_epi32(offset, _mm256_add_epi32(_mm256_mullo_epi32(iy1, pitch), ix1));
+	}
+	else
+	{
+		for(i=0; i<4; i++)
+		{
+			tileX = (i & 1) ? ix1 : ix0;
+			tileY = (i & 2) ? iy1 : iy0;
+
+			// Interleave the low three bits of x and y to find the texel inside its 8x8 tile.
+			morton = _mm256_or_si256(_mm256_and_si256(tileX, one), _mm256_slli_epi32(_mm256_and_si256(tileY, one), 1));
+			morton = _mm256_or_si256(morton, _mm256_slli_epi32(_mm256_and_si256(tileX, _mm256_set1_epi32(2)), 1));
+			morton = _mm256_or_si256(morton, _mm256_slli_epi32(_mm256_and_si256(tileY, _mm256_set1_epi32(2)), 2));
+			morton = _mm256_or_si256(morton, _mm256_slli_epi32(_mm256_and_si256(tileX, _mm256_set1_epi32(4)), 2));
+			morton = _mm256_or_si256(morton, _mm256_slli_epi32(_mm256_and_si256(tileY, _mm256_set1_epi32(4)), 3));
+
+			index[i] = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(tileY, 3), pitch), _mm256_srli_epi32(tileX, 3));
+			index[i] = _mm256_add_epi32(offset, _mm256_add_epi32(_mm256_slli_epi32(index[i], 6), morton));
+		}
+	}
+
+	for(i=0; i<4; i++)
+	{
+		texel[i] = _mm256_i32gather_epi32((const int*)m_texels, index[i], 4);
+	}
+
+	weight[0] = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), fx), _mm256_sub_ps(_mm256_set1_ps(1.0f), fy));
+	weight[1] = _mm256_mul_ps(fx, _mm256_sub_ps(_mm256_set1_ps(1.0f), fy));
+	weight[2] = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), fx), fy);
+	weight[3] = _mm256_mul_ps(fx, fy);
+
+	// Blend the texels and convert from 8-bit to the 0-1 range.
+	for(c=0; c<4; c++)
+	{
+		color[c] = _mm256_mul_ps(weight[0], _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texel[0], c * 8), byteMask)));
+		for(i=1; i<4; i++)
+		{
+			color[c] = _mm256_add_ps(color[c], _mm256_mul_ps(weight[i],
+				_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texel[i], c * 8), byteMask))));
+		}
+		color[c] = _mm256_mul_ps(color[c], _mm256_set1_ps(1.0f / 255.0f));
+	}
+
+	return;
+}
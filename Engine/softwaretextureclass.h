@@ -0,0 +1,120 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: softwaretextureclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _SOFTWARETEXTURECLASS_H_
+#define _SOFTWARETEXTURECLASS_H_
+
+
+/////////////
+// LINKING //
+/////////////
+#pragma comment(lib, "windowscodecs.lib")
+#pragma comment(lib, "ole32.lib")
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <windows.h>
+#include <d3dx10math.h>
+#include <fstream>
+using namespace std;
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "softwareshaderclass.h"
+#include "memorytrackerclass.h"
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int SOFTWARE_TEXTURE_MAX_LEVELS = 16;
+const int SOFTWARE_TEXTURE_TILE_SIZE = 8;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: SoftwareTextureClass
+// System memory copy of a texture for the software renderer.  Texels are
+// 32-bit RGBA with red in the low byte, the same layout as
+// DXGI_FORMAT_R8G8B8A8_UNORM, so no graphics device is needed to load one.
+//
+// A full box filtered mip chain is built on load.  By default each level is
+// stored in 8x8 texel tiles with the texels of a tile in Morton order, so a
+// 4x4 block is one cache line and a bilinear footprint rarely spans more than
+// one tile whichever way the texture is rotated on screen.  The linear layout
+// is kept for comparison.
+//
+// SampleSpan filters eight pixels at once the way the light shader's sampler
+// state does: wrap addressing with trilinear filtering, taking the level of
+// detail from the screen space derivatives of the texture coordinates.
+////////////////////////////////////////////////////////////////////////////////
+class SoftwareTextureClass
+{
+public:
+	enum LayoutType
+	{
+		LAYOUT_LINEAR,
+		LAYOUT_SWIZZLED
+	};
+
+	// Texture coordinates of a span and their derivatives along the screen x and y axes.
+	struct SampleInputType
+	{
+		float u[SOFTWARE_SIMD_WIDTH];
+		float v[SOFTWARE_SIMD_WIDTH];
+		float dudx[SOFTWARE_SIMD_WIDTH];
+		float dvdx[SOFTWARE_SIMD_WIDTH];
+		float dudy[SOFTWARE_SIMD_WIDTH];
+		float dvdy[SOFTWARE_SIMD_WIDTH];
+	};
+
+public:
+	SoftwareTextureClass();
+	SoftwareTextureClass(const SoftwareTextureClass&);
+	~SoftwareTextureClass();
+
+	bool Initialize(WCHAR*);
+	bool Initialize(int, int, unsigned int*);
+	void Shutdown();
+
+	bool SetLayout(LayoutType);
+	LayoutType GetLayout();
+
+	int GetWidth();
+	int GetHeight();
+	int GetLevelCount();
+	int GetTexelIndex(int, int, int);
+	unsigned int* GetTexels();
+
+	D3DXVECTOR4 Sample(float, float, float);
+	void SampleSpan(SampleInputType*, float[4][SOFTWARE_SIMD_WIDTH]);
+
+private:
+	bool LoadDDS(WCHAR*, unsigned int*&);
+	bool LoadImageFile(WCHAR*, unsigned int*&);
+
+	bool BuildLevels(unsigned int*);
+	bool StoreLevels(unsigned int**);
+	int LayoutLevels();
+
+	float GetLevelOfDetail(float, float, float, float);
+	void SampleBilinear(int, float, float, float*);
+	void SampleSpanAVX2(SampleInputType*, float[4][SOFTWARE_SIMD_WIDTH]);
+	void SampleBilinearAVX2(__m256, __m256, __m256i, __m256*);
+
+private:
+	unsigned int* m_texels;
+	int m_width, m_height;
+	int m_levelCount;
+	int m_levelWidth[SOFTWARE_TEXTURE_MAX_LEVELS];
+	int m_levelHeight[SOFTWARE_TEXTURE_MAX_LEVELS];
+	int m_levelPitch[SOFTWARE_TEXTURE_MAX_LEVELS];
+	int m_levelOffset[SOFTWARE_TEXTURE_MAX_LEVELS];
+	LayoutType m_layout;
+	bool m_useAVX2;
+};
+
+#endif
@@ -0,0 +1,790 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: spatialtreeclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "spatialtreeclass.h"
+#include <algorithm>
+#include <math.h>
+
+
+SpatialTreeClass::SpatialTreeClass()
+{
+	m_nodes = 0;
+	m_candidates = 0;
+	m_root = -1;
+	m_freeList = -1;
+	m_proxyCount = 0;
+	m_rotationCount = 0;
+}
+
+
+SpatialTreeClass::SpatialTreeClass(const SpatialTreeClass& other)
+{
+}
+
+
+SpatialTreeClass::~SpatialTreeClass()
+{
+}
+
+
+bool SpatialTreeClass::Initialize()
+{
+	// Create the node array.
+	m_nodes = new vector<NodeType>;
+	if(!m_nodes)
+	{
+		return false;
+	}
+
+	m_nodes->reserve(SPATIAL_TREE_INITIAL_NODES);
+
+	// Create the heap the insertion search keeps its candidates in.
+	m_candidates = new vector<CandidateType>;
+	if(!m_candidates)
+	{
+		return false;
+	}
+
+	m_root = -1;
+	m_freeList = -1;
+	m_proxyCount = 0;
+	m_rotationCount = 0;
+
+	return true;
+}
+
+
+void SpatialTreeClass::Shutdown()
+{
+	// Release the candidate heap.
+	if(m_candidates)
+	{
+		delete m_candidates;
+		m_candidates = 0;
+	}
+
+	// Release the nodes.
+	if(m_nodes)
+	{
+		delete m_nodes;
+		m_nodes = 0;
+	}
+
+	m_root = -1;
+	m_freeList = -1;
+	m_proxyCount = 0;
+
+	return;
+}
+
+
+int SpatialTreeClass::CreateProxy(D3DXVECTOR3& minimum, D3DXVECTOR3& maximum, int object)
+{
+	NodeType* node;
+	D3DXVECTOR3 margin;
+	int proxy;
+
+
+	// Make a leaf for the object with a fattened box around its own.
+	proxy = AllocateNode();
+	margin = D3DXVECTOR3(SPATIAL_TREE_MARGIN, SPATIAL_TREE_MARGIN, SPATIAL_TREE_MARGIN);
+
+	node = &(*m_nodes)[proxy];
+	node->objectMinimum = minimum;
+	node->objectMaximum = maximum;
+	node->minimum = minimum - margin;
+	node->maximum = maximum + margin;
+	node->object = object;
+
+	InsertLeaf(proxy);
+	m_proxyCount++;
+
+	return proxy;
+}
+
+
+void SpatialTreeClass::DestroyProxy(int proxy)
+{
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	m_proxyCount--;
+
+	return;
+}
+
+
+bool SpatialTreeClass::MoveProxy(int proxy, D3DXVECTOR3& minimum, D3DXVECTOR3& maximum)
+{
+	NodeType* node;
+	D3DXVECTOR3 margin;
+
+
+	node = &(*m_nodes)[proxy];
+	node->objectMinimum = minimum;
+	node->objectMaximum = maximum;
+
+	// Nothing in the tree changes while the object stays inside its fat box.
+	if(Contains(*node, minimum, maximum))
+	{
+		return false;
+	}
+
+	// Otherwise take the leaf out and put it back with a new fat box.
+	RemoveLeaf(proxy);
+
+	margin = D3DXVECTOR3(SPATIAL_TREE_MARGIN, SPATIAL_TREE_MARGIN, SPATIAL_TREE_MARGIN);
+
+	node = &(*m_nodes)[proxy];
+	node->minimum = minimum - margin;
+	node->maximum = maximum + margin;
+
+	InsertLeaf(proxy);
+
+	return true;
+}
+
+
+int SpatialTreeClass::GetProxyObject(int proxy)
+{
+	return (*m_nodes)[proxy].object;
+}
+
+
+void SpatialTreeClass::QueryRegion(D3DXVECTOR3& minimum, D3DXVECTOR3& maximum, vector<int>& results)
+{
+	vector<int> stack;
+	NodeType* node;
+	int index;
+
+
+	if(m_root == -1)
+	{
+		return;
+	}
+
+	// Descend into every node whose box touches the region.
+	stack.push_back(m_root);
+	while(!stack.empty())
+	{
+		index = stack.back();
+		stack.pop_back();
+
+		node = &(*m_nodes)[index];
+		if(!Overlaps(node->minimum, node->maximum, minimum, maximum))
+		{
+			continue;
+		}
+
+		// Leaves report their object if its own box touches the region as well.
+		if(node->height == 0)
+		{
+			if(Overlaps(node->objectMinimum, node->objectMaximum, minimum, maximum))
+			{
+				results.push_back(node->object);
+			}
+			continue;
+		}
+
+		stack.push_back(node->child1);
+		stack.push_back(node->child2);
+	}
+
+	return;
+}
+
+
+void SpatialTreeClass::QueryFrustum(float planes[CULLING_PLANE_COUNT][4], vector<int>& results)
+{
+	vector<int> stack;
+	NodeType* node;
+	int index, side;
+
+
+	if(m_root == -1)
+	{
+		return;
+	}
+
+	stack.push_back(m_root);
+	while(!stack.empty())
+	{
+		index = stack.back();
+		stack.pop_back();
+
+		node = &(*m_nodes)[index];
+		side = ClassifyBox(planes, node->minimum, node->maximum);
+		if(side < 0)
+		{
+			continue;
+		}
+
+		// A leaf that straddles a plane is decided by the object's own box.
+		if(node->height == 0)
+		{
+			if((side > 0) || (ClassifyBox(planes, node->objectMinimum, node->objectMaximum) >= 0))
+			{
+				results.push_back(node->object);
+			}
+			continue;
+		}
+
+		// Everything under a node that is entirely inside is visible without testing further.
+		if(side > 0)
+		{
+			AddSubtree(index, results);
+			continue;
+		}
+
+		stack.push_back(node->child1);
+		stack.push_back(node->child2);
+	}
+
+	return;
+}
+
+
+bool SpatialTreeClass::RayCast(D3DXVECTOR3& origin, D3DXVECTOR3& direction, float maxDistance, int& object, float& distance)
+{
+	vector<int> stack;
+	NodeType* node;
+	D3DXVECTOR3 inverse;
+	float nearest, hitDistance;
+	bool hit;
+	int index;
+
+
+	if(m_root == -1)
+	{
+		return false;
+	}
+
+	// The slab tests divide by the direction, so do it once.
+	inverse = D3DXVECTOR3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	// Only descend into boxes the ray reaches before the nearest hit so far.
+	hit = false;
+	nearest = maxDistance;
+
+	stack.push_back(m_root);
+	while(!stack.empty())
+	{
+		index = stack.back();
+		stack.pop_back();
+
+		node = &(*m_nodes)[index];
+		if(!IntersectRay(origin, inverse, node->minimum, node->maximum, nearest, hitDistance))
+		{
+			continue;
+		}
+
+		if(node->height == 0)
+		{
+			if(IntersectRay(origin, inverse, node->objectMinimum, node->objectMaximum, nearest, hitDistance))
+			{
+				nearest = hitDistance;
+				object = node->object;
+				hit = true;
+			}
+			continue;
+		}
+
+		stack.push_back(node->child1);
+		stack.push_back(node->child2);
+	}
+
+	distance = nearest;
+
+	return hit;
+}
+
+
+int SpatialTreeClass::GetProxyCount()
+{
+	return m_proxyCount;
+}
+
+
+int SpatialTreeClass::GetHeight()
+{
+	return (m_root == -1) ? 0 : (*m_nodes)[m_root].height;
+}
+
+
+int SpatialTreeClass::GetRotationCount()
+{
+	return m_rotationCount;
+}
+
+
+float SpatialTreeClass::GetAreaRatio()
+{
+	float area;
+	int i;
+
+
+	if(m_root == -1)
+	{
+		return 0.0f;
+	}
+
+	// The surface area of every inner node against the root's, which is what a query that misses pays.
+	area = 0.0f;
+	for(i=0; i<(int)m_nodes->size(); i++)
+	{
+		if((*m_nodes)[i].height > 0)
+		{
+			area += Area((*m_nodes)[i].minimum, (*m_nodes)[i].maximum);
+		}
+	}
+
+	return area / Area((*m_nodes)[m_root].minimum, (*m_nodes)[m_root].maximum);
+}
+
+
+int SpatialTreeClass::AllocateNode()
+{
+	NodeType node;
+	int index;
+
+
+	// Reuse a freed node, or grow the array.
+	if(m_freeList != -1)
+	{
+		index = m_freeList;
+		m_freeList = (*m_nodes)[index].parent;
+	}
+	else
+	{
+		m_nodes->push_back(node);
+		index = (int)m_nodes->size() - 1;
+	}
+
+	(*m_nodes)[index].parent = -1;
+	(*m_nodes)[index].child1 = -1;
+	(*m_nodes)[index].child2 = -1;
+	(*m_nodes)[index].height = 0;
+	(*m_nodes)[index].object = -1;
+
+	return index;
+}
+
+
+void SpatialTreeClass::FreeNode(int index)
+{
+	// Free nodes are chained through their parent index.
+	(*m_nodes)[index].parent = m_freeList;
+	(*m_nodes)[index].height = -1;
+	m_freeList = index;
+
+	return;
+}
+
+
+void SpatialTreeClass::InsertLeaf(int leaf)
+{
+	NodeType* node;
+	int sibling, oldParent, newParent;
+
+
+	if(m_root == -1)
+	{
+		m_root = leaf;
+		(*m_nodes)[leaf].parent = -1;
+		return;
+	}
+
+	sibling = FindBestSibling(leaf);
+
+	// Join the leaf and its sibling under a new parent in the sibling's place.  Allocating may move the array, so look nodes up after.
+	newParent = AllocateNode();
+	oldParent = (*m_nodes)[sibling].parent;
+
+	node = &(*m_nodes)[newParent];
+	node->parent = oldParent;
+	node->child1 = sibling;
+	node->child2 = leaf;
+	D3DXVec3Minimize(&node->minimum, &(*m_nodes)[sibling].minimum, &(*m_nodes)[leaf].minimum);
+	D3DXVec3Maximize(&node->maximum, &(*m_nodes)[sibling].maximum, &(*m_nodes)[leaf].maximum);
+	node->height = (*m_nodes)[sibling].height + 1;
+
+	(*m_nodes)[sibling].parent = newParent;
+	(*m_nodes)[leaf].parent = newParent;
+
+	if(oldParent == -1)
+	{
+		m_root = newParent;
+	}
+	else if((*m_nodes)[oldParent].child1 == sibling)
+	{
+		(*m_nodes)[oldParent].child1 = newParent;
+	}
+	else
+	{
+		(*m_nodes)[oldParent].child2 = newParent;
+	}
+
+	// Grow the ancestors to hold the leaf, rotating where it helps.
+	Refit(newParent);
+
+	return;
+}
+
+
+void SpatialTreeClass::RemoveLeaf(int leaf)
+{
+	int parent, grandParent, sibling;
+
+
+	if(leaf == m_root)
+	{
+		m_root = -1;
+		return;
+	}
+
+	parent = (*m_nodes)[leaf].parent;
+	grandParent = (*m_nodes)[parent].parent;
+	sibling = ((*m_nodes)[parent].child1 == leaf) ? (*m_nodes)[parent].child2 : (*m_nodes)[parent].child1;
+
+	// The sibling takes the parent's place, and the parent goes.
+	if(grandParent == -1)
+	{
+		m_root = sibling;
+		(*m_nodes)[sibling].parent = -1;
+		FreeNode(parent);
+		return;
+	}
+
+	if((*m_nodes)[grandParent].child1 == parent)
+	{
+		(*m_nodes)[grandParent].child1 = sibling;
+	}
+	else
+	{
+		(*m_nodes)[grandParent].child2 = sibling;
+	}
+
+	(*m_nodes)[sibling].parent = grandParent;
+	FreeNode(parent);
+
+	// Shrink the ancestors.
+	Refit(grandParent);
+
+	return;
+}
+
+
+int SpatialTreeClass::FindBestSibling(int leaf)
+{
+	NodeType* node;
+	NodeType* leafNode;
+	CandidateType candidate;
+	float leafArea, directCost, cost, bestCost, childCost;
+	int best;
+	auto cheaper = [](const CandidateType& a, const CandidateType& b) { return a.inheritedCost > b.inheritedCost; };
+
+
+	leafNode = &(*m_nodes)[leaf];
+	leafArea = Area(leafNode->minimum, leafNode->maximum);
+
+	// Start with the root, which costs the area of the new root.
+	best = m_root;
+	bestCost = UnionArea((*m_nodes)[m_root], *leafNode);
+
+	candidate.inheritedCost = 0.0f;
+	candidate.node = m_root;
+	m_candidates->clear();
+	m_candidates->push_back(candidate);
+
+	// Search the nodes whose ancestors grow the least first.
+	while(!m_candidates->empty())
+	{
+		pop_heap(m_candidates->begin(), m_candidates->end(), cheaper);
+		candidate = m_candidates->back();
+		m_candidates->pop_back();
+
+		// No node below here can cost less than the new parent's own area plus what the ancestors grow by.
+		if(leafArea + candidate.inheritedCost >= bestCost)
+		{
+			break;
+		}
+
+		// Choosing this node costs a parent around both plus the growth of every ancestor.
+		node = &(*m_nodes)[candidate.node];
+		directCost = UnionArea(*node, *leafNode);
+		cost = directCost + candidate.inheritedCost;
+		if(cost < bestCost)
+		{
+			best = candidate.node;
+			bestCost = cost;
+		}
+
+		// Going further down also grows this node.
+		if(node->height > 0)
+		{
+			childCost = candidate.inheritedCost + directCost - Area(node->minimum, node->maximum);
+			if(leafArea + childCost < bestCost)
+			{
+				candidate.inheritedCost = childCost;
+
+				candidate.node = node->child1;
+				m_candidates->push_back(candidate);
+				push_heap(m_candidates->begin(), m_candidates->end(), cheaper);
+
+				candidate.node = node->child2;
+				m_candidates->push_back(candidate);
+				push_heap(m_candidates->begin(), m_candidates->end(), cheaper);
+			}
+		}
+	}
+
+	return best;
+}
+
+
+void SpatialTreeClass::Refit(int index)
+{
+	NodeType* node;
+	NodeType* child1;
+	NodeType* child2;
+
+
+	// Walk to the root, fitting each node around its children and then trying a rotation.
+	while(index != -1)
+	{
+		node = &(*m_nodes)[index];
+		child1 = &(*m_nodes)[node->child1];
+		child2 = &(*m_nodes)[node->child2];
+
+		D3DXVec3Minimize(&node->minimum, &child1->minimum, &child2->minimum);
+		D3DXVec3Maximize(&node->maximum, &child1->maximum, &child2->maximum);
+		node->height = 1 + max(child1->height, child2->height);
+
+		Rotate(index);
+
+		index = node->parent;
+	}
+
+	return;
+}
+
+
+void SpatialTreeClass::Rotate(int index)
+{
+	NodeType* node;
+	NodeType* b;
+	NodeType* c;
+	NodeType* inner;
+	float areaB, areaC, cost, bestCost;
+	int best, moving, staying, swapped, innerIndex;
+
+
+	// Children are B and C.  B can swap with either child of C, or C with either child of B.
+	node = &(*m_nodes)[index];
+	b = &(*m_nodes)[node->child1];
+	c = &(*m_nodes)[node->child2];
+	if((b->height == 0) && (c->height == 0))
+	{
+		return;
+	}
+
+	areaB = Area(b->minimum, b->maximum);
+	areaC = Area(c->minimum, c->maximum);
+
+	// A swap only changes the box of the child it swaps into, so pick the one that shrinks it most.
+	best = -1;
+	bestCost = 0.0f;
+
+	if(c->height > 0)
+	{
+		cost = UnionArea(*b, (*m_nodes)[c->child2]) - areaC;
+		if(cost < bestCost)
+		{
+			best = 0;
+			bestCost = cost;
+		}
+
+		cost = UnionArea(*b, (*m_nodes)[c->child1]) - areaC;
+		if(cost < bestCost)
+		{
+			best = 1;
+			bestCost = cost;
+		}
+	}
+
+	if(b->height > 0)
+	{
+		cost = UnionArea(*c, (*m_nodes)[b->child2]) - areaB;
+		if(cost < bestCost)
+		{
+			best = 2;
+			bestCost = cost;
+		}
+
+		cost = UnionArea(*c, (*m_nodes)[b->child1]) - areaB;
+		if(cost < bestCost)
+		{
+			best = 3;
+			bestCost = cost;
+		}
+	}
+
+	if(best == -1)
+	{
+		return;
+	}
+
+	// Work out which child moves down into which inner node, and which grandchild comes up.
+	if(best < 2)
+	{
+		innerIndex = node->child2;
+		moving = node->child1;
+		staying = (best == 0) ? c->child2 : c->child1;
+		swapped = (best == 0) ? c->child1 : c->child2;
+		node->child1 = swapped;
+	}
+	else
+	{
+		innerIndex = node->child1;
+		moving = node->child2;
+		staying = (best == 2) ? b->child2 : b->child1;
+		swapped = (best == 2) ? b->child1 : b->child2;
+		node->child2 = swapped;
+	}
+
+	inner = &(*m_nodes)[innerIndex];
+	inner->child1 = moving;
+	inner->child2 = staying;
+	(*m_nodes)[moving].parent = innerIndex;
+	(*m_nodes)[swapped].parent = index;
+
+	// Refit the inner node around its new children.  The node above keeps the same leaves, so only its height can change.
+	D3DXVec3Minimize(&inner->minimum, &(*m_nodes)[moving].minimum, &(*m_nodes)[staying].minimum);
+	D3DXVec3Maximize(&inner->maximum, &(*m_nodes)[moving].maximum, &(*m_nodes)[staying].maximum);
+	inner->height = 1 + max((*m_nodes)[moving].height, (*m_nodes)[staying].height);
+	node->height = 1 + max((*m_nodes)[node->child1].height, (*m_nodes)[node->child2].height);
+
+	m_rotationCount++;
+
+	return;
+}
+
+
+void SpatialTreeClass::AddSubtree(int index, vector<int>& results)
+{
+	vector<int> stack;
+	NodeType* node;
+
+
+	stack.push_back(index);
+	while(!stack.empty())
+	{
+		node = &(*m_nodes)[stack.back()];
+		stack.pop_back();
+
+		if(node->height == 0)
+		{
+			results.push_back(node->object);
+			continue;
+		}
+
+		stack.push_back(node->child1);
+		stack.push_back(node->child2);
+	}
+
+	return;
+}
+
+
+float SpatialTreeClass::Area(D3DXVECTOR3& minimum, D3DXVECTOR3& maximum)
+{
+	D3DXVECTOR3 size;
+
+
+	// Half the surface area, which compares the same way.
+	size = maximum - minimum;
+
+	return (size.x * size.y) + (size.y * size.z) + (size.z * size.x);
+}
+
+
+float SpatialTreeClass::UnionArea(NodeType& first, NodeType& second)
+{
+	D3DXVECTOR3 minimum, maximum;
+
+
+	D3DXVec3Minimize(&minimum, &first.minimum, &second.minimum);
+	D3DXVec3Maximize(&maximum, &first.maximum, &second.maximum);
+
+	return Area(minimum, maximum);
+}
+
+
+bool SpatialTreeClass::Contains(NodeType& node, D3DXVECTOR3& minimum, D3DXVECTOR3& maximum)
+{
+	return (node.minimum.x <= minimum.x) && (node.minimum.y <= minimum.y) && (node.minimum.z <= minimum.z) &&
+		(node.maximum.x >= maximum.x) && (node.maximum.y >= maximum.y) && (node.maximum.z >= maximum.z);
+}
+
+
+bool SpatialTreeClass::Overlaps(D3DXVECTOR3& minimum1, D3DXVECTOR3& maximum1, D3DXVECTOR3& minimum2, D3DXVECTOR3& maximum2)
+{
+	return (minimum1.x <= maximum2.x) && (minimum1.y <= maximum2.y) && (minimum1.z <= maximum2.z) &&
+		(minimum2.x <= maximum1.x) && (minimum2.y <= maximum1.y) && (minimum2.z <= maximum1.z);
+}
+
+
+bool SpatialTreeClass::IntersectRay(D3DXVECTOR3& origin, D3DXVECTOR3& inverse, D3DXVECTOR3& minimum, D3DXVECTOR3& maximum, float maxDistance,
+									float& distance)
+{
+	float nearDistance, farDistance, t1, t2;
+	int axis;
+
+
+	// Clip the ray against the three pairs of planes in turn.
+	nearDistance = 0.0f;
+	farDistance = maxDistance;
+	for(axis=0; axis<3; axis++)
+	{
+		t1 = (((float*)minimum)[axis] - ((float*)origin)[axis]) * ((float*)inverse)[axis];
+		t2 = (((float*)maximum)[axis] - ((float*)origin)[axis]) * ((float*)inverse)[axis];
+
+		nearDistance = max(nearDistance, min(t1, t2));
+		farDistance = min(farDistance, max(t1, t2));
+	}
+
+	distance = nearDistance;
+
+	return nearDistance <= farDistance;
+}
+
+
+int SpatialTreeClass::ClassifyBox(float planes[CULLING_PLANE_COUNT][4], D3DXVECTOR3& minimum, D3DXVECTOR3& maximum)
+{
+	D3DXVECTOR3 center, extents;
+	float distance, radius;
+	int side, plane;
+
+
+	center = (minimum + maximum) * 0.5f;
+	extents = (maximum - minimum) * 0.5f;
+
+	// The box is outside if it is behind any plane, and inside only if it is in front of all of them.
+	side = 1;
+	for(plane=0; plane<CULLING_PLANE_COUNT; plane++)
+	{
+		distance = (planes[plane][0] * center.x) + (planes[plane][1] * center.y) + (planes[plane][2] * center.z) + planes[plane][3];
+		radius = (fabsf(planes[plane][0]) * extents.x) + (fabsf(planes[plane][1]) * extents.y) + (fabsf(planes[plane][2]) * extents.z);
+
+		if(distance < -radius)
+		{
+			return -1;
+		}
+
+		if(distance < radius)
+		{
+			side = 0;
+		}
+	}
+
+	return side;
+}
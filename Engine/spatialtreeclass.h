@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: spatialtreeclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _SPATIALTREECLASS_H_
+#define _SPATIALTREECLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <d3dx10math.h>
+#include <vector>
+using namespace std;
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "cullingclass.h"
+
+
+/////////////
+// GLOBALS //
+/////////////
+const float SPATIAL_TREE_MARGIN = 0.1f;
+const int SPATIAL_TREE_INITIAL_NODES = 256;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: SpatialTreeClass
+// A dynamic bounding volume hierarchy of axis aligned boxes for frustum, ray
+// and region queries.  Every object is a leaf, and the caller keeps the proxy
+// id CreateProxy returns to move or remove it.  Leaves hold the object's own
+// box for the final test and a box fattened by SPATIAL_TREE_MARGIN for the
+// tree, so an object that moves a little stays where it is and only one that
+// leaves its fat box is taken out and inserted again.
+//
+// Insertion picks the sibling that adds the least surface area to the tree,
+// counting the growth of every ancestor, with a branch and bound search that
+// stops descending once a subtree cannot beat the best sibling found.  The
+// ancestors are then refit on the way back to the root, and each one tries
+// swapping a child with a grandchild on the other side when that shrinks the
+// child's box, which keeps the tree close to balanced as objects come and go
+// without ever rebuilding it.
+//
+// Nodes live in one array and are linked by index, with freed nodes kept on a
+// list for reuse.  Queries only read the tree, so any number of threads can
+// query it while nothing is being moved.
+////////////////////////////////////////////////////////////////////////////////
+class SpatialTreeClass
+{
+private:
+	struct NodeType
+	{
+		D3DXVECTOR3 minimum, maximum;
+		D3DXVECTOR3 objectMinimum, objectMaximum;
+		int parent;
+		int child1, child2;
+		int height;
+		int object;
+	};
+
+	// A candidate sibling and the area its ancestors would grow by.
+	struct CandidateType
+	{
+		float inheritedCost;
+		int node;
+	};
+
+public:
+	SpatialTreeClass();
+	SpatialTreeClass(const SpatialTreeClass&);
+	~SpatialTreeClass();
+
+	bool Initialize();
+	void Shutdown();
+
+	int CreateProxy(D3DXVECTOR3&, D3DXVECTOR3&, int);
+	void DestroyProxy(int);
+	bool MoveProxy(int, D3DXVECTOR3&, D3DXVECTOR3&);
+	int GetProxyObject(int);
+
+	void QueryRegion(D3DXVECTOR3&, D3DXVECTOR3&, vector<int>&);
+	void QueryFrustum(float[CULLING_PLANE_COUNT][4], vector<int>&);
+	bool RayCast(D3DXVECTOR3&, D3DXVECTOR3&, float, int&, float&);
+
+	int GetProxyCount();
+	int GetHeight();
+	int GetRotationCount();
+	float GetAreaRatio();
+
+private:
+	int AllocateNode();
+	void FreeNode(int);
+	void InsertLeaf(int);
+	void RemoveLeaf(int);
+	int FindBestSibling(int);
+	void Refit(int);
+	void Rotate(int);
+	void AddSubtree(int, vector<int>&);
+
+	static float Area(D3DXVECTOR3&, D3DXVECTOR3&);
+	static float UnionArea(NodeType&, NodeType&);
+	static bool Contains(NodeType&, D3DXVECTOR3&, D3DXVECTOR3&);
+	static bool Overlaps(D3DXVECTOR3&, D3DXVECTOR3&, D3DXVECTOR3&, D3DXVECTOR3&);
+	static bool IntersectRay(D3DXVECTOR3&, D3DXVECTOR3&, D3DXVECTOR3&, D3DXVECTOR3&, float, float&);
+	static int ClassifyBox(float[CULLING_PLANE_COUNT][4], D3DXVECTOR3&, D3DXVECTOR3&);
+
+private:
+	vector<NodeType>* m_nodes;
+	vector<CandidateType>* m_candidates;
+	int m_root, m_freeList;
+	int m_proxyCount, m_rotationCount;
+};
+
+#endif
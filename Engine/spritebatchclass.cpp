@@ -0,0 +1,298 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: spritebatchclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "spritebatchclass.h"
+
+
+SpriteBatchClass::SpriteBatchClass()
+{
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+	m_vertices = 0;
+	m_batches = 0;
+	m_maxSprites = 0;
+	m_spriteCount = 0;
+}
+
+
+SpriteBatchClass::SpriteBatchClass(const SpriteBatchClass& other)
+{
+}
+
+
+SpriteBatchClass::~SpriteBatchClass()
+{
+}
+
+
+bool SpriteBatchClass::Initialize(ID3D11Device* device, int maxSprites)
+{
+	MEMORY_TAG(MemoryTrackerClass::TAG_UI);
+	unsigned long* indices;
+	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
+	D3D11_SUBRESOURCE_DATA indexData;
+	HRESULT result;
+	int i;
+
+
+	m_maxSprites = maxSprites;
+	m_spriteCount = 0;
+
+	// Create the array the quads are written to, four corners a sprite.
+	m_vertices = new VertexType::Textured[m_maxSprites * 4];
+	if(!m_vertices)
+	{
+		return false;
+	}
+
+	// Create the list of batches.
+	m_batches = new vector<BatchType>;
+	if(!m_batches)
+	{
+		return false;
+	}
+
+	// The software renderer reads the quads straight from the array, so there are no buffers to create without a device.
+	if(!device)
+	{
+		return true;
+	}
+
+	// Set up the description of the dynamic vertex buffer, which is refilled every frame.
+	vertexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	vertexBufferDesc.ByteWidth = sizeof(VertexType::Textured) * m_maxSprites * 4;
+	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vertexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	vertexBufferDesc.MiscFlags = 0;
+	vertexBufferDesc.StructureByteStride = 0;
+
+	result = device->CreateBuffer(&vertexBufferDesc, 0, &m_vertexBuffer);
+	if(FAILED(result))
+	{
+		return false;
+	}
+
+	MemoryTrackerClass::AddBuffer(MemoryTrackerClass::TAG_UI, m_vertexBuffer);
+
+	// Create the index array, two triangles for each quad in the same order the corners are written.
+	indices = new unsigned long[m_maxSprites * 6];
+	if(!indices)
+	{
+		return false;
+	}
+
+	for(i=0; i<m_maxSprites; i++)
+	{
+		indices[(i * 6) + 0] = (i * 4) + 0;
+		indices[(i * 6) + 1] = (i * 4) + 2;
+		indices[(i * 6) + 2] = (i * 4) + 3;
+		indices[(i * 6) + 3] = (i * 4) + 0;
+		indices[(i * 6) + 4] = (i * 4) + 1;
+		indices[(i * 6) + 5] = (i * 4) + 2;
+	}
+
+	// Set up the description of the static index buffer.
+	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	indexBufferDesc.ByteWidth = sizeof(unsigned long) * m_maxSprites * 6;
+	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	indexBufferDesc.CPUAccessFlags = 0;
+	indexBufferDesc.MiscFlags = 0;
+	indexBufferDesc.StructureByteStride = 0;
+
+	// Give the subresource structure a pointer to the index data.
+	indexData.pSysMem = indices;
+	indexData.SysMemPitch = 0;
+	indexData.SysMemSlicePitch = 0;
+
+	// Create the index buffer.
+	result = device->CreateBuffer(&indexBufferDesc, &indexData, &m_indexBuffer);
+
+	// Release the index array now that the buffer has been created and loaded.
+	delete [] indices;
+	indices = 0;
+
+	if(FAILED(result))
+	{
+		return false;
+	}
+
+	MemoryTrackerClass::AddBuffer(MemoryTrackerClass::TAG_UI, m_indexBuffer);
+
+	return true;
+}
+
+
+void SpriteBatchClass::Shutdown()
+{
+	// Release the index buffer.
+	if(m_indexBuffer)
+	{
+		MemoryTrackerClass::RemoveBuffer(MemoryTrackerClass::TAG_UI, m_indexBuffer);
+		m_indexBuffer->Release();
+		m_indexBuffer = 0;
+	}
+
+	// Release the vertex buffer.
+	if(m_vertexBuffer)
+	{
+		MemoryTrackerClass::RemoveBuffer(MemoryTrackerClass::TAG_UI, m_vertexBuffer);
+		m_vertexBuffer->Release();
+		m_vertexBuffer = 0;
+	}
+
+	// Release the batches and the quads.
+	if(m_batches)
+	{
+		delete m_batches;
+		m_batches = 0;
+	}
+
+	if(m_vertices)
+	{
+		delete [] m_vertices;
+		m_vertices = 0;
+	}
+
+	m_spriteCount = 0;
+
+	return;
+}
+
+
+void SpriteBatchClass::Begin()
+{
+	// Start the frame with no sprites.
+	m_spriteCount = 0;
+	m_batches->clear();
+
+	return;
+}
+
+
+bool SpriteBatchClass::AddSprite(BitmapClass* bitmap, int positionX, int positionY, bool merge, int& batch)
+{
+	BatchType newBatch;
+
+
+	if(m_spriteCount >= m_maxSprites)
+	{
+		return false;
+	}
+
+	// Write the sprite's corners after the last one.
+	bitmap->GetQuad(positionX, positionY, &m_vertices[m_spriteCount * 4]);
+
+	// Extend the last batch when the caller says the sprite can join it, otherwise start a new one.
+	if(merge && !m_batches->empty() && (m_batches->back().bitmap == bitmap))
+	{
+		m_batches->back().spriteCount++;
+		batch = -1;
+	}
+	else
+	{
+		newBatch.bitmap = bitmap;
+		newBatch.spriteStart = m_spriteCount;
+		newBatch.spriteCount = 1;
+		m_batches->push_back(newBatch);
+		batch = (int)m_batches->size() - 1;
+	}
+
+	m_spriteCount++;
+
+	return true;
+}
+
+
+bool SpriteBatchClass::Upload(ID3D11DeviceContext* deviceContext)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	HRESULT result;
+
+
+	if(!m_vertexBuffer || (m_spriteCount == 0))
+	{
+		return true;
+	}
+
+	// Replace the whole buffer, so the driver can hand out fresh memory instead of waiting on the last frame's draws.
+	result = deviceContext->Map(m_vertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	if(FAILED(result))
+	{
+		return false;
+	}
+
+	memcpy(mappedResource.pData, m_vertices, sizeof(VertexType::Textured) * m_spriteCount * 4);
+
+	deviceContext->Unmap(m_vertexBuffer, 0);
+
+	return true;
+}
+
+
+bool SpriteBatchClass::Render(ID3D11DeviceContext* deviceContext, TextureShaderClass* textureShader, int batch, D3DXMATRIX worldMatrix,
+							  D3DXMATRIX viewMatrix, D3DXMATRIX projectionMatrix)
+{
+	BatchType* current;
+	unsigned int stride, offset;
+
+
+	current = &(*m_batches)[batch];
+
+	// Put the shared vertex and index buffers on the pipeline, since the scene may have replaced them.
+	stride = sizeof(VertexType::Textured);
+	offset = 0;
+	deviceContext->IASetVertexBuffers(0, 1, &m_vertexBuffer, &stride, &offset);
+	deviceContext->IASetIndexBuffer(m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	// Draw the batch's quads with its bitmap's texture.
+	return textureShader->Render(deviceContext, current->spriteCount * 6, current->spriteStart * 6, worldMatrix, viewMatrix,
+		projectionMatrix, current->bitmap->GetTexture());
+}
+
+
+bool SpriteBatchClass::Render(SoftwareRendererClass* software, int batch, D3DXMATRIX worldMatrix, D3DXMATRIX viewMatrix,
+							  D3DXMATRIX projectionMatrix)
+{
+	BatchType* current;
+	VertexType::Textured* quad;
+	VertexType::Textured* vertices;
+	int i;
+
+
+	current = &(*m_batches)[batch];
+
+	// The software renderer takes plain triangle lists, so spell the quads out in frame memory.
+	vertices = (VertexType::Textured*)FrameAllocatorClass::Allocate(sizeof(VertexType::Textured) * current->spriteCount * 6);
+	if(!vertices)
+	{
+		return false;
+	}
+
+	for(i=0; i<current->spriteCount; i++)
+	{
+		quad = &m_vertices[(current->spriteStart + i) * 4];
+
+		vertices[(i * 6) + 0] = quad[0];
+		vertices[(i * 6) + 1] = quad[2];
+		vertices[(i * 6) + 2] = quad[3];
+		vertices[(i * 6) + 3] = quad[0];
+		vertices[(i * 6) + 4] = quad[1];
+		vertices[(i * 6) + 5] = quad[2];
+	}
+
+	return software->RenderTexture(vertices, current->spriteCount * 6, worldMatrix, viewMatrix, projectionMatrix,
+		current->bitmap->GetSoftwareTexture());
+}
+
+
+int SpriteBatchClass::GetSpriteCount()
+{
+	return m_spriteCount;
+}
+
+
+int SpriteBatchClass::GetBatchCount()
+{
+	return (int)m_batches->size();
+}
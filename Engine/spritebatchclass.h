@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: spritebatchclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _SPRITEBATCHCLASS_H_
+#define _SPRITEBATCHCLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <d3d11.h>
+#include <d3dx10math.h>
+#include <vector>
+using namespace std;
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "bitmapclass.h"
+#include "textureshaderclass.h"
+#include "softwarerendererclass.h"
+#include "vertextypes.h"
+#include "frameallocatorclass.h"
+#include "memorytrackerclass.h"
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int SPRITE_BATCH_MAX_SPRITES = 16384;
+const int SPRITE_LAYER_COUNT = 256;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: SpriteBatchClass
+// Collects the bitmaps drawn in a frame into one streaming vertex buffer, so
+// they are uploaded with a single map and drawn with as few calls as there
+// are runs of the same bitmap.  Each sprite is a quad of four corners, and a
+// static index buffer turns every quad into two triangles.
+//
+// The draw queue puts the sprites in order first, by layer and then by
+// bitmap, so AddSprite only has to extend the last batch or start a new one.
+// Upload copies the quads to the GPU once they are all in, and Render draws
+// one batch.  Without a device the batches go to the software renderer as
+// triangle lists instead.
+////////////////////////////////////////////////////////////////////////////////
+class SpriteBatchClass
+{
+private:
+	// A run of sprites drawn with the same bitmap.
+	struct BatchType
+	{
+		BitmapClass* bitmap;
+		int spriteStart, spriteCount;
+	};
+
+public:
+	SpriteBatchClass();
+	SpriteBatchClass(const SpriteBatchClass&);
+	~SpriteBatchClass();
+
+	bool Initialize(ID3D11Device*, int);
+	void Shutdown();
+
+	void Begin();
+	bool AddSprite(BitmapClass*, int, int, bool, int&);
+	bool Upload(ID3D11DeviceContext*);
+	bool Render(ID3D11DeviceContext*, TextureShaderClass*, int, D3DXMATRIX, D3DXMATRIX, D3DXMATRIX);
+	bool Render(SoftwareRendererClass*, int, D3DXMATRIX, D3DXMATRIX, D3DXMATRIX);
+
+	int GetSpriteCount();
+	int GetBatchCount();
+
+private:
+	ID3D11Buffer *m_vertexBuffer, *m_indexBuffer;
+	VertexType::Textured* m_vertices;
+	vector<BatchType>* m_batches;
+	int m_maxSprites, m_spriteCount;
+};
+
+#endif
@@ -8,9 +8,12 @@ TextClass::TextClass()
 {
 	m_Font = 0;
 	m_FontShader = 0;
-
-	m_sentence1 = 0;
-	m_sentence2 = 0;
+	m_Texts = 0;
+	m_device = 0;
+	m_glyphBuffer = 0;
+	m_glyphCount = 0;
+	m_maxGlyphs = 0;
+	m_layoutChanged = false;
 }
 
 
@@ -24,9 +27,10 @@ TextClass::~TextClass()
 }
 
 
-bool TextClass::Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, HWND hwnd, int screenWidth, int screenHeight, 
+bool TextClass::Initialize(ID3D11Device* device, PipelineStateClass* pipelineState, HWND hwnd, int screenWidth, int screenHeight,
 						   D3DXMATRIX baseViewMatrix)
 {
+	MEMORY_TAG(MemoryTrackerClass::TAG_TEXT);
 	bool result;
 
 
@@ -37,59 +41,63 @@ bool TextClass::Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceCont
 	// Store the base view matrix.
 	m_baseViewMatrix = baseViewMatrix;
 
-	// Create the font object.
-	m_Font = new FontClass;
-	if(!m_Font)
+	// Keep the device to recreate the glyph buffer with when the text outgrows it.
+	m_device = device;
+
+	// Create the table the text objects are kept in.
+	m_Texts = new HandleTableClass;
+	if(!m_Texts)
 	{
 		return false;
 	}
 
-	// Initialize the font object.
-	result = m_Font->Initialize(device, "../Engine/data/fontdata.txt", L"../Engine/data/font.dds");
+	result = m_Texts->Initialize();
 	if(!result)
 	{
-		MessageBox(hwnd, L"Could not initialize the font object.", L"Error", MB_OK);
 		return false;
 	}
 
-	// Create the font shader object.
-	m_FontShader = new FontShaderClass;
-	if(!m_FontShader)
+	// Create the font object.
+	m_Font = new FontClass;
+	if(!m_Font)
 	{
 		return false;
 	}
 
-	// Initialize the font shader object.
-	result = m_FontShader->Initialize(device, hwnd);
+	// Initialize the font object.
+	result = m_Font->Initialize(device, "../Engine/data/fontdata.txt", L"../Engine/data/font.dds");
 	if(!result)
 	{
-		MessageBox(hwnd, L"Could not initialize the font shader object.", L"Error", MB_OK);
+		MessageBox(hwnd, L"Could not initialize the font object.", L"Error", MB_OK);
 		return false;
 	}
 
-	// Initialize the first sentence.
-	result = InitializeSentence(&m_sentence1, 16, device);
-	if(!result)
+	// Keep the glyph metrics the quads are built from.
+	m_Font->GetGlyphMetrics(m_glyphMetrics);
+
+	// Without a device the text is drawn by the software renderer, so there is no shader or buffer to create.
+	if(!device)
 	{
-		return false;
+		return true;
 	}
 
-	// Now update the sentence vertex buffer with the new string information.
-	result = UpdateSentence(m_sentence1, "Hello", 100, 100, 1.0f, 1.0f, 1.0f, deviceContext);
-	if(!result)
+	// Create the font shader object.
+	m_FontShader = new FontShaderClass;
+	if(!m_FontShader)
 	{
 		return false;
 	}
 
-	// Initialize the first sentence.
-	result = InitializeSentence(&m_sentence2, 16, device);
+	// Initialize the font shader object with the glyph metrics, and the kind of atlas it reads.
+	result = m_FontShader->Initialize(device, pipelineState, hwnd, m_glyphMetrics, m_Font->IsDistanceField());
 	if(!result)
 	{
+		MessageBox(hwnd, L"Could not initialize the font shader object.", L"Error", MB_OK);
 		return false;
 	}
 
-	// Now update the sentence vertex buffer with the new string information.
-	result = UpdateSentence(m_sentence2, "Goodbye", 100, 200, 1.0f, 1.0f, 0.0f, deviceContext);
+	// Create the glyph buffer all the text shares.
+	result = InitializeBuffer(TEXT_INITIAL_GLYPHS);
 	if(!result)
 	{
 		return false;
@@ -101,11 +109,27 @@ bool TextClass::Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceCont
 
 void TextClass::Shutdown()
 {
-	// Release the first sentence.
-	ReleaseSentence(&m_sentence1);
+	TextObjectType* object;
+	int i;
+
+
+	// Release the shared glyph buffer.
+	ShutdownBuffer();
 
-	// Release the second sentence.
-	ReleaseSentence(&m_sentence2);
+	// Release the text objects that were never destroyed.
+	if(m_Texts)
+	{
+		for(i=0; i<m_Texts->GetCount(); i++)
+		{
+			object = (TextObjectType*)m_Texts->GetItem(i);
+			delete [] object->glyphs;
+			delete object;
+		}
+
+		m_Texts->Shutdown();
+		delete m_Texts;
+		m_Texts = 0;
+	}
 
 	// Release the font shader object.
 	if(m_FontShader)
@@ -123,262 +147,397 @@ void TextClass::Shutdown()
 		m_Font = 0;
 	}
 
+	m_device = 0;
+
 	return;
 }
 
 
-bool TextClass::Render(ID3D11DeviceContext* deviceContext, D3DXMATRIX worldMatrix, D3DXMATRIX orthoMatrix)
+unsigned int TextClass::CreateText()
 {
-	bool result;
+	MEMORY_TAG(MemoryTrackerClass::TAG_TEXT);
+	TextObjectType* object;
+	unsigned int handle;
 
 
-	// Draw the first sentence.
-	result = RenderSentence(deviceContext, m_sentence1, worldMatrix, orthoMatrix);
-	if(!result)
+	// Start the object empty, white and visible, with nothing to upload.
+	object = new TextObjectType;
+	if(!object)
 	{
-		return false;
+		return HANDLE_INVALID;
 	}
 
-	// Draw the second sentence.
-	result = RenderSentence(deviceContext, m_sentence2, worldMatrix, orthoMatrix);
-	if(!result)
+	object->positionX = 0;
+	object->positionY = 0;
+	object->height = (int)m_Font->GetHeight();
+	object->color = D3DXVECTOR4(1.0f, 1.0f, 1.0f, 1.0f);
+	object->glyphs = 0;
+	object->glyphCount = 0;
+	object->maxGlyphs = 0;
+	object->visible = true;
+	object->dirty = false;
+
+	handle = m_Texts->Add(object);
+	if(handle == HANDLE_INVALID)
 	{
-		return false;
+		delete object;
 	}
 
-	return true;
+	return handle;
 }
 
 
-bool TextClass::InitializeSentence(SentenceType** sentence, int maxLength, ID3D11Device* device)
+bool TextClass::UpdateText(unsigned int handle, char* text, int positionX, int positionY, float red, float green, float blue)
 {
-	VertexType* vertices;
-	unsigned long* indices;
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-    D3D11_SUBRESOURCE_DATA vertexData, indexData;
-	HRESULT result;
-	int i;
+	TextObjectType* object;
+	D3DXVECTOR4 color;
 
 
-	// Create a new sentence object.
-	*sentence = new SentenceType;
-	if(!*sentence)
+	object = (TextObjectType*)m_Texts->Get(handle);
+	if(!object)
 	{
 		return false;
 	}
 
-	// Initialize the sentence buffers to null.
-	(*sentence)->vertexBuffer = 0;
-	(*sentence)->indexBuffer = 0;
+	color = D3DXVECTOR4(red, green, blue, 1.0f);
 
-	// Set the maximum length of the sentence.
-	(*sentence)->maxLength = maxLength;
+	// Text that is the same as last time keeps the glyphs it has and leaves the shared buffer alone.
+	if((object->text == text) && (object->positionX == positionX) && (object->positionY == positionY) && (object->color == color))
+	{
+		return true;
+	}
+
+	return BuildGlyphs(object, text, positionX, positionY, object->height, color);
+}
 
-	// Set the number of vertices in the vertex array.
-	(*sentence)->vertexCount = 6 * maxLength;
 
-	// Set the number of indexes in the index array.
-	(*sentence)->indexCount = (*sentence)->vertexCount;
+bool TextClass::SetTextVisible(unsigned int handle, bool visible)
+{
+	TextObjectType* object;
+
 
-	// Create the vertex array.
-	vertices = new VertexType[(*sentence)->vertexCount];
-	if(!vertices)
+	object = (TextObjectType*)m_Texts->Get(handle);
+	if(!object)
 	{
 		return false;
 	}
 
-	// Create the index array.
-	indices = new unsigned long[(*sentence)->indexCount];
-	if(!indices)
+	// Showing or hiding the text changes which glyphs are packed, but not the glyphs themselves.
+	if(object->visible != visible)
 	{
-		return false;
+		object->visible = visible;
+		m_layoutChanged = true;
 	}
 
-	// Initialize vertex array to zeros at first.
-	memset(vertices, 0, (sizeof(VertexType) * (*sentence)->vertexCount));
+	return true;
+}
 
-	// Initialize the index array.
-	for(i=0; i<(*sentence)->indexCount; i++)
-	{
-		indices[i] = i;
-	}
 
-	// Set up the description of the dynamic vertex buffer.
-    vertexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-    vertexBufferDesc.ByteWidth = sizeof(VertexType) * (*sentence)->vertexCount;
-    vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    vertexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    vertexBufferDesc.MiscFlags = 0;
-	vertexBufferDesc.StructureByteStride = 0;
+bool TextClass::SetTextHeight(unsigned int handle, int height)
+{
+	TextObjectType* object;
+	string text;
 
-	// Give the subresource structure a pointer to the vertex data.
-    vertexData.pSysMem = vertices;
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
 
-	// Create the vertex buffer.
-    result = device->CreateBuffer(&vertexBufferDesc, &vertexData, &(*sentence)->vertexBuffer);
-	if(FAILED(result))
+	object = (TextObjectType*)m_Texts->Get(handle);
+	if(!object || (height <= 0))
 	{
 		return false;
 	}
 
-	// Set up the description of the static index buffer.
-    indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-    indexBufferDesc.ByteWidth = sizeof(unsigned long) * (*sentence)->indexCount;
-    indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    indexBufferDesc.CPUAccessFlags = 0;
-    indexBufferDesc.MiscFlags = 0;
-	indexBufferDesc.StructureByteStride = 0;
+	if(object->height == height)
+	{
+		return true;
+	}
+
+	// Lay the same text out again at the new height, from a copy since the rebuild replaces the object's own.
+	text = object->text;
 
-	// Give the subresource structure a pointer to the index data.
-    indexData.pSysMem = indices;
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
+	return BuildGlyphs(object, (char*)text.c_str(), object->positionX, object->positionY, height, object->color);
+}
 
-	// Create the index buffer.
-	result = device->CreateBuffer(&indexBufferDesc, &indexData, &(*sentence)->indexBuffer);
-	if(FAILED(result))
+
+bool TextClass::DestroyText(unsigned int handle)
+{
+	TextObjectType* object;
+
+
+	object = (TextObjectType*)m_Texts->Get(handle);
+	if(!object)
 	{
 		return false;
 	}
 
-	// Release the vertex array as it is no longer needed.
-	delete [] vertices;
-	vertices = 0;
+	m_Texts->Remove(handle);
+
+	delete [] object->glyphs;
+	delete object;
 
-	// Release the index array as it is no longer needed.
-	delete [] indices;
-	indices = 0;
+	// The glyphs packed after the object's have to move down into the space it leaves.
+	m_layoutChanged = true;
 
 	return true;
 }
 
 
-bool TextClass::UpdateSentence(SentenceType* sentence, char* text, int positionX, int positionY, float red, float green, float blue,
-							   ID3D11DeviceContext* deviceContext)
+bool TextClass::Upload(ID3D11DeviceContext* deviceContext)
 {
-	int numLetters;
-	VertexType* vertices;
-	float drawX, drawY;
-	HRESULT result;
+	PROFILE_ZONE("TextClass::Upload");
 	D3D11_MAPPED_SUBRESOURCE mappedResource;
-	VertexType* verticesPtr;
-
+	TextObjectType* object;
+	VertexType::Glyph* glyphs;
+	HRESULT result;
+	bool changed;
+	int count, total, maxGlyphs, i;
 
-	// Store the color of the sentence.
-	sentence->red = red;
-	sentence->green = green;
-	sentence->blue = blue;
 
-	// Get the number of letters in the sentence.
-	numLetters = (int)strlen(text);
+	// The buffer is only repacked when some object is different from what it holds.
+	count = m_Texts->GetCount();
+	changed = m_layoutChanged;
+	for(i=0; (i<count) && !changed; i++)
+	{
+		changed = ((TextObjectType*)m_Texts->GetItem(i))->dirty;
+	}
 
-	// Check for possible buffer overflow.
-	if(numLetters > sentence->maxLength)
+	if(!changed)
 	{
-		return false;
+		return true;
 	}
 
-	// Create the vertex array.
-	vertices = new VertexType[sentence->vertexCount];
-	if(!vertices)
+	// Recreate the buffer at double the size until all the visible glyphs fit in it.
+	total = 0;
+	for(i=0; i<count; i++)
 	{
-		return false;
+		object = (TextObjectType*)m_Texts->GetItem(i);
+		if(object->visible)
+		{
+			total += object->glyphCount;
+		}
 	}
 
-	// Initialize vertex array to zeros at first.
-	memset(vertices, 0, (sizeof(VertexType) * sentence->vertexCount));
+	if(m_glyphBuffer && (total > m_maxGlyphs))
+	{
+		maxGlyphs = m_maxGlyphs;
+		while(total > maxGlyphs)
+		{
+			maxGlyphs *= 2;
+		}
 
-	// Calculate the X and Y pixel position on the screen to start drawing to.
-	drawX = (float)(((m_screenWidth / 2) * -1) + positionX);
-	drawY = (float)((m_screenHeight / 2) - positionY);
+		ShutdownBuffer();
 
-	// Use the font class to build the vertex array from the sentence text and sentence draw location.
-	m_Font->BuildVertexArray((void*)vertices, text, drawX, drawY);
+		if(!InitializeBuffer(maxGlyphs))
+		{
+			return false;
+		}
+	}
 
-	// Lock the vertex buffer so it can be written to.
-	result = deviceContext->Map(sentence->vertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	if(FAILED(result))
+	// Replace the whole buffer, so the driver can hand out fresh memory instead of waiting on the last draw.
+	glyphs = 0;
+	if(m_glyphBuffer)
 	{
-		return false;
+		result = deviceContext->Map(m_glyphBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+		if(FAILED(result))
+		{
+			return false;
+		}
+
+		glyphs = (VertexType::Glyph*)mappedResource.pData;
 	}
 
-	// Get a pointer to the data in the vertex buffer.
-	verticesPtr = (VertexType*)mappedResource.pData;
+	// Pack the visible objects one after another.
+	m_glyphCount = 0;
+	for(i=0; i<count; i++)
+	{
+		object = (TextObjectType*)m_Texts->GetItem(i);
+		object->dirty = false;
 
-	// Copy the data into the vertex buffer.
-	memcpy(verticesPtr, (void*)vertices, (sizeof(VertexType) * sentence->vertexCount));
+		if(!object->visible)
+		{
+			continue;
+		}
 
-	// Unlock the vertex buffer.
-	deviceContext->Unmap(sentence->vertexBuffer, 0);
+		if(glyphs)
+		{
+			memcpy(&glyphs[m_glyphCount], object->glyphs, sizeof(VertexType::Glyph) * object->glyphCount);
+		}
 
-	// Release the vertex array as it is no longer needed.
-	delete [] vertices;
-	vertices = 0;
+		m_glyphCount += object->glyphCount;
+	}
+
+	if(m_glyphBuffer)
+	{
+		deviceContext->Unmap(m_glyphBuffer, 0);
+	}
+
+	m_layoutChanged = false;
 
 	return true;
 }
 
 
-void TextClass::ReleaseSentence(SentenceType** sentence)
+bool TextClass::Render(ID3D11DeviceContext* deviceContext, D3DXMATRIX worldMatrix, D3DXMATRIX orthoMatrix)
 {
-	if(*sentence)
+	unsigned int stride, offset;
+	bool result;
+
+
+	// Bring the buffer up to date with any text that changed.
+	result = Upload(deviceContext);
+	if(!result)
 	{
-		// Release the sentence vertex buffer.
-		if((*sentence)->vertexBuffer)
+		return false;
+	}
+
+	if(m_glyphCount == 0)
+	{
+		return true;
+	}
+
+	// Set the glyph buffer stride and offset.
+	stride = sizeof(VertexType::Glyph);
+	offset = 0;
+
+	// Put the glyphs on the input assembler as instance data, with the corners of each quad coming from the vertex id.
+	deviceContext->IASetVertexBuffers(0, 1, &m_glyphBuffer, &stride, &offset);
+	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	// Draw every visible glyph with the font shader in one call.
+	return m_FontShader->Render(deviceContext, m_glyphCount, worldMatrix, m_baseViewMatrix, orthoMatrix, m_Font->GetTexture());
+}
+
+
+bool TextClass::Render(SoftwareRendererClass* renderer, D3DXMATRIX worldMatrix, D3DXMATRIX orthoMatrix)
+{
+	TextObjectType* object;
+	bool result;
+	int i;
+
+
+	// There is no buffer to pack, but the upload still brings the glyph count up to date.
+	result = Upload(0);
+	if(!result)
+	{
+		return false;
+	}
+
+	// Draw each visible object straight from its own glyphs, with the quads built the way the font shader builds them.
+	for(i=0; i<m_Texts->GetCount(); i++)
+	{
+		object = (TextObjectType*)m_Texts->GetItem(i);
+		if(!object->visible || (object->glyphCount == 0))
 		{
-			(*sentence)->vertexBuffer->Release();
-			(*sentence)->vertexBuffer = 0;
+			continue;
 		}
 
-		// Release the sentence index buffer.
-		if((*sentence)->indexBuffer)
+		result = renderer->RenderFont(object->glyphs, object->glyphCount, m_glyphMetrics, worldMatrix, m_baseViewMatrix, orthoMatrix,
+			m_Font->GetSoftwareTexture(), m_Font->IsDistanceField());
+		if(!result)
 		{
-			(*sentence)->indexBuffer->Release();
-			(*sentence)->indexBuffer = 0;
+			return false;
 		}
+	}
 
-		// Release the sentence.
-		delete *sentence;
-		*sentence = 0;
+	return true;
+}
+
+
+int TextClass::GetGlyphCount()
+{
+	return m_glyphCount;
+}
+
+
+bool TextClass::InitializeBuffer(int maxGlyphs)
+{
+	D3D11_BUFFER_DESC glyphBufferDesc;
+	HRESULT result;
+
+
+	// Set up the description of the dynamic buffer the objects' glyphs are packed into.
+	glyphBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	glyphBufferDesc.ByteWidth = sizeof(VertexType::Glyph) * maxGlyphs;
+	glyphBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	glyphBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	glyphBufferDesc.MiscFlags = 0;
+	glyphBufferDesc.StructureByteStride = 0;
+
+	result = m_device->CreateBuffer(&glyphBufferDesc, 0, &m_glyphBuffer);
+	if(FAILED(result))
+	{
+		m_glyphBuffer = 0;
+		return false;
 	}
 
-	return;
+	MemoryTrackerClass::AddBuffer(MemoryTrackerClass::TAG_TEXT, m_glyphBuffer);
+
+	m_maxGlyphs = maxGlyphs;
+
+	return true;
 }
 
 
-bool TextClass::RenderSentence(ID3D11DeviceContext* deviceContext, SentenceType* sentence, D3DXMATRIX worldMatrix, 
-							   D3DXMATRIX orthoMatrix)
+void TextClass::ShutdownBuffer()
 {
-	unsigned int stride, offset;
-	D3DXVECTOR4 pixelColor;
-	bool result;
+	// Release the glyph buffer.
+	if(m_glyphBuffer)
+	{
+		MemoryTrackerClass::RemoveBuffer(MemoryTrackerClass::TAG_TEXT, m_glyphBuffer);
+		m_glyphBuffer->Release();
+		m_glyphBuffer = 0;
+	}
 
+	m_glyphCount = 0;
+	m_maxGlyphs = 0;
 
-	// Set vertex buffer stride and offset.
-    stride = sizeof(VertexType); 
-	offset = 0;
+	return;
+}
 
-	// Set the vertex buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetVertexBuffers(0, 1, &sentence->vertexBuffer, &stride, &offset);
 
-    // Set the index buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetIndexBuffer(sentence->indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+bool TextClass::BuildGlyphs(TextObjectType* object, char* text, int positionX, int positionY, int height, D3DXVECTOR4 color)
+{
+	MEMORY_TAG(MemoryTrackerClass::TAG_TEXT);
+	int numLetters;
+	float drawX, drawY;
+	unsigned int packedColor;
 
-    // Set the type of primitive that should be rendered from this vertex buffer, in this case triangles.
-	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-	// Create a pixel color vector with the input sentence color.
-	pixelColor = D3DXVECTOR4(sentence->red, sentence->green, sentence->blue, 1.0f);
+	// Get the number of letters in the text.
+	numLetters = (int)strlen(text);
 
-	// Render the text using the font shader.
-	result = m_FontShader->Render(deviceContext, sentence->indexCount, worldMatrix, m_baseViewMatrix, orthoMatrix, m_Font->GetTexture(), 
-								  pixelColor);
-	if(!result)
+	// Grow the object's glyph array when the text is longer than any it has held.
+	if(numLetters > object->maxGlyphs)
 	{
-		false;
+		delete [] object->glyphs;
+		object->glyphCount = 0;
+		object->maxGlyphs = 0;
+
+		object->glyphs = new VertexType::Glyph[numLetters];
+		if(!object->glyphs)
+		{
+			return false;
+		}
+
+		object->maxGlyphs = numLetters;
 	}
 
+	// Keep what the glyphs are built from, to compare the next update against.
+	object->text = text;
+	object->positionX = positionX;
+	object->positionY = positionY;
+	object->height = height;
+	object->color = color;
+
+	// Calculate the X and Y pixel position on the screen to start drawing to.
+	drawX = (float)(((m_screenWidth / 2) * -1) + positionX);
+	drawY = (float)((m_screenHeight / 2) - positionY);
+
+	// Pack the color into a byte a channel, red first, the way the shader reads it back.
+	packedColor = ((unsigned int)(color.x * 255.0f + 0.5f)) | ((unsigned int)(color.y * 255.0f + 0.5f) << 8) |
+		((unsigned int)(color.z * 255.0f + 0.5f) << 16) | ((unsigned int)(color.w * 255.0f + 0.5f) << 24);
+
+	// Use the font class to lay out the glyphs, and mark the object for the next upload.
+	object->glyphCount = m_Font->BuildGlyphArray((void*)object->glyphs, text, drawX, drawY, packedColor, height);
+	object->dirty = true;
+
 	return true;
 }
\ No newline at end of file
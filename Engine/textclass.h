@@ -4,30 +4,67 @@
 #ifndef _TEXTCLASS_H_
 #define _TEXTCLASS_H_
 
+
+//////////////
+// INCLUDES //
+//////////////
+#include <string>
+using namespace std;
+
+
 ///////////////////////
 // MY CLASS INCLUDES //
 ///////////////////////
 #include "fontclass.h"
 #include "fontshaderclass.h"
+#include "softwarerendererclass.h"
+#include "handletableclass.h"
+#include "profilerclass.h"
+#include "memorytrackerclass.h"
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int TEXT_INITIAL_GLYPHS = 2048;
 
 
 ////////////////////////////////////////////////////////////////////////////////
 // Class name: TextClass
+// Keeps any number of text objects, each created once and then updated in
+// place through its handle.  An object keeps the glyphs it was last built
+// with, and UpdateText only rebuilds them when the string, position or color
+// actually changed, so text that stays the same costs a compare.
+//
+// All the visible objects share one dynamic buffer of glyphs, 16 bytes each
+// where the quads they stand for would take six vertices.  Upload packs them
+// into it with a single map, and only when an object was changed, shown,
+// hidden, created or destroyed since the last time, and Render draws the lot
+// in one instanced call with the font's texture.  The color travels with
+// each glyph so lines of different colors can share the draw.  The buffer
+// starts with room for TEXT_INITIAL_GLYPHS and is recreated at double the
+// size whenever the visible text outgrows it.
+//
+// Text is drawn at the font's own height unless SetTextHeight picks another,
+// which keeps its edges sharp with a distance field font and blurs them
+// with a bitmap one.
+//
+// Different objects can be updated from different threads at once, but
+// creating, destroying, uploading and rendering belong to the main thread.
+// Without a device there is no shared buffer, and the software renderer
+// draws each visible object straight from its own glyphs instead.
 ////////////////////////////////////////////////////////////////////////////////
 class TextClass
 {
 private:
-	struct SentenceType
+	struct TextObjectType
 	{
-		ID3D11Buffer *vertexBuffer, *indexBuffer;
-		int vertexCount, indexCount, maxLength;
-		float red, green, blue;
-	};
-
-	struct VertexType
-	{
-		D3DXVECTOR3 position;
-	    D3DXVECTOR2 texture;
+		string text;
+		int positionX, positionY, height;
+		D3DXVECTOR4 color;
+		VertexType::Glyph* glyphs;
+		int glyphCount, maxGlyphs;
+		bool visible, dirty;
 	};
 
 public:
@@ -35,23 +72,37 @@ public:
 	TextClass(const TextClass&);
 	~TextClass();
 
-	bool Initialize(ID3D11Device*, ID3D11DeviceContext*, HWND, int, int, D3DXMATRIX);
+	bool Initialize(ID3D11Device*, PipelineStateClass*, HWND, int, int, D3DXMATRIX);
 	void Shutdown();
+
+	unsigned int CreateText();
+	bool UpdateText(unsigned int, char*, int, int, float, float, float);
+	bool SetTextVisible(unsigned int, bool);
+	bool SetTextHeight(unsigned int, int);
+	bool DestroyText(unsigned int);
+
+	bool Upload(ID3D11DeviceContext*);
 	bool Render(ID3D11DeviceContext*, D3DXMATRIX, D3DXMATRIX);
+	bool Render(SoftwareRendererClass*, D3DXMATRIX, D3DXMATRIX);
+
+	int GetGlyphCount();
 
 private:
-	bool InitializeSentence(SentenceType**, int, ID3D11Device*);
-	bool UpdateSentence(SentenceType*, char*, int, int, float, float, float, ID3D11DeviceContext*);
-	void ReleaseSentence(SentenceType**);
-	bool RenderSentence(ID3D11DeviceContext*, SentenceType*, D3DXMATRIX, D3DXMATRIX);
+	bool InitializeBuffer(int);
+	void ShutdownBuffer();
+	bool BuildGlyphs(TextObjectType*, char*, int, int, int, D3DXVECTOR4);
 
 private:
 	FontClass* m_Font;
 	FontShaderClass* m_FontShader;
 	int m_screenWidth, m_screenHeight;
 	D3DXMATRIX m_baseViewMatrix;
-	SentenceType* m_sentence1;
-	SentenceType* m_sentence2;
+	D3DXVECTOR4 m_glyphMetrics[FONT_GLYPH_COUNT];
+	HandleTableClass* m_Texts;
+	ID3D11Device* m_device;
+	ID3D11Buffer* m_glyphBuffer;
+	int m_glyphCount, m_maxGlyphs;
+	bool m_layoutChanged;
 };
 
 #endif
\ No newline at end of file
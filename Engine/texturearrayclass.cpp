@@ -0,0 +1,272 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: texturearrayclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "texturearrayclass.h"
+
+
+TextureArrayClass::TextureArrayClass()
+{
+	m_device = 0;
+	m_deviceContext = 0;
+	m_groups = 0;
+}
+
+
+TextureArrayClass::TextureArrayClass(const TextureArrayClass& other)
+{
+}
+
+
+TextureArrayClass::~TextureArrayClass()
+{
+}
+
+
+bool TextureArrayClass::Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext)
+{
+	// Store the device the arrays are created on and the context their slices are copied with.
+	m_device = device;
+	m_deviceContext = deviceContext;
+
+	// Create the list of groups.
+	m_groups = new vector<GroupType>;
+	if(!m_groups)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+void TextureArrayClass::Shutdown()
+{
+	int i;
+
+
+	// Release the array and view of every group.
+	if(m_groups)
+	{
+		for(i=0; i<(int)m_groups->size(); i++)
+		{
+			if((*m_groups)[i].view)
+			{
+				(*m_groups)[i].view->Release();
+				(*m_groups)[i].view = 0;
+			}
+
+			if((*m_groups)[i].texture)
+			{
+				MemoryTrackerClass::RemoveTexture(MemoryTrackerClass::TAG_TEXTURES, (*m_groups)[i].desc);
+				(*m_groups)[i].texture->Release();
+				(*m_groups)[i].texture = 0;
+			}
+		}
+
+		delete m_groups;
+		m_groups = 0;
+	}
+
+	m_device = 0;
+	m_deviceContext = 0;
+
+	return;
+}
+
+
+bool TextureArrayClass::AddTexture(WCHAR* filename, int& group, int& slice)
+{
+	ID3D11Resource* resource;
+	ID3D11Texture2D* texture;
+	D3D11_TEXTURE2D_DESC desc;
+	GroupType newGroup;
+	GroupType* target;
+	HRESULT result;
+	bool success;
+	int mip;
+
+
+	// Load the texture in.
+	result = D3DX11CreateTextureFromFile(m_device, filename, NULL, NULL, &resource, NULL);
+	if(FAILED(result))
+	{
+		return false;
+	}
+
+	texture = (ID3D11Texture2D*)resource;
+	texture->GetDesc(&desc);
+
+	// Only plain two dimensional textures can become a slice.
+	if((desc.ArraySize != 1) || (desc.SampleDesc.Count != 1))
+	{
+		texture->Release();
+		return false;
+	}
+
+	// Find the group the texture belongs to, or start a new one.
+	group = FindGroup(desc);
+	if(group < 0)
+	{
+		newGroup.desc = desc;
+		newGroup.desc.ArraySize = 0;
+		newGroup.desc.Usage = D3D11_USAGE_DEFAULT;
+		newGroup.desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		newGroup.desc.CPUAccessFlags = 0;
+		newGroup.desc.MiscFlags = 0;
+		newGroup.texture = 0;
+		newGroup.view = 0;
+		newGroup.count = 0;
+
+		m_groups->push_back(newGroup);
+		group = (int)m_groups->size() - 1;
+	}
+
+	target = &(*m_groups)[group];
+
+	// Double the array when it is full.
+	if(target->count == (int)target->desc.ArraySize)
+	{
+		success = ResizeGroup(*target, (target->count == 0) ? TEXTURE_ARRAY_INITIAL_SIZE : target->count * 2);
+		if(!success)
+		{
+			texture->Release();
+			return false;
+		}
+	}
+
+	// Copy every mip level of the texture into the next slice.
+	slice = target->count;
+	for(mip=0; mip<(int)desc.MipLevels; mip++)
+	{
+		m_deviceContext->CopySubresourceRegion(target->texture, D3D11CalcSubresource(mip, slice, desc.MipLevels), 0, 0, 0, texture, mip, NULL);
+	}
+
+	target->count++;
+
+	// Release the loaded texture now that the array holds it.
+	texture->Release();
+	texture = 0;
+
+	return true;
+}
+
+
+bool TextureArrayClass::RemoveTexture(int group, int slice)
+{
+	// Only the slice added last can be given back, since the ones after it would have to move down.
+	if((group < 0) || (group >= (int)m_groups->size()) || (slice != (*m_groups)[group].count - 1))
+	{
+		return false;
+	}
+
+	// The slice's contents are simply left to be overwritten by the next texture the group takes.
+	(*m_groups)[group].count--;
+
+	return true;
+}
+
+
+int TextureArrayClass::GetGroupCount()
+{
+	return (int)m_groups->size();
+}
+
+
+ID3D11ShaderResourceView* TextureArrayClass::GetTexture(int group)
+{
+	return (*m_groups)[group].view;
+}
+
+
+int TextureArrayClass::FindGroup(D3D11_TEXTURE2D_DESC& desc)
+{
+	D3D11_TEXTURE2D_DESC* groupDesc;
+	int i;
+
+
+	// A texture fits a group with the same size, format and mips that still has room or can still grow.
+	for(i=0; i<(int)m_groups->size(); i++)
+	{
+		groupDesc = &(*m_groups)[i].desc;
+
+		if((groupDesc->Width == desc.Width) && (groupDesc->Height == desc.Height) && (groupDesc->Format == desc.Format) &&
+			(groupDesc->MipLevels == desc.MipLevels) && ((*m_groups)[i].count < D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION))
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+
+bool TextureArrayClass::ResizeGroup(GroupType& group, int size)
+{
+	D3D11_TEXTURE2D_DESC desc;
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+	ID3D11Texture2D* texture;
+	ID3D11ShaderResourceView* view;
+	HRESULT result;
+	int slice, mip;
+
+
+	if(size > D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION)
+	{
+		size = D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION;
+	}
+
+	// Create the larger array.
+	desc = group.desc;
+	desc.ArraySize = size;
+
+	result = m_device->CreateTexture2D(&desc, NULL, &texture);
+	if(FAILED(result))
+	{
+		return false;
+	}
+
+	// Setup the shader resource view over every slice and mip.
+	viewDesc.Format = desc.Format;
+	viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	viewDesc.Texture2DArray.MostDetailedMip = 0;
+	viewDesc.Texture2DArray.MipLevels = desc.MipLevels;
+	viewDesc.Texture2DArray.FirstArraySlice = 0;
+	viewDesc.Texture2DArray.ArraySize = size;
+
+	result = m_device->CreateShaderResourceView(texture, &viewDesc, &view);
+	if(FAILED(result))
+	{
+		texture->Release();
+		return false;
+	}
+
+	MemoryTrackerClass::AddTexture(MemoryTrackerClass::TAG_TEXTURES, desc);
+
+	// Copy the slices that are already in the group across.
+	for(slice=0; slice<group.count; slice++)
+	{
+		for(mip=0; mip<(int)desc.MipLevels; mip++)
+		{
+			m_deviceContext->CopySubresourceRegion(texture, D3D11CalcSubresource(mip, slice, desc.MipLevels), 0, 0, 0, group.texture,
+				D3D11CalcSubresource(mip, slice, desc.MipLevels), NULL);
+		}
+	}
+
+	// Replace the old array and its view.
+	if(group.view)
+	{
+		group.view->Release();
+	}
+
+	if(group.texture)
+	{
+		MemoryTrackerClass::RemoveTexture(MemoryTrackerClass::TAG_TEXTURES, group.desc);
+		group.texture->Release();
+	}
+
+	group.texture = texture;
+	group.view = view;
+	group.desc.ArraySize = size;
+
+	return true;
+}
@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: texturearrayclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _TEXTUREARRAYCLASS_H_
+#define _TEXTUREARRAYCLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <DXGI.h>
+#include <D3D11.h>
+#include <d3dx11tex.h>
+#include <vector>
+using namespace std;
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "memorytrackerclass.h"
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int TEXTURE_ARRAY_INITIAL_SIZE = 8;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: TextureArrayClass
+// Packs textures that have the same size, format and mip count into texture
+// arrays, so models that use different textures of one group can be drawn
+// with a single bind and a single draw call.  AddTexture loads a file and
+// returns the group it went into and its slice, which the model's vertices
+// carry to the pixel shader.  A caller that cannot use the slice it was
+// given hands it back with RemoveTexture before adding anything else.
+//
+// An array cannot be resized, so a full group is rebuilt at twice the size
+// and its slices are copied across on the GPU.  That replaces the group's
+// shader resource view, so it should be fetched with GetTexture at draw time
+// rather than kept.  A group that reaches the largest array size the
+// hardware allows is followed by a new group of the same kind.
+////////////////////////////////////////////////////////////////////////////////
+class TextureArrayClass
+{
+private:
+	struct GroupType
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		ID3D11Texture2D* texture;
+		ID3D11ShaderResourceView* view;
+		int count;
+	};
+
+public:
+	TextureArrayClass();
+	TextureArrayClass(const TextureArrayClass&);
+	~TextureArrayClass();
+
+	bool Initialize(ID3D11Device*, ID3D11DeviceContext*);
+	void Shutdown();
+
+	bool AddTexture(WCHAR*, int&, int&);
+	bool RemoveTexture(int, int);
+
+	int GetGroupCount();
+	ID3D11ShaderResourceView* GetTexture(int);
+
+private:
+	int FindGroup(D3D11_TEXTURE2D_DESC&);
+	bool ResizeGroup(GroupType&, int);
+
+private:
+	ID3D11Device* m_device;
+	ID3D11DeviceContext* m_deviceContext;
+	vector<GroupType>* m_groups;
+};
+
+#endif
@@ -32,6 +32,9 @@ bool TextureClass::Initialize(ID3D11Device* device, WCHAR* filename)
 		return false;
 	}
 
+	// Count the texture's estimated size against the texture budget.
+	MemoryTrackerClass::AddTexture(MemoryTrackerClass::TAG_TEXTURES, m_texture);
+
 	return true;
 }
 
@@ -41,6 +44,7 @@ void TextureClass::Shutdown()
 	// Release the texture resource.
 	if(m_texture)
 	{
+		MemoryTrackerClass::RemoveTexture(MemoryTrackerClass::TAG_TEXTURES, m_texture);
 		m_texture->Release();
 		m_texture = 0;
 	}
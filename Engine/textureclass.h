@@ -13,6 +13,12 @@
 #include <d3dx11tex.h>
 
 
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "memorytrackerclass.h"
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Class name: TextureClass
 ////////////////////////////////////////////////////////////////////////////////
@@ -6,6 +6,7 @@
 
 TextureShaderClass::TextureShaderClass()
 {
+	m_PipelineState = 0;
 	m_vertexShader = 0;
 	m_pixelShader = 0;
 	m_layout = 0;
@@ -24,11 +25,15 @@ TextureShaderClass::~TextureShaderClass()
 }
 
 
-bool TextureShaderClass::Initialize(ID3D11Device* device, HWND hwnd, WCHAR* vertexShader, WCHAR* pixelShader)
+bool TextureShaderClass::Initialize(ID3D11Device* device, PipelineStateClass* pipelineState, HWND hwnd, WCHAR* vertexShader,
+									WCHAR* pixelShader)
 {
 	bool result;
 
 
+	// Store the pipeline state object that state is shared and bound through.
+	m_PipelineState = pipelineState;
+
 	// Initialize the vertex and pixel shaders.
 	result = InitializeShader(device, hwnd, vertexShader, pixelShader);
 	if(!result)
@@ -51,6 +56,13 @@ void TextureShaderClass::Shutdown()
 
 bool TextureShaderClass::Render(ID3D11DeviceContext* deviceContext, int indexCount, D3DXMATRIX worldMatrix,
                                 D3DXMATRIX viewMatrix, D3DXMATRIX projectionMatrix, ID3D11ShaderResourceView* texture)
+{
+	return Render(deviceContext, indexCount, 0, worldMatrix, viewMatrix, projectionMatrix, texture);
+}
+
+
+bool TextureShaderClass::Render(ID3D11DeviceContext* deviceContext, int indexCount, int indexStart, D3DXMATRIX worldMatrix,
+                                D3DXMATRIX viewMatrix, D3DXMATRIX projectionMatrix, ID3D11ShaderResourceView* texture)
 {
 	bool result;
 
@@ -63,7 +75,7 @@ bool TextureShaderClass::Render(ID3D11DeviceContext* deviceContext, int indexCou
 	}
 
 	// Now render the prepared buffers with the shader.
-	RenderShader(deviceContext, indexCount);
+	RenderShader(deviceContext, indexCount, indexStart);
 
 	return true;
 }
@@ -206,9 +218,9 @@ bool TextureShaderClass::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR
     samplerDesc.MinLOD = 0;
     samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
 
-	// Create the texture sampler state.
-    result = device->CreateSamplerState(&samplerDesc, &m_sampleState);
-	if(FAILED(result))
+	// Get the texture sampler state from the cache, which shares it with any other shader that asks for the same one.
+    m_sampleState = m_PipelineState->GetSamplerState(&samplerDesc);
+	if(!m_sampleState)
 	{
 		return false;
 	}
@@ -219,12 +231,9 @@ bool TextureShaderClass::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR
 
 void TextureShaderClass::ShutdownShader()
 {
-	// Release the sampler state.
-	if(m_sampleState)
-	{
-		m_sampleState->Release();
-		m_sampleState = 0;
-	}
+	// The sampler state belongs to the pipeline state cache.
+	m_sampleState = 0;
+	m_PipelineState = 0;
 
 	// Release the matrix constant buffer.
 	if(m_matrixBuffer)
@@ -330,29 +339,29 @@ bool TextureShaderClass::SetShaderParameters(ID3D11DeviceContext* deviceContext,
 	bufferNumber = 0;
 
 	// Now set the constant buffer in the vertex shader with the updated values.
-    deviceContext->VSSetConstantBuffers(bufferNumber, 1, &m_matrixBuffer);
+    m_PipelineState->SetVSConstantBuffer(bufferNumber, m_matrixBuffer);
 
 	// Set shader texture resource in the pixel shader.
-	deviceContext->PSSetShaderResources(0, 1, &texture);
+	m_PipelineState->SetPSShaderResource(0, texture);
 
 	return true;
 }
 
 
-void TextureShaderClass::RenderShader(ID3D11DeviceContext* deviceContext, int indexCount)
+void TextureShaderClass::RenderShader(ID3D11DeviceContext* deviceContext, int indexCount, int indexStart)
 {
 	// Set the vertex input layout.
-	deviceContext->IASetInputLayout(m_layout);
+	m_PipelineState->SetInputLayout(m_layout);
 
     // Set the vertex and pixel shaders that will be used to render this triangle.
-    deviceContext->VSSetShader(m_vertexShader, NULL, 0);
-    deviceContext->PSSetShader(m_pixelShader, NULL, 0);
+    m_PipelineState->SetVertexShader(m_vertexShader);
+    m_PipelineState->SetPixelShader(m_pixelShader);
 
 	// Set the sampler state in the pixel shader.
-	deviceContext->PSSetSamplers(0, 1, &m_sampleState);
+	m_PipelineState->SetPSSampler(0, m_sampleState);
 
-	// Render the triangle.
-	deviceContext->DrawIndexed(indexCount, 0, 0);
+	// Render the triangles.
+	deviceContext->DrawIndexed(indexCount, indexStart, 0);
 
 	return;
 }
\ No newline at end of file
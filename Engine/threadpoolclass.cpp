@@ -0,0 +1,555 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: threadpoolclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "threadpoolclass.h"
+#include <algorithm>
+
+
+__declspec(thread) ThreadPoolClass* ThreadPoolClass::m_threadPool = 0;
+__declspec(thread) int ThreadPoolClass::m_threadIndex = -1;
+
+
+ThreadPoolClass::ThreadPoolClass()
+{
+	m_threads = 0;
+	m_queues = 0;
+	m_queueCount = 0;
+	m_mainJobs = 0;
+	m_pending = 0;
+	m_sleeping = 0;
+	m_shutdown = false;
+}
+
+
+ThreadPoolClass::ThreadPoolClass(const ThreadPoolClass& other)
+{
+}
+
+
+ThreadPoolClass::~ThreadPoolClass()
+{
+}
+
+
+bool ThreadPoolClass::Initialize(int threadCount)
+{
+	int i;
+
+
+	// Use one worker per hardware thread, leaving one for the thread that creates the pool.
+	if(threadCount < 0)
+	{
+		threadCount = (int)thread::hardware_concurrency() - 1;
+		if(threadCount < 0)
+		{
+			threadCount = 0;
+		}
+	}
+
+	// Create one deque per worker plus one for the main thread, which always uses the last one.
+	m_queueCount = threadCount + 1;
+	m_queues = new QueueType[m_queueCount];
+	if(!m_queues)
+	{
+		return false;
+	}
+
+	for(i=0; i<m_queueCount; i++)
+	{
+		m_queues[i].top = 0;
+		m_queues[i].bottom = 0;
+	}
+
+	m_mainJobs = new deque<JobType>;
+	if(!m_mainJobs)
+	{
+		return false;
+	}
+
+	m_pending = 0;
+	m_sleeping = 0;
+	m_shutdown = false;
+
+	// The creating thread is the main thread from now on.
+	m_threadPool = this;
+	m_threadIndex = m_queueCount - 1;
+
+	// Start the worker threads.  They sleep until the first jobs are pushed.
+	m_threads = new vector<thread>;
+	if(!m_threads)
+	{
+		return false;
+	}
+
+	for(i=0; i<threadCount; i++)
+	{
+		m_threads->push_back(thread(&ThreadPoolClass::WorkerThread, this, i));
+	}
+
+	return true;
+}
+
+
+void ThreadPoolClass::Shutdown()
+{
+	unsigned int i;
+
+
+	// Wake every worker and tell it to exit.
+	if(m_threads)
+	{
+		{
+			lock_guard<mutex> guard(m_lock);
+			m_shutdown = true;
+		}
+		m_wake.notify_all();
+
+		for(i=0; i<m_threads->size(); i++)
+		{
+			(*m_threads)[i].join();
+		}
+
+		delete m_threads;
+		m_threads = 0;
+	}
+
+	// Release the job queues.
+	if(m_mainJobs)
+	{
+		delete m_mainJobs;
+		m_mainJobs = 0;
+	}
+
+	if(m_queues)
+	{
+		delete [] m_queues;
+		m_queues = 0;
+	}
+
+	m_queueCount = 0;
+
+	if(m_threadPool == this)
+	{
+		m_threadPool = 0;
+		m_threadIndex = -1;
+	}
+
+	return;
+}
+
+
+void ThreadPoolClass::Submit(TaskFunction function, void* context, int index, CounterType* counter)
+{
+	JobType job;
+	int thread;
+
+
+	job.function = function;
+	job.context = context;
+	job.index = index;
+	job.counter = counter;
+
+	if(counter)
+	{
+		(*counter)++;
+	}
+
+	// Threads outside the pool have no deque, and a full deque takes no more, so those jobs run right away.
+	thread = GetThreadIndex();
+	if((thread < 0) || !Push(thread, job))
+	{
+		Execute(job);
+		return;
+	}
+
+	Wake();
+
+	return;
+}
+
+
+void ThreadPoolClass::SubmitMain(TaskFunction function, void* context, int index, CounterType* counter)
+{
+	JobType job;
+
+
+	job.function = function;
+	job.context = context;
+	job.index = index;
+	job.counter = counter;
+
+	if(counter)
+	{
+		(*counter)++;
+	}
+
+	// Any thread may queue work for the main thread, so this queue is locked.  It only holds the few jobs that
+	// must use the immediate context.
+	lock_guard<mutex> guard(m_mainLock);
+	m_mainJobs->push_back(job);
+
+	return;
+}
+
+
+void ThreadPoolClass::Wait(CounterType* counter)
+{
+	JobType job;
+	int thread;
+
+
+	// Run other jobs until the counter reaches zero rather than blocking, so a pool thread can wait on jobs
+	// that are still in its own deque.
+	thread = GetThreadIndex();
+	while(counter->load() > 0)
+	{
+		if((thread == m_queueCount - 1) && GetMainJob(job))
+		{
+			Execute(job);
+		}
+		else if((thread >= 0) && GetJob(thread, job))
+		{
+			Execute(job);
+		}
+		else
+		{
+			this_thread::yield();
+		}
+	}
+
+	return;
+}
+
+
+void ThreadPoolClass::RunMainJobs()
+{
+	JobType job;
+
+
+	if(!IsMainThread())
+	{
+		return;
+	}
+
+	while(GetMainJob(job))
+	{
+		Execute(job);
+	}
+
+	return;
+}
+
+
+void ThreadPoolClass::Run(TaskFunction function, void* context, int taskCount)
+{
+	CounterType counter;
+	JobType job;
+	int thread, i;
+
+
+	if(taskCount <= 0)
+	{
+		return;
+	}
+
+	counter = taskCount;
+	job.function = function;
+	job.context = context;
+	job.counter = &counter;
+
+	// Push the whole batch before waking the workers, so they wake once and steal from a full deque.  Tasks the
+	// deque has no room for run here.
+	thread = GetThreadIndex();
+	for(i=0; i<taskCount; i++)
+	{
+		job.index = i;
+		if((thread < 0) || !Push(thread, job))
+		{
+			Execute(job);
+		}
+	}
+
+	Wake();
+
+	// Work on the batch from this thread as well until every task is done.
+	Wait(&counter);
+
+	return;
+}
+
+
+void ThreadPoolClass::ParallelFor(RangeFunction function, void* context, int count, int grainSize)
+{
+	RangeType range;
+
+
+	if(count <= 0)
+	{
+		return;
+	}
+
+	// Run the loop a chunk of iterations per job, so tiny iterations do not cost a job each.
+	range.function = function;
+	range.context = context;
+	range.count = count;
+	range.grainSize = (grainSize > 0) ? grainSize : 1;
+
+	Run(&ThreadPoolClass::RangeTask, &range, (count + range.grainSize - 1) / range.grainSize);
+
+	return;
+}
+
+
+int ThreadPoolClass::GetThreadCount()
+{
+	return m_queueCount;
+}
+
+
+bool ThreadPoolClass::IsMainThread()
+{
+	return (m_threadPool == this) && (m_threadIndex == m_queueCount - 1);
+}
+
+
+void ThreadPoolClass::WorkerThread(int index)
+{
+	JobType job;
+	int spins;
+
+
+	m_threadPool = this;
+	m_threadIndex = index;
+
+	spins = 0;
+	while(true)
+	{
+		if(GetJob(index, job))
+		{
+			Execute(job);
+			spins = 0;
+			continue;
+		}
+
+		if(m_shutdown)
+		{
+			return;
+		}
+
+		// Spin a little in case more jobs are about to be pushed, before paying for a sleep and a wake.
+		spins++;
+		if(spins < THREAD_POOL_SPIN_COUNT)
+		{
+			this_thread::yield();
+			continue;
+		}
+
+		// Sleep until jobs are pushed.  Counting ourselves as asleep before looking at the pending count means a
+		// thread that pushes a job either sees us asleep and wakes us, or we see its job.
+		{
+			unique_lock<mutex> guard(m_lock);
+			m_sleeping++;
+			while(!m_shutdown && (m_pending == 0))
+			{
+				m_wake.wait(guard);
+			}
+			m_sleeping--;
+		}
+
+		spins = 0;
+	}
+}
+
+
+int ThreadPoolClass::GetThreadIndex()
+{
+	// Each thread knows which pool it belongs to and which deque is its own.
+	if(m_threadPool != this)
+	{
+		return -1;
+	}
+
+	return m_threadIndex;
+}
+
+
+void ThreadPoolClass::Execute(JobType& job)
+{
+	job.function(job.context, job.index);
+
+	// Finishing is the last thing done with the counter, since a waiting thread may release it right after.
+	if(job.counter)
+	{
+		(*job.counter)--;
+	}
+
+	return;
+}
+
+
+bool ThreadPoolClass::Push(int index, JobType& job)
+{
+	QueueType* queue;
+	long long bottom, top;
+
+
+	queue = &m_queues[index];
+	bottom = queue->bottom.load(memory_order_relaxed);
+	top = queue->top.load(memory_order_acquire);
+
+	// A full deque takes no more jobs.  Thieves only ever read slots between top and bottom, so the slot written
+	// here cannot be one a thief is still copying.
+	if(bottom - top >= THREAD_POOL_QUEUE_SIZE)
+	{
+		return false;
+	}
+
+	queue->jobs[bottom & (THREAD_POOL_QUEUE_SIZE - 1)] = job;
+
+	// Publish the job to thieves by moving the bottom past it.
+	atomic_thread_fence(memory_order_release);
+	queue->bottom.store(bottom + 1, memory_order_relaxed);
+
+	m_pending++;
+
+	return true;
+}
+
+
+bool ThreadPoolClass::Pop(int index, JobType& job)
+{
+	QueueType* queue;
+	long long bottom, top;
+	bool result;
+
+
+	// Claim the bottom job, then check whether a thief got to the same job first.
+	queue = &m_queues[index];
+	bottom = queue->bottom.load(memory_order_relaxed) - 1;
+	queue->bottom.store(bottom, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	top = queue->top.load(memory_order_relaxed);
+
+	if(top > bottom)
+	{
+		// The deque was empty.
+		queue->bottom.store(bottom + 1, memory_order_relaxed);
+		return false;
+	}
+
+	job = queue->jobs[bottom & (THREAD_POOL_QUEUE_SIZE - 1)];
+	result = true;
+
+	// The last job can be taken by a thief at the same time, so it is claimed with the same compare and swap
+	// the thieves use.
+	if(top == bottom)
+	{
+		result = queue->top.compare_exchange_strong(top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+		queue->bottom.store(bottom + 1, memory_order_relaxed);
+	}
+
+	if(result)
+	{
+		m_pending--;
+	}
+
+	return result;
+}
+
+
+bool ThreadPoolClass::Steal(int index, JobType& job)
+{
+	QueueType* queue;
+	long long bottom, top;
+
+
+	queue = &m_queues[index];
+	top = queue->top.load(memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	bottom = queue->bottom.load(memory_order_acquire);
+
+	if(top >= bottom)
+	{
+		return false;
+	}
+
+	// Copy the job before claiming it.  If another thread claimed it first the copy is thrown away.
+	job = queue->jobs[top & (THREAD_POOL_QUEUE_SIZE - 1)];
+	if(!queue->top.compare_exchange_strong(top, top + 1, memory_order_seq_cst, memory_order_relaxed))
+	{
+		return false;
+	}
+
+	m_pending--;
+
+	return true;
+}
+
+
+bool ThreadPoolClass::GetJob(int index, JobType& job)
+{
+	int i;
+
+
+	// Take the newest job from our own deque first, then steal the oldest from the others, starting with our
+	// neighbour so thieves spread out.
+	if(Pop(index, job))
+	{
+		return true;
+	}
+
+	for(i=1; i<m_queueCount; i++)
+	{
+		if(Steal((index + i) % m_queueCount, job))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+bool ThreadPoolClass::GetMainJob(JobType& job)
+{
+	lock_guard<mutex> guard(m_mainLock);
+
+	if(m_mainJobs->empty())
+	{
+		return false;
+	}
+
+	job = m_mainJobs->front();
+	m_mainJobs->pop_front();
+
+	return true;
+}
+
+
+void ThreadPoolClass::Wake()
+{
+	// Only take the lock when a worker is asleep, which is rare while the pool is busy.
+	if(m_sleeping > 0)
+	{
+		lock_guard<mutex> guard(m_lock);
+		m_wake.notify_all();
+	}
+
+	return;
+}
+
+
+void ThreadPoolClass::RangeTask(void* context, int chunk)
+{
+	RangeType* range;
+	int start, end;
+
+
+	range = (RangeType*)context;
+	start = chunk * range->grainSize;
+	end = min(start + range->grainSize, range->count);
+
+	range->function(range->context, start, end);
+
+	return;
+}
@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: threadpoolclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _THREADPOOLCLASS_H_
+#define _THREADPOOLCLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+using namespace std;
+
+
+/////////////
+// GLOBALS //
+/////////////
+const int THREAD_POOL_QUEUE_SIZE = 8192;
+const int THREAD_POOL_SPIN_COUNT = 64;
+const int THREAD_POOL_CACHE_LINE = 64;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: ThreadPoolClass
+// The engine's job system.  A job is a function, a context pointer and an
+// index, run once on whichever thread gets to it first.  There is a worker
+// per hardware thread besides the one that created the pool, which counts as
+// the main thread and runs jobs too whenever it waits.
+//
+// Every thread owns a Chase-Lev deque.  The owner pushes and pops jobs at
+// the bottom without locking, and threads that run dry steal from the top of
+// the others with a single compare and swap, so the only contention is
+// between thieves of the same deque.  Workers spin briefly when they find
+// nothing and then sleep until new jobs are pushed.
+//
+// A job may be given a counter, which goes up when it is submitted and down
+// when it finishes.  Wait runs other jobs until a counter reaches zero, which
+// is how a job waits for the jobs it depends on, from any pool thread.  Jobs
+// submitted with SubmitMain only ever run on the main thread, for work bound
+// to the immediate context, and run while the main thread waits or calls
+// RunMainJobs.  Run and ParallelFor split a loop into jobs and wait for them.
+////////////////////////////////////////////////////////////////////////////////
+class ThreadPoolClass
+{
+public:
+	typedef void (*TaskFunction)(void*, int);
+	typedef void (*RangeFunction)(void*, int, int);
+	typedef atomic<int> CounterType;
+
+private:
+	struct JobType
+	{
+		TaskFunction function;
+		void* context;
+		int index;
+		CounterType* counter;
+	};
+
+	// The owner works at the bottom and thieves take from the top, each on its own cache line.
+	struct QueueType
+	{
+		atomic<long long> top;
+		char topPadding[THREAD_POOL_CACHE_LINE];
+		atomic<long long> bottom;
+		char bottomPadding[THREAD_POOL_CACHE_LINE];
+		JobType jobs[THREAD_POOL_QUEUE_SIZE];
+	};
+
+	// A loop split into chunks of a few iterations, each chunk run as one job.
+	struct RangeType
+	{
+		RangeFunction function;
+		void* context;
+		int count;
+		int grainSize;
+	};
+
+public:
+	ThreadPoolClass();
+	ThreadPoolClass(const ThreadPoolClass&);
+	~ThreadPoolClass();
+
+	bool Initialize(int);
+	void Shutdown();
+
+	void Submit(TaskFunction, void*, int, CounterType*);
+	void SubmitMain(TaskFunction, void*, int, CounterType*);
+	void Wait(CounterType*);
+	void RunMainJobs();
+
+	void Run(TaskFunction, void*, int);
+	void ParallelFor(RangeFunction, void*, int, int);
+
+	int GetThreadCount();
+	bool IsMainThread();
+
+private:
+	void WorkerThread(int);
+	int GetThreadIndex();
+	void Execute(JobType&);
+	bool Push(int, JobType&);
+	bool Pop(int, JobType&);
+	bool Steal(int, JobType&);
+	bool GetJob(int, JobType&);
+	bool GetMainJob(JobType&);
+	void Wake();
+	static void RangeTask(void*, int);
+
+private:
+	vector<thread>* m_threads;
+	QueueType* m_queues;
+	int m_queueCount;
+
+	mutex m_mainLock;
+	deque<JobType>* m_mainJobs;
+
+	static __declspec(thread) ThreadPoolClass* m_threadPool;
+	static __declspec(thread) int m_threadIndex;
+
+	mutex m_lock;
+	condition_variable m_wake;
+	atomic<int> m_pending;
+	atomic<int> m_sleeping;
+	atomic<bool> m_shutdown;
+};
+
+#endif
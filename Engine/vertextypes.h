@@ -13,6 +13,22 @@ namespace VertexType
 		D3DXVECTOR2 texture;
 		D3DXVECTOR3 normal;
 	};
+
+	struct Textured
+	{
+		D3DXVECTOR3 position;
+		D3DXVECTOR2 texture;
+	};
+
+	// One glyph of text, from which the font shader builds its quad.  The
+	// glyph index is in the low 16 bits of glyph and its scale in the high 16,
+	// as 8.8 fixed point, and the color is a byte a channel, red first.
+	struct Glyph
+	{
+		D3DXVECTOR2 position;
+		unsigned int glyph;
+		unsigned int color;
+	};
 }
 
 #endif
\ No newline at end of file
@@ -133,6 +133,7 @@ void InputClass::Shutdown()
 
 bool InputClass::Frame()
 {
+	PROFILE_ZONE("InputClass::Frame");
 	bool result;
 
 
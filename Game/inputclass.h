@@ -20,6 +20,11 @@
 //////////////
 #include <dinput.h>
 
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "profilerclass.h"
+
 ////////////////////////////////////////////////////////////////////////////////
 // Class name: InputClass
 ////////////////////////////////////////////////////////////////////////////////
@@ -2,11 +2,78 @@
 // Filename: main.cpp
 ////////////////////////////////////////////////////////////////////////////////
 #include "systemclass.h"
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+
+#ifdef ENGINE_PROFILE
+// In profiling builds every heap allocation the game makes goes through the tracker, which also counts them for the
+// frame allocator.  The replacement lives here rather than in the engine library, so nothing else that links the
+// library, such as the benchmarks, pays for the headers and counters.
+void* operator new(size_t size)
+{
+	void* memory;
+
+
+	memory = MemoryTrackerClass::Allocate(size);
+	if(!memory)
+	{
+		throw bad_alloc();
+	}
+
+	return memory;
+}
+
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+
+void* operator new(size_t size, const nothrow_t&)
+{
+	return MemoryTrackerClass::Allocate(size);
+}
+
+
+void* operator new[](size_t size, const nothrow_t&)
+{
+	return MemoryTrackerClass::Allocate(size);
+}
+
+
+void operator delete(void* memory)
+{
+	MemoryTrackerClass::Free(memory);
+}
+
+
+void operator delete[](void* memory)
+{
+	MemoryTrackerClass::Free(memory);
+}
+
+
+void operator delete(void* memory, const nothrow_t&)
+{
+	MemoryTrackerClass::Free(memory);
+}
+
+
+void operator delete[](void* memory, const nothrow_t&)
+{
+	MemoryTrackerClass::Free(memory);
+}
+#endif
 
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pScmdline, int iCmdshow)
 {
 	SystemClass* System;
+	char* option;
+	int headlessTicks;
 	bool result;
 	
 	
@@ -17,11 +84,34 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pScmdline,
 		return 0;
 	}
 
+	// "-headless [ticks]" steps the simulation without a window as fast as it will go, for benchmarking.
+	headlessTicks = 0;
+	option = strstr(pScmdline, "-headless");
+	if(option)
+	{
+		headlessTicks = atoi(option + strlen("-headless"));
+		if(headlessTicks <= 0)
+		{
+			headlessTicks = HEADLESS_TICKS;
+		}
+	}
+
 	// Initialize and run the system object.
-	result = System->Initialize();
-	if(result)
+	if(headlessTicks > 0)
+	{
+		result = System->InitializeHeadless();
+		if(result)
+		{
+			System->RunHeadless(headlessTicks);
+		}
+	}
+	else
 	{
-		System->Run();
+		result = System->Initialize();
+		if(result)
+		{
+			System->Run();
+		}
 	}
 
 	// Shutdown and release the system object.
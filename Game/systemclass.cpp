@@ -3,12 +3,19 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include "systemclass.h"
 
-string uuid;
-
 SystemClass::SystemClass()
 {
 	m_Input = 0;
 	m_Graphics = 0;
+	m_Timer = 0;
+	m_headless = false;
+	m_accumulator = 0.0;
+	m_renderedX = 0.0f;
+	m_renderedY = 0.0f;
+	m_showProfile = false;
+	m_profileKeyDown = false;
+	m_traceKeyDown = false;
+	m_memoryKeyDown = false;
 }
 
 
@@ -31,6 +38,13 @@ bool SystemClass::Initialize()
 	int screenWidth, screenHeight;
 	bool result;
 
+	// Start the profiler first so every zone after it is recorded.
+	result = ProfilerClass::Initialize();
+	if(!result)
+	{
+		return false;
+	}
+
 	// Initialize the width and height of the screen to zero before sending the variables into the function.
 	screenWidth = 0;
 	screenHeight = 0;
@@ -67,17 +81,65 @@ bool SystemClass::Initialize()
 		return false;
 	}
 
-    //uuid = m_Graphics->LoadModelResource("../Engine/data/syn.bin", L"../Engine/data/syn.png");
-    uuid = m_Graphics->LoadModelResource("../Engine/data/swordOpt.bin", L"../Engine/data/sword.tif");
-    uuid = m_Graphics->LoadModelResource("../Engine/data/knightOpt.bin", L"../Engine/data/armor.jpg");
-    uuid = m_Graphics->LoadBitmapResource(L"../engine/data/seafloor.dds", 100, 100);
+	// Load the scene and start the simulation clock.
+	result = InitializeSimulation();
+	if(!result)
+	{
+		MessageBox(m_hwnd, L"Could not initialize the timer object.", L"Error", MB_OK);
+		return false;
+	}
 	
 	return true;
 }
 
 
+bool SystemClass::InitializeHeadless()
+{
+	bool result;
+
+
+	// Start the profiler first so every zone after it is recorded.
+	result = ProfilerClass::Initialize();
+	if(!result)
+	{
+		return false;
+	}
+
+	// There is no window or input without a screen, and the frames are drawn by the software renderer.
+	m_headless = true;
+
+	m_Graphics = new GraphicsClass;
+	if(!m_Graphics)
+	{
+		return false;
+	}
+
+	result = m_Graphics->InitializeHeadless(WINDOW_WIDTH, WINDOW_HEIGHT, -1);
+	if(!result)
+	{
+		return false;
+	}
+
+	// Load the same scene as the windowed mode and start the simulation clock.
+	result = InitializeSimulation();
+	if(!result)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
 void SystemClass::Shutdown()
 {
+	// Release the timer object.
+	if(m_Timer)
+	{
+		delete m_Timer;
+		m_Timer = 0;
+	}
+
 	// Release the graphics object.
 	if(m_Graphics)
 	{
@@ -95,7 +157,13 @@ void SystemClass::Shutdown()
 	}
 
 	// Shutdown the window.
-	ShutdownWindows();
+	if(!m_headless)
+	{
+		ShutdownWindows();
+	}
+
+	// Release the profiler's buffers.
+	ProfilerClass::Shutdown();
 	
 	return;
 }
@@ -135,6 +203,9 @@ void SystemClass::Run()
                 MessageBox(m_hwnd, L"Frame Processing Failed", L"Error", MB_OK);
 				done = true;
 			}
+
+			// Close the frame's zones into the profiler's summary.
+			PROFILE_FRAME();
 		}
 
         // Check if the user pressed escape and wants to quit.
@@ -149,105 +220,291 @@ void SystemClass::Run()
 }
 
 
+bool SystemClass::RunHeadless(int ticks)
+{
+	ofstream fout;
+	double seconds;
+	bool result;
+	int i;
+
+
+	// Step the simulation as fast as it will go, drawing every tick, with a steady turn standing in for the mouse.
+	m_Timer->Frame();
+	for(i=0; i<ticks; i++)
+	{
+		m_input.mouseMovedX = HEADLESS_MOUSE_SPEED;
+
+		Update(SIMULATION_TIMESTEP);
+
+		result = Render(1.0f);
+		if(!result)
+		{
+			return false;
+		}
+
+		PROFILE_FRAME();
+	}
+
+	m_Timer->Frame();
+	seconds = m_Timer->GetTime();
+
+	// Write the results next to the executable, with a trace of the last ticks and a memory report for a closer look.
+	fout.open("headless.txt");
+	if(fout.fail())
+	{
+		return false;
+	}
+
+	fout << "ticks: " << ticks << endl;
+	fout << "simulated seconds: " << ticks * SIMULATION_TIMESTEP << endl;
+	fout << "real seconds: " << seconds << endl;
+	fout << "ticks per second: " << (seconds > 0.0 ? ticks / seconds : 0.0) << endl;
+	fout << "ms per tick: " << (ticks > 0 ? seconds * 1000.0 / ticks : 0.0) << endl;
+	fout << "heap allocations in the last tick: " << FrameAllocatorClass::GetHeapAllocations() << endl;
+	fout.close();
+
+	ProfilerClass::ExportTrace("headless.json");
+	MemoryTrackerClass::WriteReport("headless_memory.txt");
+
+	return true;
+}
+
+
+bool SystemClass::InitializeSimulation()
+{
+	char* meshPaths[] = { "../Engine/data/swordOpt.bin", "../Engine/data/knightOpt.bin" };
+	WCHAR* texturePaths[] = { L"../Engine/data/sword.tif", L"../Engine/data/armor.jpg" };
+	vector<GraphicsClass::ModelHandleType> models;
+	GraphicsClass::BitmapHandleType bitmap;
+	bool result;
+
+
+	// Load the models side by side on the job system.
+    //m_Graphics->LoadModelResource("../Engine/data/syn.bin", L"../Engine/data/syn.png");
+    m_Graphics->LoadModelResources(2, meshPaths, texturePaths, models);
+    bitmap = m_Graphics->LoadBitmapResource(L"../engine/data/seafloor.dds", 100, 100);
+
+	// Start the simulation with the camera pulled back from the scene, and nothing drawn yet.
+	ZeroMemory(&m_currentState, sizeof(SimulationStateType));
+	m_currentState.zoom = -10.0f;
+	m_previousState = m_currentState;
+
+	ZeroMemory(&m_input, sizeof(SimulationInputType));
+	m_accumulator = 0.0;
+	m_renderedX = 0.0f;
+	m_renderedY = 0.0f;
+
+	// Create the timer that paces the simulation.
+	m_Timer = new TimerClass;
+	if(!m_Timer)
+	{
+		return false;
+	}
+
+	result = m_Timer->Initialize();
+	if(!result)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
 bool SystemClass::Frame()
 {
-    
+	PROFILE_ZONE("SystemClass::Frame");
+	double frameTime;
 	bool result;
-    
-    int mouseX, mouseY;
-    int mouseMovedX, mouseMovedY, mouseMovedZ;
-    float moveX, moveY;
-    const float moveSpeed = 0.05f;
 
-    static float rotateX = 0.0f;
-    static float rotateY = 0.0f;
-    static float rotateZ = 0.0f;
-    static float zoom = -10.0f;
 
-    mouseMovedX = 0;
-    mouseMovedY = 0;
-    mouseMovedZ = 0;
+	// Gather the input since the last frame.
+	result = ReadInput();
+	if(!result)
+	{
+		return false;
+	}
+
+	// Add the real time that passed to the time the simulation owes.  A long stall is cut short, or catching up
+	// would take longer than the stall did.
+	m_Timer->Frame();
+	frameTime = min(m_Timer->GetTime(), (double)MAX_FRAME_TIME);
+	m_accumulator += frameTime;
+
+	// Run as many whole ticks as fit in it, so the simulation moves at the same rate at any frame rate.
+	while(m_accumulator >= SIMULATION_TIMESTEP)
+	{
+		Update(SIMULATION_TIMESTEP);
+		m_accumulator -= SIMULATION_TIMESTEP;
+	}
 
-    moveX = 0;
-    moveY = 0;
+	// Draw the state part way between the last two ticks, by how far the leftover time reaches into the next one.
+	result = Render((float)(m_accumulator / SIMULATION_TIMESTEP));
+	if(!result)
+	{
+		return false;
+	}
     
+	return true;
+}
+
+
+bool SystemClass::ReadInput()
+{
+	PROFILE_ZONE("SystemClass::ReadInput");
+    int mouseMovedX, mouseMovedY, mouseMovedZ;
+	bool result;
+
+
 	// Do the input frame processing.
 	result = m_Input->Frame();
 	if(!result)
 	{
 		return false;
 	}
-    
-	// Get the location of the mouse from the input object,
-	m_Input->GetMouseLocation(mouseX, mouseY);
+
+	// Sum the mouse movement until a tick uses it.  Dragging turns the scene and the wheel zooms.
     m_Input->GetMouseMoved(mouseMovedX, mouseMovedY, mouseMovedZ);
 
-    if (!m_Input->IsLeftMouseDown())
+    if (m_Input->IsLeftMouseDown())
     {
-        mouseMovedX = 0;
-        mouseMovedY = 0;
+        m_input.mouseMovedX += mouseMovedX;
+        m_input.mouseMovedY += mouseMovedY;
     }
-    
-    // Update the rotation variable each frame.
-    rotateX -= (float)D3DX_PI * (mouseMovedX * 0.001f);
-    rotateY -= (float)D3DX_PI * (mouseMovedY * 0.001f);
+    m_input.mouseMovedZ += mouseMovedZ;
 
-    // Zoom out exponentially, and zoom in logarithmically
-    if (zoom > 0)
+	// The movement keys are held, so every tick moves by them.
+    m_input.moveX = 0.0f;
+    m_input.moveY = 0.0f;
+
+    if (m_Input->IsPressed(DIK_W))
     {
-        zoom += mouseMovedZ * (abs(zoom) * 0.08f);
+        m_input.moveY = 1.0f;
     }
-    else
+    if (m_Input->IsPressed(DIK_A))
     {
-        zoom += mouseMovedZ * (abs(zoom) * 0.00064f);
+        m_input.moveX = -1.0f;
     }
-    if (zoom > -0.00001)
+    if (m_Input->IsPressed(DIK_S))
     {
-        zoom = -0.00001f;
+        m_input.moveY = -1.0f;
+    }
+    if (m_Input->IsPressed(DIK_D))
+    {
+        m_input.moveX = 1.0f;
     }
 
-    // Reset rotations after a full 360-degree rotation
-    if (rotateX > (float)D3DX_PI * 2)
-	{
-		rotateX -= (float)D3DX_PI * 2;
-	}
-    else if (rotateX < -(float)D3DX_PI * 2)
+    // F1 shows or hides the profiler summary, F2 saves a trace of the recent frames, and F3 saves a memory report.
+    if (m_Input->IsPressed(DIK_F1) && !m_profileKeyDown)
     {
-        rotateX += (float)D3DX_PI * 2;
+        m_showProfile = !m_showProfile;
+        m_Graphics->ShowProfile(m_showProfile);
     }
-    if (rotateY > (float)D3DX_PI * 2)
+    m_profileKeyDown = m_Input->IsPressed(DIK_F1);
+
+    if (m_Input->IsPressed(DIK_F2) && !m_traceKeyDown)
     {
-        rotateY -= (float)D3DX_PI * 2;
+        ProfilerClass::ExportTrace("profile.json");
     }
-    else if (rotateY < -(float)D3DX_PI * 2)
+    m_traceKeyDown = m_Input->IsPressed(DIK_F2);
+
+    if (m_Input->IsPressed(DIK_F3) && !m_memoryKeyDown)
     {
-        rotateY += (float)D3DX_PI * 2;
+        MemoryTrackerClass::WriteReport("memory.txt");
     }
+    m_memoryKeyDown = m_Input->IsPressed(DIK_F3);
 
-    if (m_Input->IsPressed(DIK_W))
+	return true;
+}
+
+
+void SystemClass::Update(float timeStep)
+{
+	PROFILE_ZONE("SystemClass::Update");
+	SimulationStateType* state;
+
+
+	// Keep the state the tick starts from for interpolation.
+	m_previousState = m_currentState;
+	state = &m_currentState;
+
+    // Turn by the mouse movement gathered since the last tick.
+    state->rotateX -= (float)D3DX_PI * (m_input.mouseMovedX * 0.001f);
+    state->rotateY -= (float)D3DX_PI * (m_input.mouseMovedY * 0.001f);
+
+    // Zoom out exponentially, and zoom in logarithmically
+    if (state->zoom > 0)
     {
-        moveY = moveSpeed;
+        state->zoom += m_input.mouseMovedZ * (abs(state->zoom) * 0.08f);
     }
-    if (m_Input->IsPressed(DIK_A))
+    else
     {
-        moveX = -moveSpeed;
+        state->zoom += m_input.mouseMovedZ * (abs(state->zoom) * 0.00064f);
     }
-    if (m_Input->IsPressed(DIK_S))
+    if (state->zoom > -0.00001)
     {
-        moveY = -moveSpeed;
+        state->zoom = -0.00001f;
     }
-    if (m_Input->IsPressed(DIK_D))
+
+    m_input.mouseMovedX = 0;
+    m_input.mouseMovedY = 0;
+    m_input.mouseMovedZ = 0;
+
+    // Move at a fixed speed per second.
+    state->positionX += m_input.moveX * MOVE_SPEED * timeStep;
+    state->positionY += m_input.moveY * MOVE_SPEED * timeStep;
+
+    // Reset rotations after a full 360-degree rotation.  The previous state moves with them, so the
+    // interpolation between the two does not spin back the long way.
+    if (state->rotateX > (float)D3DX_PI * 2)
+	{
+		state->rotateX -= (float)D3DX_PI * 2;
+		m_previousState.rotateX -= (float)D3DX_PI * 2;
+	}
+    else if (state->rotateX < -(float)D3DX_PI * 2)
+    {
+        state->rotateX += (float)D3DX_PI * 2;
+		m_previousState.rotateX += (float)D3DX_PI * 2;
+    }
+    if (state->rotateY > (float)D3DX_PI * 2)
+    {
+        state->rotateY -= (float)D3DX_PI * 2;
+		m_previousState.rotateY -= (float)D3DX_PI * 2;
+    }
+    else if (state->rotateY < -(float)D3DX_PI * 2)
     {
-        moveX = moveSpeed;
+        state->rotateY += (float)D3DX_PI * 2;
+		m_previousState.rotateY += (float)D3DX_PI * 2;
     }
 
-	// Do the frame processing for the graphics object.
-	result = m_Graphics->Frame(rotateX, rotateY, rotateZ, zoom, moveX, moveY);
+	return;
+}
+
+
+bool SystemClass::Render(float blend)
+{
+	SimulationStateType state;
+	bool result;
+
+
+	// Blend the last two ticks.
+	state.rotateX = m_previousState.rotateX + (m_currentState.rotateX - m_previousState.rotateX) * blend;
+	state.rotateY = m_previousState.rotateY + (m_currentState.rotateY - m_previousState.rotateY) * blend;
+	state.rotateZ = m_previousState.rotateZ + (m_currentState.rotateZ - m_previousState.rotateZ) * blend;
+	state.zoom = m_previousState.zoom + (m_currentState.zoom - m_previousState.zoom) * blend;
+	state.positionX = m_previousState.positionX + (m_currentState.positionX - m_previousState.positionX) * blend;
+	state.positionY = m_previousState.positionY + (m_currentState.positionY - m_previousState.positionY) * blend;
+
+	// Do the frame processing for the graphics object.  The camera is moved by the distance since the last drawn frame.
+	result = m_Graphics->Frame(state.rotateX, state.rotateY, state.rotateZ, state.zoom, state.positionX - m_renderedX, state.positionY - m_renderedY);
 	if(!result)
 	{
 		return false;
 	}
-    
+
+	m_renderedX = state.positionX;
+	m_renderedY = state.positionY;
+
 	return true;
 }
 
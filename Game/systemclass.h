@@ -27,28 +27,57 @@
 ///////////////////////
 #include "inputclass.h"
 #include "graphicsclass.h"
+#include "timerclass.h"
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
 
+const float SIMULATION_TIMESTEP = 1.0f / 60.0f;
+const float MAX_FRAME_TIME = 0.25f;
+const float MOVE_SPEED = 3.0f;
+const int HEADLESS_TICKS = 1000;
+const int HEADLESS_MOUSE_SPEED = 4;
+
 ////////////////////////////////////////////////////////////////////////////////
 // Class name: SystemClass
 ////////////////////////////////////////////////////////////////////////////////
 class SystemClass
 {
+private:
+	// Everything the simulation moves each tick.  Rendering blends the last two ticks' states.
+	struct SimulationStateType
+	{
+		float rotateX, rotateY, rotateZ;
+		float zoom;
+		float positionX, positionY;
+	};
+
+	// The input gathered since the last tick.  Mouse movement is summed until a tick uses it.
+	struct SimulationInputType
+	{
+		int mouseMovedX, mouseMovedY, mouseMovedZ;
+		float moveX, moveY;
+	};
+
 public:
 	SystemClass();
 	SystemClass(const SystemClass&);
 	~SystemClass();
 
 	bool Initialize();
+	bool InitializeHeadless();
 	void Shutdown();
 	void Run();
+	bool RunHeadless(int);
 
 	LRESULT CALLBACK MessageHandler(HWND, UINT, WPARAM, LPARAM);
 
 private:
+	bool InitializeSimulation();
 	bool Frame();
+	bool ReadInput();
+	void Update(float);
+	bool Render(float);
 	void InitializeWindows(int&, int&);
 	void ShutdownWindows();
 
@@ -56,9 +85,17 @@ private:
 	LPCWSTR m_applicationName;
 	HINSTANCE m_hinstance;
 	HWND m_hwnd;
+	bool m_headless;
 
 	InputClass* m_Input;
 	GraphicsClass* m_Graphics;
+	TimerClass* m_Timer;
+
+	SimulationStateType m_previousState, m_currentState;
+	SimulationInputType m_input;
+	double m_accumulator;
+	float m_renderedX, m_renderedY;
+	bool m_showProfile, m_profileKeyDown, m_traceKeyDown, m_memoryKeyDown;
 };
 
 
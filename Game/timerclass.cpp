@@ -0,0 +1,70 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: timerclass.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "timerclass.h"
+
+
+TimerClass::TimerClass()
+{
+	m_frequency = 0.0;
+	m_frameTime = 0.0;
+}
+
+
+TimerClass::TimerClass(const TimerClass& other)
+{
+}
+
+
+TimerClass::~TimerClass()
+{
+}
+
+
+bool TimerClass::Initialize()
+{
+	LARGE_INTEGER frequency;
+
+
+	// Check that the system has a high frequency counter to time with.
+	QueryPerformanceFrequency(&frequency);
+	if(frequency.QuadPart == 0)
+	{
+		return false;
+	}
+
+	m_frequency = (double)frequency.QuadPart;
+
+	// Start timing from now.
+	QueryPerformanceCounter(&m_startTime);
+	m_lastTime = m_startTime;
+	m_frameTime = 0.0;
+
+	return true;
+}
+
+
+void TimerClass::Frame()
+{
+	LARGE_INTEGER currentTime;
+
+
+	// Find the seconds since the last frame.
+	QueryPerformanceCounter(&currentTime);
+	m_frameTime = (double)(currentTime.QuadPart - m_lastTime.QuadPart) / m_frequency;
+	m_lastTime = currentTime;
+
+	return;
+}
+
+
+double TimerClass::GetTime()
+{
+	return m_frameTime;
+}
+
+
+double TimerClass::GetTotalTime()
+{
+	return (double)(m_lastTime.QuadPart - m_startTime.QuadPart) / m_frequency;
+}
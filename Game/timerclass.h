@@ -0,0 +1,37 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: timerclass.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _TIMERCLASS_H_
+#define _TIMERCLASS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <windows.h>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: TimerClass
+// Measures the time between calls to Frame with the performance counter.
+////////////////////////////////////////////////////////////////////////////////
+class TimerClass
+{
+public:
+	TimerClass();
+	TimerClass(const TimerClass&);
+	~TimerClass();
+
+	bool Initialize();
+	void Frame();
+
+	double GetTime();
+	double GetTotalTime();
+
+private:
+	double m_frequency;
+	LARGE_INTEGER m_startTime, m_lastTime;
+	double m_frameTime;
+};
+
+#endif